@@ -0,0 +1,83 @@
+#include <string.h>
+#include <unistd.h>
+#include <esp_timer.h>
+
+#include "animation.h"
+
+AnimationStream::AnimationStream() :
+    cancelled(false),
+    lastFrameUs(0),
+    totalDecodeUs(0),
+    stats()
+{
+}
+
+bool AnimationStream::begin()
+{
+    return decoder.begin() && ring.begin();
+}
+
+// New animation: empty ring and statistics. Only while nothing is playing.
+void AnimationStream::start()
+{
+    ring.clear();
+    stats = AnimationStats();
+    totalDecodeUs = 0;
+    cancelled = false;
+    decoder.reset(this);
+    lastFrameUs = esp_timer_get_time();
+}
+
+// Play the same source again from its first byte
+void AnimationStream::rewind()
+{
+    stats.loops++;
+    decoder.reset(this);
+    lastFrameUs = esp_timer_get_time();
+}
+
+// Decode the next bytes of the source, false once it is broken or cancelled.
+// Bytes after the end of the GIF are ignored, see finished().
+bool AnimationStream::write(const uint8_t *data, size_t len)
+{
+    return !cancelled && decoder.write(data, len);
+}
+
+void AnimationStream::played()
+{
+    ring.release();
+    stats.played++;
+}
+
+AnimationStats AnimationStream::getStats() const
+{
+    AnimationStats copy = stats;
+    if (copy.decoded)
+        copy.avgDecodeUs = totalDecodeUs / copy.decoded;
+    return copy;
+}
+
+// Decoder callback: queue the frame, waiting for the render side to free a slot
+bool AnimationStream::frame(const uint8_t *rgb, uint16_t delayMs)
+{
+    uint32_t decodeUs = esp_timer_get_time() - lastFrameUs;
+    RingFrame *slot;
+    while (!(slot = ring.acquire()))
+    {
+        if (cancelled)
+            return false;
+        usleep(ANIMATION_WAIT_MS * 1000);
+    }
+    if (cancelled)
+        return false;
+    memcpy(slot->rgb, rgb, sizeof(slot->rgb));
+    slot->delayMs = delayMs;
+    ring.publish();
+
+    stats.decoded++;
+    totalDecodeUs += decodeUs;
+    if (decodeUs > stats.maxDecodeUs)
+        stats.maxDecodeUs = decodeUs;
+    lastFrameUs = esp_timer_get_time();
+    return true;
+}
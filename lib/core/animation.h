@@ -0,0 +1,61 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "framering.h"
+#include "gifdecoder.h"
+#include "httpssession.h"
+
+#define ANIMATION_WAIT_MS 5 // producer poll interval while the ring is full
+
+struct AnimationStats
+{
+    uint32_t decoded;
+    uint32_t loops;
+    uint32_t avgDecodeUs; // per frame, reading the source included, waiting for ring space not
+    uint32_t maxDecodeUs;
+    uint32_t played;
+    uint32_t underruns; // frames that were due while the ring was empty
+};
+
+// Streaming animated emoji: a producer task pushes GIF bytes in with write() as they are read
+// from flash or the network, decoded frames queue up in a small ring and the render side
+// takes them out with next()/played() when their delay is up. Memory stays the same for any
+// length of animation; the producer waits while the ring is full. Doubles as the body sink of
+// a streaming HttpsSession::get.
+class AnimationStream : public GifFrameSink, public HttpsBodySink {
+    public:
+        AnimationStream();
+        bool begin();
+
+        // producer
+        void start();
+        void rewind();
+        bool write(const uint8_t *data, size_t len) override;
+        bool finished() const { return decoder.finished(); }
+        const char *getError() const { return decoder.getError(); }
+
+        void cancel() { cancelled = true; }
+        bool isCancelled() const { return cancelled; }
+
+        // consumer
+        const RingFrame *next() { return ring.peek(); }
+        void played();
+        void underrun() { stats.underruns++; }
+
+        AnimationStats getStats() const;
+        bool frame(const uint8_t *rgb, uint16_t delayMs) override;
+
+    private:
+        GifDecoder decoder;
+        FrameRing ring;
+        std::atomic<bool> cancelled;
+        int64_t lastFrameUs;
+        uint64_t totalDecodeUs;
+        AnimationStats stats;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include <math.h>
+
+#include "colorlut.h"
+
+// 4x4 Bayer matrix, thresholds 0..15 spread evenly over a dither cell
+static const uint8_t bayer[16] = {0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5};
+
+ColorLut::ColorLut() :
+    phase(0),
+    shift(8),
+    droppedBits(0),
+    maxLevel(255),
+    temporal(false)
+{
+    // identity until build()
+    for (int c = 0; c < 3; c++)
+    {
+        for (int i = 0; i < 256; i++)
+            table[c][i] = i << 8;
+    }
+    for (int p = 0; p < COLOR_TEMPORAL_PHASES; p++)
+    {
+        for (int i = 0; i < 16; i++)
+            threshold[p][i] = 128;
+    }
+}
+
+void ColorLut::build(const ColorSettings &settings, uint8_t brightness)
+{
+    float gamma = settings.gamma / 10.0f;
+    for (int c = 0; c < 3; c++)
+    {
+        float scale = 255.0f * 256.0f * settings.whiteBalance[c] / 255.0f;
+        for (int i = 0; i < 256; i++)
+            table[c][i] = (uint16_t)(powf(i / 255.0f, gamma) * scale + 0.5f);
+    }
+
+    // the driver only shows the top depthBits of a value, and each halving of the
+    // brightness leaves the shortest remaining bit plane dark
+    uint8_t depthBits = settings.depthBits ? settings.depthBits : COLOR_DEPTH_BITS;
+    droppedBits = depthBits < COLOR_DEPTH_BITS ? COLOR_DEPTH_BITS - depthBits : 0;
+    for (uint8_t planes = 0; settings.dither && droppedBits < COLOR_DEPTH_BITS - 1 && brightness < (256 >> (planes + 1)); planes++)
+        droppedBits++;
+    shift = 8 + droppedBits;
+    maxLevel = 255 >> droppedBits;
+    // the second phase uses the opposite half of the thresholds at every position, so
+    // the two frames average to twice the spatial resolution
+    temporal = settings.dither && settings.temporal;
+    for (int p = 0; p < COLOR_TEMPORAL_PHASES; p++)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            uint8_t rank = temporal ? (bayer[i] + p * 16 / COLOR_TEMPORAL_PHASES) & 15 : bayer[i];
+            threshold[p][i] = settings.dither ? (2 * rank + 1) << (shift - 5) : 1 << (shift - 1);
+        }
+    }
+}
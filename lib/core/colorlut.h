@@ -0,0 +1,54 @@
+#ifndef COLORLUT_H
+#define COLORLUT_H
+
+#include <stdint.h>
+
+#define COLOR_GAMMA_MIN 10 // tenths, 1.0 is linear
+#define COLOR_GAMMA_MAX 30
+#define COLOR_DEPTH_BITS 8 // bit planes the HUB75 driver shows at most (PIXEL_COLOR_DEPTH_BITS)
+#define COLOR_DEPTH_MIN 4
+#define COLOR_TEMPORAL_PHASES 2 // one dither pattern per DMA buffer
+
+// How framebuffer sRGB values become LED drive levels
+struct ColorSettings
+{
+    uint8_t gamma;           // tenths
+    uint8_t whiteBalance[3]; // per channel scale, 255 is full
+    bool dither;
+    bool temporal;           // alternate complementary dither patterns from frame to frame
+    uint8_t depthBits;       // bit planes the driver was configured with
+};
+
+// Per channel gamma and white balance tables, rebuilt only when the settings or the
+// brightness change, so the commit loop is three lookups, an add and a shift per pixel.
+// At reduced brightness the driver's lowest bit planes are too short to light up; with
+// dithering on, the levels they carried come back as a 4x4 ordered pattern of the
+// planes that are still visible, and so do the planes a reduced color depth leaves out.
+// Temporal dithering gives every phase the complementary pattern, so each pixel also
+// alternates between the two levels around its exact value from one frame to the next.
+class ColorLut {
+    public:
+        ColorLut();
+        void build(const ColorSettings &settings, uint8_t brightness);
+        uint8_t getDroppedBits() const { return droppedBits; }
+        bool isTemporal() const { return temporal; }
+        void setPhase(uint8_t phase) { this->phase = phase % COLOR_TEMPORAL_PHASES; }
+
+        // corrected drive level of channel c (0 R, 1 G, 2 B) for a pixel at x, y
+        inline uint8_t apply(int c, uint8_t value, int16_t x, int16_t y) const
+        {
+            uint32_t level = (table[c][value] + threshold[phase][(y & 3) << 2 | (x & 3)]) >> shift;
+            return level > maxLevel ? 255 : level << droppedBits;
+        }
+
+    private:
+        uint16_t table[3][256];                         // linear drive level * 256
+        uint16_t threshold[COLOR_TEMPORAL_PHASES][16];  // ordered dither offsets, or plain rounding
+        uint8_t phase;
+        uint8_t shift;
+        uint8_t droppedBits;
+        uint32_t maxLevel;
+        bool temporal;
+};
+
+#endif
@@ -0,0 +1,314 @@
+#include <string.h>
+
+#include "display.h"
+
+static int clampSegment(int value)
+{
+    return value < 0 ? 0 : (value > 63 ? 63 : value);
+}
+
+Display::Display() :
+    panel(NULL),
+    frame(DISPLAY_WIDTH, DISPLAY_HEIGHT),
+    committed(DISPLAY_WIDTH, DISPLAY_HEIGHT),
+    strip(MARQUEE_MAX_WIDTH, MARQUEE_HEIGHT),
+    stripReady(false),
+    marqueeWidth(0),
+    doubleBuffered(false),
+    fullRedraw(false),
+    phase(0),
+    lastCommitPixels(0),
+    stats()
+{
+    for (int16_t y = 0; y < DISPLAY_HEIGHT; y++)
+    {
+        pendingStart[y] = DISPLAY_WIDTH;
+        pendingEnd[y] = -1;
+    }
+}
+
+// Allocate the back buffer. doubleBuffered requires the driver to be configured with double_buff.
+// Without memory for the marquee strip long text is wrapped instead.
+bool Display::begin(MatrixPanel_I2S_DMA *panel, bool doubleBuffered)
+{
+    this->panel = panel;
+    this->doubleBuffered = doubleBuffered;
+    stripReady = strip.begin();
+    return frame.begin() && committed.begin();
+}
+
+// Switch to a restarted driver. It shows nothing yet, the next commit draws the current
+// frame into both of its DMA buffers. NULL while there is no driver running: drawing goes
+// on off-screen and commits write nothing until the next driver is set.
+void Display::setPanel(MatrixPanel_I2S_DMA *panel, bool doubleBuffered)
+{
+    this->panel = panel;
+    this->doubleBuffered = doubleBuffered;
+    phase = 0;
+    invalidate();
+}
+
+// Push the composed frame to the panel, color corrected, and return the number of pixels written.
+// Only rows inside the dirty box are diffed against the last committed frame, and only
+// the changed span of each row is written. With a double buffered driver the hidden DMA
+// buffer is one frame behind, so the previous commit's spans are written again too, then
+// the buffers are flipped at the end of the current refresh.
+uint32_t Display::commit()
+{
+    if (!panel)
+        return 0;
+    Rect dirty = frame.dirtyRect();
+    uint32_t pixels = 0;
+    color.setPhase(phase);
+    for (int16_t y = 0; y < DISPLAY_HEIGHT; y++)
+    {
+        int16_t start = DISPLAY_WIDTH;
+        int16_t end = -1;
+        if (fullRedraw)
+        {
+            start = 0;
+            end = DISPLAY_WIDTH - 1;
+            memcpy(committed.row(y), frame.row(y), DISPLAY_WIDTH * 3);
+        }
+        else if (!dirty.empty() && y >= dirty.y0 && y <= dirty.y1)
+        {
+            const uint8_t *next = frame.row(y);
+            uint8_t *last = committed.row(y);
+            for (int16_t x = dirty.x0; x <= dirty.x1; x++)
+            {
+                if (memcmp(&next[x * 3], &last[x * 3], 3))
+                {
+                    if (start > x)
+                        start = x;
+                    end = x;
+                }
+            }
+            if (end >= start)
+                memcpy(&last[start * 3], &next[start * 3], (end - start + 1) * 3);
+        }
+
+        int16_t writeStart = start;
+        int16_t writeEnd = end;
+        if (doubleBuffered)
+        {
+            writeStart = pendingStart[y] < start ? pendingStart[y] : start;
+            writeEnd = pendingEnd[y] > end ? pendingEnd[y] : end;
+            pendingStart[y] = start;
+            pendingEnd[y] = end;
+        }
+
+        const uint8_t *px = &frame.row(y)[writeStart * 3];
+        for (int16_t x = writeStart; x <= writeEnd; x++, px += 3)
+        {
+            panel->drawPixelRGB888(x, y, color.apply(0, px[0], x, y), color.apply(1, px[1], x, y), color.apply(2, px[2], x, y));
+        }
+        if (writeEnd >= writeStart)
+            pixels += writeEnd - writeStart + 1;
+    }
+    frame.clearDirty();
+    fullRedraw = false;
+
+    if (doubleBuffered && pixels)
+    {
+        panel->flipDMABuffer();
+        phase = (phase + 1) % COLOR_TEMPORAL_PHASES;
+        stats.flips++;
+    }
+    lastCommitPixels = pixels;
+    stats.commits++;
+    stats.pixels += pixels;
+    return pixels;
+}
+
+// Show the other temporal dither phase of the committed frame. Each DMA buffer keeps the
+// frame drawn with its own dither pattern, so this only brings the hidden buffer up to
+// date with the previous commit and flips to it, which costs nothing while the frame
+// stays the same. Returns the number of pixels written.
+uint32_t Display::ditherFrame()
+{
+    if (!panel || !isTemporal())
+        return 0;
+    if (fullRedraw)
+        return commit();
+    uint32_t pixels = 0;
+    color.setPhase(phase);
+    for (int16_t y = 0; y < DISPLAY_HEIGHT; y++)
+    {
+        const uint8_t *px = &committed.row(y)[pendingStart[y] * 3];
+        for (int16_t x = pendingStart[y]; x <= pendingEnd[y]; x++, px += 3)
+        {
+            panel->drawPixelRGB888(x, y, color.apply(0, px[0], x, y), color.apply(1, px[1], x, y), color.apply(2, px[2], x, y));
+        }
+        if (pendingEnd[y] >= pendingStart[y])
+            pixels += pendingEnd[y] - pendingStart[y] + 1;
+        pendingStart[y] = DISPLAY_WIDTH;
+        pendingEnd[y] = -1;
+    }
+    panel->flipDMABuffer();
+    phase = (phase + 1) % COLOR_TEMPORAL_PHASES;
+    stats.flips++;
+    stats.pixels += pixels;
+    return pixels;
+}
+
+// Switch the color correction applied at commit (see colorlut.h) and redraw everything with it
+void Display::setColor(const ColorSettings &settings, uint8_t brightness)
+{
+    color.build(settings, brightness);
+    invalidate();
+}
+
+// Forget what the panel shows, e.g. after drawing to the driver directly. The next
+// commits rewrite every pixel of both DMA buffers.
+void Display::invalidate()
+{
+    fullRedraw = true;
+    for (int16_t y = 0; y < DISPLAY_HEIGHT; y++)
+    {
+        pendingStart[y] = 0;
+        pendingEnd[y] = DISPLAY_WIDTH - 1;
+    }
+}
+
+void Display::clear()
+{
+    frame.fill(0, 0, 0);
+}
+
+// blank the emoji half of the display
+void Display::clearEmoji()
+{
+    frame.fillRect(0, 0, DISPLAY_WIDTH, TEXT_Y, 0, 0, 0);
+}
+
+// draw a decoded emoji frame centered in the top half of the display
+void Display::drawEmoji(const uint8_t *frame)
+{
+    clearEmoji();
+    blit(EMOJI_X, EMOJI_Y, EMOJI_SIZE, EMOJI_SIZE, frame);
+}
+
+// Decode a packed emoji row by row into the top half, false if the data is corrupt
+bool Display::drawPackedEmoji(const uint8_t *packed, size_t size)
+{
+    EmojiUnpacker unpacker;
+    uint8_t row[EMOJI_SIZE * 3];
+    clearEmoji();
+    if (!unpacker.begin(packed, size))
+        return false;
+    for (int16_t y = 0; y < EMOJI_SIZE; y++)
+    {
+        if (!unpacker.readRow(row))
+            return false;
+        blit(EMOJI_X, EMOJI_Y + y, EMOJI_SIZE, 1, row);
+    }
+    return true;
+}
+
+// Copy a w x h RGB888 tile into the back buffer
+void Display::blit(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *rgb)
+{
+    frame.blit(x, y, w, h, rgb);
+}
+
+// Premultiply and copy a w x h RGBA tile, one row at a time through a stack buffer
+void Display::blitRGBA(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *rgba)
+{
+    uint8_t row[DISPLAY_WIDTH * 3];
+    if (w > DISPLAY_WIDTH)
+        return;
+    for (int16_t i = 0; i < h; i++)
+    {
+        emojiFromRGBA(&rgba[i * w * 4], row, w);
+        blit(x, y + i, w, 1, row);
+    }
+}
+
+// replace the text in the bottom half of the display, wrapped and sized to fit.
+// false if it had to be clipped or broken mid-word
+bool Display::drawText(const char *text)
+{
+    TextLayout layout;
+    frame.fillRect(0, TEXT_Y, DISPLAY_WIDTH, DISPLAY_HEIGHT - TEXT_Y, 0, 0, 0);
+    bool fits = fitText(text, DISPLAY_WIDTH, DISPLAY_HEIGHT - TEXT_Y, &layout);
+    drawTextLayout(frame, text, layout, 0, TEXT_Y, DISPLAY_WIDTH, DISPLAY_HEIGHT - TEXT_Y, 255, 255, 255);
+    return fits;
+}
+
+// Render text once into the off-screen strip, on one line followed by a display wide gap,
+// and show its start in the text half. false if there is no strip.
+bool Display::setMarquee(const char *text)
+{
+    if (!stripReady)
+        return false;
+    size_t len = strlen(text);
+    int16_t width = textWidth(text, len, MARQUEE_SCALE);
+    if (width > MARQUEE_MAX_WIDTH - DISPLAY_WIDTH)
+        width = MARQUEE_MAX_WIDTH - DISPLAY_WIDTH;
+    strip.fillRect(0, 0, width, MARQUEE_HEIGHT, 0, 0, 0);
+    drawTextLine(strip, text, len, MARQUEE_SCALE, 0, 0, 255, 255, 255);
+    strip.fillRect(width, 0, DISPLAY_WIDTH, MARQUEE_HEIGHT, 0, 0, 0);
+    marqueeWidth = width + DISPLAY_WIDTH;
+
+    frame.fillRect(0, TEXT_Y, DISPLAY_WIDTH, DISPLAY_HEIGHT - TEXT_Y, 0, 0, 0);
+    drawMarquee(0);
+    return true;
+}
+
+// Show the strip from offset pixels in, wrapping around at its end. Only a window copy
+// of the strip rows, the text itself is not laid out again.
+void Display::drawMarquee(uint32_t offset)
+{
+    if (!marqueeWidth)
+        return;
+    int16_t y = TEXT_Y + (DISPLAY_HEIGHT - TEXT_Y - MARQUEE_HEIGHT) / 2;
+    int16_t start = offset % marqueeWidth;
+    int16_t first = marqueeWidth - start < DISPLAY_WIDTH ? marqueeWidth - start : DISPLAY_WIDTH;
+    for (int16_t j = 0; j < MARQUEE_HEIGHT; j++)
+    {
+        frame.blit(0, y + j, first, 1, &strip.row(j)[start * 3]);
+        if (first < DISPLAY_WIDTH)
+            frame.blit(first, y + j, DISPLAY_WIDTH - first, 1, strip.row(j));
+    }
+}
+
+// full screen of small text, used for debug info and setup prompts
+void Display::drawMessage(const char *text)
+{
+    frame.fill(0, 0, 0);
+    frame.setTextColor(255, 255, 255);
+    frame.setTextSize(1);
+    frame.setCursor(0, 0);
+    frame.print(text);
+}
+
+// full screen label shown while a firmware update is running
+void Display::drawBanner(const char *label)
+{
+    frame.fill(0, 0, 0);
+    frame.setCursor(6, 21);
+    frame.setTextColor(255, 255, 255);
+    frame.setTextSize(3);
+    frame.print(label);
+}
+
+// Draw a progress bar on edges of the display
+void Display::drawProgress(unsigned int progress, unsigned int total)
+{
+    int segments[4];
+    progressSegments(progress, total, segments);
+    frame.fillRect(0, 0, segments[0], 1, 255, 255, 255);
+    frame.fillRect(63, 0, 1, segments[1], 255, 255, 255);
+    frame.fillRect(63 - segments[2], 63, segments[2], 1, 255, 255, 255);
+    frame.fillRect(0, 63 - segments[3], 1, segments[3], 255, 255, 255);
+}
+
+// Split progress into lengths for the top, right, bottom and left edge, clockwise from the top left
+void Display::progressSegments(unsigned int progress, unsigned int total, int segments[4])
+{
+    int i = total ? (int)((uint64_t)progress * 256 / total) : 0;
+    for (int edge = 0; edge < 4; edge++)
+    {
+        segments[edge] = clampSegment(i - edge * 64);
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <stdint.h>
+#include <ESP32-HUB75-MatrixPanel-I2S-DMA.h>
+
+#include "colorlut.h"
+#include "emoji.h"
+#include "emojipack.h"
+#include "framebuffer.h"
+#include "text.h"
+
+// Must match PANEL_WIDTH/PANEL_HEIGHT in config.h
+#define DISPLAY_WIDTH 64
+#define DISPLAY_HEIGHT 64
+
+// Status layout: emoji in the top half, text in the bottom half
+#define EMOJI_X 16
+#define EMOJI_Y 0
+#define TEXT_Y 32
+
+// Long text scrolls through the text half as one line at this font scale
+#define MARQUEE_SCALE 2
+#define MARQUEE_HEIGHT (8 * MARQUEE_SCALE)
+#define MARQUEE_MAX_WIDTH 1600 // a full text command at the widest glyphs, plus the gap
+
+// Counters since begin(), for the metrics endpoint
+struct DisplayStats
+{
+    uint32_t commits;
+    uint32_t flips;
+    uint64_t pixels; // written to the driver
+};
+
+// Composes status screens off-screen and commits them to a HUB75 panel (or the host simulator).
+// Draw calls only touch the back buffer, nothing is visible until commit(), which only
+// pushes pixels that differ from what the DMA buffer already shows.
+class Display {
+    public:
+        Display();
+        bool begin(MatrixPanel_I2S_DMA *panel, bool doubleBuffered);
+        void setPanel(MatrixPanel_I2S_DMA *panel, bool doubleBuffered);
+        uint32_t commit();
+        uint32_t ditherFrame();
+        void invalidate();
+        void setColor(const ColorSettings &settings, uint8_t brightness);
+        uint8_t getDitherBits() const { return color.getDroppedBits(); }
+        bool isTemporal() const { return doubleBuffered && color.isTemporal(); }
+        uint32_t getLastCommitPixels() const { return lastCommitPixels; }
+        DisplayStats getStats() const { return stats; }
+
+        void clear();
+        void clearEmoji();
+        void drawEmoji(const uint8_t *frame);
+        bool drawPackedEmoji(const uint8_t *packed, size_t size);
+        void blit(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *rgb);
+        void blitRGBA(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *rgba);
+        bool drawText(const char *text);
+        bool setMarquee(const char *text);
+        void drawMarquee(uint32_t offset);
+        int16_t getMarqueeWidth() const { return marqueeWidth; }
+        void drawMessage(const char *text);
+        void drawBanner(const char *label);
+        void drawProgress(unsigned int progress, unsigned int total);
+        static void progressSegments(unsigned int progress, unsigned int total, int segments[4]);
+
+    private:
+        MatrixPanel_I2S_DMA *panel;
+        Framebuffer frame;
+        Framebuffer committed;
+        Framebuffer strip;
+        ColorLut color;
+        bool stripReady;
+        int16_t marqueeWidth;
+        bool doubleBuffered;
+        bool fullRedraw;
+        uint8_t phase; // temporal dither phase the hidden DMA buffer is drawn with
+        uint32_t lastCommitPixels;
+        DisplayStats stats;
+        // per row span changed by the previous commit, still missing from the hidden DMA buffer
+        int16_t pendingStart[DISPLAY_HEIGHT];
+        int16_t pendingEnd[DISPLAY_HEIGHT];
+};
+
+#endif
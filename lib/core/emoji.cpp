@@ -0,0 +1,91 @@
+#include <string.h>
+#include <esp_log.h>
+
+#include "emoji.h"
+#include "grapheme.h"
+
+bool emojiKey(const char *emoji, char *key, size_t size)
+{
+    if (!size)
+        return false;
+    key[0] = '\0';
+    size_t len = graphemeNext(emoji, strlen(emoji));
+    size_t keyLen = 0;
+    bool isEmoji = false;
+    for (size_t i = 0; i < len;)
+    {
+        uint32_t codepoint;
+        i += utf8Decode(emoji + i, len - i, &codepoint);
+        if (codepoint == GRAPHEME_INVALID)
+            return false;
+        // emojiapi.dev names files without presentation selectors
+        if (codepoint == 0xFE0E || codepoint == 0xFE0F)
+            continue;
+        GraphemeClass type = graphemeClass(codepoint);
+        if (type == GRAPHEME_PICTOGRAPHIC || type == GRAPHEME_REGIONAL_INDICATOR || codepoint == 0x20E3)
+            isEmoji = true;
+
+        // codepoints in lowercase hex joined by '_', except the joiner which is spelled 200D
+        // digits are collected least significant first
+        char digits[8];
+        int n = 0;
+        if (codepoint == 0x200D)
+        {
+            memcpy(digits, "D002", 4);
+            n = 4;
+        }
+        else
+        {
+            do
+                digits[n++] = "0123456789abcdef"[codepoint & 0xF];
+            while (codepoint >>= 4);
+        }
+        if (keyLen + (keyLen ? 1 : 0) + n >= size)
+        {
+            key[0] = '\0';
+            return false;
+        }
+        if (keyLen)
+            key[keyLen++] = '_';
+        while (n)
+            key[keyLen++] = digits[--n];
+    }
+    key[keyLen] = '\0';
+    if (!isEmoji)
+    {
+        key[0] = '\0';
+        return false;
+    }
+    ESP_LOGD(__func__, "Emoji: %s", key);
+    return true;
+}
+
+uint32_t emojiKeyHash(const char *key)
+{
+    uint32_t hash = 2166136261u;
+    while (*key)
+    {
+        hash ^= (uint8_t)*key++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// c * a / 255 without a division, exact for all 8 bit inputs
+static inline uint8_t premultiply(uint8_t c, uint8_t a)
+{
+    uint16_t t = c * a;
+    return (t + 1 + (t >> 8)) >> 8;
+}
+
+// Straight loop over the tile so the compiler can unroll/vectorize it
+void emojiFromRGBA(const uint8_t *rgba, uint8_t *rgb, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; i++, rgba += 4, rgb += 3)
+    {
+        uint8_t a = rgba[3];
+        rgb[0] = premultiply(rgba[0], a);
+        rgb[1] = premultiply(rgba[1], a);
+        rgb[2] = premultiply(rgba[2], a);
+    }
+}
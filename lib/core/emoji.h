@@ -0,0 +1,22 @@
+#ifndef EMOJI_H
+#define EMOJI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Decoded emoji frames are 32x32 RGB888, alpha already applied
+#define EMOJI_SIZE 32
+#define EMOJI_FRAME_BYTES (EMOJI_SIZE * EMOJI_SIZE * 3)
+#define EMOJI_KEY_MAX 64
+
+// Convert the first grapheme cluster of a UTF-8 string into the emojiapi.dev codepoint key
+// (e.g. 1f9d1_200D_1f4bb), false if it is not an emoji or the key does not fit in size
+bool emojiKey(const char *emoji, char *key, size_t size);
+
+// FNV-1a of a codepoint key, used to name cache files and index the emoji bundle
+uint32_t emojiKeyHash(const char *key);
+
+// Apply alpha of emojiapi.dev RGBA pixels, producing RGB888 frame pixels
+void emojiFromRGBA(const uint8_t *rgba, uint8_t *rgb, size_t pixels);
+
+#endif
@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+
+#include "emojibundle.h"
+#include "heaptrack.h"
+
+#define EMOJI_BUNDLE_MAGIC 0x314E4245 // "EBN1"
+
+EmojiBundle::EmojiBundle() :
+    file(NULL),
+    index(NULL),
+    count(0),
+    hits(0)
+{
+}
+
+EmojiBundle::~EmojiBundle()
+{
+    if (file)
+        fclose(file);
+    heapTagFree(HEAP_TAG_EMOJI, index);
+}
+
+// Open the bundle and load its index, false if there is none (the bundle is optional)
+bool EmojiBundle::begin(const char *path)
+{
+    file = fopen(path, "rb");
+    if (!file)
+    {
+        ESP_LOGW(__func__, "No emoji bundle at %s", path);
+        return false;
+    }
+    uint32_t header[2];
+    if (fread(header, sizeof(header), 1, file) != 1 || header[0] != EMOJI_BUNDLE_MAGIC)
+    {
+        ESP_LOGE(__func__, "%s is not an emoji bundle", path);
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+
+    size_t size = header[1] * sizeof(Entry);
+    index = (Entry *)heapTagMalloc(HEAP_TAG_EMOJI, size);
+    if (!index || fread(index, sizeof(Entry), header[1], file) != header[1])
+    {
+        ESP_LOGE(__func__, "Failed to load emoji bundle index");
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+    count = header[1];
+    ESP_LOGI(__func__, "Emoji bundle: %u emojis", count);
+    return true;
+}
+
+// Copy the packed frame for key into packed (EMOJI_PACKED_MAX buffer)
+bool EmojiBundle::get(const char *key, uint8_t *packed, size_t *size)
+{
+    uint32_t hash = emojiKeyHash(key);
+    // equal hashes are adjacent, the record key settles collisions
+    for (uint32_t i = lowerBound(hash); i < count && index[i].hash == hash; i++)
+    {
+        if (readRecord(index[i].offset, key, packed, size))
+        {
+            hits++;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Index only check, may be fooled by a hash collision
+bool EmojiBundle::contains(const char *key)
+{
+    uint32_t hash = emojiKeyHash(key);
+    uint32_t i = lowerBound(hash);
+    return i < count && index[i].hash == hash;
+}
+
+uint32_t EmojiBundle::lowerBound(uint32_t hash)
+{
+    uint32_t low = 0;
+    uint32_t high = count;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (index[mid].hash < hash)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+bool EmojiBundle::readRecord(uint32_t offset, const char *key, uint8_t *packed, size_t *size)
+{
+    char recordKey[EMOJI_KEY_MAX];
+    uint8_t keyLen;
+    uint8_t sizeBytes[2];
+    if (fseek(file, offset, SEEK_SET) || fread(&keyLen, 1, 1, file) != 1 || keyLen >= EMOJI_KEY_MAX ||
+        fread(recordKey, 1, keyLen, file) != keyLen)
+        return false;
+    recordKey[keyLen] = '\0';
+    if (strcmp(recordKey, key))
+        return false;
+    if (fread(sizeBytes, 1, 2, file) != 2)
+        return false;
+    *size = sizeBytes[0] | sizeBytes[1] << 8;
+    return *size <= EMOJI_PACKED_MAX && fread(packed, 1, *size, file) == *size;
+}
+
+// Build a bundle from packed frames, used by the host tool
+bool EmojiBundle::write(const char *path, const char *const *keys, const uint8_t *const *packed, const size_t *sizes, uint32_t count)
+{
+    Entry *entries = (Entry *)malloc(count * sizeof(Entry));
+    if (!entries)
+        return false;
+    uint32_t offset = 8 + count * sizeof(Entry);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        entries[i].hash = emojiKeyHash(keys[i]);
+        entries[i].offset = offset;
+        offset += 1 + strlen(keys[i]) + 2 + sizes[i];
+    }
+    qsort(entries, count, sizeof(Entry), [](const void *a, const void *b)
+          {
+        uint32_t x = ((const Entry *)a)->hash;
+        uint32_t y = ((const Entry *)b)->hash;
+        return x < y ? -1 : (x > y ? 1 : 0); });
+
+    FILE *out = fopen(path, "wb");
+    if (!out)
+    {
+        free(entries);
+        return false;
+    }
+    uint32_t header[2] = {EMOJI_BUNDLE_MAGIC, count};
+    bool ok = fwrite(header, sizeof(header), 1, out) == 1 &&
+              fwrite(entries, sizeof(Entry), count, out) == count;
+    // records in input order, the offsets above were assigned in that order
+    for (uint32_t i = 0; ok && i < count; i++)
+    {
+        uint8_t keyLen = strlen(keys[i]);
+        uint8_t sizeBytes[2] = {(uint8_t)sizes[i], (uint8_t)(sizes[i] >> 8)};
+        ok = fwrite(&keyLen, 1, 1, out) == 1 &&
+             fwrite(keys[i], 1, keyLen, out) == keyLen &&
+             fwrite(sizeBytes, 1, 2, out) == 2 &&
+             fwrite(packed[i], 1, sizes[i], out) == sizes[i];
+    }
+    free(entries);
+    return fclose(out) == 0 && ok;
+}
@@ -0,0 +1,44 @@
+#ifndef EMOJIBUNDLE_H
+#define EMOJIBUNDLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "emoji.h"
+#include "emojipack.h"
+
+// Read-only set of packed emojis shipped in the spiffs image, consulted before the network.
+// File layout (little endian):
+//   "EBN1", entry count, then count x {key hash, record offset} sorted by hash,
+//   then records of {key length, key, packed size (2 bytes), packed frame}.
+// Only the hash index is held in RAM, a lookup is a binary search plus one record read.
+class EmojiBundle {
+    public:
+        EmojiBundle();
+        ~EmojiBundle();
+        bool begin(const char *path);
+        bool get(const char *key, uint8_t *packed, size_t *size);
+        bool contains(const char *key);
+        uint32_t getCount() const { return count; }
+        uint32_t getHits() const { return hits; }
+
+        static bool write(const char *path, const char *const *keys, const uint8_t *const *packed, const size_t *sizes, uint32_t count);
+
+    private:
+        struct Entry
+        {
+            uint32_t hash;
+            uint32_t offset;
+        };
+
+        FILE *file;
+        Entry *index;
+        uint32_t count;
+        uint32_t hits;
+
+        uint32_t lowerBound(uint32_t hash);
+        bool readRecord(uint32_t offset, const char *key, uint8_t *packed, size_t *size);
+};
+
+#endif
@@ -0,0 +1,199 @@
+#include <string.h>
+
+#include "emojipack.h"
+
+#define EMOJI_PIXELS (EMOJI_SIZE * EMOJI_SIZE)
+// open addressing table for the palette, at most half full
+#define PALETTE_SLOTS 512
+#define SLOT_EMPTY 0xFFFFFFFF
+
+// Color -> palette index table, small enough for a task stack
+struct PaletteTable
+{
+    uint32_t colors[PALETTE_SLOTS];
+    uint8_t indices[PALETTE_SLOTS];
+    int count;
+
+    void clear()
+    {
+        memset(colors, 0xFF, sizeof(colors));
+        count = 0;
+    }
+
+    // index of color, added if new. -1 once the palette is full
+    int lookup(uint32_t color)
+    {
+        uint32_t slot = (color * 2654435761u) >> 23;
+        while (colors[slot] != SLOT_EMPTY)
+        {
+            if (colors[slot] == color)
+                return indices[slot];
+            slot = (slot + 1) & (PALETTE_SLOTS - 1);
+        }
+        if (count == 256)
+            return -1;
+        colors[slot] = color;
+        indices[slot] = count;
+        return count++;
+    }
+};
+
+// Keep the top 8 - shift bits of a channel, rescaled so 0 and 255 stay exact
+static inline uint8_t quantize(uint8_t c, int shift)
+{
+    if (!shift)
+        return c;
+    int levels = (256 >> shift) - 1;
+    return ((c >> shift) * 255 + levels / 2) / levels;
+}
+
+static inline uint32_t pixelColor(const uint8_t *rgb, int i, int shift)
+{
+    const uint8_t *px = &rgb[i * 3];
+    return quantize(px[0], shift) << 16 | quantize(px[1], shift) << 8 | quantize(px[2], shift);
+}
+
+size_t emojiPack(const uint8_t *rgb, uint8_t *packed)
+{
+    PaletteTable table;
+    int shift = 0;
+    for (;; shift++)
+    {
+        table.clear();
+        int i = 0;
+        while (i < EMOJI_PIXELS && table.lookup(pixelColor(rgb, i, shift)) >= 0)
+            i++;
+        // 6 bits dropped leaves 64 colors, always fits
+        if (i == EMOJI_PIXELS)
+            break;
+    }
+
+    // palette in index order
+    uint8_t *out = packed + 1;
+    packed[0] = table.count - 1;
+    for (int slot = 0; slot < PALETTE_SLOTS; slot++)
+    {
+        if (table.colors[slot] == SLOT_EMPTY)
+            continue;
+        uint8_t *entry = &out[table.indices[slot] * 3];
+        entry[0] = table.colors[slot] >> 16;
+        entry[1] = table.colors[slot] >> 8;
+        entry[2] = table.colors[slot];
+    }
+    out += table.count * 3;
+
+    // PackBits: n >= 0 copies n + 1 literal indices, n < 0 repeats the next index 1 - n times
+    // equal colors have equal indices, so runs are found on the colors
+    auto color = [&](int i)
+    { return pixelColor(rgb, i, shift); };
+    int i = 0;
+    while (i < EMOJI_PIXELS)
+    {
+        uint32_t first = color(i);
+        int run = 1;
+        while (i + run < EMOJI_PIXELS && run < 128 && color(i + run) == first)
+            run++;
+        if (run >= 2)
+        {
+            *out++ = (uint8_t)(1 - run);
+            *out++ = table.lookup(first);
+            i += run;
+            continue;
+        }
+        // literal until the next run of three or more
+        int start = i;
+        while (i < EMOJI_PIXELS && i - start < 128)
+        {
+            if (i + 2 < EMOJI_PIXELS && color(i) == color(i + 1) && color(i) == color(i + 2))
+                break;
+            i++;
+        }
+        *out++ = i - start - 1;
+        for (int j = start; j < i; j++)
+            *out++ = table.lookup(color(j));
+    }
+    return out - packed;
+}
+
+bool EmojiUnpacker::begin(const uint8_t *packed, size_t size)
+{
+    if (size < 1)
+        return false;
+    paletteSize = packed[0] + 1;
+    if (size < 1 + (size_t)paletteSize * 3)
+        return false;
+    palette = packed + 1;
+    pos = palette + paletteSize * 3;
+    end = packed + size;
+    run = 0;
+    literal = 0;
+    return true;
+}
+
+// Decode the next EMOJI_SIZE pixels, false on corrupt or truncated data
+bool EmojiUnpacker::readRow(uint8_t *rgb)
+{
+    int x = 0;
+    while (x < EMOJI_SIZE)
+    {
+        if (!run && !literal)
+        {
+            if (pos >= end)
+                return false;
+            int8_t token = *pos++;
+            if (token >= 0)
+                literal = token + 1;
+            else
+            {
+                if (pos >= end)
+                    return false;
+                run = 1 - token;
+                runIndex = *pos++;
+                if (runIndex >= paletteSize)
+                    return false;
+            }
+        }
+        if (run)
+        {
+            int n = run < EMOJI_SIZE - x ? run : EMOJI_SIZE - x;
+            const uint8_t *color = &palette[runIndex * 3];
+            for (int i = 0; i < n; i++, rgb += 3)
+            {
+                rgb[0] = color[0];
+                rgb[1] = color[1];
+                rgb[2] = color[2];
+            }
+            run -= n;
+            x += n;
+        }
+        else
+        {
+            int n = literal < EMOJI_SIZE - x ? literal : EMOJI_SIZE - x;
+            if (end - pos < n)
+                return false;
+            for (int i = 0; i < n; i++, rgb += 3)
+            {
+                uint8_t index = *pos++;
+                if (index >= paletteSize)
+                    return false;
+                memcpy(rgb, &palette[index * 3], 3);
+            }
+            literal -= n;
+            x += n;
+        }
+    }
+    return true;
+}
+
+bool emojiUnpack(const uint8_t *packed, size_t size, uint8_t *rgb)
+{
+    EmojiUnpacker unpacker;
+    if (!unpacker.begin(packed, size))
+        return false;
+    for (int y = 0; y < EMOJI_SIZE; y++)
+    {
+        if (!unpacker.readRow(&rgb[y * EMOJI_SIZE * 3]))
+            return false;
+    }
+    return true;
+}
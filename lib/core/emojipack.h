@@ -0,0 +1,37 @@
+#ifndef EMOJIPACK_H
+#define EMOJIPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "emoji.h"
+
+// Packed emoji frame: palette size - 1, palette as RGB888, then PackBits coded palette
+// indices for the 1024 pixels in row order. Emojis rarely use more than a few hundred
+// colors, so this is 3-8x smaller than the RGB888 frame and never larger than this:
+#define EMOJI_PACKED_MAX (1 + 256 * 3 + EMOJI_SIZE * EMOJI_SIZE + EMOJI_SIZE * EMOJI_SIZE / 128)
+
+// Pack an RGB888 frame, returns the packed size. Frames with more than 256 colors are
+// quantized (low bits dropped per channel until they fit), black is always kept exact.
+size_t emojiPack(const uint8_t *rgb, uint8_t *packed);
+
+// Decode a packed frame row by row, e.g. straight into a framebuffer
+class EmojiUnpacker {
+    public:
+        bool begin(const uint8_t *packed, size_t size);
+        bool readRow(uint8_t *rgb);
+
+    private:
+        const uint8_t *palette;
+        int paletteSize;
+        const uint8_t *pos;
+        const uint8_t *end;
+        int run;
+        int literal;
+        uint8_t runIndex;
+};
+
+// Decode a whole packed frame into RGB888
+bool emojiUnpack(const uint8_t *packed, size_t size, uint8_t *rgb);
+
+#endif
@@ -0,0 +1,682 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "firmwarestream.h"
+#include "heaptrack.h"
+
+#define DIFF_KEY 8           // bytes hashed to find matches in the source
+#define DIFF_HASH_BITS 20
+#define DIFF_CANDIDATES 16   // source positions tried per hash
+#define DIFF_MIN_MATCH 16    // exact match that starts a DIFF
+#define DIFF_GIVE_UP 256     // bytes scanned past the best end of an approximate match
+#define DIFF_MIN_COPY 8      // equal bytes that make a COPY rather than zeros in a DIFF
+
+static uint32_t le32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void putLe32(uint8_t *p, uint32_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+// CRC-32 (zlib), a nibble at a time
+uint32_t firmwareCrc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    static const uint32_t table[16] = {0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+                                       0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = (crc >> 4) ^ table[(crc ^ data[i]) & 15];
+        crc = (crc >> 4) ^ table[(crc ^ (data[i] >> 4)) & 15];
+    }
+    return ~crc;
+}
+
+FirmwareStream::FirmwareStream() :
+    buffers(NULL),
+    target(NULL),
+    source(NULL),
+    cookie(NULL),
+    verifier(NULL),
+    state(STATE_ERROR),
+    error(NULL),
+    format(FIRMWARE_UNKNOWN),
+    stats(),
+    header(),
+    headerLen(0),
+    imageSize(0),
+    imageCrc(0),
+    crc(0),
+    outLen(0),
+    begun(false),
+    cookieSeen(false),
+    signature(),
+    signatureSize(0),
+    signatureLen(0),
+    op(OP_NONE),
+    readingCount(false),
+    count(0),
+    countShift(0),
+    sourcePos(0),
+    sourceSize(0),
+    sourceIndex(0),
+    sourceLen(0)
+{
+}
+
+FirmwareStream::~FirmwareStream()
+{
+    end();
+}
+
+// Allocate the decoder, only while an update runs
+bool FirmwareStream::begin()
+{
+    if (!buffers)
+        buffers = (Buffers *)heapTagMalloc(HEAP_TAG_FIRMWARE, sizeof(Buffers));
+    return buffers != NULL;
+}
+
+void FirmwareStream::end()
+{
+    heapTagFree(HEAP_TAG_FIRMWARE, buffers);
+    buffers = NULL;
+    state = STATE_ERROR;
+}
+
+void FirmwareStream::reset(FirmwareTarget *target, FirmwareSource *source)
+{
+    this->target = target;
+    this->source = source;
+    cookie = NULL;
+    verifier = NULL;
+    state = STATE_HEADER;
+    error = NULL;
+    format = FIRMWARE_UNKNOWN;
+    stats = {};
+    headerLen = 0;
+    imageSize = 0;
+    imageCrc = 0;
+    crc = 0;
+    outLen = 0;
+    begun = false;
+    cookieSeen = false;
+    signatureSize = signatureLen = 0;
+    op = OP_NONE;
+    readingCount = false;
+    sourcePos = 0;
+    sourceSize = 0;
+    sourceIndex = sourceLen = 0;
+    if (buffers)
+        buffers->lzss.reset();
+}
+
+void FirmwareStream::require(const char *cookie, FirmwareVerifier *verifier)
+{
+    this->cookie = cookie;
+    this->verifier = verifier;
+}
+
+const char *FirmwareStream::formatName(FirmwareFormat format)
+{
+    switch (format)
+    {
+    case FIRMWARE_IMAGE:
+        return "image";
+    case FIRMWARE_COMPRESSED:
+        return "compressed";
+    case FIRMWARE_PATCH:
+        return "patch";
+    default:
+        return "unknown";
+    }
+}
+
+bool FirmwareStream::fail(const char *error)
+{
+    this->error = error;
+    state = STATE_ERROR;
+    return false;
+}
+
+bool FirmwareStream::write(const uint8_t *data, size_t len)
+{
+    if (!buffers)
+        return fail("not started");
+    stats.received += len;
+    while (len && state < STATE_DONE)
+    {
+        if (state == STATE_HEADER)
+        {
+            if (!headerLen && data[0] == FIRMWARE_IMAGE_MAGIC)
+            {
+                if (verifier && !signatureSize)
+                    return fail("image is not signed");
+                format = FIRMWARE_IMAGE;
+                state = STATE_IMAGE;
+                continue;
+            }
+            header[headerLen++] = *data++;
+            len--;
+            if (headerLen == 4)
+            {
+                if (!memcmp(header, FIRMWARE_COMPRESSED_MAGIC, 4))
+                    format = FIRMWARE_COMPRESSED;
+                else if (!memcmp(header, FIRMWARE_PATCH_MAGIC, 4))
+                    format = FIRMWARE_PATCH;
+                else if (memcmp(header, FIRMWARE_SIGNED_MAGIC, 4) || signatureSize)
+                    return fail("not a firmware image");
+                else
+                    continue;
+                if (verifier && !signatureSize)
+                    return fail("image is not signed");
+            }
+            if (headerLen == 6 && format == FIRMWARE_UNKNOWN)
+            {
+                signatureSize = header[4] | header[5] << 8;
+                if (!signatureSize || signatureSize > sizeof(signature))
+                    return fail("bad signature size");
+                state = STATE_SIGNATURE;
+            }
+            if ((format == FIRMWARE_COMPRESSED && headerLen == 12) || (format == FIRMWARE_PATCH && headerLen == 20))
+            {
+                if (!parseHeader())
+                    return false;
+            }
+        }
+        else if (state == STATE_SIGNATURE)
+        {
+            size_t n = (size_t)(signatureSize - signatureLen) < len ? signatureSize - signatureLen : len;
+            memcpy(&signature[signatureLen], data, n);
+            signatureLen += n;
+            data += n;
+            len -= n;
+            if (signatureLen < signatureSize)
+                continue;
+            // the signed stream follows
+            if (verifier && !verifier->start())
+                return fail("signature check failed");
+            headerLen = 0;
+            state = STATE_HEADER;
+        }
+        else if (state == STATE_IMAGE)
+        {
+            if (!emit(data, len))
+                return false;
+            len = 0;
+        }
+        else
+        {
+            // a full buffer may leave more in the decoder, also once the input is used up
+            size_t produced;
+            do
+            {
+                size_t used;
+                produced = buffers->lzss.decode(data, len, &used, buffers->decoded, sizeof(buffers->decoded));
+                data += used;
+                len -= used;
+                if (produced && !decoded(buffers->decoded, produced))
+                    return false;
+            } while ((len || produced == sizeof(buffers->decoded)) && state == STATE_DECODE);
+        }
+    }
+    if (len && state == STATE_DONE)
+        return fail("data after the end of the patch");
+    return state != STATE_ERROR;
+}
+
+bool FirmwareStream::parseHeader()
+{
+    imageSize = le32(&header[4]);
+    imageCrc = le32(&header[8]);
+    if (!imageSize)
+        return fail("empty image");
+    if (format == FIRMWARE_PATCH)
+    {
+        if (!source)
+            return fail("patches are not accepted here");
+        // a patch for another build would turn into garbage
+        if (!checkSource(le32(&header[12]), le32(&header[16])))
+            return false;
+    }
+    state = STATE_DECODE;
+    return true;
+}
+
+// CRC of the first size bytes of the running image, through the output buffer (not in use yet)
+bool FirmwareStream::checkSource(uint32_t size, uint32_t expected)
+{
+    uint32_t sum = 0;
+    for (uint32_t offset = 0; offset < size;)
+    {
+        size_t n = size - offset < sizeof(buffers->out) ? size - offset : sizeof(buffers->out);
+        if (!source->read(offset, buffers->out, n))
+            return fail("source read failed");
+        sum = firmwareCrc32(sum, buffers->out, n);
+        offset += n;
+    }
+    stats.sourceRead += size;
+    if (sum != expected)
+        return fail("patch is for another build");
+    sourceSize = size;
+    return true;
+}
+
+bool FirmwareStream::decoded(const uint8_t *data, size_t len)
+{
+    if (format == FIRMWARE_COMPRESSED)
+        return emit(data, len);
+    return patch(data, len);
+}
+
+bool FirmwareStream::patch(const uint8_t *data, size_t len)
+{
+    while (len)
+    {
+        if (state == STATE_DONE)
+            return fail("data after the end of the patch");
+        if (op == OP_NONE)
+        {
+            if (*data > FIRMWARE_OP_COPY)
+                return fail("bad patch operation");
+            op = *data++;
+            len--;
+            if (op == FIRMWARE_OP_END)
+            {
+                state = STATE_DONE;
+                continue;
+            }
+            readingCount = true;
+            count = 0;
+            countShift = 0;
+            continue;
+        }
+        if (readingCount)
+        {
+            if (countShift > 35)
+                return fail("bad patch count");
+            uint8_t c = *data++;
+            len--;
+            count |= (uint64_t)(c & 0x7f) << countShift;
+            countShift += 7;
+            if (c & 0x80)
+                continue;
+            readingCount = false;
+            if (op == FIRMWARE_OP_SEEK)
+            {
+                int64_t position = (int64_t)sourcePos + (int64_t)((count >> 1) ^ -(count & 1));
+                if (position < 0 || position > sourceSize)
+                    return fail("seek outside the source");
+                sourcePos = position;
+                sourceIndex = sourceLen = 0;
+                op = OP_NONE;
+            }
+            else if (op != FIRMWARE_OP_EXTRA && count > sourceSize - sourcePos)
+                return fail("diff past the end of the source");
+            else if (op == FIRMWARE_OP_COPY)
+            {
+                // no bytes follow
+                if (!diff(NULL, count))
+                    return false;
+                op = OP_NONE;
+            }
+            else if (!count)
+                op = OP_NONE;
+            continue;
+        }
+        size_t n = len < count ? len : count;
+        if (op == FIRMWARE_OP_EXTRA ? !emit(data, n) : !diff(data, n))
+            return false;
+        data += n;
+        len -= n;
+        count -= n;
+        if (!count)
+            op = OP_NONE;
+    }
+    return true;
+}
+
+// Add len patch bytes to the source bytes at the source position, into the output buffer.
+// NULL data copies them as they are.
+bool FirmwareStream::diff(const uint8_t *data, size_t len)
+{
+    if (stats.written + len > imageSize)
+        return fail("image longer than announced");
+    // what is left of the operation, all of it inside the source
+    uint64_t left = count;
+    while (len)
+    {
+        if (sourceIndex == sourceLen)
+        {
+            sourceLen = left < sizeof(buffers->source) ? left : sizeof(buffers->source);
+            if (!source->read(sourcePos, buffers->source, sourceLen))
+                return fail("source read failed");
+            stats.sourceRead += sourceLen;
+            sourceIndex = 0;
+        }
+        if (outLen == sizeof(buffers->out) && !flush())
+            return false;
+        size_t n = len;
+        if (n > sourceLen - sourceIndex)
+            n = sourceLen - sourceIndex;
+        if (n > sizeof(buffers->out) - outLen)
+            n = sizeof(buffers->out) - outLen;
+        uint8_t *out = &buffers->out[outLen];
+        const uint8_t *from = &buffers->source[sourceIndex];
+        if (data)
+        {
+            for (size_t i = 0; i < n; i++)
+                out[i] = from[i] + data[i];
+            data += n;
+        }
+        else
+            memcpy(out, from, n);
+        if (!inspect(out, n))
+            return false;
+        outLen += n;
+        sourceIndex += n;
+        sourcePos += n;
+        left -= n;
+        len -= n;
+    }
+    return true;
+}
+
+bool FirmwareStream::emit(const uint8_t *data, size_t len)
+{
+    // plain images say nothing of their size
+    if (format != FIRMWARE_IMAGE && stats.written + len > imageSize)
+        return fail("image longer than announced");
+    if (!inspect(data, len))
+        return false;
+    while (len)
+    {
+        if (outLen == sizeof(buffers->out) && !flush())
+            return false;
+        size_t n = sizeof(buffers->out) - outLen < len ? sizeof(buffers->out) - outLen : len;
+        memcpy(&buffers->out[outLen], data, n);
+        outLen += n;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Checks on the next len bytes of the image, before they go to the output buffer
+bool FirmwareStream::inspect(const uint8_t *data, size_t len)
+{
+    uint32_t at = stats.written;
+    crc = firmwareCrc32(crc, data, len);
+    stats.written += len;
+    if (verifier && !verifier->update(data, len))
+        return fail("signature check failed");
+    if (!cookie || at >= FIRMWARE_COOKIE_OFFSET + FIRMWARE_COOKIE_SIZE || at + len <= FIRMWARE_COOKIE_OFFSET)
+        return true;
+    // the part of the cookie in these bytes
+    uint32_t from = at > FIRMWARE_COOKIE_OFFSET ? at : FIRMWARE_COOKIE_OFFSET;
+    uint32_t to = at + len < FIRMWARE_COOKIE_OFFSET + FIRMWARE_COOKIE_SIZE ? at + len : FIRMWARE_COOKIE_OFFSET + FIRMWARE_COOKIE_SIZE;
+    if (memcmp(&data[from - at], &cookie[from - FIRMWARE_COOKIE_OFFSET], to - from))
+        return fail("not firmware for this panel");
+    cookieSeen = to == FIRMWARE_COOKIE_OFFSET + FIRMWARE_COOKIE_SIZE;
+    return true;
+}
+
+// Hand the output buffer to the target, beginning it on the first write. The buffer is larger
+// than the cookie offset, so the target is not begun for an image that fails that check.
+bool FirmwareStream::flush()
+{
+    if (outLen && !begun)
+    {
+        if (cookie && !cookieSeen)
+            return fail("no panel cookie");
+        if (!target->begin(imageSize))
+            return fail("target refused the image");
+        begun = true;
+    }
+    if (outLen && !target->write(buffers->out, outLen))
+        return fail("write failed");
+    outLen = 0;
+    return true;
+}
+
+bool FirmwareStream::finish()
+{
+    if (state == STATE_ERROR)
+        return false;
+    if (format == FIRMWARE_UNKNOWN)
+        return fail("no image");
+    if (format == FIRMWARE_IMAGE)
+    {
+        if (!stats.written)
+            return fail("no image");
+        imageSize = stats.written;
+    }
+    else
+    {
+        if (format == FIRMWARE_PATCH && state != STATE_DONE)
+            return fail("patch cut short");
+        if (stats.written != imageSize)
+            return fail("image cut short");
+        if (crc != imageCrc)
+            return fail("image CRC mismatch");
+    }
+    if (cookie && !cookieSeen)
+        return fail("no panel cookie");
+    if (!flush())
+        return false;
+    // the target has all of the image but nothing is activated before this
+    if (verifier && !verifier->verify(signature, signatureSize))
+        return fail("bad signature");
+    state = STATE_DONE;
+    return true;
+}
+
+size_t firmwareCompress(const uint8_t *image, size_t imageSize, uint8_t *out, size_t size)
+{
+    if (size < 12)
+        return 0;
+    memcpy(out, FIRMWARE_COMPRESSED_MAGIC, 4);
+    putLe32(&out[4], imageSize);
+    putLe32(&out[8], firmwareCrc32(0, image, imageSize));
+    size_t len = lzssCompress(image, imageSize, &out[12], size - 12);
+    return len ? 12 + len : 0;
+}
+
+size_t firmwareSign(const uint8_t *stream, size_t streamSize, const uint8_t *signature, size_t signatureSize, uint8_t *out, size_t size)
+{
+    if (!signatureSize || signatureSize > FIRMWARE_SIGNATURE_MAX || size < 6 + signatureSize + streamSize)
+        return 0;
+    memcpy(out, FIRMWARE_SIGNED_MAGIC, 4);
+    out[4] = signatureSize;
+    out[5] = signatureSize >> 8;
+    memcpy(&out[6], signature, signatureSize);
+    memcpy(&out[6 + signatureSize], stream, streamSize);
+    return 6 + signatureSize + streamSize;
+}
+
+static void putCount(uint8_t *ops, size_t *len, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        ops[(*len)++] = value | 0x80;
+        value >>= 7;
+    }
+    ops[(*len)++] = value;
+}
+
+static uint32_t diffHash(const uint8_t *p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return (value * 0x9E3779B97F4A7C15ull) >> (64 - DIFF_HASH_BITS);
+}
+
+// Patch from source to image, bsdiff style: regions of the image are paired with the
+// source region they mostly match (code moved by an insertion differs only in the
+// addresses it holds) and stored as byte differences, which are mostly zeros and compress
+// to almost nothing. Matches are found through a hash of every DIFF_KEY bytes of the source.
+size_t firmwareDiff(const uint8_t *source, size_t sourceSize, const uint8_t *image, size_t imageSize, uint8_t *out, size_t size)
+{
+    if (size < 20 || !imageSize)
+        return 0;
+    int32_t *head = (int32_t *)malloc(sizeof(int32_t) << DIFF_HASH_BITS);
+    int32_t *chain = (int32_t *)malloc(sizeof(int32_t) * (sourceSize + 1));
+    // worst case is every byte in an EXTRA, or DIFFs a few count bytes apart
+    size_t opsSize = imageSize + imageSize / DIFF_MIN_MATCH * 24 + 64;
+    uint8_t *ops = (uint8_t *)malloc(opsSize);
+    if (!head || !chain || !ops)
+    {
+        free(head);
+        free(chain);
+        free(ops);
+        return 0;
+    }
+    memset(head, 0xff, sizeof(int32_t) << DIFF_HASH_BITS);
+    for (size_t i = 0; i + DIFF_KEY <= sourceSize; i++)
+    {
+        uint32_t hash = diffHash(&source[i]);
+        chain[i] = head[hash];
+        head[hash] = i;
+    }
+
+    auto exactLength = [&](size_t at, size_t from)
+    {
+        size_t n = 0;
+        while (at + n < imageSize && from + n < sourceSize && image[at + n] == source[from + n])
+            n++;
+        return n;
+    };
+    size_t len = 0;
+    size_t literalStart = 0; // image bytes not covered yet
+    size_t sourcePos = 0;    // where the decoder's source position is
+    int64_t offset = 0;      // source - image position of the last DIFF
+    for (size_t at = 0; at + DIFF_KEY <= imageSize;)
+    {
+        // carry on where the last match left off, or look the bytes up
+        size_t bestLength = 0;
+        size_t bestFrom = 0;
+        int64_t from = (int64_t)at + offset;
+        if (from >= 0 && from < (int64_t)sourceSize)
+        {
+            bestLength = exactLength(at, from);
+            bestFrom = from;
+        }
+        if (bestLength < DIFF_MIN_MATCH)
+        {
+            int32_t candidate = head[diffHash(&image[at])];
+            for (int tries = 0; tries < DIFF_CANDIDATES && candidate >= 0; tries++, candidate = chain[candidate])
+            {
+                size_t n = exactLength(at, candidate);
+                if (n > bestLength)
+                {
+                    bestLength = n;
+                    bestFrom = candidate;
+                }
+            }
+        }
+        if (bestLength < DIFF_MIN_MATCH)
+        {
+            at++;
+            continue;
+        }
+
+        // stretch the match both ways for as long as more than half of the bytes agree
+        size_t back = 0;
+        int score = 0;
+        int bestScore = 0;
+        for (size_t k = 1; k <= at - literalStart && k <= bestFrom; k++)
+        {
+            score += image[at - k] == source[bestFrom - k] ? 1 : -1;
+            if (score > bestScore)
+            {
+                bestScore = score;
+                back = k;
+            }
+        }
+        size_t forward = 0;
+        score = bestScore = 0;
+        for (size_t k = 0; at + k < imageSize && bestFrom + k < sourceSize && k - forward <= DIFF_GIVE_UP; k++)
+        {
+            score += image[at + k] == source[bestFrom + k] ? 1 : -1;
+            if (score > bestScore)
+            {
+                bestScore = score;
+                forward = k + 1;
+            }
+        }
+
+        size_t start = at - back;
+        size_t startFrom = bestFrom - back;
+        size_t length = back + forward;
+        if (start > literalStart)
+        {
+            ops[len++] = FIRMWARE_OP_EXTRA;
+            putCount(ops, &len, start - literalStart);
+            memcpy(&ops[len], &image[literalStart], start - literalStart);
+            len += start - literalStart;
+        }
+        if (startFrom != sourcePos)
+        {
+            int64_t delta = (int64_t)startFrom - (int64_t)sourcePos;
+            ops[len++] = FIRMWARE_OP_SEEK;
+            putCount(ops, &len, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+        }
+        // runs of equal bytes are copied, LZSS matches are too short for long runs of zeros
+        for (size_t k = 0; k < length;)
+        {
+            size_t equal = 0;
+            while (k + equal < length && image[start + k + equal] == source[startFrom + k + equal])
+                equal++;
+            if (equal >= DIFF_MIN_COPY || k + equal == length)
+            {
+                ops[len++] = FIRMWARE_OP_COPY;
+                putCount(ops, &len, equal);
+                k += equal;
+                continue;
+            }
+            // differences up to the next run worth a COPY
+            size_t end = k + equal;
+            for (size_t run = 0; end < length; end++)
+            {
+                run = image[start + end] == source[startFrom + end] ? run + 1 : 0;
+                if (run == DIFF_MIN_COPY)
+                {
+                    end -= DIFF_MIN_COPY - 1;
+                    break;
+                }
+            }
+            ops[len++] = FIRMWARE_OP_DIFF;
+            putCount(ops, &len, end - k);
+            for (; k < end; k++)
+                ops[len++] = image[start + k] - source[startFrom + k];
+        }
+        sourcePos = startFrom + length;
+        at = literalStart = start + length;
+        offset = (int64_t)startFrom - (int64_t)start;
+    }
+    if (imageSize > literalStart)
+    {
+        ops[len++] = FIRMWARE_OP_EXTRA;
+        putCount(ops, &len, imageSize - literalStart);
+        memcpy(&ops[len], &image[literalStart], imageSize - literalStart);
+        len += imageSize - literalStart;
+    }
+    ops[len++] = FIRMWARE_OP_END;
+    free(head);
+    free(chain);
+
+    memcpy(out, FIRMWARE_PATCH_MAGIC, 4);
+    putLe32(&out[4], imageSize);
+    putLe32(&out[8], firmwareCrc32(0, image, imageSize));
+    putLe32(&out[12], sourceSize);
+    putLe32(&out[16], firmwareCrc32(0, source, sourceSize));
+    size_t compressed = lzssCompress(ops, len, &out[20], size - 20);
+    free(ops);
+    return compressed ? 20 + compressed : 0;
+}
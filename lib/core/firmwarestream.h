@@ -0,0 +1,185 @@
+#ifndef FIRMWARESTREAM_H
+#define FIRMWARESTREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "httpssession.h"
+#include "lzss.h"
+
+// First bytes of what FirmwareStream takes:
+//   0xE9                                     plain image, as esptool builds it
+//   "SFZ1", image size, image CRC-32         LZSS compressed image
+//   "SFP1", image size, image CRC-32,        delta against the running image, LZSS compressed
+//           source size, source CRC-32
+//   "SFS1", signature size (16 bit),         signed envelope around one of the above, the
+//           signature                        signature is over the image it decodes to
+// (sizes and CRCs little endian). A patch is a list of operations: DIFF n (n bytes added to
+// the source bytes at the source position, which moves on), COPY n (source bytes as they
+// are), EXTRA n (n new bytes), SEEK d (move the source position) and END, with LEB128
+// counts, zigzag for SEEK. DIFF and SEEK are as in bsdiff.
+#define FIRMWARE_IMAGE_MAGIC 0xE9
+#define FIRMWARE_COMPRESSED_MAGIC "SFZ1"
+#define FIRMWARE_PATCH_MAGIC "SFP1"
+#define FIRMWARE_SIGNED_MAGIC "SFS1"
+#define FIRMWARE_SIGNATURE_MAX 72 // DER encoded ECDSA P-256
+#define FIRMWARE_HEADER_MAX 20
+#define FIRMWARE_OP_END 0
+#define FIRMWARE_OP_DIFF 1
+#define FIRMWARE_OP_EXTRA 2
+#define FIRMWARE_OP_SEEK 3
+#define FIRMWARE_OP_COPY 4
+#define FIRMWARE_WRITE_SIZE 1024 // bytes handed to the target at once
+// PanelPartition (.rodata_custom_desc) in an esptool image, after the image header (24 bytes),
+// the first segment header (8) and esp_app_desc_t (256). It is seen long before the first
+// write to the target.
+#define FIRMWARE_COOKIE_OFFSET 288
+#define FIRMWARE_COOKIE_SIZE 32
+
+enum FirmwareFormat
+{
+    FIRMWARE_UNKNOWN,
+    FIRMWARE_IMAGE,
+    FIRMWARE_COMPRESSED,
+    FIRMWARE_PATCH
+};
+
+// Image the running firmware was flashed from, what patches are applied to
+class FirmwareSource {
+    public:
+        virtual ~FirmwareSource() {}
+        virtual bool read(uint32_t offset, uint8_t *data, size_t len) = 0;
+};
+
+// Where the new image goes, the OTA partition on the device
+class FirmwareTarget {
+    public:
+        virtual ~FirmwareTarget() {}
+        // called before the first write, once the stream is known to be good so far (header,
+        // source and cookie checked), size 0 if not known
+        virtual bool begin(uint32_t size) = 0;
+        virtual bool write(const uint8_t *data, size_t len) = 0;
+};
+
+// Signature over the image, hashed as the image is written: SHA-256 and ECDSA, mbedTLS on
+// the device and OpenSSL on the host
+class FirmwareVerifier {
+    public:
+        virtual ~FirmwareVerifier() {}
+        virtual bool start() = 0;
+        virtual bool update(const uint8_t *data, size_t len) = 0;
+        // whether signature is one over everything since start
+        virtual bool verify(const uint8_t *signature, size_t len) = 0;
+};
+
+struct FirmwareStreamStats
+{
+    uint32_t received;   // bytes of the stream
+    uint32_t written;    // bytes of the image
+    uint32_t sourceRead; // bytes read from the running image
+};
+
+// Turns a plain, compressed or delta image pushed in piece by piece into the image itself,
+// written to the target as it is decoded. Memory is fixed at begin(): the LZSS window and a
+// few small buffers, whatever the image size. Checks on the image run on the decoded bytes
+// before they are written, so a stream for another device stops within its first kilobyte
+// and a bad signature before the image is activated.
+class FirmwareStream : public HttpsBodySink {
+    public:
+        FirmwareStream();
+        ~FirmwareStream();
+        bool begin();
+        void end();
+        // source NULL: patches are refused
+        void reset(FirmwareTarget *target, FirmwareSource *source);
+        // after reset: the image must have cookie (FIRMWARE_COOKIE_SIZE bytes) at
+        // FIRMWARE_COOKIE_OFFSET, and with a verifier be signed. NULL skips the check.
+        void require(const char *cookie, FirmwareVerifier *verifier);
+        bool write(const uint8_t *data, size_t len) override;
+        // after the last byte: true if the image is complete (its CRC and signature matched)
+        bool finish();
+        // NULL unless write or finish failed
+        const char *getError() const { return error; }
+        FirmwareFormat getFormat() const { return format; }
+        bool isSigned() const { return signatureSize; }
+        // of a signed stream, to pass the image on signed
+        const uint8_t *getSignature() const { return signature; }
+        uint16_t getSignatureSize() const { return signatureSize; }
+        // 0 for plain images until they are done
+        uint32_t getImageSize() const { return imageSize; }
+        FirmwareStreamStats getStats() const { return stats; }
+        static const char *formatName(FirmwareFormat format);
+
+    private:
+        enum State
+        {
+            STATE_HEADER,
+            STATE_SIGNATURE,
+            STATE_IMAGE,   // plain image, copied through
+            STATE_DECODE,  // compressed image or patch
+            STATE_DONE,
+            STATE_ERROR
+        };
+
+        static const uint8_t OP_NONE = 0xff; // the next byte is an operation
+
+        // decoder window and buffers, one allocation
+        struct Buffers
+        {
+            LzssDecoder lzss;
+            uint8_t decoded[256];
+            uint8_t source[256];
+            uint8_t out[FIRMWARE_WRITE_SIZE];
+        };
+
+        Buffers *buffers;
+        FirmwareTarget *target;
+        FirmwareSource *source;
+        const char *cookie;
+        FirmwareVerifier *verifier;
+        State state;
+        const char *error;
+        FirmwareFormat format;
+        FirmwareStreamStats stats;
+
+        uint8_t header[FIRMWARE_HEADER_MAX];
+        uint8_t headerLen;
+        uint32_t imageSize;
+        uint32_t imageCrc;
+        uint32_t crc;
+        size_t outLen;
+        bool begun;        // the target was begun
+        bool cookieSeen;   // all of the cookie was compared
+        uint8_t signature[FIRMWARE_SIGNATURE_MAX];
+        uint16_t signatureSize;
+        uint16_t signatureLen; // bytes of it read
+
+        uint8_t op;        // FIRMWARE_OP_*
+        bool readingCount; // the op byte was read, its LEB128 count is not complete
+        uint64_t count;    // bytes left of the current operation once read
+        uint8_t countShift;
+        uint32_t sourcePos;
+        uint32_t sourceSize;
+        size_t sourceIndex; // buffered source bytes, source[sourceIndex] is at sourcePos
+        size_t sourceLen;
+
+        bool parseHeader();
+        bool checkSource(uint32_t size, uint32_t expected);
+        bool decoded(const uint8_t *data, size_t len);
+        bool patch(const uint8_t *data, size_t len);
+        bool diff(const uint8_t *data, size_t len);
+        bool emit(const uint8_t *data, size_t len);
+        bool inspect(const uint8_t *data, size_t len);
+        bool flush();
+        bool fail(const char *error);
+};
+
+uint32_t firmwareCrc32(uint32_t crc, const uint8_t *data, size_t len);
+
+// Build side (status_sim patch), return the stream size or 0 if it does not fit in size
+size_t firmwareCompress(const uint8_t *image, size_t imageSize, uint8_t *out, size_t size);
+size_t firmwareDiff(const uint8_t *source, size_t sourceSize, const uint8_t *image, size_t imageSize, uint8_t *out, size_t size);
+// Wrap a stream (plain, compressed or patch) with the signature of the image it decodes to
+size_t firmwareSign(const uint8_t *stream, size_t streamSize, const uint8_t *signature, size_t signatureSize, uint8_t *out, size_t size);
+
+#endif
@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "framebuffer.h"
+#include "glcdfont.h"
+#include "heaptrack.h"
+
+Framebuffer::Framebuffer(int16_t width, int16_t height) :
+    frameWidth(width),
+    frameHeight(height),
+    pixels(NULL),
+    cursorX(0),
+    cursorY(0),
+    textColor{255, 255, 255},
+    textSize(1),
+    dirty({0, 0, (int16_t)(width - 1), (int16_t)(height - 1)})
+{
+}
+
+Framebuffer::~Framebuffer()
+{
+    heapTagFree(HEAP_TAG_FRAME, pixels);
+}
+
+// Allocate the frame, in PSRAM when the board has it
+bool Framebuffer::begin()
+{
+    size_t size = frameWidth * frameHeight * 3;
+    pixels = (uint8_t *)heapTagMalloc(HEAP_TAG_FRAME, size);
+    if (!pixels)
+        return false;
+    memset(pixels, 0, size);
+    return true;
+}
+
+void Framebuffer::fill(uint8_t r, uint8_t g, uint8_t b)
+{
+    fillRect(0, 0, frameWidth, frameHeight, r, g, b);
+}
+
+void Framebuffer::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t r, uint8_t g, uint8_t b)
+{
+    // clip to frame
+    if (x < 0)
+    {
+        w += x;
+        x = 0;
+    }
+    if (y < 0)
+    {
+        h += y;
+        y = 0;
+    }
+    if (x + w > frameWidth)
+        w = frameWidth - x;
+    if (y + h > frameHeight)
+        h = frameHeight - y;
+    if (w <= 0 || h <= 0)
+        return;
+
+    markDirty(x, y, w, h);
+    for (int16_t j = y; j < y + h; j++)
+    {
+        uint8_t *px = &row(j)[x * 3];
+        for (int16_t i = 0; i < w; i++, px += 3)
+        {
+            px[0] = r;
+            px[1] = g;
+            px[2] = b;
+        }
+    }
+}
+
+void Framebuffer::drawPixel(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b)
+{
+    if (x < 0 || y < 0 || x >= frameWidth || y >= frameHeight)
+        return;
+    markDirty(x, y, 1, 1);
+    uint8_t *px = &row(y)[x * 3];
+    px[0] = r;
+    px[1] = g;
+    px[2] = b;
+}
+
+// Copy a w x h RGB888 tile into the frame, clipped at the edges
+void Framebuffer::blit(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *rgb)
+{
+    int16_t x0 = x < 0 ? -x : 0;
+    int16_t x1 = x + w > frameWidth ? frameWidth - x : w;
+    if (x1 <= x0)
+        return;
+    int16_t top = y < 0 ? 0 : y;
+    int16_t bottom = y + h > frameHeight ? frameHeight : y + h;
+    markDirty(x + x0, top, x1 - x0, bottom - top);
+    for (int16_t j = 0; j < h; j++)
+    {
+        if (y + j < 0 || y + j >= frameHeight)
+            continue;
+        memcpy(&row(y + j)[(x + x0) * 3], &rgb[(j * w + x0) * 3], (x1 - x0) * 3);
+    }
+}
+
+// Set the pixels of a 1 bit bitmap up to 16 wide, bit 0 of a row is its leftmost pixel
+void Framebuffer::drawBitmap(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *rows, uint8_t r, uint8_t g, uint8_t b)
+{
+    int16_t x0 = x < 0 ? -x : 0;
+    int16_t x1 = x + w > frameWidth ? frameWidth - x : w;
+    if (x1 <= x0 || w > 16)
+        return;
+    int16_t top = y < 0 ? 0 : y;
+    int16_t bottom = y + h > frameHeight ? frameHeight : y + h;
+    if (bottom <= top)
+        return;
+    uint32_t clip = ((1u << x1) - 1) & ~((1u << x0) - 1);
+    markDirty(x + x0, top, x1 - x0, bottom - top);
+    for (int16_t j = top; j < bottom; j++)
+    {
+        uint32_t mask = rows[j - y] & clip;
+        uint8_t *line = row(j);
+        while (mask)
+        {
+            uint8_t *px = &line[(x + __builtin_ctz(mask)) * 3];
+            px[0] = r;
+            px[1] = g;
+            px[2] = b;
+            mask &= mask - 1;
+        }
+    }
+}
+
+void Framebuffer::clearDirty()
+{
+    dirty = {frameWidth, frameHeight, -1, -1};
+}
+
+// grow the dirty box to cover an already clipped area
+void Framebuffer::markDirty(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+    if (w <= 0 || h <= 0)
+        return;
+    if (x < dirty.x0)
+        dirty.x0 = x;
+    if (y < dirty.y0)
+        dirty.y0 = y;
+    if (x + w - 1 > dirty.x1)
+        dirty.x1 = x + w - 1;
+    if (y + h - 1 > dirty.y1)
+        dirty.y1 = y + h - 1;
+}
+
+void Framebuffer::setCursor(int16_t x, int16_t y)
+{
+    cursorX = x;
+    cursorY = y;
+}
+
+void Framebuffer::setTextColor(uint8_t r, uint8_t g, uint8_t b)
+{
+    textColor[0] = r;
+    textColor[1] = g;
+    textColor[2] = b;
+}
+
+void Framebuffer::setTextSize(uint8_t size)
+{
+    textSize = size ? size : 1;
+}
+
+// Print with wrapping at the right edge, same metrics as Adafruit GFX (6x8 cells)
+void Framebuffer::print(const char *text)
+{
+    for (; *text; text++)
+    {
+        if (*text == '\n')
+        {
+            cursorX = 0;
+            cursorY += textSize * 8;
+        }
+        else if (*text != '\r')
+        {
+            if (cursorX + textSize * 6 > frameWidth)
+            {
+                cursorX = 0;
+                cursorY += textSize * 8;
+            }
+            drawChar(cursorX, cursorY, *text);
+            cursorX += textSize * 6;
+        }
+    }
+}
+
+void Framebuffer::drawChar(int16_t x, int16_t y, unsigned char c)
+{
+    if (c < 0x20 || c > 0x7E)
+        c = '?';
+    const uint8_t *glyph = glcdfont[c - 0x20];
+    for (int col = 0; col < 5; col++)
+    {
+        for (int line = 0; line < 8; line++)
+        {
+            if (glyph[col] & (1 << line))
+                fillRect(x + col * textSize, y + line * textSize, textSize, textSize, textColor[0], textColor[1], textColor[2]);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Inclusive pixel bounds, empty when x1 < x0
+struct Rect
+{
+    int16_t x0;
+    int16_t y0;
+    int16_t x1;
+    int16_t y1;
+    bool empty() const { return x1 < x0 || y1 < y0; }
+};
+
+// Off-screen RGB888 frame, composed in RAM and committed to the panel in one go
+class Framebuffer {
+    public:
+        Framebuffer(int16_t width, int16_t height);
+        ~Framebuffer();
+        bool begin();
+        int16_t width() const { return frameWidth; }
+        int16_t height() const { return frameHeight; }
+        uint8_t *row(int16_t y) { return &pixels[y * frameWidth * 3]; }
+        const uint8_t *row(int16_t y) const { return &pixels[y * frameWidth * 3]; }
+
+        void fill(uint8_t r, uint8_t g, uint8_t b);
+        void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t r, uint8_t g, uint8_t b);
+        void drawPixel(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b);
+        void blit(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *rgb);
+        void drawBitmap(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *rows, uint8_t r, uint8_t g, uint8_t b);
+
+        // Adafruit GFX style text with the built in 5x7 font
+        void setCursor(int16_t x, int16_t y);
+        void setTextColor(uint8_t r, uint8_t g, uint8_t b);
+        void setTextSize(uint8_t size);
+        void print(const char *text);
+
+        // bounding box of everything drawn since the last clearDirty()
+        const Rect &dirtyRect() const { return dirty; }
+        void clearDirty();
+
+    private:
+        int16_t frameWidth;
+        int16_t frameHeight;
+        uint8_t *pixels;
+        int16_t cursorX;
+        int16_t cursorY;
+        uint8_t textColor[3];
+        uint8_t textSize;
+        Rect dirty;
+
+        void markDirty(int16_t x, int16_t y, int16_t w, int16_t h);
+        void drawChar(int16_t x, int16_t y, unsigned char c);
+};
+
+#endif
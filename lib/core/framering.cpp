@@ -0,0 +1,59 @@
+#include <stdlib.h>
+
+#include "framering.h"
+#include "heaptrack.h"
+
+FrameRing::FrameRing() :
+    slots(NULL),
+    head(0),
+    tail(0)
+{
+}
+
+FrameRing::~FrameRing()
+{
+    heapTagFree(HEAP_TAG_ANIMATION, slots);
+}
+
+// Allocate the slots, in PSRAM when the board has it
+bool FrameRing::begin()
+{
+    slots = (RingFrame *)heapTagMalloc(HEAP_TAG_ANIMATION, sizeof(RingFrame) * FRAME_RING_SLOTS);
+    return slots != NULL;
+}
+
+RingFrame *FrameRing::acquire()
+{
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (!slots || h - tail.load(std::memory_order_acquire) == FRAME_RING_SLOTS)
+        return NULL;
+    return &slots[h % FRAME_RING_SLOTS];
+}
+
+void FrameRing::publish()
+{
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+const RingFrame *FrameRing::peek()
+{
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (!slots || head.load(std::memory_order_acquire) == t)
+        return NULL;
+    return &slots[t % FRAME_RING_SLOTS];
+}
+
+void FrameRing::release()
+{
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void FrameRing::clear()
+{
+    tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+size_t FrameRing::size() const
+{
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
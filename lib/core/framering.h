@@ -0,0 +1,41 @@
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "emoji.h"
+
+// Decoded frames buffered ahead of playback, enough to ride out a slow network read
+#define FRAME_RING_SLOTS 4
+
+struct RingFrame
+{
+    uint8_t rgb[EMOJI_FRAME_BYTES];
+    uint16_t delayMs;
+};
+
+// Single producer, single consumer ring of emoji frames. The producer fills the slot from
+// acquire() and hands it over with publish(), the consumer reads peek() and gives it back
+// with release(). Neither side blocks, a full or empty ring returns NULL.
+class FrameRing {
+    public:
+        FrameRing();
+        ~FrameRing();
+        bool begin();
+        RingFrame *acquire();
+        void publish();
+        const RingFrame *peek();
+        void release();
+        // only while the producer is stopped
+        void clear();
+        size_t size() const;
+
+    private:
+        RingFrame *slots;
+        std::atomic<uint32_t> head; // next slot to publish, written by the producer
+        std::atomic<uint32_t> tail; // next slot to play, written by the consumer
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "frametimer.h"
+
+FrameTimer::FrameTimer() :
+    periodUs(0),
+    beginUs(0),
+    lastStartUs(0),
+    startUs(0),
+    frames(0),
+    late(0),
+    totalJitterUs(0),
+    maxJitterUs(0),
+    totalFrameUs(0),
+    maxFrameUs(0)
+{
+}
+
+// Reset the statistics for a new animation, the first frame is due one period after nowUs
+void FrameTimer::begin(uint32_t periodUs, int64_t nowUs)
+{
+    *this = FrameTimer();
+    this->periodUs = periodUs;
+    beginUs = nowUs;
+    lastStartUs = nowUs;
+}
+
+void FrameTimer::frameStart(int64_t nowUs)
+{
+    int64_t offset = nowUs - lastStartUs - periodUs;
+    uint32_t jitter = offset < 0 ? -offset : offset;
+    totalJitterUs += jitter;
+    if (jitter > maxJitterUs)
+        maxJitterUs = jitter;
+    if (jitter > periodUs / 2)
+        late++;
+    lastStartUs = nowUs;
+    startUs = nowUs;
+}
+
+void FrameTimer::frameEnd(int64_t nowUs)
+{
+    uint32_t frameUs = nowUs - startUs;
+    totalFrameUs += frameUs;
+    if (frameUs > maxFrameUs)
+        maxFrameUs = frameUs;
+    frames++;
+}
+
+FrameStats FrameTimer::getStats(int64_t nowUs) const
+{
+    FrameStats stats = {};
+    stats.frames = frames;
+    stats.late = late;
+    stats.periodUs = periodUs;
+    stats.maxJitterUs = maxJitterUs;
+    stats.maxFrameUs = maxFrameUs;
+    if (frames)
+    {
+        stats.avgJitterUs = totalJitterUs / frames;
+        stats.avgFrameUs = totalFrameUs / frames;
+    }
+    if (nowUs > beginUs)
+        stats.cpuPpm = totalFrameUs * 1000000 / (nowUs - beginUs);
+    return stats;
+}
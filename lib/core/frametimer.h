@@ -0,0 +1,41 @@
+#ifndef FRAMETIMER_H
+#define FRAMETIMER_H
+
+#include <stdint.h>
+
+// Timing of a fixed rate animation since begin(), all times in microseconds.
+// Jitter is how far a frame started from one period after the previous one.
+struct FrameStats
+{
+    uint32_t frames;
+    uint32_t late; // frames that started more than half a period off
+    uint32_t periodUs;
+    uint32_t avgJitterUs;
+    uint32_t maxJitterUs;
+    uint32_t avgFrameUs; // time spent drawing and committing
+    uint32_t maxFrameUs;
+    uint32_t cpuPpm; // share of wall time spent in frames, parts per million
+};
+
+class FrameTimer {
+    public:
+        FrameTimer();
+        void begin(uint32_t periodUs, int64_t nowUs);
+        void frameStart(int64_t nowUs);
+        void frameEnd(int64_t nowUs);
+        FrameStats getStats(int64_t nowUs) const;
+
+    private:
+        uint32_t periodUs;
+        int64_t beginUs;
+        int64_t lastStartUs;
+        int64_t startUs;
+        uint32_t frames;
+        uint32_t late;
+        uint64_t totalJitterUs;
+        uint32_t maxJitterUs;
+        uint64_t totalFrameUs;
+        uint32_t maxFrameUs;
+};
+
+#endif
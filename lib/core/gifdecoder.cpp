@@ -0,0 +1,402 @@
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+
+#include "gifdecoder.h"
+#include "heaptrack.h"
+
+// interlaced images send rows in four passes
+static const uint8_t passStart[4] = {0, 4, 2, 1};
+static const uint8_t passStep[4] = {8, 8, 4, 2};
+
+GifDecoder::GifDecoder() :
+    tables(NULL),
+    sink(NULL),
+    state(STATE_ERROR),
+    error(NULL),
+    frames(0)
+{
+}
+
+GifDecoder::~GifDecoder()
+{
+    heapTagFree(HEAP_TAG_ANIMATION, tables);
+}
+
+// Allocate the tables, in PSRAM when the board has it
+bool GifDecoder::begin()
+{
+    tables = (Tables *)heapTagMalloc(HEAP_TAG_ANIMATION, sizeof(Tables));
+    return tables != NULL;
+}
+
+// Start decoding a new stream, frames go to sink
+void GifDecoder::reset(GifFrameSink *sink)
+{
+    this->sink = sink;
+    error = NULL;
+    frames = 0;
+    disposal = 0;
+    transparent = -1;
+    delayMs = 0;
+    if (tables)
+        memset(tables->canvas, 0, sizeof(tables->canvas));
+    expect(STATE_HEADER, field, 13);
+}
+
+// Feed the next bytes of the stream, false on malformed data or once the sink stopped.
+// Anything after the trailer is ignored.
+bool GifDecoder::write(const uint8_t *data, size_t len)
+{
+    if (!tables)
+        return fail("not started");
+    while (len && state < STATE_DONE)
+    {
+        size_t n = need - have < len ? need - have : len;
+        if (state == STATE_DATA)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                if (!decodeByte(data[i]))
+                    return false;
+            }
+        }
+        else if (target)
+            memcpy(target + have, data, n);
+        have += n;
+        data += n;
+        len -= n;
+        while (have == need && state < STATE_DONE)
+        {
+            if (!advance())
+                return false;
+        }
+    }
+    return state <= STATE_DONE;
+}
+
+void GifDecoder::expect(State next, uint8_t *into, size_t count)
+{
+    state = next;
+    target = into;
+    need = count;
+    have = 0;
+}
+
+bool GifDecoder::fail(const char *reason)
+{
+    ESP_LOGW(__func__, "Bad GIF: %s", reason);
+    error = reason;
+    state = STATE_ERROR;
+    return false;
+}
+
+// The bytes the current state asked for are in, move on to the next part of the stream
+bool GifDecoder::advance()
+{
+    switch (state)
+    {
+    case STATE_HEADER:
+        if (memcmp(field, "GIF87a", 6) && memcmp(field, "GIF89a", 6))
+            return fail("signature");
+        screenWidth = field[6] | field[7] << 8;
+        screenHeight = field[8] | field[9] << 8;
+        if (!screenWidth || !screenHeight)
+            return fail("screen size");
+        globalColors = field[10] & 0x80 ? 2 << (field[10] & 0x07) : 0;
+        if (globalColors)
+            expect(STATE_GLOBAL_PALETTE, tables->globalPalette, globalColors * 3);
+        else
+            expect(STATE_BLOCK, field, 1);
+        return true;
+
+    case STATE_GLOBAL_PALETTE:
+        expect(STATE_BLOCK, field, 1);
+        return true;
+
+    case STATE_BLOCK:
+        if (field[0] == 0x21)
+            expect(STATE_EXTENSION_LABEL, field, 1);
+        else if (field[0] == 0x2C)
+            expect(STATE_IMAGE, field, 9);
+        else if (field[0] == 0x3B)
+            state = STATE_DONE;
+        else
+            return fail("block type");
+        return true;
+
+    case STATE_EXTENSION_LABEL:
+        extensionLabel = field[0];
+        firstSubBlock = true;
+        expect(STATE_EXTENSION_SIZE, field, 1);
+        return true;
+
+    case STATE_EXTENSION_SIZE:
+        if (!field[0])
+            expect(STATE_BLOCK, field, 1);
+        // the graphic control block is the only one read, the rest is skipped
+        else if (extensionLabel == 0xF9 && firstSubBlock && field[0] == 4)
+            expect(STATE_EXTENSION_DATA, field, 4);
+        else
+            expect(STATE_EXTENSION_DATA, NULL, field[0]);
+        return true;
+
+    case STATE_EXTENSION_DATA:
+        if (target && extensionLabel == 0xF9 && firstSubBlock)
+        {
+            disposal = field[0] >> 2 & 0x07;
+            transparent = field[0] & 0x01 ? field[3] : -1;
+            uint16_t delay = (field[1] | field[2] << 8) * 10;
+            delayMs = delay < GIF_MIN_DELAY_MS ? 100 : delay;
+        }
+        firstSubBlock = false;
+        expect(STATE_EXTENSION_SIZE, field, 1);
+        return true;
+
+    case STATE_IMAGE:
+        frameX = field[0] | field[1] << 8;
+        frameY = field[2] | field[3] << 8;
+        frameWidth = field[4] | field[5] << 8;
+        frameHeight = field[6] | field[7] << 8;
+        interlaced = field[8] & 0x40;
+        if (field[8] & 0x80)
+        {
+            colors = 2 << (field[8] & 0x07);
+            palette = tables->localPalette;
+            expect(STATE_LOCAL_PALETTE, tables->localPalette, colors * 3);
+        }
+        else
+        {
+            colors = globalColors;
+            palette = tables->globalPalette;
+            expect(STATE_CODE_SIZE, field, 1);
+        }
+        return true;
+
+    case STATE_LOCAL_PALETTE:
+        expect(STATE_CODE_SIZE, field, 1);
+        return true;
+
+    case STATE_CODE_SIZE:
+        if (field[0] < 2 || field[0] > 8)
+            return fail("code size");
+        minCodeSize = field[0];
+        return beginImage();
+
+    case STATE_DATA_SIZE:
+        if (!field[0])
+            return finishImage();
+        expect(STATE_DATA, NULL, field[0]);
+        return true;
+
+    case STATE_DATA:
+        expect(STATE_DATA_SIZE, field, 1);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+bool GifDecoder::beginImage()
+{
+    clearCode = 1 << minCodeSize;
+    codeSize = minCodeSize + 1;
+    nextCode = clearCode + 2;
+    oldCode = -1;
+    bits = 0;
+    bitCount = 0;
+    endOfImage = false;
+    pass = 0;
+    x = 0;
+    row = 0;
+    rowsDone = 0;
+    startRow();
+    if (disposal == 3)
+        memcpy(tables->previous, tables->canvas, sizeof(tables->canvas));
+    expect(STATE_DATA_SIZE, field, 1);
+    return true;
+}
+
+// Hand the composed frame to the sink, then clear up after it as its disposal asks
+bool GifDecoder::finishImage()
+{
+    frames++;
+    bool more = sink->frame(tables->canvas, delayMs ? delayMs : 100);
+    dispose();
+    disposal = 0;
+    transparent = -1;
+    delayMs = 0;
+    if (!more)
+    {
+        state = STATE_STOPPED;
+        return false;
+    }
+    expect(STATE_BLOCK, field, 1);
+    return true;
+}
+
+bool GifDecoder::decodeByte(uint8_t byte)
+{
+    bits |= (uint32_t)byte << bitCount;
+    bitCount += 8;
+    while (bitCount >= codeSize)
+    {
+        uint16_t code = bits & ((1 << codeSize) - 1);
+        bits >>= codeSize;
+        bitCount -= codeSize;
+        if (!endOfImage && !decodeCode(code))
+            return false;
+    }
+    return true;
+}
+
+bool GifDecoder::decodeCode(uint16_t code)
+{
+    if (code == clearCode)
+    {
+        codeSize = minCodeSize + 1;
+        nextCode = clearCode + 2;
+        oldCode = -1;
+        return true;
+    }
+    if (code == clearCode + 1)
+    {
+        // end of information, the rest of the sub-blocks is padding
+        endOfImage = true;
+        return true;
+    }
+    if (oldCode < 0)
+    {
+        if (code > clearCode)
+            return fail("first code");
+        emit(code);
+        oldCode = code;
+        firstByte = code;
+        return true;
+    }
+    if (code > nextCode)
+        return fail("code out of range");
+
+    // walk the chain back to its first byte, the string comes out reversed
+    uint8_t *stack = tables->stack;
+    size_t depth = 0;
+    uint16_t in = code;
+    if (code == nextCode)
+    {
+        stack[depth++] = firstByte;
+        code = oldCode;
+    }
+    while (code > clearCode)
+    {
+        if (depth == GIF_MAX_CODES - 1)
+            return fail("code chain");
+        stack[depth++] = tables->suffix[code];
+        code = tables->prefix[code];
+    }
+    firstByte = code;
+    stack[depth++] = firstByte;
+
+    // a full table stops growing until the next clear code
+    if (nextCode < GIF_MAX_CODES)
+    {
+        tables->prefix[nextCode] = oldCode;
+        tables->suffix[nextCode] = firstByte;
+        nextCode++;
+        if (nextCode == 1 << codeSize && codeSize < 12)
+            codeSize++;
+    }
+    oldCode = in;
+    while (depth)
+        emit(stack[--depth]);
+    return true;
+}
+
+// Place the next pixel of the image, transparent ones leave the canvas as it is
+void GifDecoder::emit(uint8_t index)
+{
+    if (rowsDone >= frameHeight)
+        return;
+    if (canvasRow >= 0 && index != transparent && index < colors)
+    {
+        int16_t cx = canvasX(frameX + x);
+        if (cx >= 0)
+            memcpy(&tables->canvas[(canvasRow * EMOJI_SIZE + cx) * 3], &palette[index * 3], 3);
+    }
+    if (++x < frameWidth)
+        return;
+    x = 0;
+    rowsDone++;
+    if (interlaced)
+    {
+        row += passStep[pass];
+        while (row >= frameHeight && pass < 3)
+            row = passStart[++pass];
+    }
+    else
+        row++;
+    startRow();
+}
+
+void GifDecoder::startRow()
+{
+    canvasRow = canvasY(frameY + row);
+}
+
+// Canvas column of a screen column: centered when the screen is smaller than the canvas,
+// otherwise the first screen column of each canvas column. -1 if it is not shown.
+int16_t GifDecoder::canvasX(uint32_t screenX) const
+{
+    if (screenX >= screenWidth)
+        return -1;
+    if (screenWidth <= EMOJI_SIZE)
+        return screenX + (EMOJI_SIZE - screenWidth) / 2;
+    uint32_t cx = screenX * EMOJI_SIZE / screenWidth;
+    return (cx * screenWidth + EMOJI_SIZE - 1) / EMOJI_SIZE == screenX ? cx : -1;
+}
+
+int16_t GifDecoder::canvasY(uint32_t screenY) const
+{
+    if (screenY >= screenHeight)
+        return -1;
+    if (screenHeight <= EMOJI_SIZE)
+        return screenY + (EMOJI_SIZE - screenHeight) / 2;
+    uint32_t cy = screenY * EMOJI_SIZE / screenHeight;
+    return (cy * screenHeight + EMOJI_SIZE - 1) / EMOJI_SIZE == screenY ? cy : -1;
+}
+
+// Screen pixel shown at a canvas pixel, false for the border around a small screen
+bool GifDecoder::screenPosition(int cx, int cy, uint32_t *sx, uint32_t *sy) const
+{
+    if (screenWidth <= EMOJI_SIZE)
+        *sx = cx - (EMOJI_SIZE - screenWidth) / 2;
+    else
+        *sx = ((uint32_t)cx * screenWidth + EMOJI_SIZE - 1) / EMOJI_SIZE;
+    if (screenHeight <= EMOJI_SIZE)
+        *sy = cy - (EMOJI_SIZE - screenHeight) / 2;
+    else
+        *sy = ((uint32_t)cy * screenHeight + EMOJI_SIZE - 1) / EMOJI_SIZE;
+    return *sx < screenWidth && *sy < screenHeight;
+}
+
+void GifDecoder::dispose()
+{
+    if (disposal == 3)
+    {
+        memcpy(tables->canvas, tables->previous, sizeof(tables->canvas));
+        return;
+    }
+    if (disposal != 2)
+        return;
+    // back to the background, which is black on the panel
+    for (int cy = 0; cy < EMOJI_SIZE; cy++)
+    {
+        for (int cx = 0; cx < EMOJI_SIZE; cx++)
+        {
+            uint32_t sx, sy;
+            if (screenPosition(cx, cy, &sx, &sy) && sx >= frameX && sx < (uint32_t)frameX + frameWidth &&
+                sy >= frameY && sy < (uint32_t)frameY + frameHeight)
+                memset(&tables->canvas[(cy * EMOJI_SIZE + cx) * 3], 0, 3);
+        }
+    }
+}
@@ -0,0 +1,130 @@
+#ifndef GIFDECODER_H
+#define GIFDECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "emoji.h"
+
+#define GIF_MAX_CODES 4096
+#define GIF_MIN_DELAY_MS 20 // shorter frame delays are shown for 100 ms, as browsers do
+
+// Receives each composed frame as a 32x32 RGB888 emoji frame, false stops decoding
+class GifFrameSink {
+    public:
+        virtual ~GifFrameSink() {}
+        virtual bool frame(const uint8_t *rgb, uint16_t delayMs) = 0;
+};
+
+// Incremental GIF decoder: bytes are pushed in as they arrive, from any chunking, and frames
+// come out composed (transparency, disposal) onto a 32x32 canvas. Smaller images are
+// centered, larger ones sampled down. Memory is fixed at begin(), whatever the length
+// of the animation or the size of the image.
+class GifDecoder {
+    public:
+        GifDecoder();
+        ~GifDecoder();
+        bool begin();
+        void reset(GifFrameSink *sink);
+        bool write(const uint8_t *data, size_t len);
+        bool finished() const { return state == STATE_DONE; }
+        // NULL unless write failed on bad data (a sink stop is not an error)
+        const char *getError() const { return error; }
+        uint32_t getFrames() const { return frames; }
+        static size_t tablesSize() { return sizeof(Tables); }
+
+    private:
+        enum State
+        {
+            STATE_HEADER,
+            STATE_GLOBAL_PALETTE,
+            STATE_BLOCK,
+            STATE_EXTENSION_LABEL,
+            STATE_EXTENSION_SIZE,
+            STATE_EXTENSION_DATA,
+            STATE_IMAGE,
+            STATE_LOCAL_PALETTE,
+            STATE_CODE_SIZE,
+            STATE_DATA_SIZE,
+            STATE_DATA,
+            STATE_DONE,
+            STATE_STOPPED,
+            STATE_ERROR
+        };
+
+        // LZW tables and canvases, one allocation
+        struct Tables
+        {
+            uint16_t prefix[GIF_MAX_CODES];
+            uint8_t suffix[GIF_MAX_CODES];
+            uint8_t stack[GIF_MAX_CODES];
+            uint8_t globalPalette[256 * 3];
+            uint8_t localPalette[256 * 3];
+            uint8_t canvas[EMOJI_FRAME_BYTES];
+            uint8_t previous[EMOJI_FRAME_BYTES]; // canvas before a "restore previous" frame
+        };
+
+        Tables *tables;
+        GifFrameSink *sink;
+        State state;
+        const char *error;
+        uint32_t frames;
+
+        // bytes wanted by the current state, collected into target unless it is NULL
+        uint8_t field[16];
+        uint8_t *target;
+        size_t need;
+        size_t have;
+
+        uint16_t screenWidth;
+        uint16_t screenHeight;
+        uint16_t globalColors;
+        uint8_t extensionLabel;
+        bool firstSubBlock;
+
+        // graphic control of the next image
+        uint8_t disposal;
+        int16_t transparent;
+        uint16_t delayMs;
+
+        // image being decoded
+        const uint8_t *palette;
+        uint16_t colors;
+        uint16_t frameX;
+        uint16_t frameY;
+        uint16_t frameWidth;
+        uint16_t frameHeight;
+        bool interlaced;
+        uint8_t pass;
+        uint16_t x;
+        uint16_t row;
+        uint16_t rowsDone;
+        int16_t canvasRow;
+
+        // LZW state
+        uint8_t minCodeSize;
+        uint8_t codeSize;
+        uint16_t clearCode;
+        uint16_t nextCode;
+        int16_t oldCode;
+        uint8_t firstByte;
+        uint32_t bits;
+        uint8_t bitCount;
+        bool endOfImage;
+
+        void expect(State next, uint8_t *into, size_t count);
+        bool advance();
+        bool fail(const char *reason);
+        bool beginImage();
+        bool finishImage();
+        bool decodeByte(uint8_t byte);
+        bool decodeCode(uint16_t code);
+        void emit(uint8_t index);
+        void startRow();
+        int16_t canvasX(uint32_t screenX) const;
+        int16_t canvasY(uint32_t screenY) const;
+        bool screenPosition(int cx, int cy, uint32_t *sx, uint32_t *sy) const;
+        void dispose();
+};
+
+#endif
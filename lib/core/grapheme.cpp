@@ -0,0 +1,196 @@
+#include "grapheme.h"
+
+struct CodepointRange
+{
+    uint32_t first;
+    uint32_t last;
+};
+
+// Extended_Pictographic, from emoji-data.txt (Unicode 15)
+static constexpr CodepointRange pictographic[] = {
+    {0x00A9, 0x00A9}, {0x00AE, 0x00AE}, {0x203C, 0x203C}, {0x2049, 0x2049}, {0x2122, 0x2122},
+    {0x2139, 0x2139}, {0x2194, 0x2199}, {0x21A9, 0x21AA}, {0x231A, 0x231B}, {0x2328, 0x2328},
+    {0x2388, 0x2388}, {0x23CF, 0x23CF}, {0x23E9, 0x23F3}, {0x23F8, 0x23FA}, {0x24C2, 0x24C2},
+    {0x25AA, 0x25AB}, {0x25B6, 0x25B6}, {0x25C0, 0x25C0}, {0x25FB, 0x25FE}, {0x2600, 0x2605},
+    {0x2607, 0x2612}, {0x2614, 0x2685}, {0x2690, 0x2705}, {0x2708, 0x2712}, {0x2714, 0x2714},
+    {0x2716, 0x2716}, {0x271D, 0x271D}, {0x2721, 0x2721}, {0x2728, 0x2728}, {0x2733, 0x2734},
+    {0x2744, 0x2744}, {0x2747, 0x2747}, {0x274C, 0x274C}, {0x274E, 0x274E}, {0x2753, 0x2755},
+    {0x2757, 0x2757}, {0x2763, 0x2767}, {0x2795, 0x2797}, {0x27A1, 0x27A1}, {0x27B0, 0x27B0},
+    {0x27BF, 0x27BF}, {0x2934, 0x2935}, {0x2B05, 0x2B07}, {0x2B1B, 0x2B1C}, {0x2B50, 0x2B50},
+    {0x2B55, 0x2B55}, {0x3030, 0x3030}, {0x303D, 0x303D}, {0x3297, 0x3297}, {0x3299, 0x3299},
+    {0x1F000, 0x1F0FF}, {0x1F10D, 0x1F10F}, {0x1F12F, 0x1F12F}, {0x1F16C, 0x1F171}, {0x1F17E, 0x1F17F},
+    {0x1F18E, 0x1F18E}, {0x1F191, 0x1F19A}, {0x1F1AD, 0x1F1E5}, {0x1F201, 0x1F20F}, {0x1F21A, 0x1F21A},
+    {0x1F22F, 0x1F22F}, {0x1F232, 0x1F23A}, {0x1F23C, 0x1F23F}, {0x1F249, 0x1F3FA}, {0x1F400, 0x1F53D},
+    {0x1F546, 0x1F64F}, {0x1F680, 0x1F6FF}, {0x1F774, 0x1F77F}, {0x1F7D5, 0x1F7FF}, {0x1F80C, 0x1F80F},
+    {0x1F848, 0x1F84F}, {0x1F85A, 0x1F85F}, {0x1F888, 0x1F88F}, {0x1F8AE, 0x1F8FF}, {0x1F90C, 0x1F93A},
+    {0x1F93C, 0x1F945}, {0x1F947, 0x1FAFF}, {0x1FC00, 0x1FFFD},
+};
+
+// Grapheme_Cluster_Break=Extend, the blocks that show up around emoji and Latin/Greek/Cyrillic
+// text: combining marks, ZWNJ, variation selectors, emoji modifiers and tags
+static constexpr CodepointRange extend[] = {
+    {0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x0610, 0x061A}, {0x064B, 0x065F},
+    {0x1AB0, 0x1AFF}, {0x1DC0, 0x1DFF}, {0x200C, 0x200C}, {0x20D0, 0x20F0}, {0xFE00, 0xFE0F},
+    {0xFE20, 0xFE2F}, {0x1F3FB, 0x1F3FF}, {0xE0020, 0xE007F}, {0xE0100, 0xE01EF},
+};
+
+// the binary searches below rely on sorted, non-overlapping ranges
+template <size_t N>
+static constexpr bool sortedRanges(const CodepointRange (&ranges)[N])
+{
+    for (size_t i = 0; i < N; i++)
+    {
+        if (ranges[i].first > ranges[i].last || (i && ranges[i - 1].last >= ranges[i].first))
+            return false;
+    }
+    return true;
+}
+static_assert(sortedRanges(pictographic), "Extended_Pictographic table must be sorted");
+static_assert(sortedRanges(extend), "Extend table must be sorted");
+
+template <size_t N>
+static bool inRanges(const CodepointRange (&ranges)[N], uint32_t codepoint)
+{
+    if (codepoint < ranges[0].first || codepoint > ranges[N - 1].last)
+        return false;
+    size_t low = 0;
+    size_t high = N;
+    while (low < high)
+    {
+        size_t mid = (low + high) / 2;
+        if (ranges[mid].last < codepoint)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low < N && ranges[low].first <= codepoint;
+}
+
+size_t utf8Decode(const char *text, size_t len, uint32_t *codepoint)
+{
+    const uint8_t *s = (const uint8_t *)text;
+    uint8_t lead = s[0];
+    if (lead < 0x80)
+    {
+        *codepoint = lead;
+        return 1;
+    }
+
+    size_t n;
+    uint32_t value;
+    uint32_t min;
+    if ((lead & 0xE0) == 0xC0)
+    {
+        n = 2;
+        value = lead & 0x1F;
+        min = 0x80;
+    }
+    else if ((lead & 0xF0) == 0xE0)
+    {
+        n = 3;
+        value = lead & 0x0F;
+        min = 0x800;
+    }
+    else if ((lead & 0xF8) == 0xF0)
+    {
+        n = 4;
+        value = lead & 0x07;
+        min = 0x10000;
+    }
+    else
+    {
+        *codepoint = GRAPHEME_INVALID;
+        return 1;
+    }
+
+    if (n > len)
+    {
+        *codepoint = GRAPHEME_INVALID;
+        return 1;
+    }
+    for (size_t i = 1; i < n; i++)
+    {
+        if ((s[i] & 0xC0) != 0x80)
+        {
+            *codepoint = GRAPHEME_INVALID;
+            return 1;
+        }
+        value = value << 6 | (s[i] & 0x3F);
+    }
+    // overlong forms, surrogates and values past U+10FFFF
+    if (value < min || value > 0x10FFFF || (value >= 0xD800 && value <= 0xDFFF))
+    {
+        *codepoint = GRAPHEME_INVALID;
+        return 1;
+    }
+    *codepoint = value;
+    return n;
+}
+
+GraphemeClass graphemeClass(uint32_t codepoint)
+{
+    if (codepoint < 0x80)
+    {
+        if (codepoint == '\r')
+            return GRAPHEME_CR;
+        if (codepoint == '\n')
+            return GRAPHEME_LF;
+        return codepoint < 0x20 || codepoint == 0x7F ? GRAPHEME_CONTROL : GRAPHEME_OTHER;
+    }
+    if (codepoint == 0x200D)
+        return GRAPHEME_ZWJ;
+    if (codepoint >= 0x1F1E6 && codepoint <= 0x1F1FF)
+        return GRAPHEME_REGIONAL_INDICATOR;
+    if (codepoint < 0xA0 || codepoint == 0x2028 || codepoint == 0x2029)
+        return GRAPHEME_CONTROL;
+    if (inRanges(extend, codepoint))
+        return GRAPHEME_EXTEND;
+    if (inRanges(pictographic, codepoint))
+        return GRAPHEME_PICTOGRAPHIC;
+    return GRAPHEME_OTHER;
+}
+
+size_t graphemeNext(const char *text, size_t len)
+{
+    if (!len)
+        return 0;
+    uint32_t codepoint;
+    size_t pos = utf8Decode(text, len, &codepoint);
+    GraphemeClass prev = graphemeClass(codepoint);
+    // inside ExtPict Extend* (GB11), and the number of regional indicators so far (GB12/13)
+    bool pictographic = prev == GRAPHEME_PICTOGRAPHIC;
+    bool zwjAfterPictographic = false;
+    int regional = prev == GRAPHEME_REGIONAL_INDICATOR;
+
+    while (pos < len)
+    {
+        size_t n = utf8Decode(text + pos, len - pos, &codepoint);
+        GraphemeClass next = graphemeClass(codepoint);
+        bool join;
+        if (prev == GRAPHEME_CR && next == GRAPHEME_LF)
+            join = true; // GB3
+        else if (prev == GRAPHEME_CR || prev == GRAPHEME_LF || prev == GRAPHEME_CONTROL ||
+                 next == GRAPHEME_CR || next == GRAPHEME_LF || next == GRAPHEME_CONTROL)
+            join = false; // GB4, GB5
+        else if (next == GRAPHEME_EXTEND || next == GRAPHEME_ZWJ)
+            join = true; // GB9
+        else if (prev == GRAPHEME_ZWJ && next == GRAPHEME_PICTOGRAPHIC)
+            join = zwjAfterPictographic; // GB11
+        else if (prev == GRAPHEME_REGIONAL_INDICATOR && next == GRAPHEME_REGIONAL_INDICATOR)
+            join = regional & 1; // GB12, GB13
+        else
+            join = false; // GB999
+        if (!join)
+            break;
+
+        if (next == GRAPHEME_ZWJ)
+            zwjAfterPictographic = pictographic;
+        if (next != GRAPHEME_EXTEND)
+            pictographic = next == GRAPHEME_PICTOGRAPHIC;
+        if (next == GRAPHEME_REGIONAL_INDICATOR)
+            regional++;
+        prev = next;
+        pos += n;
+    }
+    return pos;
+}
@@ -0,0 +1,32 @@
+#ifndef GRAPHEME_H
+#define GRAPHEME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GRAPHEME_INVALID 0xFFFD // replacement for malformed UTF-8
+
+// Grapheme_Cluster_Break classes that matter for emoji and plain text input
+enum GraphemeClass : uint8_t
+{
+    GRAPHEME_OTHER,
+    GRAPHEME_CR,
+    GRAPHEME_LF,
+    GRAPHEME_CONTROL,
+    GRAPHEME_EXTEND, // combining marks, variation selectors, skin tones, tags
+    GRAPHEME_ZWJ,
+    GRAPHEME_REGIONAL_INDICATOR,
+    GRAPHEME_PICTOGRAPHIC // Extended_Pictographic
+};
+
+// Decode one codepoint from at most len bytes, returns the bytes consumed (1 for malformed
+// or truncated input, which decodes as GRAPHEME_INVALID). Never reads past len.
+size_t utf8Decode(const char *text, size_t len, uint32_t *codepoint);
+
+GraphemeClass graphemeClass(uint32_t codepoint);
+
+// Byte length of the extended grapheme cluster at the start of text (UAX #29 rules
+// GB3-GB13 without the Hangul syllable and Prepend/SpacingMark rules), 0 if len is 0
+size_t graphemeNext(const char *text, size_t len);
+
+#endif
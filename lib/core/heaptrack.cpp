@@ -0,0 +1,178 @@
+#include <atomic>
+#include <stdlib.h>
+#include <string.h>
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#endif
+
+#include "heaptrack.h"
+
+// in front of every tagged block, keeps the block aligned like malloc does
+union HeapHeader
+{
+    size_t size;
+    max_align_t align;
+};
+
+struct HeapCounters
+{
+    std::atomic<uint32_t> live;
+    std::atomic<uint32_t> peak;
+    std::atomic<uint32_t> allocs;
+    std::atomic<uint32_t> frees;
+    std::atomic<uint32_t> failures;
+    std::atomic<uint64_t> allocated;
+};
+
+static HeapCounters counters[HEAP_TAGS];
+
+static const char *tagNames[HEAP_TAGS] = {"json", "tls", "frame", "emoji", "animation", "firmware"};
+
+static void *rawAlloc(size_t size, bool spiram)
+{
+    void *block = NULL;
+#ifdef ESP_PLATFORM
+    if (spiram)
+        block = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (!block)
+        block = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#else
+    (void)spiram;
+    block = malloc(size);
+#endif
+    return block;
+}
+
+// Relaxed atomics like the metrics histograms, allocations come from every task
+static void charge(HeapTag tag, size_t size)
+{
+    HeapCounters &counter = counters[tag];
+    uint32_t live = counter.live.fetch_add(size, std::memory_order_relaxed) + size;
+    uint32_t peak = counter.peak.load(std::memory_order_relaxed);
+    while (live > peak && !counter.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        ;
+    counter.allocs.fetch_add(1, std::memory_order_relaxed);
+    counter.allocated.fetch_add(size, std::memory_order_relaxed);
+}
+
+static void release(HeapTag tag, size_t size)
+{
+    counters[tag].live.fetch_sub(size, std::memory_order_relaxed);
+    counters[tag].frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+void *heapTagMalloc(HeapTag tag, size_t size, bool spiram)
+{
+    HeapHeader *header = size <= SIZE_MAX - sizeof(HeapHeader) ? (HeapHeader *)rawAlloc(sizeof(HeapHeader) + size, spiram) : NULL;
+    if (!header)
+    {
+        counters[tag].failures.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
+    }
+    header->size = size;
+    charge(tag, size);
+    return header + 1;
+}
+
+void *heapTagCalloc(HeapTag tag, size_t count, size_t size, bool spiram)
+{
+    if (size && count > SIZE_MAX / size)
+    {
+        counters[tag].failures.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
+    }
+    void *block = heapTagMalloc(tag, count * size, spiram);
+    if (block)
+        memset(block, 0, count * size);
+    return block;
+}
+
+// A block that cannot grow in place moves, possibly into the other region, contents are kept
+void *heapTagRealloc(HeapTag tag, void *pointer, size_t size, bool spiram)
+{
+    if (!pointer)
+        return heapTagMalloc(tag, size, spiram);
+    if (!size)
+    {
+        heapTagFree(tag, pointer);
+        return NULL;
+    }
+    HeapHeader *header = (HeapHeader *)pointer - 1;
+    size_t old = header->size;
+    HeapHeader *moved = NULL;
+    if (size <= SIZE_MAX - sizeof(HeapHeader))
+    {
+#ifdef ESP_PLATFORM
+        moved = (HeapHeader *)heap_caps_realloc(header, sizeof(HeapHeader) + size, spiram ? MALLOC_CAP_SPIRAM : MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (!moved && spiram)
+            moved = (HeapHeader *)heap_caps_realloc(header, sizeof(HeapHeader) + size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#else
+        moved = (HeapHeader *)realloc(header, sizeof(HeapHeader) + size);
+#endif
+    }
+    if (!moved)
+    {
+        counters[tag].failures.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
+    }
+    moved->size = size;
+    release(tag, old);
+    charge(tag, size);
+    return moved + 1;
+}
+
+void heapTagFree(HeapTag tag, void *pointer)
+{
+    if (!pointer)
+        return;
+    HeapHeader *header = (HeapHeader *)pointer - 1;
+    release(tag, header->size);
+    free(header);
+}
+
+HeapTagStats heapTagStats(HeapTag tag)
+{
+    const HeapCounters &counter = counters[tag];
+    return {counter.live.load(std::memory_order_relaxed),
+            counter.peak.load(std::memory_order_relaxed),
+            counter.allocs.load(std::memory_order_relaxed),
+            counter.frees.load(std::memory_order_relaxed),
+            counter.failures.load(std::memory_order_relaxed),
+            counter.allocated.load(std::memory_order_relaxed)};
+}
+
+const char *heapTagName(HeapTag tag)
+{
+    return tag < HEAP_TAGS ? tagNames[tag] : "unknown";
+}
+
+uint16_t heapFragmentation(uint32_t freeBytes, uint32_t largestBlock)
+{
+    if (!freeBytes || largestBlock >= freeBytes)
+        return 0;
+    return 1000 - (uint64_t)largestBlock * 1000 / freeBytes;
+}
+
+HeapHistory::HeapHistory() :
+    history(),
+    snapshots(0)
+{
+}
+
+void HeapHistory::sample(int64_t nowUs, const HeapRegion &internal, const HeapRegion &spiram)
+{
+    HeapSnapshot &snapshot = history[snapshots % HEAP_HISTORY];
+    snapshot.timeUs = nowUs;
+    snapshot.internal = internal;
+    snapshot.internal.fragmentation = heapFragmentation(internal.freeBytes, internal.largestBlock);
+    snapshot.spiram = spiram;
+    snapshot.spiram.fragmentation = heapFragmentation(spiram.freeBytes, spiram.largestBlock);
+    for (int tag = 0; tag < HEAP_TAGS; tag++)
+        snapshot.live[tag] = counters[tag].live.load(std::memory_order_relaxed);
+    snapshots++;
+}
+
+const HeapSnapshot &HeapHistory::get(int age) const
+{
+    return history[(snapshots - 1 - age) % HEAP_HISTORY];
+}
@@ -0,0 +1,73 @@
+#ifndef HEAPTRACK_H
+#define HEAPTRACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HEAP_HISTORY 32 // fragmentation snapshots kept
+
+// Subsystems heap allocations are charged to
+enum HeapTag
+{
+    HEAP_TAG_JSON,      // ArduinoJson documents (SpiRamAllocator)
+    HEAP_TAG_TLS,       // mbedTLS on the device, OpenSSL on the host
+    HEAP_TAG_FRAME,     // Display framebuffers
+    HEAP_TAG_EMOJI,     // emoji cache RAM tier and bundle index
+    HEAP_TAG_ANIMATION, // GIF decoder tables and the frame ring
+    HEAP_TAG_FIRMWARE,  // firmware update decoder, while an update runs
+    HEAP_TAGS
+};
+
+struct HeapTagStats
+{
+    uint32_t live;  // bytes currently allocated
+    uint32_t peak;  // most bytes allocated at once
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;
+    uint64_t allocated; // bytes handed out in total
+};
+
+// Tagged allocation, in PSRAM when the board has it (spiram) or internal RAM otherwise. Every
+// block carries its size in a small header so frees can be charged back without a lookup,
+// blocks must only be released through heapTagFree/heapTagRealloc with the same tag.
+void *heapTagMalloc(HeapTag tag, size_t size, bool spiram = true);
+void *heapTagCalloc(HeapTag tag, size_t count, size_t size, bool spiram = true);
+void *heapTagRealloc(HeapTag tag, void *pointer, size_t size, bool spiram = true);
+void heapTagFree(HeapTag tag, void *pointer);
+HeapTagStats heapTagStats(HeapTag tag);
+const char *heapTagName(HeapTag tag);
+
+// How broken up a heap region is: 0 when all free memory is one block, towards 1000 when the
+// largest block is a small share of what is free
+uint16_t heapFragmentation(uint32_t freeBytes, uint32_t largestBlock);
+
+struct HeapRegion
+{
+    uint32_t freeBytes;
+    uint32_t largestBlock;
+    uint16_t fragmentation; // per mille, see heapFragmentation()
+};
+
+struct HeapSnapshot
+{
+    int64_t timeUs;
+    HeapRegion internal;
+    HeapRegion spiram;
+    uint32_t live[HEAP_TAGS]; // per tag, to see which subsystem grew when a block collapsed
+};
+
+// Ring of the last HEAP_HISTORY heap snapshots, sampled by the memory printer task
+class HeapHistory {
+    public:
+        HeapHistory();
+        void sample(int64_t nowUs, const HeapRegion &internal, const HeapRegion &spiram);
+        int size() const { return snapshots < HEAP_HISTORY ? snapshots : HEAP_HISTORY; }
+        const HeapSnapshot &get(int age) const; // 0 is the newest
+
+    private:
+        HeapSnapshot history[HEAP_HISTORY];
+        uint32_t snapshots;
+};
+
+#endif
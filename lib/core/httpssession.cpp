@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "httpssession.h"
+
+// value of a "Name: value" header line, NULL if the line is another header
+static const char *headerValue(const char *line, const char *name)
+{
+    size_t len = strlen(name);
+    if (strncasecmp(line, name, len) || line[len] != ':')
+        return NULL;
+    line += len + 1;
+    while (*line == ' ' || *line == '\t')
+        line++;
+    return line;
+}
+
+// case insensitive search for a token in a header value
+static bool hasToken(const char *value, const char *token)
+{
+    size_t len = strlen(token);
+    for (; *value; value++)
+    {
+        if (!strncasecmp(value, token, len))
+            return true;
+    }
+    return false;
+}
+
+HttpsSession::HttpsSession(TlsTransport &transport) :
+    transport(&transport),
+    host(),
+    port(443),
+    connected(false),
+    keepAlive(true),
+    idleTimeoutMs(HTTPS_IDLE_TIMEOUT_MS),
+    lastUsedUs(0),
+    stats(),
+    headers(NULL),
+    validators(NULL),
+    status(0),
+    responseValidators(),
+    retryAfter(0),
+    sink(NULL),
+    streaming(false),
+    aborted(false),
+    rxStart(0),
+    rxEnd(0)
+{
+}
+
+// Switch origin, drops the connection if it changed
+void HttpsSession::setHost(const char *host, uint16_t port)
+{
+    if (strcmp(this->host, host) || this->port != port)
+        close();
+    snprintf(this->host, sizeof(this->host), "%s", host);
+    this->port = port;
+}
+
+// GET path from the origin. Up to size bytes of the body are stored, *length is the full
+// body length. Returns the HTTP status, or a negative HTTPS_ERR_* on failure.
+int HttpsSession::get(const char *path, uint8_t *body, size_t size, size_t *length)
+{
+    int64_t start = esp_timer_get_time();
+    *length = 0;
+    aborted = false;
+    this->status = 0;
+    if (connected && (start - lastUsedUs) / 1000 > idleTimeoutMs)
+    {
+        ESP_LOGI(__func__, "Connection idle for %u ms, reconnecting", (uint32_t)((start - lastUsedUs) / 1000));
+        close();
+    }
+
+    int status = HTTPS_ERR_CONNECT;
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        bool fresh = !connected;
+        if (fresh && !connect())
+            break;
+        if (!fresh)
+            stats.reused++;
+
+        bool reusable = false;
+        status = request(path, body, size, length, &reusable);
+        if (aborted)
+            status = HTTPS_ERR_ABORTED;
+        if (status < 0 || !reusable || !keepAlive)
+            close();
+        // a kept alive connection the server already dropped fails before any response
+        if (status != HTTPS_ERR_STALE || fresh)
+            break;
+        ESP_LOGW(__func__, "Kept alive connection was closed by %s, retrying", host);
+    }
+
+    stats.fetches++;
+    if (status < 0)
+        stats.failures++;
+    lastUsedUs = esp_timer_get_time();
+    stats.lastFetchUs = lastUsedUs - start;
+    stats.totalFetchUs += stats.lastFetchUs;
+    return status;
+}
+
+// GET path from the origin, handing a 2xx body to sink as it arrives instead of buffering it.
+// *length is the number of body bytes received. Returns the HTTP status, HTTPS_ERR_ABORTED
+// when the sink stopped the transfer, or another negative HTTPS_ERR_* on failure.
+int HttpsSession::get(const char *path, HttpsBodySink &sink, size_t *length)
+{
+    this->sink = &sink;
+    int status = get(path, NULL, 0, length);
+    this->sink = NULL;
+    return status;
+}
+
+// Switch between TLS and plain connections, drops the connection if it changed
+void HttpsSession::setTransport(TlsTransport &transport)
+{
+    if (this->transport != &transport)
+        close();
+    this->transport = &transport;
+}
+
+void HttpsSession::close()
+{
+    if (connected)
+        transport->close();
+    connected = false;
+    rxStart = rxEnd = 0;
+}
+
+bool HttpsSession::closeIfIdle()
+{
+    if (!connected || (esp_timer_get_time() - lastUsedUs) / 1000 < idleTimeoutMs)
+        return false;
+    ESP_LOGI(__func__, "Connection to %s idle for %u ms, closing", host, (uint32_t)((esp_timer_get_time() - lastUsedUs) / 1000));
+    close();
+    return true;
+}
+
+bool HttpsSession::connect()
+{
+    int64_t start = esp_timer_get_time();
+    if (!transport->connect(host, port, HTTPS_CONNECT_TIMEOUT_MS))
+    {
+        ESP_LOGE(__func__, "Failed to connect to %s:%u", host, port);
+        return false;
+    }
+    stats.lastHandshakeUs = esp_timer_get_time() - start;
+    stats.totalHandshakeUs += stats.lastHandshakeUs;
+    stats.handshakes++;
+    bool resumed = transport->resumed();
+    if (resumed)
+        stats.resumed++;
+    ESP_LOGI(__func__, "Connected to %s:%u in %u us (%s)", host, port, stats.lastHandshakeUs, resumed ? "resumed" : "full handshake");
+    connected = true;
+    rxStart = rxEnd = 0;
+    return true;
+}
+
+int HttpsSession::request(const char *path, uint8_t *body, size_t size, size_t *length, bool *reusable)
+{
+    char out[HTTPS_REQUEST_MAX];
+    int len = snprintf(out, sizeof(out), "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n%s",
+                       path, host, keepAlive ? "keep-alive" : "close", headers ? headers : "");
+    if (validators && validators->etag[0] && len < (int)sizeof(out))
+        len += snprintf(&out[len], sizeof(out) - len, "If-None-Match: %s\r\n", validators->etag);
+    if (validators && validators->lastModified[0] && len < (int)sizeof(out))
+        len += snprintf(&out[len], sizeof(out) - len, "If-Modified-Since: %s\r\n", validators->lastModified);
+    if (len < (int)sizeof(out))
+        len += snprintf(&out[len], sizeof(out) - len, "\r\n");
+    if (len >= (int)sizeof(out))
+        return HTTPS_ERR_REQUEST;
+    for (int sent = 0; sent < len;)
+    {
+        int n = transport->write((const uint8_t *)out + sent, len - sent);
+        if (n <= 0)
+            return HTTPS_ERR_STALE;
+        sent += n;
+    }
+    responseValidators = {};
+    retryAfter = 0;
+
+    char line[256];
+
+    // status line, e.g. "HTTP/1.1 200 OK"
+    int minor = 0;
+    int status = 0;
+    if (!readLine(line, sizeof(line)))
+        return HTTPS_ERR_STALE;
+    if (sscanf(line, "HTTP/1.%d %d", &minor, &status) != 2)
+        return HTTPS_ERR_RESPONSE;
+    *reusable = minor >= 1;
+    this->status = status;
+    streaming = sink && status >= 200 && status < 300;
+
+    long contentLength = -1;
+    bool chunked = false;
+    for (;;)
+    {
+        // only the start of long headers is of interest
+        if (!readLine(line, sizeof(line), true))
+            return HTTPS_ERR_RESPONSE;
+        if (!line[0])
+            break;
+        const char *value;
+        if ((value = headerValue(line, "Content-Length")))
+            contentLength = strtol(value, NULL, 10);
+        else if ((value = headerValue(line, "ETag")))
+            snprintf(responseValidators.etag, sizeof(responseValidators.etag), "%s", value);
+        else if ((value = headerValue(line, "Last-Modified")))
+            snprintf(responseValidators.lastModified, sizeof(responseValidators.lastModified), "%s", value);
+        else if ((value = headerValue(line, "Retry-After")))
+            retryAfter = strtoul(value, NULL, 10);
+        else if ((value = headerValue(line, "Transfer-Encoding")))
+            chunked = hasToken(value, "chunked");
+        else if ((value = headerValue(line, "Connection")))
+            *reusable = !hasToken(value, "close") && (minor >= 1 || hasToken(value, "keep-alive"));
+    }
+
+    // no body, whatever the framing headers say
+    if (status == 204 || status == 304 || status < 200)
+        return status;
+    if (chunked)
+    {
+        for (;;)
+        {
+            if (!readLine(line, sizeof(line)))
+                return HTTPS_ERR_RESPONSE;
+            size_t chunk = strtoul(line, NULL, 16);
+            if (!chunk)
+                break;
+            if (!readBody(body, size, chunk, length) || !readLine(line, sizeof(line)))
+                return HTTPS_ERR_RESPONSE;
+        }
+        // skip trailers
+        do
+        {
+            if (!readLine(line, sizeof(line), true))
+                return HTTPS_ERR_RESPONSE;
+        } while (line[0]);
+    }
+    else if (contentLength >= 0)
+    {
+        if (!readBody(body, size, contentLength, length))
+            return HTTPS_ERR_RESPONSE;
+    }
+    else
+    {
+        // no framing, the body ends when the server closes
+        *reusable = false;
+        readBody(body, size, SIZE_MAX, length);
+    }
+    return status;
+}
+
+// Read more bytes into the receive buffer, false once the connection is closed
+bool HttpsSession::fill()
+{
+    if (rxStart == rxEnd)
+        rxStart = rxEnd = 0;
+    else if (rxEnd == sizeof(rx))
+    {
+        memmove(rx, &rx[rxStart], rxEnd - rxStart);
+        rxEnd -= rxStart;
+        rxStart = 0;
+    }
+    if (rxEnd == sizeof(rx))
+        return false;
+    int n = transport->read(&rx[rxEnd], sizeof(rx) - rxEnd);
+    if (n <= 0)
+        return false;
+    rxEnd += n;
+    return true;
+}
+
+// Read one CRLF terminated line without the line ending. A line that does not fit is false,
+// or with truncate its start, the rest is skipped.
+bool HttpsSession::readLine(char *line, size_t size, bool truncate)
+{
+    bool skipping = false;
+    for (;;)
+    {
+        uint8_t *end = (uint8_t *)memchr(&rx[rxStart], '\n', rxEnd - rxStart);
+        size_t len = (end ? end : &rx[rxEnd]) - &rx[rxStart];
+        if (end && len && end[-1] == '\r')
+            len--;
+        if (len >= size && !truncate)
+            return false;
+        if (!skipping && (end || len >= size))
+        {
+            len = len < size ? len : size - 1;
+            memcpy(line, &rx[rxStart], len);
+            line[len] = '\0';
+            skipping = true;
+        }
+        if (end)
+        {
+            rxStart = end - rx + 1;
+            return true;
+        }
+        // the receive buffer is full of one line, drop what was kept of it
+        if (skipping)
+            rxStart = rxEnd = 0;
+        if (!fill())
+            return false;
+    }
+}
+
+// Consume count body bytes (SIZE_MAX: until the connection closes), storing what fits.
+// Large reads bypass the receive buffer and land in body directly.
+bool HttpsSession::readBody(uint8_t *body, size_t size, size_t count, size_t *stored)
+{
+    while (count)
+    {
+        size_t n = rxEnd - rxStart;
+        if (!n)
+        {
+            size_t space = *stored < size ? size - *stored : 0;
+            if (space >= sizeof(rx))
+            {
+                int direct = transport->read(&body[*stored], count < space ? count : space);
+                if (direct <= 0)
+                    return count == SIZE_MAX;
+                *stored += direct;
+                if (count != SIZE_MAX)
+                    count -= direct;
+                continue;
+            }
+            if (!fill())
+                return count == SIZE_MAX;
+            n = rxEnd - rxStart;
+        }
+        if (n > count)
+            n = count;
+        if (streaming && !sink->write(&rx[rxStart], n))
+        {
+            aborted = true;
+            return false;
+        }
+        if (*stored < size)
+            memcpy(&body[*stored], &rx[rxStart], n < size - *stored ? n : size - *stored);
+        *stored += n;
+        rxStart += n;
+        if (count != SIZE_MAX)
+            count -= n;
+    }
+    return true;
+}
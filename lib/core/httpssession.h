@@ -0,0 +1,121 @@
+#ifndef HTTPSSESSION_H
+#define HTTPSSESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// close an idle connection before reuse, origins drop keep-alive sockets after a while
+#define HTTPS_IDLE_TIMEOUT_MS 30000
+#define HTTPS_CONNECT_TIMEOUT_MS 10000
+#define HTTPS_HOST_MAX 64
+#define HTTPS_REQUEST_MAX 512 // request line and headers
+#define HTTPS_ETAG_MAX 80
+#define HTTPS_DATE_MAX 32
+
+// HttpsSession::get failures
+#define HTTPS_ERR_CONNECT -1
+#define HTTPS_ERR_STALE -2 // kept alive connection closed before answering
+#define HTTPS_ERR_RESPONSE -3
+#define HTTPS_ERR_REQUEST -4
+#define HTTPS_ERR_ABORTED -5 // the body sink stopped the transfer
+
+// TLS byte stream to a single origin, esp_tls on the device and OpenSSL on the host (or plain
+// TCP with TcpTransport, for servers on the LAN)
+class TlsTransport {
+    public:
+        virtual ~TlsTransport() {}
+        // open a connection, offering the previous session for resumption when there is one
+        virtual bool connect(const char *host, uint16_t port, uint32_t timeoutMs) = 0;
+        // bytes transferred, 0 when the peer closed, negative on error
+        virtual int write(const uint8_t *data, size_t len) = 0;
+        virtual int read(uint8_t *data, size_t len) = 0;
+        virtual void close() = 0;
+        // whether the last connect skipped the full handshake
+        virtual bool resumed() = 0;
+};
+
+// Receives a 2xx response body piece by piece as it arrives, false stops the transfer
+class HttpsBodySink {
+    public:
+        virtual ~HttpsBodySink() {}
+        virtual bool write(const uint8_t *data, size_t len) = 0;
+};
+
+// Cache validators of a response, sent back as If-None-Match / If-Modified-Since so an
+// unchanged resource is answered with a bodiless 304
+struct HttpsValidators
+{
+    char etag[HTTPS_ETAG_MAX];
+    char lastModified[HTTPS_DATE_MAX];
+};
+
+struct HttpsSessionStats
+{
+    uint32_t fetches;
+    uint32_t failures;
+    uint32_t handshakes;
+    uint32_t resumed;
+    uint32_t reused;
+    uint32_t lastFetchUs;
+    uint32_t lastHandshakeUs;
+    uint64_t totalFetchUs;
+    uint64_t totalHandshakeUs;
+};
+
+// Minimal HTTP/1.1 GET client that keeps the connection to one origin open between requests.
+// Requests on a connection the server has silently closed are retried once on a new one.
+class HttpsSession {
+    public:
+        HttpsSession(TlsTransport &transport);
+        void setHost(const char *host, uint16_t port = 443);
+        void setTransport(TlsTransport &transport);
+        void setIdleTimeout(uint32_t ms) { idleTimeoutMs = ms; }
+        void setKeepAlive(bool keepAlive) { this->keepAlive = keepAlive; }
+        // extra request header lines, each ending in CRLF, the caller keeps the string
+        void setHeaders(const char *headers) { this->headers = headers; }
+        // make the following requests conditional, NULL to stop
+        void setValidators(const HttpsValidators *validators) { this->validators = validators; }
+        int get(const char *path, uint8_t *body, size_t size, size_t *length);
+        int get(const char *path, HttpsBodySink &sink, size_t *length);
+        void close();
+        // close a kept alive connection unused for the idle timeout, freeing the TLS context
+        // while nothing is fetched. For the owning task between requests, true if it closed.
+        bool closeIfIdle();
+        bool isConnected() const { return connected; }
+        HttpsSessionStats getStats() const { return stats; }
+        // of the last response, also when its body was not read to the end
+        int getStatus() const { return status; }
+        const HttpsValidators &getResponseValidators() const { return responseValidators; }
+        uint32_t getRetryAfter() const { return retryAfter; } // seconds, 0 if not sent
+
+    private:
+        TlsTransport *transport;
+        char host[HTTPS_HOST_MAX];
+        uint16_t port;
+        bool connected;
+        bool keepAlive;
+        uint32_t idleTimeoutMs;
+        int64_t lastUsedUs;
+        HttpsSessionStats stats;
+        const char *headers;
+        const HttpsValidators *validators;
+        int status;
+        HttpsValidators responseValidators;
+        uint32_t retryAfter;
+        // streaming get(): where the body goes, and whether it said stop
+        HttpsBodySink *sink;
+        bool streaming;
+        bool aborted;
+        // receive buffer shared by header parsing and body reads
+        uint8_t rx[512];
+        size_t rxStart;
+        size_t rxEnd;
+
+        bool connect();
+        int request(const char *path, uint8_t *body, size_t size, size_t *length, bool *reusable);
+        bool fill();
+        bool readLine(char *line, size_t size, bool truncate = false);
+        bool readBody(uint8_t *body, size_t size, size_t count, size_t *stored);
+};
+
+#endif
@@ -0,0 +1,22 @@
+#include "hub75timing.h"
+
+Hub75Timing hub75Timing(uint16_t width, uint16_t height, uint8_t depthBits, uint32_t clockHz, uint16_t minRefreshHz)
+{
+    Hub75Timing timing = {};
+    timing.depthBits = depthBits;
+    // two rows are shifted out at once, one pixel per clock, as 16 bit DMA words
+    uint32_t rows = height / 2;
+    timing.dmaBytes = rows * depthBits * width * 2;
+    uint64_t nsPerLatch = (uint64_t)width * 1000000000ULL / clockHz;
+    for (;;)
+    {
+        uint64_t nsPerRow = depthBits * nsPerLatch;
+        for (int bit = timing.transitionBit + 1; bit < depthBits; bit++)
+            nsPerRow += (1ULL << (bit - timing.transitionBit - 1)) * (depthBits - bit) * nsPerLatch;
+        timing.refreshHz = 1000000000ULL / (nsPerRow * rows);
+        if (timing.refreshHz > minRefreshHz || timing.transitionBit >= depthBits - 1)
+            break;
+        timing.transitionBit++;
+    }
+    return timing;
+}
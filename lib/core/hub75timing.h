@@ -0,0 +1,22 @@
+#ifndef HUB75TIMING_H
+#define HUB75TIMING_H
+
+#include <stdint.h>
+
+// How the HUB75 DMA driver will refresh a panel configuration
+struct Hub75Timing
+{
+    uint8_t depthBits;
+    uint8_t transitionBit; // planes up to here are shown once each, their weight comes from OE
+    uint32_t refreshHz;
+    uint32_t dmaBytes;     // per DMA buffer
+};
+
+// Estimate of the refresh rate the driver settles on, computed the way the driver sizes its
+// bit planes: planes above the LSB/MSB transition bit are repeated to get their binary
+// weight, and the transition bit is raised until the panel refreshes at minRefreshHz.
+// Every raise halves the time spent on the high planes but leaves the low ones closer
+// together, which is what dithering makes up for.
+Hub75Timing hub75Timing(uint16_t width, uint16_t height, uint8_t depthBits, uint32_t clockHz, uint16_t minRefreshHz);
+
+#endif
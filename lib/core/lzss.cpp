@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lzss.h"
+
+#define LZSS_HASH_BITS 15
+#define LZSS_CHAIN 64 // match candidates tried per position when compressing
+
+LzssDecoder::LzssDecoder() :
+    window(),
+    windowPos(0),
+    bits(0),
+    bitCount(0),
+    matchDistance(0),
+    matchLeft(0)
+{
+}
+
+void LzssDecoder::reset()
+{
+    memset(window, 0, sizeof(window));
+    windowPos = 0;
+    bits = 0;
+    bitCount = 0;
+    matchDistance = 0;
+    matchLeft = 0;
+}
+
+size_t LzssDecoder::decode(const uint8_t *in, size_t len, size_t *consumed, uint8_t *out, size_t size)
+{
+    size_t used = 0;
+    size_t produced = 0;
+    // at least count bits buffered, false when the input ran out first
+    auto need = [&](uint8_t count)
+    {
+        while (bitCount < count && used < len)
+        {
+            bits = bits << 8 | in[used++];
+            bitCount += 8;
+        }
+        return bitCount >= count;
+    };
+    while (produced < size)
+    {
+        if (matchLeft)
+        {
+            uint8_t c = window[(windowPos - matchDistance) & (LZSS_WINDOW - 1)];
+            window[windowPos++ & (LZSS_WINDOW - 1)] = c;
+            out[produced++] = c;
+            matchLeft--;
+            continue;
+        }
+        if (!need(1))
+            break;
+        if (bits >> (bitCount - 1) & 1)
+        {
+            if (!need(9))
+                break;
+            bitCount -= 9;
+            uint8_t c = bits >> bitCount;
+            window[windowPos++ & (LZSS_WINDOW - 1)] = c;
+            out[produced++] = c;
+        }
+        else
+        {
+            if (!need(1 + LZSS_WINDOW_BITS + LZSS_LENGTH_BITS))
+                break;
+            bitCount -= 1 + LZSS_WINDOW_BITS + LZSS_LENGTH_BITS;
+            uint32_t token = bits >> bitCount;
+            matchDistance = (token >> LZSS_LENGTH_BITS & (LZSS_WINDOW - 1)) + 1;
+            matchLeft = (token & ((1 << LZSS_LENGTH_BITS) - 1)) + LZSS_MIN_MATCH;
+        }
+        bits &= (1u << bitCount) - 1;
+    }
+    *consumed = used;
+    return produced;
+}
+
+// MSB first bit writer over a bounded buffer
+struct BitWriter
+{
+    uint8_t *out;
+    size_t size;
+    size_t len;
+    uint32_t bits;
+    uint8_t bitCount;
+
+    bool put(uint32_t value, uint8_t count)
+    {
+        bits = bits << count | value;
+        bitCount += count;
+        while (bitCount >= 8)
+        {
+            if (len == size)
+                return false;
+            bitCount -= 8;
+            out[len++] = bits >> bitCount;
+        }
+        bits &= (1u << bitCount) - 1;
+        return true;
+    }
+};
+
+static uint32_t lzssHash(const uint8_t *p)
+{
+    return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - LZSS_HASH_BITS);
+}
+
+size_t lzssCompress(const uint8_t *in, size_t len, uint8_t *out, size_t size)
+{
+    // hash chains over the window: newest position per hash, previous one with the same hash
+    int32_t *head = (int32_t *)malloc(sizeof(int32_t) << LZSS_HASH_BITS);
+    int32_t *prev = (int32_t *)malloc(sizeof(int32_t) * LZSS_WINDOW);
+    if (!head || !prev)
+    {
+        free(head);
+        free(prev);
+        return 0;
+    }
+    memset(head, 0xff, sizeof(int32_t) << LZSS_HASH_BITS);
+    BitWriter writer = {out, size, 0, 0, 0};
+    bool ok = true;
+    auto insert = [&](size_t pos)
+    {
+        if (pos + LZSS_MIN_MATCH > len)
+            return;
+        uint32_t hash = lzssHash(&in[pos]);
+        prev[pos & (LZSS_WINDOW - 1)] = head[hash];
+        head[hash] = pos;
+    };
+    for (size_t pos = 0; ok && pos < len;)
+    {
+        size_t bestLen = 0;
+        size_t bestDistance = 0;
+        if (pos + LZSS_MIN_MATCH <= len)
+        {
+            size_t limit = len - pos < LZSS_MAX_MATCH ? len - pos : LZSS_MAX_MATCH;
+            int32_t candidate = head[lzssHash(&in[pos])];
+            for (int chain = 0; chain < LZSS_CHAIN && candidate >= 0 && pos - candidate <= LZSS_WINDOW; chain++)
+            {
+                size_t n = 0;
+                while (n < limit && in[candidate + n] == in[pos + n])
+                    n++;
+                if (n > bestLen)
+                {
+                    bestLen = n;
+                    bestDistance = pos - candidate;
+                    if (n == limit)
+                        break;
+                }
+                int32_t next = prev[candidate & (LZSS_WINDOW - 1)];
+                // the slot was reused by a newer position
+                if (next >= candidate)
+                    break;
+                candidate = next;
+            }
+        }
+        if (bestLen >= LZSS_MIN_MATCH)
+        {
+            ok = writer.put(0, 1) && writer.put(bestDistance - 1, LZSS_WINDOW_BITS) && writer.put(bestLen - LZSS_MIN_MATCH, LZSS_LENGTH_BITS);
+            for (size_t i = 0; i < bestLen; i++)
+                insert(pos + i);
+            pos += bestLen;
+        }
+        else
+        {
+            ok = writer.put(1, 1) && writer.put(in[pos], 8);
+            insert(pos);
+            pos++;
+        }
+    }
+    // pad the last byte, too few bits for another token
+    if (ok && writer.bitCount)
+        ok = writer.put(0, 8 - writer.bitCount);
+    free(head);
+    free(prev);
+    return ok ? writer.len : 0;
+}
@@ -0,0 +1,38 @@
+#ifndef LZSS_H
+#define LZSS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// LZSS in the style of heatshrink: a bit stream of literals (1, then 8 bits) and back
+// references (0, then distance - 1 in LZSS_WINDOW_BITS and length - LZSS_MIN_MATCH in
+// LZSS_LENGTH_BITS), most significant bit first. Decoding only needs the window.
+#define LZSS_WINDOW_BITS 12
+#define LZSS_LENGTH_BITS 5
+#define LZSS_WINDOW (1 << LZSS_WINDOW_BITS)
+#define LZSS_MIN_MATCH 3
+#define LZSS_MAX_MATCH (LZSS_MIN_MATCH + (1 << LZSS_LENGTH_BITS) - 1)
+
+// Streaming decoder, input in any chunking, output as much as fits each call
+class LzssDecoder {
+    public:
+        LzssDecoder();
+        void reset();
+        // Decode from in into out, returns the bytes written to out, *consumed is how much of in
+        // was used. Call again with the rest of in once out was full.
+        size_t decode(const uint8_t *in, size_t len, size_t *consumed, uint8_t *out, size_t size);
+
+    private:
+        uint8_t window[LZSS_WINDOW];
+        uint32_t windowPos;
+        uint32_t bits;
+        uint8_t bitCount;
+        uint16_t matchDistance;
+        uint16_t matchLeft;
+};
+
+// Compress len bytes of in, returns the compressed size or 0 if it does not fit in size.
+// Build side (status_sim patch), the match finder allocates about 200 KB.
+size_t lzssCompress(const uint8_t *in, size_t len, uint8_t *out, size_t size);
+
+#endif
@@ -0,0 +1,67 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "metrics.h"
+
+// snprintf at out + len, keeping the total length when the buffer runs out
+static size_t append(char *out, size_t size, size_t len, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(len < size ? out + len : NULL, len < size ? size - len : 0, format, args);
+    va_end(args);
+    return n > 0 ? len + n : len;
+}
+
+Histogram::Histogram(const char *name, const char *help) :
+    name(name),
+    help(help),
+    sumUs(0)
+{
+    for (int i = 0; i <= HISTOGRAM_BUCKETS; i++)
+        buckets[i] = 0;
+}
+
+// index of the smallest bucket holding us, HISTOGRAM_BUCKETS for +Inf
+int Histogram::bucket(uint32_t us)
+{
+    uint32_t above = us ? (us - 1) / HISTOGRAM_MIN_US : 0;
+    int index = above ? 32 - __builtin_clz(above) : 0;
+    return index < HISTOGRAM_BUCKETS ? index : HISTOGRAM_BUCKETS;
+}
+
+void Histogram::record(uint32_t us)
+{
+    buckets[bucket(us)].fetch_add(1, std::memory_order_relaxed);
+    sumUs.fetch_add(us, std::memory_order_relaxed);
+}
+
+uint32_t Histogram::getCount() const
+{
+    uint32_t count = 0;
+    for (int i = 0; i <= HISTOGRAM_BUCKETS; i++)
+        count += buckets[i].load(std::memory_order_relaxed);
+    return count;
+}
+
+// Cumulative buckets in seconds. The count is the +Inf bucket, so the two always agree even
+// while other tasks keep recording.
+size_t Histogram::format(char *out, size_t size) const
+{
+    size_t len = append(out, size, 0, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    uint32_t cumulative = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        cumulative += buckets[i].load(std::memory_order_relaxed);
+        len = append(out, size, len, "%s_bucket{le=\"%.6f\"} %u\n", name, (double)((uint32_t)HISTOGRAM_MIN_US << i) / 1e6, cumulative);
+    }
+    cumulative += buckets[HISTOGRAM_BUCKETS].load(std::memory_order_relaxed);
+    len = append(out, size, len, "%s_bucket{le=\"+Inf\"} %u\n", name, cumulative);
+    len = append(out, size, len, "%s_sum %.6f\n%s_count %u\n", name, sumUs.load(std::memory_order_relaxed) / 1e6, name, cumulative);
+    return len;
+}
+
+size_t formatMetric(char *out, size_t size, const char *name, const char *type, const char *help, double value)
+{
+    return append(out, size, 0, "# HELP %s %s\n# TYPE %s %s\n%s %.15g\n", name, help, name, type, name, value);
+}
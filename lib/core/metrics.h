@@ -0,0 +1,33 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Histogram buckets double from HISTOGRAM_MIN_US, 32 us up to 4.2 s, then +Inf
+#define HISTOGRAM_MIN_US 32
+#define HISTOGRAM_BUCKETS 18
+
+// Duration histogram with fixed power of two buckets. record() is a bucket index and three
+// relaxed atomic adds, it never locks or allocates, so it stays in the hot paths whether or
+// not anyone reads the metrics. format() renders the Prometheus text exposition on demand.
+class Histogram {
+    public:
+        Histogram(const char *name, const char *help);
+        void record(uint32_t us);
+        uint32_t getCount() const;
+        size_t format(char *out, size_t size) const;
+        static int bucket(uint32_t us);
+
+    private:
+        const char *name;
+        const char *help;
+        std::atomic<uint32_t> buckets[HISTOGRAM_BUCKETS + 1];
+        std::atomic<uint64_t> sumUs;
+};
+
+// One counter or gauge in the Prometheus text format, returns the length like snprintf
+size_t formatMetric(char *out, size_t size, const char *name, const char *type, const char *help, double value);
+
+#endif
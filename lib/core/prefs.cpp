@@ -0,0 +1,33 @@
+#include <string.h>
+
+#include "prefs.h"
+
+#define PANEL_PREFS_UNVERSIONED 5 // layouts before the version field
+
+static constexpr size_t layoutSizes[] = PANEL_PREFS_SIZES;
+static_assert(sizeof(layoutSizes) / sizeof(layoutSizes[0]) == PANEL_PREFS_VERSION &&
+                  layoutSizes[PANEL_PREFS_VERSION - 1] == sizeof(PanelPrefs),
+              "PANEL_PREFS_SIZES must end with the size of this layout");
+
+bool loadPanelPrefs(PanelPrefs *prefs, const uint8_t *blob, size_t size)
+{
+    uint8_t *fields = (uint8_t *)prefs;
+    // the same fields without the version in front, told apart by their size
+    for (int version = 1; version <= PANEL_PREFS_UNVERSIONED; version++)
+    {
+        if (size == layoutSizes[version - 1])
+        {
+            memcpy(fields + offsetof(PanelPrefs, brightness), blob, size);
+            prefs->version = PANEL_PREFS_VERSION;
+            return true;
+        }
+    }
+    if (!size || blob[0] <= PANEL_PREFS_UNVERSIONED)
+        return false;
+    // a newer layout starts with all of the fields of this one
+    if (blob[0] <= PANEL_PREFS_VERSION ? size != layoutSizes[blob[0] - 1] : size <= sizeof(PanelPrefs))
+        return false;
+    memcpy(fields, blob, size < sizeof(PanelPrefs) ? size : sizeof(PanelPrefs));
+    prefs->version = PANEL_PREFS_VERSION;
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef PREFS_H
+#define PREFS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_log.h>
+
+// Layout of PanelPrefs in NVS. Fields are only ever appended (bump the version and add its
+// size to PANEL_PREFS_SIZES), so a blob of an older layout loads as a prefix of this one with
+// the newer fields at their defaults. Versions 1 to 5 predate the version field.
+#define PANEL_PREFS_VERSION 6
+#define PANEL_PREFS_SIZES {7, 8, 13, 15, 17, 18} // sizeof(PanelPrefs) of each version
+
+// Preferences struct for storing and loading in nvs
+struct PanelPrefs
+{
+    uint8_t version = PANEL_PREFS_VERSION;
+    uint8_t brightness = 255;
+    bool development = 0;
+    bool ota = 0;
+    bool github = 1;
+    bool signedFWOnly = 1;
+    uint8_t latchBlanking = 1;
+    bool use20MHz = 0;
+    uint8_t marqueeSpeed = 24; // pixels per second, 0 wraps long text instead of scrolling it
+    uint8_t gamma = 22; // tenths, applied with white balance and dithering at commit (see colorlut.h)
+    uint8_t whiteBalance[3] = {255, 255, 255};
+    bool dither = 1;
+    bool temporalDither = 0; // flicker between two dither patterns for more dark levels
+    uint8_t colorDepth = 8;  // driver bit planes, fewer refresh faster
+    uint8_t rolloutHours = 24; // a release reaches the whole fleet over this long (see rollout.h)
+    bool peerUpdates = 0;      // serve the running release to other panels, and ask them first
+    void print(const char *prefix) {
+        ESP_LOGI(__func__, "%s\nBrightness: %d\nDevelopment: %d\nOTA: %d\nGithub: %d\nSigned FW Only: %d\nGamma: %d.%d\nWhite Balance: %d %d %d\nDither: %d (temporal %d)\nColor Depth: %d\nRollout: %d h\nPeer Updates: %d\n", prefix, brightness, development, ota, github, signedFWOnly,
+                 gamma / 10, gamma % 10, whiteBalance[0], whiteBalance[1], whiteBalance[2], dither, temporalDither, colorDepth, rolloutHours, peerUpdates);
+    }
+};
+
+// Load a stored PanelPrefs blob of this or an older layout (or the known prefix of a newer
+// one) over prefs, which keeps its defaults for the rest. False for a blob of no known layout.
+bool loadPanelPrefs(PanelPrefs *prefs, const uint8_t *blob, size_t size);
+
+#endif
@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "releasefeed.h"
+
+ReleaseFeed::ReleaseFeed() :
+    prereleases(false),
+    asset(),
+    state(STATE_ERROR),
+    error(NULL),
+    releases(0),
+    depth(0),
+    objects(0),
+    keyNext(false),
+    opened(false),
+    releaseDepth(0),
+    capture(CAPTURE_NONE),
+    text(),
+    textLen(0),
+    truncated(false),
+    unicodeDigits(0),
+    bare(),
+    bareLen(0),
+    releaseKey(),
+    assetKey(),
+    inAssets(false),
+    current(),
+    draft(false),
+    hasAsset(false),
+    best(),
+    found(false)
+{
+}
+
+// Start a new document. With prereleases only they count (development builds), otherwise
+// every release does. asset (e.g. "esp32.bin") must be attached, NULL or "" for any.
+void ReleaseFeed::reset(bool prereleases, const char *asset)
+{
+    this->prereleases = prereleases;
+    snprintf(this->asset, sizeof(this->asset), "%s", asset ? asset : "");
+    state = STATE_VALUE;
+    error = NULL;
+    releases = 0;
+    depth = 0;
+    objects = 0;
+    keyNext = false;
+    opened = false;
+    releaseDepth = 0;
+    inAssets = false;
+    found = false;
+}
+
+bool ReleaseFeed::getRelease(ReleaseInfo *release) const
+{
+    if (found)
+        *release = best;
+    return found;
+}
+
+bool ReleaseFeed::fail(const char *error)
+{
+    this->error = error;
+    state = STATE_ERROR;
+    return false;
+}
+
+bool ReleaseFeed::write(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!step(data[i]))
+            return false;
+    }
+    return true;
+}
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+bool ReleaseFeed::step(char c)
+{
+    switch (state)
+    {
+    case STATE_VALUE:
+        if (isSpace(c))
+            return true;
+        // an empty container, not one with a trailing comma
+        if (opened && (c == '}' || c == ']'))
+            return close(c);
+        opened = false;
+        if (keyNext)
+        {
+            if (c != '"')
+                return fail("expected a key");
+            startString();
+            return true;
+        }
+        if (c == '{' || c == '[')
+            return open(c);
+        if (!depth)
+            return fail("not a release list");
+        if (c == '"')
+        {
+            startString();
+            return true;
+        }
+        if (c == '-' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z'))
+        {
+            bare[0] = c;
+            bareLen = 1;
+            state = STATE_BARE;
+            return true;
+        }
+        return fail("expected a value");
+
+    case STATE_COLON:
+        if (isSpace(c))
+            return true;
+        if (c != ':')
+            return fail("expected ':'");
+        state = STATE_VALUE;
+        return true;
+
+    case STATE_AFTER:
+        if (isSpace(c))
+            return true;
+        if (c == ',')
+        {
+            keyNext = objects >> (depth - 1) & 1;
+            state = STATE_VALUE;
+            return true;
+        }
+        if (c == '}' || c == ']')
+            return close(c);
+        return fail("expected ',' or the end of a container");
+
+    case STATE_STRING:
+        if (c == '"')
+        {
+            endString();
+            return true;
+        }
+        if (c == '\\')
+        {
+            state = STATE_ESCAPE;
+            return true;
+        }
+        if ((uint8_t)c < 0x20)
+            return fail("control character in a string");
+        break;
+
+    case STATE_ESCAPE:
+        switch (c)
+        {
+        case '"':
+        case '\\':
+        case '/':
+            break;
+        case 'b':
+            c = '\b';
+            break;
+        case 'f':
+            c = '\f';
+            break;
+        case 'n':
+            c = '\n';
+            break;
+        case 'r':
+            c = '\r';
+            break;
+        case 't':
+            c = '\t';
+            break;
+        case 'u':
+            unicodeDigits = 0;
+            state = STATE_UNICODE;
+            return true;
+        default:
+            return fail("bad escape");
+        }
+        state = STATE_STRING;
+        break;
+
+    case STATE_UNICODE:
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')))
+            return fail("bad unicode escape");
+        if (++unicodeDigits < 4)
+            return true;
+        // none of the captured strings is expected to have anything but ASCII
+        c = '?';
+        state = STATE_STRING;
+        break;
+
+    case STATE_BARE:
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '.' || c == '-' || c == '+' || c == 'E')
+        {
+            if (bareLen < sizeof(bare) - 1)
+                bare[bareLen] = c;
+            bareLen = bareLen < 255 ? bareLen + 1 : bareLen;
+            return true;
+        }
+        endBare();
+        if (state == STATE_ERROR)
+            return false;
+        return step(c);
+
+    case STATE_DONE:
+        if (isSpace(c))
+            return true;
+        return fail("data after the release list");
+
+    case STATE_ERROR:
+        return false;
+    }
+
+    // a character of a string
+    if (capture == CAPTURE_NONE)
+        return true;
+    if (textLen < sizeof(text) - 1)
+        text[textLen++] = c;
+    else
+        truncated = true;
+    return true;
+}
+
+bool ReleaseFeed::open(char c)
+{
+    if (depth == RELEASE_DEPTH_MAX)
+        return fail("nested too deep");
+    if (!depth)
+        releaseDepth = c == '[' ? 2 : 1;
+    bool inObject = depth && objects >> (depth - 1) & 1;
+    if (depth == releaseDepth && inObject && c == '[' && !strcmp(releaseKey, "assets"))
+        inAssets = true;
+    depth++;
+    if (c == '{')
+        objects |= 1u << (depth - 1);
+    else
+        objects &= ~(1u << (depth - 1));
+    if (c == '{' && depth == releaseDepth)
+    {
+        memset(&current, 0, sizeof(current));
+        current.publishedAt = -1;
+        releaseKey[0] = '\0';
+        draft = false;
+        hasAsset = false;
+    }
+    if (c == '{' && inAssets && depth == releaseDepth + 2)
+        assetKey[0] = '\0';
+    keyNext = c == '{';
+    opened = true;
+    state = STATE_VALUE;
+    return true;
+}
+
+bool ReleaseFeed::close(char c)
+{
+    bool inObject = depth && objects >> (depth - 1) & 1;
+    if (!depth || (c == '}') != inObject)
+        return fail("mismatched bracket");
+    if (c == '}' && depth == releaseDepth)
+        endRelease();
+    if (inAssets && depth == releaseDepth + 1)
+        inAssets = false;
+    depth--;
+    keyNext = false;
+    state = depth ? STATE_AFTER : STATE_DONE;
+    return true;
+}
+
+void ReleaseFeed::startString()
+{
+    bool inObject = depth && objects >> (depth - 1) & 1;
+    capture = CAPTURE_NONE;
+    if (inObject && depth == releaseDepth)
+    {
+        if (keyNext)
+            capture = CAPTURE_RELEASE_KEY;
+        else if (!strcmp(releaseKey, "tag_name"))
+            capture = CAPTURE_TAG;
+        else if (!strcmp(releaseKey, "published_at"))
+            capture = CAPTURE_PUBLISHED;
+    }
+    else if (inObject && inAssets && depth == releaseDepth + 2)
+    {
+        if (keyNext)
+            capture = CAPTURE_ASSET_KEY;
+        else if (!strcmp(assetKey, "name"))
+            capture = CAPTURE_ASSET_NAME;
+    }
+    textLen = 0;
+    truncated = false;
+    state = STATE_STRING;
+}
+
+// A key longer than the buffer is none of the keys looked for
+void ReleaseFeed::copyKey(char key[RELEASE_KEY_MAX])
+{
+    if (textLen < RELEASE_KEY_MAX)
+        memcpy(key, text, textLen + 1);
+    else
+        key[0] = '\0';
+}
+
+void ReleaseFeed::endString()
+{
+    text[textLen] = '\0';
+    switch (capture)
+    {
+    case CAPTURE_RELEASE_KEY:
+        copyKey(releaseKey);
+        break;
+    case CAPTURE_ASSET_KEY:
+        copyKey(assetKey);
+        break;
+    case CAPTURE_TAG:
+        // a cut off tag would name a release that does not exist
+        snprintf(current.tag, sizeof(current.tag), "%s", truncated ? "" : text);
+        break;
+    case CAPTURE_PUBLISHED:
+        current.publishedAt = truncated ? -1 : parseTimestamp(text);
+        break;
+    case CAPTURE_ASSET_NAME:
+        if (!truncated && !strcmp(text, asset))
+            hasAsset = true;
+        break;
+    case CAPTURE_NONE:
+        break;
+    }
+    if (keyNext)
+    {
+        keyNext = false;
+        state = STATE_COLON;
+    }
+    else
+        state = depth ? STATE_AFTER : STATE_DONE;
+}
+
+void ReleaseFeed::endBare()
+{
+    bare[bareLen < sizeof(bare) ? bareLen : sizeof(bare) - 1] = '\0';
+    bool literal = bare[0] >= 'a' && bare[0] <= 'z';
+    if (literal && strcmp(bare, "true") && strcmp(bare, "false") && strcmp(bare, "null"))
+    {
+        fail("bad literal");
+        return;
+    }
+    bool inObject = objects >> (depth - 1) & 1;
+    if (inObject && depth == releaseDepth)
+    {
+        if (!strcmp(releaseKey, "prerelease"))
+            current.prerelease = !strcmp(bare, "true");
+        else if (!strcmp(releaseKey, "draft"))
+            draft = !strcmp(bare, "true");
+    }
+    state = STATE_AFTER;
+}
+
+// Keep the release if it is the newest that matches so far
+void ReleaseFeed::endRelease()
+{
+    releases++;
+    if (draft || !current.tag[0] || current.publishedAt < 0 || (asset[0] && !hasAsset) || (prereleases && !current.prerelease))
+        return;
+    if (!found || current.publishedAt > best.publishedAt)
+    {
+        best = current;
+        found = true;
+    }
+}
+
+// days since 1970-01-01 of a proleptic Gregorian date
+static int64_t daysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return (int64_t)era * 146097 + dayOfEra - 719468;
+}
+
+int64_t parseTimestamp(const char *text)
+{
+    int year, month, day, hour, minute, second, end = 0;
+    if (sscanf(text, "%4d-%2d-%2dT%2d:%2d:%2d%n", &year, &month, &day, &hour, &minute, &second, &end) != 6 || end != 19)
+        return -1;
+    static const uint8_t monthDays[12] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (month < 1 || month > 12 || day < 1 || day > monthDays[month - 1] || hour > 23 || minute > 59 || second > 60)
+        return -1;
+    const char *rest = &text[end];
+    // fractional seconds, not needed to order releases
+    if (*rest == '.')
+    {
+        do
+            rest++;
+        while (*rest >= '0' && *rest <= '9');
+    }
+    if (strcmp(rest, "Z"))
+        return -1;
+    return daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+}
@@ -0,0 +1,107 @@
+#ifndef RELEASEFEED_H
+#define RELEASEFEED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "httpssession.h"
+
+#define RELEASE_TAG_MAX 48
+#define RELEASE_ASSET_MAX 32
+#define RELEASE_KEY_MAX 16   // longer keys are none of the ones looked at
+#define RELEASE_DEPTH_MAX 32 // nesting of the GitHub release JSON is about 5
+
+struct ReleaseInfo
+{
+    char tag[RELEASE_TAG_MAX];
+    int64_t publishedAt; // seconds since 1970, UTC
+    bool prerelease;
+};
+
+// Streaming scanner for the GitHub release list (or a single release, as from /releases/latest).
+// Bytes are pushed in as they arrive, from any chunking, and only the newest matching release
+// so far is kept, so memory is the object itself whatever the length of the feed. Drafts and
+// releases without the wanted asset are skipped, in development mode only prereleases count.
+class ReleaseFeed : public HttpsBodySink {
+    public:
+        ReleaseFeed();
+        void reset(bool prereleases, const char *asset);
+        bool write(const uint8_t *data, size_t len) override;
+        // the whole document was read
+        bool finished() const { return state == STATE_DONE; }
+        // NULL unless write failed on bad data
+        const char *getError() const { return error; }
+        // false if no release matched
+        bool getRelease(ReleaseInfo *release) const;
+        uint32_t getReleases() const { return releases; }
+
+    private:
+        enum State
+        {
+            STATE_VALUE,  // expecting a value (or a key in an object)
+            STATE_AFTER,  // after a value, expecting ',' or the end of the container
+            STATE_COLON,  // after a key
+            STATE_STRING,
+            STATE_ESCAPE,
+            STATE_UNICODE,
+            STATE_BARE,   // number, true, false or null
+            STATE_DONE,
+            STATE_ERROR
+        };
+
+        // what the string being read is
+        enum Capture
+        {
+            CAPTURE_NONE,
+            CAPTURE_RELEASE_KEY,
+            CAPTURE_ASSET_KEY,
+            CAPTURE_TAG,
+            CAPTURE_PUBLISHED,
+            CAPTURE_ASSET_NAME
+        };
+
+        bool prereleases;
+        char asset[RELEASE_ASSET_MAX];
+        State state;
+        const char *error;
+        uint32_t releases;
+
+        uint8_t depth;
+        uint32_t objects; // bit per depth, set for objects, clear for arrays
+        bool keyNext;     // a string now would be an object key
+        bool opened;      // nothing read yet in the innermost container
+        uint8_t releaseDepth;
+
+        Capture capture;
+        char text[RELEASE_TAG_MAX]; // captured string
+        uint8_t textLen;
+        bool truncated;
+        uint8_t unicodeDigits;
+        char bare[6];
+        uint8_t bareLen;
+
+        char releaseKey[RELEASE_KEY_MAX];
+        char assetKey[RELEASE_KEY_MAX];
+        bool inAssets;
+        // the release being read, and the newest matching one
+        ReleaseInfo current;
+        bool draft;
+        bool hasAsset;
+        ReleaseInfo best;
+        bool found;
+
+        bool step(char c);
+        bool open(char c);
+        bool close(char c);
+        void startString();
+        void copyKey(char key[RELEASE_KEY_MAX]);
+        void endString();
+        void endBare();
+        void endRelease();
+        bool fail(const char *error);
+};
+
+// Parse an ISO 8601 UTC time as GitHub sends it ("2024-05-01T12:00:00Z"), -1 if it is not one
+int64_t parseTimestamp(const char *text);
+
+#endif
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rollout.h"
+
+// FNV-1a, then mixed so ids that differ in one digit land far apart
+static uint32_t hashString(uint32_t hash, const char *text)
+{
+    for (; *text; text++)
+        hash = (hash ^ (uint8_t)*text) * 16777619u;
+    return hash;
+}
+
+static uint32_t mix(uint32_t hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+bool parseUpdateSource(const char *url, UpdateSource *source)
+{
+    *source = {};
+    if (!*url)
+    {
+        source->github = true;
+        source->tls = true;
+        snprintf(source->host, sizeof(source->host), "%s", UPDATE_GITHUB_HOST);
+        source->port = 443;
+        return true;
+    }
+    if (!strncmp(url, "https://", 8))
+        source->tls = true;
+    else if (strncmp(url, "http://", 7))
+        return false;
+    url += source->tls ? 8 : 7;
+    size_t hostLen = strcspn(url, ":/");
+    if (!hostLen || hostLen >= sizeof(source->host))
+        return false;
+    memcpy(source->host, url, hostLen);
+    url += hostLen;
+    source->port = source->tls ? 443 : 80;
+    if (*url == ':')
+    {
+        char *end;
+        unsigned long port = strtoul(url + 1, &end, 10);
+        if (end == url + 1 || !port || port > 65535 || (*end && *end != '/'))
+            return false;
+        source->port = port;
+        url = end;
+    }
+    size_t pathLen = strlen(url);
+    while (pathLen && url[pathLen - 1] == '/')
+        pathLen--;
+    // room for /releases/download/<tag>/<asset> is checked when the path is made
+    if (pathLen >= sizeof(source->path) || memchr(url, ' ', pathLen) || memchr(url, '?', pathLen))
+        return false;
+    memcpy(source->path, url, pathLen);
+    return true;
+}
+
+bool updateFeedPath(const UpdateSource &source, const char *repo, bool all, char *path, size_t size)
+{
+    size_t len = source.github ? snprintf(path, size, "/repos/%s/releases%s", repo, all ? "" : "/latest")
+                               : snprintf(path, size, "%s/releases%s", source.path, all ? "" : "/latest");
+    return len < size;
+}
+
+bool updateAssetUrl(const UpdateSource &source, const char *repo, const char *tag, const char *asset, char *url, size_t size)
+{
+    size_t len;
+    if (source.github)
+        len = snprintf(url, size, "https://github.com/%s/releases/download/%s/%s", repo, tag, asset);
+    else if (source.port == (source.tls ? 443 : 80))
+        len = snprintf(url, size, "%s://%s%s/releases/download/%s/%s", source.tls ? "https" : "http", source.host, source.path, tag, asset);
+    else
+        len = snprintf(url, size, "%s://%s:%u%s/releases/download/%s/%s", source.tls ? "https" : "http", source.host, source.port,
+                       source.path, tag, asset);
+    return len < size;
+}
+
+uint8_t rolloutCohort(const char *id)
+{
+    return mix(hashString(2166136261u, id)) % ROLLOUT_COHORTS;
+}
+
+Rollout::Rollout() :
+    seed(0),
+    cohort(0),
+    windowS(0),
+    startWindowS(0)
+{
+}
+
+void Rollout::begin(const char *id, uint32_t windowS, uint32_t startWindowS)
+{
+    seed = hashString(2166136261u, id);
+    cohort = rolloutCohort(id);
+    this->windowS = windowS;
+    this->startWindowS = startWindowS;
+}
+
+int64_t Rollout::startTime(const char *tag, int64_t publishedAt) const
+{
+    if (publishedAt < 0)
+        return -1;
+    uint32_t start = startWindowS ? mix(hashString(seed, tag)) % startWindowS : 0;
+    return publishedAt + (int64_t)windowS * cohort / ROLLOUT_COHORTS + start;
+}
+
+uint32_t Rollout::wait(const char *tag, int64_t publishedAt, int64_t now) const
+{
+    int64_t start = startTime(tag, publishedAt);
+    if (start < 0 || now < ROLLOUT_CLOCK_MIN || now >= start)
+        return 0;
+    // a release dated in the future is as good as a wrong clock
+    int64_t wait = start - now;
+    return wait > (int64_t)windowS + startWindowS ? 0 : wait;
+}
@@ -0,0 +1,59 @@
+#ifndef ROLLOUT_H
+#define ROLLOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "httpssession.h"
+#include "updatecheck.h"
+
+#define UPDATE_GITHUB_HOST "api.github.com"
+#define UPDATE_URL_MAX 192
+#define ROLLOUT_COHORTS 100
+#define ROLLOUT_CLOCK_MIN 1704067200 // 2024-01-01, a clock before that was never set
+
+// Where releases come from: GitHub, or a mirror laid out like it under a base URL, i.e.
+// <url>/releases/latest and <url>/releases as the GitHub API answers them and the assets at
+// <url>/releases/download/<tag>/<asset>. A static copy on any web server on the LAN will do.
+struct UpdateSource
+{
+    bool github;
+    bool tls;
+    char host[HTTPS_HOST_MAX];
+    uint16_t port;
+    char path[UPDATE_PATH_MAX]; // of the mirror, without the trailing slash
+};
+
+// "" for GitHub or "http[s]://host[:port][/path]", false for anything else
+bool parseUpdateSource(const char *url, UpdateSource *source);
+// Request path of the release feed: all releases, or only the latest
+bool updateFeedPath(const UpdateSource &source, const char *repo, bool all, char *path, size_t size);
+// Download URL of a release asset, GitHub ones redirect to its storage
+bool updateAssetUrl(const UpdateSource &source, const char *repo, const char *tag, const char *asset, char *url, size_t size);
+
+// Staged rollout over a fleet without any coordination: cohort c of ROLLOUT_COHORTS, fixed
+// per panel by an id unique to it (its MAC), may take a release windowS * c / ROLLOUT_COHORTS
+// after it was published (cohort 0 first, always the same panels), then at a point within
+// startWindowS drawn from the id and the tag. Panels of a cohort do not start together, and
+// a panel keeps its start time across checks and reboots.
+class Rollout {
+    public:
+        Rollout();
+        void begin(const char *id, uint32_t windowS, uint32_t startWindowS);
+        uint8_t getCohort() const { return cohort; }
+        uint32_t getWindow() const { return windowS; }
+        // seconds since 1970 when this panel starts on the release, -1 if publishedAt is
+        int64_t startTime(const char *tag, int64_t publishedAt) const;
+        // seconds until then, 0 for now (also without a clock or a publish time to go by)
+        uint32_t wait(const char *tag, int64_t publishedAt, int64_t now) const;
+
+    private:
+        uint32_t seed; // hash of the id
+        uint8_t cohort;
+        uint32_t windowS;
+        uint32_t startWindowS;
+};
+
+uint8_t rolloutCohort(const char *id);
+
+#endif
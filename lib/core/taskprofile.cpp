@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "taskprofile.h"
+
+#define CPU_NOT_RUNNING 0xFFFF
+
+TaskProfiler::TaskProfiler() :
+    tasks(),
+    history(),
+    snapshots(0),
+    lastTotal(0),
+    untracked(0)
+{
+}
+
+// Slot of the task, taking a free one for a task not seen before, -1 if all are in use
+int TaskProfiler::slotFor(const TaskSample &sample)
+{
+    int free = -1;
+    for (int i = 0; i < PROFILE_TASKS_MAX; i++)
+    {
+        if (tasks[i].lastSeen && tasks[i].id == sample.id)
+            return i;
+        // gone long enough that no snapshot in the ring shows it
+        if (free < 0 && (!tasks[i].lastSeen || (!tasks[i].alive && snapshots - tasks[i].lastSeen >= PROFILE_HISTORY)))
+            free = i;
+    }
+    if (free >= 0)
+    {
+        ProfiledTask &task = tasks[free];
+        snprintf(task.name, sizeof(task.name), "%s", sample.name);
+        task.id = sample.id;
+        task.runtime = 0; // everything it ran so far falls into this interval
+    }
+    return free;
+}
+
+// Take a snapshot: the share of the run time since the previous sample each task used, and
+// its stack high water mark. Counters are unsigned, a wrap between two samples is fine.
+void TaskProfiler::sample(int64_t nowUs, const TaskSample *samples, int count, uint32_t totalRuntime)
+{
+    snapshots++;
+    ProfileSnapshot &snapshot = history[(snapshots - 1) % PROFILE_HISTORY];
+    snapshot.timeUs = nowUs;
+    snapshot.elapsed = totalRuntime - lastTotal;
+    lastTotal = totalRuntime;
+    for (int i = 0; i < PROFILE_TASKS_MAX; i++)
+    {
+        snapshot.cpuPermille[i] = CPU_NOT_RUNNING;
+        tasks[i].alive = false;
+    }
+
+    untracked = 0;
+    for (int s = 0; s < count; s++)
+    {
+        int slot = slotFor(samples[s]);
+        if (slot < 0)
+        {
+            untracked++;
+            continue;
+        }
+        ProfiledTask &task = tasks[slot];
+        uint32_t ran = samples[s].runtime - task.runtime;
+        // the first snapshot has nothing to compare against
+        uint64_t permille = snapshot.elapsed && snapshots > 1 ? (uint64_t)ran * 1000 / snapshot.elapsed : 0;
+        snapshot.cpuPermille[slot] = permille < CPU_NOT_RUNNING ? permille : CPU_NOT_RUNNING - 1;
+        task.runtime = samples[s].runtime;
+        task.stackFree = samples[s].stackFree;
+        task.priority = samples[s].priority;
+        task.lastSeen = snapshots;
+        task.alive = true;
+    }
+}
+
+const ProfileSnapshot &TaskProfiler::get(int age) const
+{
+    return history[(snapshots - 1 - age) % PROFILE_HISTORY];
+}
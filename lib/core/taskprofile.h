@@ -0,0 +1,61 @@
+#ifndef TASKPROFILE_H
+#define TASKPROFILE_H
+
+#include <stdint.h>
+
+#define PROFILE_TASKS_MAX 24
+#define PROFILE_HISTORY 24 // snapshots kept
+#define PROFILE_NAME_LEN 16 // CONFIG_FREERTOS_MAX_TASK_NAME_LEN
+
+// One task as the scheduler reports it (uxTaskGetSystemState on the device)
+struct TaskSample
+{
+    const char *name;
+    uint32_t id;        // task number, unique for the lifetime of the task
+    uint32_t runtime;   // run time counter, may wrap
+    uint32_t stackFree; // high water mark: the least free stack the task has had, bytes
+    uint8_t priority;
+};
+
+// A task seen by the profiler, snapshots refer to it by slot
+struct ProfiledTask
+{
+    char name[PROFILE_NAME_LEN];
+    uint32_t id;
+    uint32_t runtime;   // counter at the last sample
+    uint32_t stackFree;
+    uint8_t priority;
+    uint32_t lastSeen;  // sample number, a slot is only reused once no snapshot refers to it
+    bool alive;
+};
+
+struct ProfileSnapshot
+{
+    int64_t timeUs;
+    uint32_t elapsed;                        // run time counter ticks since the previous snapshot
+    uint16_t cpuPermille[PROFILE_TASKS_MAX]; // of one core, per slot, 0xFFFF if not running then
+};
+
+// Turns periodic scheduler samples into per task CPU load and stack high water marks, kept
+// in a ring of the last PROFILE_HISTORY snapshots. All storage is inside the object, taking
+// a sample never allocates. Tasks beyond PROFILE_TASKS_MAX are counted but not tracked.
+class TaskProfiler {
+    public:
+        TaskProfiler();
+        void sample(int64_t nowUs, const TaskSample *samples, int count, uint32_t totalRuntime);
+        int size() const { return snapshots < PROFILE_HISTORY ? snapshots : PROFILE_HISTORY; }
+        const ProfileSnapshot &get(int age) const; // 0 is the newest
+        const ProfiledTask &getTask(int slot) const { return tasks[slot]; }
+        uint32_t getUntracked() const { return untracked; }
+
+    private:
+        ProfiledTask tasks[PROFILE_TASKS_MAX];
+        ProfileSnapshot history[PROFILE_HISTORY];
+        uint32_t snapshots;
+        uint32_t lastTotal;
+        uint32_t untracked;
+
+        int slotFor(const TaskSample &sample);
+};
+
+#endif
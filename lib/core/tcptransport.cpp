@@ -0,0 +1,95 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <esp_log.h>
+
+#include "tcptransport.h"
+
+// lwIP has no SIGPIPE to suppress
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+TcpTransport::TcpTransport() :
+    fd(-1)
+{
+}
+
+TcpTransport::~TcpTransport()
+{
+    close();
+}
+
+bool TcpTransport::connect(const char *host, uint16_t port, uint32_t timeoutMs)
+{
+    close();
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    struct addrinfo *address = NULL;
+    if (getaddrinfo(host, service, &hints, &address) || !address)
+    {
+        ESP_LOGE(__func__, "Cannot resolve %s", host);
+        return false;
+    }
+    fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+    if (fd < 0)
+    {
+        freeaddrinfo(address);
+        return false;
+    }
+
+    // connect without blocking for longer than timeoutMs
+    struct timeval timeout = {(time_t)(timeoutMs / 1000), (suseconds_t)(timeoutMs % 1000 * 1000)};
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int res = ::connect(fd, address->ai_addr, address->ai_addrlen);
+    freeaddrinfo(address);
+    if (res && errno == EINPROGRESS)
+    {
+        fd_set writable;
+        FD_ZERO(&writable);
+        FD_SET(fd, &writable);
+        int error = 0;
+        socklen_t len = sizeof(error);
+        res = select(fd + 1, NULL, &writable, NULL, &timeout) == 1 && !getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) && !error ? 0 : -1;
+    }
+    fcntl(fd, F_SETFL, flags);
+    if (res)
+    {
+        ESP_LOGE(__func__, "Connecting to %s:%u failed", host, port);
+        close();
+        return false;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return true;
+}
+
+int TcpTransport::write(const uint8_t *data, size_t len)
+{
+    return fd < 0 ? -1 : send(fd, data, len, MSG_NOSIGNAL);
+}
+
+int TcpTransport::read(uint8_t *data, size_t len)
+{
+    return fd < 0 ? -1 : recv(fd, data, len, 0);
+}
+
+void TcpTransport::close()
+{
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
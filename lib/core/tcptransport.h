@@ -0,0 +1,22 @@
+#ifndef TCPTRANSPORT_H
+#define TCPTRANSPORT_H
+
+#include "httpssession.h"
+
+// Plain TCP for HttpsSession, for http:// servers on the LAN: an update mirror or another
+// panel. Sockets are the same on lwIP and the host.
+class TcpTransport : public TlsTransport {
+    public:
+        TcpTransport();
+        ~TcpTransport();
+        bool connect(const char *host, uint16_t port, uint32_t timeoutMs) override;
+        int write(const uint8_t *data, size_t len) override;
+        int read(uint8_t *data, size_t len) override;
+        void close() override;
+        bool resumed() override { return false; }
+
+    private:
+        int fd;
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include <string.h>
+
+#include "glcdfont.h"
+#include "grapheme.h"
+#include "text.h"
+
+#define GLYPH_COUNT (sizeof(glcdfont) / sizeof(glcdfont[0]))
+#define GLYPH_SPACE 0
+#define GLYPH_UNKNOWN ('?' - 0x20)
+
+// glcdfont rasterized at build time: glyphs trimmed to their inked columns, scaled, and
+// stored as one mask per pixel row (bit 0 is the leftmost pixel) so a row is a single blit
+template <int Scale>
+struct GlyphAtlas
+{
+    static_assert(5 * Scale <= 16, "glyph rows are 16 bit masks");
+    uint16_t rows[GLYPH_COUNT][8 * Scale];
+    uint8_t widths[GLYPH_COUNT];
+
+    constexpr GlyphAtlas() :
+        rows(),
+        widths()
+    {
+        for (size_t glyph = 0; glyph < GLYPH_COUNT; glyph++)
+        {
+            int first = 5;
+            int last = -1;
+            for (int col = 0; col < 5; col++)
+            {
+                if (glcdfont[glyph][col])
+                {
+                    if (first > col)
+                        first = col;
+                    last = col;
+                }
+            }
+            // the space has no ink, keep it two columns wide
+            if (last < 0)
+            {
+                first = 0;
+                last = 1;
+            }
+            widths[glyph] = (last - first + 1) * Scale;
+            for (int line = 0; line < 8; line++)
+            {
+                uint16_t mask = 0;
+                for (int col = first; col <= last; col++)
+                {
+                    if (glcdfont[glyph][col] >> line & 1)
+                        mask |= ((1 << Scale) - 1) << (col - first) * Scale;
+                }
+                for (int s = 0; s < Scale; s++)
+                    rows[glyph][line * Scale + s] = mask;
+            }
+        }
+    }
+};
+
+struct Font
+{
+    const uint16_t *rows;
+    const uint8_t *widths;
+};
+
+static constexpr GlyphAtlas<1> atlas1;
+static constexpr GlyphAtlas<2> atlas2;
+static constexpr GlyphAtlas<3> atlas3;
+static constexpr Font fonts[] = {
+    {&atlas1.rows[0][0], atlas1.widths},
+    {&atlas2.rows[0][0], atlas2.widths},
+    {&atlas3.rows[0][0], atlas3.widths},
+};
+static_assert(sizeof(fonts) / sizeof(fonts[0]) == TEXT_MAX_SCALE - TEXT_MIN_SCALE + 1, "one atlas per scale");
+
+// ASCII stand-ins for U+00C0-U+00FF, accents are dropped
+static constexpr char latinFold[] = "AAAAAAACEEEEIIIIDNOOOOOxOUUUUYTsaaaaaaaceeeeiiiidnooooo/ouuuuyty";
+
+// Glyph for the grapheme cluster at text, -1 if it takes no space (stray marks, controls)
+static int clusterGlyph(const char *text, size_t len, size_t *clusterLen)
+{
+    // printable ASCII followed by ASCII is a cluster of its own
+    uint8_t c = text[0];
+    if (c >= 0x20 && c <= 0x7E && (len == 1 || (uint8_t)text[1] < 0x80))
+    {
+        *clusterLen = 1;
+        return c - 0x20;
+    }
+    uint32_t codepoint;
+    *clusterLen = graphemeNext(text, len);
+    utf8Decode(text, len, &codepoint);
+    if (codepoint >= 0x20 && codepoint <= 0x7E)
+        return codepoint - 0x20;
+    // no-break space, and line breaks when text is set on a single line
+    if (codepoint == 0xA0 || codepoint == '\n' || codepoint == '\r')
+        return GLYPH_SPACE;
+    if (codepoint >= 0xC0 && codepoint <= 0xFF)
+        return latinFold[codepoint - 0xC0] - 0x20;
+    GraphemeClass type = graphemeClass(codepoint);
+    if (type == GRAPHEME_EXTEND || type == GRAPHEME_ZWJ || type == GRAPHEME_CONTROL)
+        return -1;
+    return GLYPH_UNKNOWN;
+}
+
+static inline bool isNewline(char c)
+{
+    return c == '\n' || c == '\r';
+}
+
+// line width after appending a glyph, one column of spacing between glyphs
+static inline int16_t advance(int16_t width, int16_t glyphWidth, uint8_t scale)
+{
+    return (width ? width + scale : 0) + glyphWidth;
+}
+
+bool layoutText(const char *text, uint8_t scale, int16_t width, int16_t height, TextLayout *layout)
+{
+    if (scale < TEXT_MIN_SCALE)
+        scale = TEXT_MIN_SCALE;
+    if (scale > TEXT_MAX_SCALE)
+        scale = TEXT_MAX_SCALE;
+    const uint8_t *widths = fonts[scale - TEXT_MIN_SCALE].widths;
+    int maxLines = height / (8 * scale);
+    if (maxLines > TEXT_MAX_LINES)
+        maxLines = TEXT_MAX_LINES;
+    layout->scale = scale;
+    layout->lineCount = 0;
+    layout->clipped = false;
+
+    // trailing white space never needs a line, lines hold 16 bit offsets
+    size_t len = strlen(text);
+    if (len > UINT16_MAX)
+        len = UINT16_MAX;
+    while (len && (text[len - 1] == ' ' || isNewline(text[len - 1])))
+        len--;
+
+    bool broken = false;
+    size_t pos = 0;
+    while (pos < len)
+    {
+        if (layout->lineCount == maxLines)
+        {
+            layout->clipped = true;
+            break;
+        }
+
+        // wrapped lines start at the next word
+        size_t n;
+        while (pos < len && !isNewline(text[pos]) && clusterGlyph(text + pos, len - pos, &n) <= GLYPH_SPACE)
+            pos += n;
+        TextLine line = {(uint16_t)pos, (uint16_t)pos, 0};
+
+        // add words while they fit
+        while (pos < len && !isNewline(text[pos]))
+        {
+            size_t i = pos;
+            int16_t lineWidth = line.width;
+            int glyph;
+            while (i < len && !isNewline(text[i]) && (glyph = clusterGlyph(text + i, len - i, &n)) <= GLYPH_SPACE)
+            {
+                if (glyph == GLYPH_SPACE)
+                    lineWidth = advance(lineWidth, widths[glyph], scale);
+                i += n;
+            }
+            size_t wordStart = i;
+            bool overflow = false;
+            while (i < len && !isNewline(text[i]) && (glyph = clusterGlyph(text + i, len - i, &n)) != GLYPH_SPACE)
+            {
+                int16_t next = glyph < 0 ? lineWidth : advance(lineWidth, widths[glyph], scale);
+                if (next > width)
+                {
+                    overflow = true;
+                    break;
+                }
+                lineWidth = next;
+                i += n;
+            }
+            // only spaces left before a line break
+            if (!overflow && i == wordStart)
+            {
+                pos = i;
+                break;
+            }
+            if (!overflow)
+            {
+                line.end = i;
+                line.width = lineWidth;
+                pos = i;
+                continue;
+            }
+            // wrap before the word, or break a word longer than the line where it overflows
+            if (line.end == line.start)
+            {
+                broken = true;
+                if (i == wordStart)
+                {
+                    i += n;
+                    lineWidth = width;
+                }
+                line.end = i;
+                line.width = lineWidth;
+                pos = i;
+            }
+            else
+                pos = wordStart;
+            break;
+        }
+        layout->lines[layout->lineCount++] = line;
+
+        // an explicit line break ("\r\n" is a single cluster)
+        if (pos < len && isNewline(text[pos]))
+            pos += graphemeNext(text + pos, len - pos);
+    }
+    return !layout->clipped && !broken;
+}
+
+bool fitText(const char *text, int16_t width, int16_t height, TextLayout *layout)
+{
+    for (uint8_t scale = TEXT_MAX_SCALE; scale > TEXT_MIN_SCALE; scale--)
+    {
+        if (layoutText(text, scale, width, height, layout))
+            return true;
+    }
+    return layoutText(text, TEXT_MIN_SCALE, width, height, layout);
+}
+
+void drawTextLayout(Framebuffer &frame, const char *text, const TextLayout &layout,
+                    int16_t x, int16_t y, int16_t width, int16_t height, uint8_t r, uint8_t g, uint8_t b)
+{
+    int16_t lineHeight = 8 * layout.scale;
+    int16_t top = y + (height - layout.lineCount * lineHeight) / 2;
+    for (int l = 0; l < layout.lineCount; l++, top += lineHeight)
+    {
+        const TextLine &line = layout.lines[l];
+        drawTextLine(frame, text + line.start, line.end - line.start, layout.scale,
+                     x + (width - line.width) / 2, top, r, g, b);
+    }
+}
+
+int16_t textWidth(const char *text, size_t len, uint8_t scale)
+{
+    const uint8_t *widths = fonts[scale - TEXT_MIN_SCALE].widths;
+    int16_t width = 0;
+    size_t n;
+    for (size_t i = 0; i < len; i += n)
+    {
+        int glyph = clusterGlyph(text + i, len - i, &n);
+        if (glyph >= 0)
+            width = advance(width, widths[glyph], scale);
+    }
+    return width;
+}
+
+int16_t drawTextLine(Framebuffer &frame, const char *text, size_t len, uint8_t scale,
+                     int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b)
+{
+    const Font &font = fonts[scale - TEXT_MIN_SCALE];
+    int16_t lineHeight = 8 * scale;
+    int16_t left = x;
+    size_t n;
+    for (size_t i = 0; i < len; i += n)
+    {
+        int glyph = clusterGlyph(text + i, len - i, &n);
+        if (glyph < 0)
+            continue;
+        if (glyph != GLYPH_SPACE)
+            frame.drawBitmap(left, y, font.widths[glyph], lineHeight, &font.rows[glyph * lineHeight], r, g, b);
+        left += font.widths[glyph] + scale;
+    }
+    return left > x ? left - scale : x;
+}
@@ -0,0 +1,49 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "framebuffer.h"
+
+#define TEXT_MAX_LINES 8
+#define TEXT_MIN_SCALE 1
+#define TEXT_MAX_SCALE 3
+
+// Byte range of text shown on one line and its width in pixels
+struct TextLine
+{
+    uint16_t start;
+    uint16_t end;
+    int16_t width;
+};
+
+// Word wrapped text, produced by layoutText and drawn by drawTextLayout
+struct TextLayout
+{
+    uint8_t scale;
+    uint8_t lineCount;
+    bool clipped; // text left over that did not fit the box
+    TextLine lines[TEXT_MAX_LINES];
+};
+
+// Wrap UTF-8 text into a width x height box at a fixed scale of the 5x7 font,
+// true if all of it fits without breaking words
+bool layoutText(const char *text, uint8_t scale, int16_t width, int16_t height, TextLayout *layout);
+
+// Wrap with the largest scale that fits, falling back to clipped text at the smallest.
+// false if even that does not fit
+bool fitText(const char *text, int16_t width, int16_t height, TextLayout *layout);
+
+// Draw a layout centered in the box it was made for, one glyph row blit per row
+void drawTextLayout(Framebuffer &frame, const char *text, const TextLayout &layout,
+                    int16_t x, int16_t y, int16_t width, int16_t height, uint8_t r, uint8_t g, uint8_t b);
+
+// Width of len bytes of text set on a single line
+int16_t textWidth(const char *text, size_t len, uint8_t scale);
+
+// Draw len bytes of text on a single line from x, returns the x after its last glyph
+int16_t drawTextLine(Framebuffer &frame, const char *text, size_t len, uint8_t scale,
+                     int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b);
+
+#endif
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <string.h>
+#include <esp_log.h>
+
+#include "updatecheck.h"
+
+// HttpsSession stops reading when the sink says so, only the headers are needed
+struct HeadersOnly : HttpsBodySink
+{
+    bool write(const uint8_t *, size_t) override { return false; }
+};
+
+UpdateChecker::UpdateChecker(HttpsSession &session, uint32_t intervalMs, uint32_t maxBackoffMs) :
+    session(session),
+    intervalMs(intervalMs),
+    maxBackoffMs(maxBackoffMs),
+    random(1),
+    cache(),
+    pending(),
+    cacheChanged(false),
+    stats()
+{
+}
+
+// xorshift32, the jitter only has to differ between panels
+uint32_t UpdateChecker::nextRandom()
+{
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    return random;
+}
+
+UpdateCheckResult UpdateChecker::check(const char *path, HttpsBodySink *sink)
+{
+    stats.checks++;
+    // validators only apply to the feed they came with, e.g. not after a switch to development
+    bool conditional = !strcmp(cache.path, path);
+    session.setValidators(conditional ? &cache.validators : NULL);
+    HeadersOnly headersOnly;
+    size_t length = 0;
+    int res = session.get(path, sink ? *sink : headersOnly, &length);
+    session.setValidators(NULL);
+    stats.lastStatus = session.getStatus();
+
+    if (stats.lastStatus == 304)
+    {
+        ESP_LOGI(__func__, "%s not modified", path);
+        return UPDATE_UNCHANGED;
+    }
+    // without a sink the transfer is stopped after the headers of a 2xx
+    if (stats.lastStatus == 200 && (res == 200 || (!sink && res == HTTPS_ERR_ABORTED)))
+    {
+        pending = {};
+        snprintf(pending.path, sizeof(pending.path), "%s", path);
+        pending.validators = session.getResponseValidators();
+        ESP_LOGI(__func__, "%s changed (ETag %s, Last-Modified %s)", path, pending.validators.etag, pending.validators.lastModified);
+        return UPDATE_CHANGED;
+    }
+    ESP_LOGW(__func__, "%s failed: %d", path, res);
+    return UPDATE_FAILED;
+}
+
+uint32_t UpdateChecker::done(UpdateCheckResult result)
+{
+    if (result == UPDATE_FAILED)
+    {
+        stats.failures++;
+        stats.consecutiveFailures++;
+        // interval * 2^failures, then a random point in its upper half
+        uint32_t backoff = maxBackoffMs;
+        if (stats.consecutiveFailures < 32 && intervalMs <= maxBackoffMs >> stats.consecutiveFailures)
+            backoff = intervalMs << stats.consecutiveFailures;
+        stats.lastDelayMs = backoff / 2 + nextRandom() % (backoff / 2 + 1);
+        // the server knows best when it will answer again, e.g. a rate limit reset
+        uint32_t retryAfterMs = session.getRetryAfter() < maxBackoffMs / 1000 ? session.getRetryAfter() * 1000 : maxBackoffMs;
+        if (retryAfterMs > stats.lastDelayMs)
+            stats.lastDelayMs = retryAfterMs;
+        return stats.lastDelayMs;
+    }
+
+    if (result == UPDATE_CHANGED)
+    {
+        stats.changed++;
+        if (memcmp(&cache, &pending, sizeof(cache)))
+            cacheChanged = true;
+        cache = pending;
+    }
+    else
+        stats.unchanged++;
+    stats.consecutiveFailures = 0;
+    stats.lastDelayMs = intervalMs;
+    return stats.lastDelayMs;
+}
+
+bool UpdateChecker::takeCacheChanged()
+{
+    bool changed = cacheChanged;
+    cacheChanged = false;
+    return changed;
+}
@@ -0,0 +1,66 @@
+#ifndef UPDATECHECK_H
+#define UPDATECHECK_H
+
+#include <stdint.h>
+
+#include "httpssession.h"
+
+#define UPDATE_PATH_MAX 96
+
+enum UpdateCheckResult
+{
+    UPDATE_UNCHANGED, // 304, nothing to do
+    UPDATE_CHANGED,   // the feed is new, act on it and report back with done()
+    UPDATE_FAILED
+};
+
+// Validators of the release feed the panel last acted on, persisted across reboots
+struct UpdateCache
+{
+    char path[UPDATE_PATH_MAX];
+    HttpsValidators validators;
+};
+
+struct UpdateCheckStats
+{
+    uint32_t checks;
+    uint32_t unchanged;
+    uint32_t changed;
+    uint32_t failures;
+    uint32_t consecutiveFailures;
+    int lastStatus;
+    uint32_t lastDelayMs;
+};
+
+// Polls a release feed with conditional requests over a kept HttpsSession. An unchanged feed
+// is a bodiless 304 on a resumed connection, only a changed one is handed to the caller.
+// Failures back off exponentially up to maxBackoffMs, with jitter so a fleet that failed
+// together does not retry together.
+class UpdateChecker {
+    public:
+        UpdateChecker(HttpsSession &session, uint32_t intervalMs, uint32_t maxBackoffMs);
+        void seed(uint32_t seed) { random = seed ? seed : 1; }
+        void setCache(const UpdateCache &cache) { this->cache = cache; }
+        const UpdateCache &getCache() const { return cache; }
+        // Request path, sink gets the body of a changed feed (NULL: only the headers are read)
+        UpdateCheckResult check(const char *path, HttpsBodySink *sink = NULL);
+        // Outcome of acting on the check, returns the milliseconds until the next one
+        uint32_t done(UpdateCheckResult result);
+        // whether done() changed the cache since the last call, so it needs saving
+        bool takeCacheChanged();
+        UpdateCheckStats getStats() const { return stats; }
+
+    private:
+        HttpsSession &session;
+        uint32_t intervalMs;
+        uint32_t maxBackoffMs;
+        uint32_t random;
+        UpdateCache cache;
+        UpdateCache pending; // validators of the changed feed until it was acted on
+        bool cacheChanged;
+        UpdateCheckStats stats;
+
+        uint32_t nextRandom();
+};
+
+#endif
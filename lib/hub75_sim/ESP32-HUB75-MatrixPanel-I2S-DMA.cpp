@@ -0,0 +1,313 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ESP32-HUB75-MatrixPanel-I2S-DMA.h"
+#include "glcdfont.h"
+
+MatrixPanel_I2S_DMA::MatrixPanel_I2S_DMA(const HUB75_I2S_CFG &config) :
+    config(config),
+    panelWidth(config.mx_width * config.chain_length),
+    panelHeight(config.mx_height),
+    buffers{NULL, NULL},
+    front(0),
+    brightness(128),
+    pixelWrites(0),
+    flips(0),
+    cursorX(0),
+    cursorY(0),
+    textColor(0xFFFF),
+    textSize(1),
+    textWrap(true)
+{
+}
+
+MatrixPanel_I2S_DMA::~MatrixPanel_I2S_DMA()
+{
+    if (buffers[1] != buffers[0])
+        free(buffers[1]);
+    free(buffers[0]);
+}
+
+bool MatrixPanel_I2S_DMA::begin()
+{
+    buffers[0] = (uint8_t *)calloc(panelWidth * panelHeight, 3);
+    buffers[1] = config.double_buff ? (uint8_t *)calloc(panelWidth * panelHeight, 3) : buffers[0];
+    return buffers[0] != NULL && buffers[1] != NULL;
+}
+
+void MatrixPanel_I2S_DMA::setBrightness8(uint8_t brightness)
+{
+    this->brightness = brightness;
+}
+
+void MatrixPanel_I2S_DMA::setLatBlanking(uint8_t blanking)
+{
+    config.latch_blanking = blanking;
+}
+
+void MatrixPanel_I2S_DMA::drawPixelRGB888(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b)
+{
+    if (x < 0 || y < 0 || x >= panelWidth || y >= panelHeight)
+        return;
+    uint8_t *px = &buffers[front ^ 1][(y * panelWidth + x) * 3];
+    uint8_t mask = 0xFF << (8 - config.getPixelColorDepthBits());
+    px[0] = r & mask;
+    px[1] = g & mask;
+    px[2] = b & mask;
+    pixelWrites++;
+}
+
+void MatrixPanel_I2S_DMA::fillScreenRGB888(uint8_t r, uint8_t g, uint8_t b)
+{
+    for (int16_t y = 0; y < panelHeight; y++)
+    {
+        for (int16_t x = 0; x < panelWidth; x++)
+        {
+            drawPixelRGB888(x, y, r, g, b);
+        }
+    }
+}
+
+// show the back buffer, drawing continues in the other one
+void MatrixPanel_I2S_DMA::flipDMABuffer()
+{
+    if (!config.double_buff)
+        return;
+    front ^= 1;
+    flips++;
+}
+
+uint16_t MatrixPanel_I2S_DMA::color565(uint8_t r, uint8_t g, uint8_t b)
+{
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+void MatrixPanel_I2S_DMA::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+    // expand 565 the same way the driver does
+    uint8_t r = ((color >> 11) & 0x1F) << 3;
+    uint8_t g = ((color >> 5) & 0x3F) << 2;
+    uint8_t b = (color & 0x1F) << 3;
+    drawPixelRGB888(x, y, r, g, b);
+}
+
+void MatrixPanel_I2S_DMA::fillScreen(uint16_t color)
+{
+    fillRect(0, 0, panelWidth, panelHeight, color);
+}
+
+void MatrixPanel_I2S_DMA::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+    for (int16_t j = y; j < y + h; j++)
+    {
+        for (int16_t i = x; i < x + w; i++)
+        {
+            drawPixel(i, j, color);
+        }
+    }
+}
+
+void MatrixPanel_I2S_DMA::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+    fillRect(x, y, w, 1, color);
+}
+
+void MatrixPanel_I2S_DMA::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+    fillRect(x, y, 1, h, color);
+}
+
+void MatrixPanel_I2S_DMA::setCursor(int16_t x, int16_t y)
+{
+    cursorX = x;
+    cursorY = y;
+}
+
+void MatrixPanel_I2S_DMA::setTextColor(uint16_t color)
+{
+    textColor = color;
+}
+
+void MatrixPanel_I2S_DMA::setTextSize(uint8_t size)
+{
+    textSize = size ? size : 1;
+}
+
+void MatrixPanel_I2S_DMA::setTextWrap(bool wrap)
+{
+    textWrap = wrap;
+}
+
+void MatrixPanel_I2S_DMA::setFont(const GFXfont *)
+{
+    // only the built in 5x7 font is simulated
+}
+
+// draw one glyph of the classic font, transparent background like Adafruit GFX
+void MatrixPanel_I2S_DMA::drawChar(int16_t x, int16_t y, unsigned char c)
+{
+    if (c < 0x20 || c > 0x7E)
+        c = '?';
+    const uint8_t *glyph = glcdfont[c - 0x20];
+    for (int col = 0; col < 5; col++)
+    {
+        for (int row = 0; row < 8; row++)
+        {
+            if (glyph[col] & (1 << row))
+                fillRect(x + col * textSize, y + row * textSize, textSize, textSize, textColor);
+        }
+    }
+}
+
+size_t MatrixPanel_I2S_DMA::write(uint8_t c)
+{
+    if (c == '\n')
+    {
+        cursorX = 0;
+        cursorY += textSize * 8;
+    }
+    else if (c != '\r')
+    {
+        if (textWrap && cursorX + textSize * 6 > panelWidth)
+        {
+            cursorX = 0;
+            cursorY += textSize * 8;
+        }
+        drawChar(cursorX, cursorY, c);
+        cursorX += textSize * 6;
+    }
+    return 1;
+}
+
+size_t MatrixPanel_I2S_DMA::print(const char *text)
+{
+    size_t n = 0;
+    while (*text)
+        n += write(*text++);
+    return n;
+}
+
+size_t MatrixPanel_I2S_DMA::printf(const char *format, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    return print(buf);
+}
+
+const uint8_t *MatrixPanel_I2S_DMA::getPixel(int16_t x, int16_t y) const
+{
+    return &buffers[front][(y * panelWidth + x) * 3];
+}
+
+bool MatrixPanel_I2S_DMA::savePPM(const char *path) const
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+    fprintf(file, "P6\n%d %d\n255\n", panelWidth, panelHeight);
+    size_t size = panelWidth * panelHeight * 3;
+    bool ok = fwrite(buffers[front], 1, size, file) == size;
+    fclose(file);
+    return ok;
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *data++;
+        for (int k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static void putBE32(uint8_t *out, uint32_t value)
+{
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+static void writeChunk(FILE *file, const char *type, const uint8_t *data, uint32_t len)
+{
+    uint8_t header[8];
+    putBE32(header, len);
+    memcpy(header + 4, type, 4);
+    fwrite(header, 1, 8, file);
+    fwrite(data, 1, len, file);
+    uint32_t crc = crc32(crc32(0, header + 4, 4), data, len);
+    uint8_t trailer[4];
+    putBE32(trailer, crc);
+    fwrite(trailer, 1, 4, file);
+}
+
+// PNG with uncompressed (stored) deflate blocks, no zlib needed
+bool MatrixPanel_I2S_DMA::savePNG(const char *path) const
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    fwrite(signature, 1, 8, file);
+
+    uint8_t ihdr[13];
+    putBE32(ihdr, panelWidth);
+    putBE32(ihdr + 4, panelHeight);
+    ihdr[8] = 8;  // bit depth
+    ihdr[9] = 2;  // truecolor
+    ihdr[10] = 0; // deflate
+    ihdr[11] = 0; // adaptive filtering
+    ihdr[12] = 0; // no interlace
+    writeChunk(file, "IHDR", ihdr, sizeof(ihdr));
+
+    // raw scanlines, each prefixed with filter type 0
+    size_t stride = panelWidth * 3 + 1;
+    size_t rawSize = stride * panelHeight;
+    uint8_t *raw = (uint8_t *)malloc(rawSize);
+    for (int y = 0; y < panelHeight; y++)
+    {
+        raw[y * stride] = 0;
+        memcpy(&raw[y * stride + 1], &buffers[front][y * panelWidth * 3], panelWidth * 3);
+    }
+
+    size_t blocks = (rawSize + 0xFFFE) / 0xFFFF;
+    size_t idatSize = 2 + rawSize + blocks * 5 + 4;
+    uint8_t *idat = (uint8_t *)malloc(idatSize);
+    uint8_t *out = idat;
+    *out++ = 0x78; // zlib header, no compression
+    *out++ = 0x01;
+    uint32_t a = 1, b = 0;
+    for (size_t offset = 0; offset < rawSize; offset += 0xFFFF)
+    {
+        uint16_t len = rawSize - offset > 0xFFFF ? 0xFFFF : rawSize - offset;
+        *out++ = offset + len == rawSize ? 1 : 0;
+        *out++ = len & 0xFF;
+        *out++ = len >> 8;
+        *out++ = ~len & 0xFF;
+        *out++ = (~len >> 8) & 0xFF;
+        memcpy(out, &raw[offset], len);
+        out += len;
+        for (size_t i = offset; i < offset + len; i++)
+        {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+    }
+    putBE32(out, (b << 16) | a);
+    writeChunk(file, "IDAT", idat, idatSize);
+    writeChunk(file, "IEND", NULL, 0);
+
+    free(raw);
+    free(idat);
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,125 @@
+#ifndef ESP32_HUB75_MATRIXPANEL_I2S_DMA_SIM_H
+#define ESP32_HUB75_MATRIXPANEL_I2S_DMA_SIM_H
+
+/*
+ * Headless stand-in for ESP32-HUB75-MatrixPanel-I2S-DMA used by the native build.
+ * Implements the subset of the driver and Adafruit GFX API the panel code uses,
+ * drawing into an in-memory RGB888 framebuffer that can be dumped as PPM or PNG.
+ * With double_buff set, drawing goes to the hidden buffer until flipDMABuffer().
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef PIXEL_COLOR_DEPTH_BITS
+#define PIXEL_COLOR_DEPTH_BITS 8
+#endif
+
+struct GFXfont;
+
+struct HUB75_I2S_CFG
+{
+    enum clk_speed
+    {
+        HZ_8M = 8000000,
+        HZ_10M = 10000000,
+        HZ_15M = 15000000,
+        HZ_20M = 20000000
+    };
+
+    struct i2s_pins
+    {
+        int8_t r1, g1, b1, r2, g2, b2, a, b, c, d, e, lat, oe, clk;
+    };
+
+    uint16_t mx_width;
+    uint16_t mx_height;
+    uint16_t chain_length;
+    i2s_pins gpio;
+    clk_speed i2sspeed;
+    bool double_buff;
+    uint8_t latch_blanking;
+    bool clkphase;
+    uint16_t min_refresh_rate;
+
+    HUB75_I2S_CFG(uint16_t width = 64, uint16_t height = 32, uint16_t chain = 1, i2s_pins pins = {}) :
+        mx_width(width),
+        mx_height(height),
+        chain_length(chain),
+        gpio(pins),
+        i2sspeed(HZ_10M),
+        double_buff(false),
+        latch_blanking(1),
+        clkphase(true),
+        min_refresh_rate(60),
+        pixel_color_depth_bits(PIXEL_COLOR_DEPTH_BITS)
+    {
+    }
+
+    uint8_t getPixelColorDepthBits() const { return pixel_color_depth_bits; }
+    void setPixelColorDepthBits(uint8_t bits) { pixel_color_depth_bits = bits < 1 ? 1 : (bits > 8 ? 8 : bits); }
+
+    uint8_t pixel_color_depth_bits; // bit planes, set through setPixelColorDepthBits
+};
+
+class MatrixPanel_I2S_DMA {
+    public:
+        MatrixPanel_I2S_DMA(const HUB75_I2S_CFG &config);
+        ~MatrixPanel_I2S_DMA();
+        bool begin();
+
+        // driver API
+        void setBrightness8(uint8_t brightness);
+        void setLatBlanking(uint8_t blanking);
+        void drawPixelRGB888(int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b); // keeps the top color depth bits
+        void fillScreenRGB888(uint8_t r, uint8_t g, uint8_t b);
+        void flipDMABuffer();
+        const HUB75_I2S_CFG &getCfg() const { return config; }
+        static uint16_t color565(uint8_t r, uint8_t g, uint8_t b);
+
+        // Adafruit GFX API
+        int16_t width() const { return panelWidth; }
+        int16_t height() const { return panelHeight; }
+        void drawPixel(int16_t x, int16_t y, uint16_t color);
+        void fillScreen(uint16_t color);
+        void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+        void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+        void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+        void setCursor(int16_t x, int16_t y);
+        void setTextColor(uint16_t color);
+        void setTextSize(uint8_t size);
+        void setTextWrap(bool wrap);
+        void setFont(const GFXfont *font);
+        size_t write(uint8_t c);
+        size_t print(const char *text);
+        size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+        // simulator only
+        const uint8_t *getFramebuffer() const { return buffers[front]; }
+        const uint8_t *getPixel(int16_t x, int16_t y) const;
+        uint8_t getBrightness() const { return brightness; }
+        uint32_t getPixelWrites() const { return pixelWrites; }
+        uint32_t getFlips() const { return flips; }
+        void resetPixelWrites() { pixelWrites = 0; }
+        bool savePPM(const char *path) const;
+        bool savePNG(const char *path) const;
+
+    private:
+        HUB75_I2S_CFG config;
+        int16_t panelWidth;
+        int16_t panelHeight;
+        uint8_t *buffers[2];
+        uint8_t front;
+        uint8_t brightness;
+        uint32_t pixelWrites;
+        uint32_t flips;
+        int16_t cursorX;
+        int16_t cursorY;
+        uint16_t textColor;
+        uint8_t textSize;
+        bool textWrap;
+
+        void drawChar(int16_t x, int16_t y, unsigned char c);
+};
+
+#endif
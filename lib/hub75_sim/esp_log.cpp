@@ -0,0 +1,20 @@
+#include <stdarg.h>
+
+#include "esp_log.h"
+
+static esp_log_level_t logLevel = ESP_LOG_INFO;
+
+void esp_log_level_set(const char *, esp_log_level_t level)
+{
+    logLevel = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *, const char *format, ...)
+{
+    if (level > logLevel)
+        return;
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
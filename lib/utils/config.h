@@ -11,12 +11,42 @@
   #define REPO_URL "elliotmatson/esp32-hub75-status"
 #endif
 
-// Github polling interval
+// Github polling interval, conditional requests on the release feed so an unchanged one is
+// a bodiless 304. Failures back off exponentially up to the max, with jitter.
 #define CHECK_FOR_UPDATES_INTERVAL 60 // Seconds
+#define CHECK_FOR_UPDATES_BACKOFF_MAX 3600 // Seconds, GitHub rate limits reset hourly
+// Own release mirror instead of GitHub, e.g. "http://updates.lan/status" laid out as in
+// rollout.h, also set at runtime with POST /api/v1/updates. Empty: GitHub.
+#ifndef UPDATE_SOURCE
+  #define UPDATE_SOURCE ""
+#endif
+#define UPDATE_ASSET "esp32.bin" // firmware file attached to a release
+// smaller forms of it tried first, built with 'status_sim patch -z ... -o ...' (see firmwarestream.h)
+#define UPDATE_ASSET_COMPRESSED "esp32.bin.lz"
+#define UPDATE_ASSET_PATCH "esp32-%s.patch" // delta from the release named by %s
+
+// Staged rollout: panels take a release spread over PanelPrefs::rolloutHours after it is
+// published, in an order fixed by their serial, and each at a point within this window
+#define ROLLOUT_START_WINDOW 900 // Seconds
+
+// Peer updates: panels on a release announce it over mDNS (_statusfw._tcp, TXT version) and
+// serve its image at GET /api/v1/firmware, the others fetch it from them before the source.
+// That is plain HTTP from any host announcing the service, so it needs FIRMWARE_SIGNING_KEY:
+// without one peer updates cannot be turned on, and peer images must carry its signature.
+#define PEER_SERVICE "statusfw"
+#define PEER_UPLOADS_MAX 2 // at once, more are answered 503
+#define PEER_TRIES 3       // peers asked before going to the source
 
 // Signature for cube firmware
 #define MAGIC_COOKIE "status_FW"
 
+// Public key (PEM) release assets are signed with by 'status_sim sign', which prints it. With
+// "Signed FW only" on, updates then need a valid signature besides the cookie; without a key
+// only the cookie is checked. ArduinoOTA cannot carry a signature and is refused then.
+#ifndef FIRMWARE_SIGNING_KEY
+  #define FIRMWARE_SIGNING_KEY ""
+#endif
+
 // Cube Hostname
 #define HOSTNAME "status"
 
@@ -30,6 +60,59 @@
 // API Endpoint
 #define API_ENDPOINT "/api"
 
+// Render task command queue
+#define RENDER_QUEUE_LENGTH 8
+#define RENDER_HISTORY 16 // recent request ids kept for status queries
+
+// Marquee animation task frame rate, long text scrolls at PanelPrefs::marqueeSpeed
+#define MARQUEE_FPS 50
+#define MARQUEE_SPEED_MAX 64 // pixels per second
+
+// Task stack sizes (bytes), GET /api/v1/tasks shows the least each one had left
+#define RENDER_STACK 8000
+#define ANIMATE_STACK 4000
+#define DITHER_STACK 2000
+#define MEMORY_PRINTER_STACK 3000
+#define OTA_STACK 6000
+#define UPDATES_STACK 8000
+#define ANIMATION_STACK 8000
+#define PREFETCH_STACK 6000
+#define PROFILER_STACK 4000
+
+// Memory printer: heap use per allocation tag and fragmentation, HEAP_HISTORY snapshots are kept
+#define HEAP_SAMPLE_INTERVAL_MS 10000
+
+// Task profiler sampling, PROFILE_HISTORY snapshots are kept (see taskprofile.h)
+#define PROFILE_INTERVAL_MS 5000
+#define PROFILE_STATUS_MAX 32 // tasks read from the scheduler per sample
+
+// Temporal dithering flips between the two DMA buffers at this rate, keep it below the
+// refresh rate (GET /api/v1/refresh) so every pattern is shown for a whole refresh
+#define DITHER_FPS 60
+#define PANEL_MIN_REFRESH 60 // Hz, the driver trades low bit plane time for this
+
+// Animated emojis: GIFs flashed into data/gif with 'pio run -t uploadfs', played by name, or
+// https:// URLs streamed again on every loop (nothing beyond the frame ring is kept in memory)
+#define ANIMATION_DIR "/spiffs/gif"
+#define ANIMATION_READ_SIZE 512 // bytes read from flash per decoder write
+
+// Emoji origin, fetched over one kept alive TLS connection
+#define EMOJI_HOST "emojiapi.dev"
+#define EMOJI_PATH "/api/v1/%s/32.raw" // https://emojiapi.dev/api/v1/{emoticon_code_or_name}/{size}.{jpg,png,raw,tiff,webp}
+
+// Emoji cache (spiffs partition)
+#define EMOJI_CACHE_RAM_SLOTS 4
+#define EMOJI_CACHE_DIR "/e"
+
+// Offline emoji set built with 'status_sim bundle' into data/, flashed with 'pio run -t uploadfs'
+#define EMOJI_BUNDLE_PATH "/spiffs/bundle"
+
+// Favorite emojis, space separated, prefetched into the cache after boot
+#define FAVORITES_MAX_LEN 256
+#define FAVORITES_DEFAULT "\U0001F4C5 \U0001F354 \U0001F3A7 \U0001F3E0 \u2615 \U0001F697 \U0001F912 \U0001F334 \U0001F4BB \U0001F634"
+#define PREFETCH_START_DELAY_MS 10000 // leave boot and the first requests alone
+#define PREFETCH_INTERVAL_MS 1000     // pause between downloads
+
 // PCB pinouts
 #define R1_PIN 4
 #define G1_PIN 15
@@ -0,0 +1,328 @@
+#include "emojicache.h"
+
+#define EMOJI_CACHE_MAGIC 0x324A4D45 // "EMJ2", packed frames
+// SPIFFS needs free pages for garbage collection, only fill this share of the partition
+#define EMOJI_CACHE_FILL_PERCENT 75
+// Approximate per-file overhead of SPIFFS (object header + partial last page)
+#define EMOJI_CACHE_FILE_OVERHEAD 512
+// Palette and runs of a near empty frame, only used to size the index
+#define EMOJI_CACHE_MIN_PACKED 64
+
+EmojiCache::EmojiCache() :
+    flashEntries(NULL),
+    flashCount(0),
+    flashCapacity(0),
+    flashBudget(0),
+    flashUsed(0),
+    useCounter(0),
+    mounted(false),
+    stats(),
+    mutex(NULL)
+{
+    for (int i = 0; i < EMOJI_CACHE_RAM_SLOTS; i++)
+    {
+        ramSlots[i].key[0] = '\0';
+        ramSlots[i].packed = NULL;
+        ramSlots[i].size = 0;
+        ramSlots[i].lastUsed = 0;
+    }
+}
+
+// Both tiers are charged to HEAP_TAG_EMOJI and go back the same way
+EmojiCache::~EmojiCache()
+{
+    for (int i = 0; i < EMOJI_CACHE_RAM_SLOTS; i++)
+        heapTagFree(HEAP_TAG_EMOJI, ramSlots[i].packed);
+    heapTagFree(HEAP_TAG_EMOJI, flashEntries);
+    if (mutex)
+        vSemaphoreDelete(mutex);
+}
+
+// Mount spiffs partition, allocate RAM tier and index existing cache files
+bool EmojiCache::begin()
+{
+    mutex = xSemaphoreCreateMutex();
+
+    for (int i = 0; i < EMOJI_CACHE_RAM_SLOTS; i++)
+    {
+        ramSlots[i].packed = (uint8_t *)heapTagMalloc(HEAP_TAG_EMOJI, EMOJI_PACKED_MAX);
+    }
+
+    // never formatted here, that would erase the emoji bundle and animations flashed with uploadfs
+    if (!SPIFFS.begin(false))
+    {
+        ESP_LOGE(__func__, "Failed to mount spiffs (flash it with 'pio run -t uploadfs'), emoji cache is RAM only");
+        return false;
+    }
+
+    // size the flash tier to the partition, files vary in size so the budget is in bytes
+    // and the index is sized for the smallest plausible file
+    flashBudget = SPIFFS.totalBytes() * EMOJI_CACHE_FILL_PERCENT / 100;
+    flashCapacity = flashBudget / fileCost(EMOJI_CACHE_MIN_PACKED);
+    flashEntries = (FlashEntry *)heapTagCalloc(HEAP_TAG_EMOJI, flashCapacity, sizeof(FlashEntry));
+    if (!flashEntries)
+    {
+        ESP_LOGE(__func__, "No memory for %d flash entries, emoji cache is RAM only", flashCapacity);
+        flashCapacity = 0;
+        return false;
+    }
+    mounted = true;
+    stats.flashCapacity = flashCapacity;
+
+    // index existing entries, recency is not persisted so they start out equally old
+    File dir = SPIFFS.open(EMOJI_CACHE_DIR);
+    File file = dir.openNextFile();
+    while (file)
+    {
+        const char *name = strrchr(file.name(), '/');
+        name = name ? name + 1 : file.name();
+        uint32_t hash = strtoul(name, NULL, 16);
+        size_t size = file.size() - sizeof(FileHeader);
+        bool valid = file.size() > sizeof(FileHeader) && size <= EMOJI_PACKED_MAX;
+        String path = String(EMOJI_CACHE_DIR) + "/" + name;
+        file.close();
+        if (valid && flashCount < flashCapacity && flashUsed + fileCost(size) <= flashBudget)
+        {
+            flashEntries[flashCount].hash = hash;
+            flashEntries[flashCount].lastUsed = 0;
+            flashEntries[flashCount].size = size;
+            flashUsed += fileCost(size);
+            flashCount++;
+        }
+        else
+        {
+            SPIFFS.remove(path);
+        }
+        file = dir.openNextFile();
+    }
+    // leave room for files that are not ours, e.g. the emoji bundle
+    size_t other = SPIFFS.usedBytes() > flashUsed ? SPIFFS.usedBytes() - flashUsed : 0;
+    flashBudget = flashBudget > other ? flashBudget - other : 0;
+    stats.flashEntries = flashCount;
+    stats.flashBytes = flashUsed;
+    ESP_LOGI(__func__, "Emoji cache: %d/%d entries on flash, %d bytes used of %d", flashCount, flashCapacity, SPIFFS.usedBytes(), SPIFFS.totalBytes());
+    return true;
+}
+
+// Look up a packed frame (EMOJI_PACKED_MAX buffer), RAM first then flash. Flash hits are
+// promoted to RAM.
+bool EmojiCache::get(const char *key, uint8_t *packed, size_t *size)
+{
+    if (!mutex)
+        return false;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool found = false;
+
+    for (int i = 0; i < EMOJI_CACHE_RAM_SLOTS; i++)
+    {
+        if (ramSlots[i].packed && !strcmp(ramSlots[i].key, key))
+        {
+            *size = ramSlots[i].size;
+            memcpy(packed, ramSlots[i].packed, *size);
+            ramSlots[i].lastUsed = ++useCounter;
+            stats.ramHits++;
+            found = true;
+            break;
+        }
+    }
+
+    if (!found && mounted)
+    {
+        uint32_t hash = hashKey(key);
+        int index = findFlash(hash);
+        if (index >= 0 && readFlash(hash, key, packed, flashEntries[index].size))
+        {
+            *size = flashEntries[index].size;
+            flashEntries[index].lastUsed = ++useCounter;
+            putRam(key, packed, *size);
+            stats.flashHits++;
+            found = true;
+        }
+    }
+
+    if (!found)
+        stats.misses++;
+    xSemaphoreGive(mutex);
+    return found;
+}
+
+// Store a freshly packed frame in both tiers. Background fills can skip the RAM tier
+// so they don't push out what is on screen, unless there is no flash tier.
+void EmojiCache::put(const char *key, const uint8_t *packed, size_t size, bool keepInRam)
+{
+    if (!mutex || strlen(key) >= EMOJI_KEY_MAX || size > EMOJI_PACKED_MAX)
+        return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (keepInRam || !mounted || flashCapacity == 0)
+        putRam(key, packed, size);
+
+    if (mounted && flashCapacity > 0)
+    {
+        uint32_t hash = hashKey(key);
+        int index = findFlash(hash);
+        if (index >= 0)
+        {
+            flashUsed -= fileCost(flashEntries[index].size);
+            flashEntries[index] = flashEntries[--flashCount];
+        }
+        while (flashCount > 0 && (flashCount >= flashCapacity || flashUsed + fileCost(size) > flashBudget))
+            evictFlash();
+        index = flashCount++;
+        flashEntries[index].hash = hash;
+        flashEntries[index].size = size;
+        flashEntries[index].lastUsed = ++useCounter;
+        flashUsed += fileCost(size);
+        if (!writeFlash(hash, key, packed, size))
+        {
+            // drop the index entry, keep list compact
+            flashUsed -= fileCost(size);
+            flashEntries[index] = flashEntries[--flashCount];
+        }
+    }
+    stats.flashEntries = flashCount;
+    stats.flashBytes = flashUsed;
+    xSemaphoreGive(mutex);
+}
+
+// Check for a frame in either tier without counting a hit or touching recency
+bool EmojiCache::contains(const char *key)
+{
+    if (!mutex)
+        return false;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool found = false;
+    for (int i = 0; i < EMOJI_CACHE_RAM_SLOTS && !found; i++)
+    {
+        found = ramSlots[i].packed && !strcmp(ramSlots[i].key, key);
+    }
+    if (!found && mounted)
+        found = findFlash(hashKey(key)) >= 0;
+    xSemaphoreGive(mutex);
+    return found;
+}
+
+EmojiCacheStats EmojiCache::getStats()
+{
+    if (!mutex)
+        return stats;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    EmojiCacheStats current = stats;
+    current.ramEntries = 0;
+    for (int i = 0; i < EMOJI_CACHE_RAM_SLOTS; i++)
+    {
+        if (ramSlots[i].key[0])
+            current.ramEntries++;
+    }
+    xSemaphoreGive(mutex);
+    return current;
+}
+
+// keys are too long for SPIFFS' 32 character path limit, files are named by hash
+uint32_t EmojiCache::hashKey(const char *key)
+{
+    return emojiKeyHash(key);
+}
+
+// SPIFFS space taken by a cache file holding size packed bytes
+size_t EmojiCache::fileCost(size_t size)
+{
+    return sizeof(FileHeader) + size + EMOJI_CACHE_FILE_OVERHEAD;
+}
+
+void EmojiCache::filePath(uint32_t hash, char *path)
+{
+    sprintf(path, "%s/%08x", EMOJI_CACHE_DIR, hash);
+}
+
+int EmojiCache::findFlash(uint32_t hash)
+{
+    for (int i = 0; i < flashCount; i++)
+    {
+        if (flashEntries[i].hash == hash)
+            return i;
+    }
+    return -1;
+}
+
+bool EmojiCache::readFlash(uint32_t hash, const char *key, uint8_t *packed, size_t size)
+{
+    char path[32];
+    filePath(hash, path);
+    File file = SPIFFS.open(path, FILE_READ);
+    if (!file)
+        return false;
+    FileHeader header;
+    bool ok = file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+              header.magic == EMOJI_CACHE_MAGIC &&
+              !strncmp(header.key, key, EMOJI_KEY_MAX) && // guard against hash collisions
+              file.read(packed, size) == size;
+    file.close();
+    return ok;
+}
+
+bool EmojiCache::writeFlash(uint32_t hash, const char *key, const uint8_t *packed, size_t size)
+{
+    char path[32];
+    filePath(hash, path);
+    File file = SPIFFS.open(path, FILE_WRITE);
+    if (!file)
+    {
+        ESP_LOGE(__func__, "Failed to open %s for writing", path);
+        return false;
+    }
+    FileHeader header = {EMOJI_CACHE_MAGIC, {0}};
+    strncpy(header.key, key, EMOJI_KEY_MAX - 1);
+    bool ok = file.write((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+              file.write(packed, size) == size;
+    file.close();
+    if (!ok)
+    {
+        ESP_LOGE(__func__, "Failed to write %s, partition full?", path);
+        SPIFFS.remove(path);
+    }
+    return ok;
+}
+
+// Remove least recently used flash entry
+void EmojiCache::evictFlash()
+{
+    if (flashCount == 0)
+        return;
+    int oldest = 0;
+    for (int i = 1; i < flashCount; i++)
+    {
+        if (flashEntries[i].lastUsed < flashEntries[oldest].lastUsed)
+            oldest = i;
+    }
+    char path[32];
+    filePath(flashEntries[oldest].hash, path);
+    SPIFFS.remove(path);
+    flashUsed -= fileCost(flashEntries[oldest].size);
+    flashEntries[oldest] = flashEntries[--flashCount];
+    stats.evictions++;
+}
+
+// Copy a packed frame into an empty or least recently used RAM slot
+void EmojiCache::putRam(const char *key, const uint8_t *packed, size_t size)
+{
+    RamSlot *slot = NULL;
+    for (int i = 0; i < EMOJI_CACHE_RAM_SLOTS; i++)
+    {
+        if (!ramSlots[i].packed)
+            continue;
+        if (!strcmp(ramSlots[i].key, key))
+        {
+            slot = &ramSlots[i];
+            break;
+        }
+        if (!slot || ramSlots[i].lastUsed < slot->lastUsed)
+            slot = &ramSlots[i];
+    }
+    if (!slot)
+        return;
+    strncpy(slot->key, key, EMOJI_KEY_MAX - 1);
+    slot->key[EMOJI_KEY_MAX - 1] = '\0';
+    memcpy(slot->packed, packed, size);
+    slot->size = size;
+    slot->lastUsed = ++useCounter;
+}
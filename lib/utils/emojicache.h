@@ -0,0 +1,83 @@
+#ifndef EMOJICACHE_H
+#define EMOJICACHE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SPIFFS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "config.h"
+#include "emoji.h"
+#include "emojipack.h"
+#include "heaptrack.h"
+
+// Counters for cache effectiveness
+struct EmojiCacheStats
+{
+    uint32_t ramHits;
+    uint32_t flashHits;
+    uint32_t misses;
+    uint32_t evictions;
+    uint16_t ramEntries;
+    uint16_t flashEntries;
+    uint16_t flashCapacity;
+    uint32_t flashBytes;
+};
+
+// Two tier LRU cache of packed emoji frames (see emojipack.h), keyed by codepoint string
+// (e.g. 1f9d1_200d_1f4bb). A few frames are kept in RAM, the rest persist as files in the
+// spiffs partition.
+class EmojiCache {
+    public:
+        EmojiCache();
+        ~EmojiCache();
+        bool begin();
+        bool get(const char *key, uint8_t *packed, size_t *size);
+        void put(const char *key, const uint8_t *packed, size_t size, bool keepInRam = true);
+        bool contains(const char *key);
+        EmojiCacheStats getStats();
+
+    private:
+        // On-flash file layout: header followed by the packed frame
+        struct FileHeader
+        {
+            uint32_t magic;
+            char key[EMOJI_KEY_MAX];
+        };
+        struct RamSlot
+        {
+            char key[EMOJI_KEY_MAX];
+            uint8_t *packed;
+            uint16_t size;
+            uint32_t lastUsed;
+        };
+        struct FlashEntry
+        {
+            uint32_t hash;
+            uint32_t lastUsed;
+            uint16_t size;
+        };
+
+        RamSlot ramSlots[EMOJI_CACHE_RAM_SLOTS];
+        FlashEntry *flashEntries;
+        uint16_t flashCount;
+        uint16_t flashCapacity;
+        size_t flashBudget;
+        size_t flashUsed;
+        uint32_t useCounter;
+        bool mounted;
+        EmojiCacheStats stats;
+        SemaphoreHandle_t mutex;
+
+        static uint32_t hashKey(const char *key);
+        static void filePath(uint32_t hash, char *path);
+        int findFlash(uint32_t hash);
+        static size_t fileCost(size_t size);
+        bool readFlash(uint32_t hash, const char *key, uint8_t *packed, size_t size);
+        bool writeFlash(uint32_t hash, const char *key, const uint8_t *packed, size_t size);
+        void evictFlash();
+        void putRam(const char *key, const uint8_t *packed, size_t size);
+};
+
+#endif
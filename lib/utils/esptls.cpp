@@ -0,0 +1,78 @@
+#include <string.h>
+#include <esp_crt_bundle.h>
+#include <esp_log.h>
+#include <lwip/sockets.h>
+
+#include "esptls.h"
+
+EspTlsTransport::EspTlsTransport() :
+    tls(NULL),
+    session(NULL),
+    wasResumed(false)
+{
+}
+
+EspTlsTransport::~EspTlsTransport()
+{
+    close();
+    if (session)
+        esp_tls_free_client_session(session);
+}
+
+bool EspTlsTransport::connect(const char *host, uint16_t port, uint32_t timeoutMs)
+{
+    close();
+    esp_tls_cfg_t cfg = {};
+    cfg.crt_bundle_attach = esp_crt_bundle_attach;
+    cfg.timeout_ms = timeoutMs;
+    cfg.client_session = session;
+    tls = esp_tls_init();
+    if (!tls)
+        return false;
+    if (esp_tls_conn_new_sync(host, strlen(host), port, &cfg, tls) != 1)
+    {
+        esp_tls_conn_destroy(tls);
+        tls = NULL;
+        // the cached session may be what the server rejected, start over next time
+        if (session)
+        {
+            esp_tls_free_client_session(session);
+            session = NULL;
+        }
+        return false;
+    }
+
+    // a resumed session reuses the master secret of the one offered
+    const mbedtls_ssl_session *current = mbedtls_ssl_get_session_pointer(&tls->ssl);
+    wasResumed = session && current && !memcmp(current->master, session->saved_session.master, sizeof(current->master));
+    // keep the newest ticket, servers rotate them
+    if (session)
+        esp_tls_free_client_session(session);
+    session = esp_tls_get_client_session(tls);
+
+    // don't let a stalled server block the render task forever
+    int fd;
+    if (esp_tls_get_conn_sockfd(tls, &fd) == ESP_OK)
+    {
+        struct timeval timeout = {(time_t)(timeoutMs / 1000), (suseconds_t)(timeoutMs % 1000 * 1000)};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+    return true;
+}
+
+int EspTlsTransport::write(const uint8_t *data, size_t len)
+{
+    return tls ? esp_tls_conn_write(tls, data, len) : -1;
+}
+
+int EspTlsTransport::read(uint8_t *data, size_t len)
+{
+    return tls ? esp_tls_conn_read(tls, data, len) : -1;
+}
+
+void EspTlsTransport::close()
+{
+    if (tls)
+        esp_tls_conn_destroy(tls);
+    tls = NULL;
+}
@@ -0,0 +1,27 @@
+#ifndef ESPTLS_H
+#define ESPTLS_H
+
+#include <esp_tls.h>
+
+#include "httpssession.h"
+
+// TlsTransport over esp_tls, verified against the IDF certificate bundle. The session of
+// the last connection is kept and offered on the next connect so a reconnect to the same
+// origin can skip the certificate exchange (needs CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS).
+class EspTlsTransport : public TlsTransport {
+    public:
+        EspTlsTransport();
+        ~EspTlsTransport();
+        bool connect(const char *host, uint16_t port, uint32_t timeoutMs) override;
+        int write(const uint8_t *data, size_t len) override;
+        int read(uint8_t *data, size_t len) override;
+        void close() override;
+        bool resumed() override { return wasResumed; }
+
+    private:
+        esp_tls_t *tls;
+        esp_tls_client_session_t *session;
+        bool wasResumed;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include <string.h>
+#include <esp_log.h>
+
+#include "otaflash.h"
+
+RunningPartition::RunningPartition() :
+    partition(NULL)
+{
+}
+
+bool RunningPartition::read(uint32_t offset, uint8_t *data, size_t len)
+{
+    if (!partition)
+        partition = esp_ota_get_running_partition();
+    esp_err_t err = partition ? esp_partition_read(partition, offset, data, len) : ESP_ERR_NOT_FOUND;
+    if (err != ESP_OK)
+        ESP_LOGE(__func__, "Reading %u bytes at %u: %s", len, offset, esp_err_to_name(err));
+    return err == ESP_OK;
+}
+
+OtaPartition::OtaPartition() :
+    partition(NULL),
+    handle(0),
+    open(false)
+{
+}
+
+bool OtaPartition::begin(uint32_t size)
+{
+    abort();
+    partition = esp_ota_get_next_update_partition(NULL);
+    if (!partition)
+    {
+        ESP_LOGE(__func__, "No OTA partition");
+        return false;
+    }
+    if (size > partition->size)
+    {
+        ESP_LOGE(__func__, "Image of %u bytes does not fit in %s (%u bytes)", size, partition->label, partition->size);
+        return false;
+    }
+    esp_err_t err = esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(__func__, "esp_ota_begin: %s", esp_err_to_name(err));
+        return false;
+    }
+    ESP_LOGI(__func__, "Writing %u bytes to %s", size, partition->label);
+    open = true;
+    return true;
+}
+
+bool OtaPartition::write(const uint8_t *data, size_t len)
+{
+    esp_err_t err = open ? esp_ota_write(handle, data, len) : ESP_ERR_INVALID_STATE;
+    if (err != ESP_OK)
+        ESP_LOGE(__func__, "esp_ota_write: %s", esp_err_to_name(err));
+    return err == ESP_OK;
+}
+
+esp_err_t OtaPartition::end()
+{
+    if (!open)
+        return ESP_ERR_INVALID_STATE;
+    open = false;
+    esp_err_t err = esp_ota_end(handle);
+    if (err == ESP_OK)
+        err = esp_ota_set_boot_partition(partition);
+    if (err != ESP_OK)
+        ESP_LOGE(__func__, "Image in %s not accepted: %s", partition->label, esp_err_to_name(err));
+    return err;
+}
+
+void OtaPartition::abort()
+{
+    if (open)
+        esp_ota_abort(handle);
+    open = false;
+}
+
+MbedTlsVerifier::MbedTlsVerifier(const char *publicKey) :
+    publicKey(publicKey),
+    loaded(false)
+{
+    mbedtls_pk_init(&key);
+    mbedtls_sha256_init(&sha);
+}
+
+MbedTlsVerifier::~MbedTlsVerifier()
+{
+    mbedtls_pk_free(&key);
+    mbedtls_sha256_free(&sha);
+}
+
+bool MbedTlsVerifier::start()
+{
+    if (!loaded)
+    {
+        // PEM is parsed with its terminating NUL
+        int err = mbedtls_pk_parse_public_key(&key, (const unsigned char *)publicKey, strlen(publicKey) + 1);
+        if (err || !mbedtls_pk_can_do(&key, MBEDTLS_PK_ECDSA))
+        {
+            ESP_LOGE(__func__, "Bad firmware signing key (-0x%04x)", -err);
+            return false;
+        }
+        loaded = true;
+    }
+    return !mbedtls_sha256_starts_ret(&sha, 0);
+}
+
+bool MbedTlsVerifier::update(const uint8_t *data, size_t len)
+{
+    return !mbedtls_sha256_update_ret(&sha, data, len);
+}
+
+bool MbedTlsVerifier::verify(const uint8_t *signature, size_t len)
+{
+    uint8_t hash[32];
+    if (!loaded || mbedtls_sha256_finish_ret(&sha, hash))
+        return false;
+    int err = mbedtls_pk_verify(&key, MBEDTLS_MD_SHA256, hash, sizeof(hash), signature, len);
+    if (err)
+        ESP_LOGE(__func__, "Image signature not valid (-0x%04x)", -err);
+    return !err;
+}
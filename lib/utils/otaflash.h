@@ -0,0 +1,74 @@
+#ifndef OTAFLASH_H
+#define OTAFLASH_H
+
+#include <functional>
+#include <Stream.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/sha256.h>
+
+#include "firmwarestream.h"
+
+// The running app partition, what delta updates are applied to
+class RunningPartition : public FirmwareSource {
+    public:
+        RunningPartition();
+        bool read(uint32_t offset, uint8_t *data, size_t len) override;
+
+    private:
+        const esp_partition_t *partition;
+};
+
+// The next OTA slot, erased a sector at a time as the image is written rather than all
+// up front, so a rejected stream costs little flash wear
+class OtaPartition : public FirmwareTarget {
+    public:
+        OtaPartition();
+        bool begin(uint32_t size) override;
+        bool write(const uint8_t *data, size_t len) override;
+        // validate the image and boot it next
+        esp_err_t end();
+        void abort();
+        const esp_partition_t *getPartition() const { return partition; }
+
+    private:
+        const esp_partition_t *partition;
+        esp_ota_handle_t handle;
+        bool open;
+};
+
+// ECDSA signature of an image against the public key it was built with (PEM), the SHA-256
+// runs on the hash accelerator as the image is written
+class MbedTlsVerifier : public FirmwareVerifier {
+    public:
+        MbedTlsVerifier(const char *publicKey);
+        ~MbedTlsVerifier();
+        bool start() override;
+        bool update(const uint8_t *data, size_t len) override;
+        bool verify(const uint8_t *signature, size_t len) override;
+
+    private:
+        const char *publicKey;
+        bool loaded;
+        mbedtls_pk_context key;
+        mbedtls_sha256_context sha;
+};
+
+// Arduino Stream end of a firmware download, HTTPClient::writeToStream pushes the body in.
+// A false from the writer stops the transfer.
+class FirmwareWriter : public Stream {
+    public:
+        FirmwareWriter(std::function<bool(const uint8_t *, size_t)> writer) : writer(writer) {}
+        size_t write(const uint8_t *data, size_t len) override { return writer(data, len) ? len : 0; }
+        size_t write(uint8_t c) override { return write(&c, 1); }
+        int available() override { return 0; }
+        int read() override { return -1; }
+        int peek() override { return -1; }
+        void flush() {}
+
+    private:
+        std::function<bool(const uint8_t *, size_t)> writer;
+};
+
+#endif
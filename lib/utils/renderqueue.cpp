@@ -0,0 +1,153 @@
+#include <esp_timer.h>
+
+#include "renderqueue.h"
+
+RenderQueue::RenderQueue() :
+    queue(NULL),
+    mutex(NULL),
+    nextId(1),
+    history()
+{
+}
+
+bool RenderQueue::begin()
+{
+    queue = xQueueCreate(RENDER_QUEUE_LENGTH, sizeof(RenderCommand));
+    mutex = xSemaphoreCreateMutex();
+    return queue && mutex;
+}
+
+// Fold a newer command into an older one, the newer one's fields win and its id stays.
+// Call with the mutex held.
+void RenderQueue::merge(RenderCommand &command, const RenderCommand &newer)
+{
+    History &entry = history[command.id % RENDER_HISTORY];
+    if (entry.id == command.id)
+        entry.mergedInto = newer.id;
+    command.id = newer.id;
+    command.queuedUs = newer.queuedUs;
+    if (newer.fields & RENDER_EMOJI)
+    {
+        memcpy(command.emoji, newer.emoji, sizeof(command.emoji));
+        command.fields &= ~RENDER_ANIMATION;
+    }
+    if (newer.fields & RENDER_ANIMATION)
+    {
+        memcpy(command.animation, newer.animation, sizeof(command.animation));
+        command.fields &= ~RENDER_EMOJI;
+    }
+    if (newer.fields & RENDER_TEXT)
+        memcpy(command.text, newer.text, sizeof(command.text));
+    if (newer.fields & RENDER_BRIGHTNESS)
+        command.brightness = newer.brightness;
+    command.fields |= newer.fields;
+}
+
+// Assign an id and queue the command. With the queue full the waiting commands are folded
+// into one ahead of it, nothing is dropped and the newest fields win.
+uint32_t RenderQueue::enqueue(RenderCommand &command)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    command.id = nextId++;
+    command.queuedUs = esp_timer_get_time();
+    if (!nextId)
+        nextId = 1;
+    xSemaphoreGive(mutex);
+    setState(command.id, RENDER_QUEUED, ESP_OK);
+
+    // the mutex keeps receive from taking commands out of order while they are folded
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (!uxQueueSpacesAvailable(queue))
+    {
+        RenderCommand merged;
+        RenderCommand next;
+        bool any = xQueueReceive(queue, &merged, 0) == pdTRUE;
+        while (any && xQueueReceive(queue, &next, 0) == pdTRUE)
+            merge(merged, next);
+        if (any)
+        {
+            ESP_LOGI(__func__, "Render queue full, requests up to %u merged", merged.id);
+            xQueueSend(queue, &merged, 0);
+        }
+    }
+    xQueueSend(queue, &command, 0);
+    xSemaphoreGive(mutex);
+    return command.id;
+}
+
+// Block until a command is available, then fold everything else already waiting into it.
+// The returned command carries the newest id, the ones folded into it follow its state.
+bool RenderQueue::receive(RenderCommand &command, TickType_t wait)
+{
+    if (xQueueReceive(queue, &command, wait) != pdTRUE)
+        return false;
+
+    RenderCommand newer;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    while (xQueueReceive(queue, &newer, 0) == pdTRUE)
+    {
+        ESP_LOGI(__func__, "Request %u merged into %u", command.id, newer.id);
+        merge(command, newer);
+    }
+    xSemaphoreGive(mutex);
+    setState(command.id, RENDER_RUNNING, ESP_OK);
+    return true;
+}
+
+void RenderQueue::complete(uint32_t id, esp_err_t err)
+{
+    setState(id, err == ESP_OK ? RENDER_DONE : RENDER_FAILED, err);
+}
+
+// Look up a recent request, RENDER_UNKNOWN once it has dropped out of the history. A
+// merged request answers with the state of the request its fields went with.
+RenderState RenderQueue::getState(uint32_t id, esp_err_t *err)
+{
+    RenderState state = RENDER_UNKNOWN;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int hops = 0; id && hops < RENDER_HISTORY; hops++)
+    {
+        History &entry = history[id % RENDER_HISTORY];
+        if (entry.id != id)
+            break;
+        if (entry.mergedInto)
+        {
+            id = entry.mergedInto;
+            continue;
+        }
+        state = entry.state;
+        if (err)
+            *err = entry.err;
+        break;
+    }
+    xSemaphoreGive(mutex);
+    return state;
+}
+
+const char *RenderQueue::stateName(RenderState state)
+{
+    switch (state)
+    {
+    case RENDER_QUEUED:
+        return "queued";
+    case RENDER_RUNNING:
+        return "running";
+    case RENDER_DONE:
+        return "done";
+    case RENDER_FAILED:
+        return "failed";
+    default:
+        return "unknown";
+    }
+}
+
+void RenderQueue::setState(uint32_t id, RenderState state, esp_err_t err)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    History &entry = history[id % RENDER_HISTORY];
+    entry.id = id;
+    entry.state = state;
+    entry.err = err;
+    entry.mergedInto = 0;
+    xSemaphoreGive(mutex);
+}
@@ -0,0 +1,75 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+#include "config.h"
+
+#define RENDER_EMOJI_MAX 64
+#define RENDER_TEXT_MAX 128
+#define RENDER_ANIMATION_MAX 128
+
+// Fields of a RenderCommand that are set
+#define RENDER_EMOJI 0x01
+#define RENDER_TEXT 0x02
+#define RENDER_BRIGHTNESS 0x04
+#define RENDER_ANIMATION 0x08 // replaces RENDER_EMOJI, the top half shows one or the other
+
+// Status update queued by the API, only fields flagged in `fields` are applied
+struct RenderCommand
+{
+    uint32_t id;
+    uint8_t fields;
+    uint8_t brightness;
+    int64_t queuedUs; // set by enqueue, for the request to frame latency
+    char emoji[RENDER_EMOJI_MAX];
+    char text[RENDER_TEXT_MAX];
+    char animation[RENDER_ANIMATION_MAX];
+};
+
+enum RenderState
+{
+    RENDER_UNKNOWN,
+    RENDER_QUEUED,
+    RENDER_RUNNING,
+    RENDER_DONE,
+    RENDER_FAILED
+};
+
+// Bounded queue between the web server and the render task. Commands that are still
+// waiting when a newer one arrives are merged into it (latest wins per field), and a
+// merged request reports the state of the one that carried its fields.
+class RenderQueue {
+    public:
+        RenderQueue();
+        bool begin();
+        uint32_t enqueue(RenderCommand &command);
+        // false if nothing came within wait
+        bool receive(RenderCommand &command, TickType_t wait = portMAX_DELAY);
+        void complete(uint32_t id, esp_err_t err);
+        RenderState getState(uint32_t id, esp_err_t *err);
+        static const char *stateName(RenderState state);
+
+    private:
+        // recent request ids and their outcome, indexed by id % RENDER_HISTORY
+        struct History
+        {
+            uint32_t id;
+            RenderState state;
+            esp_err_t err;
+            uint32_t mergedInto; // 0 unless its fields went with a newer request
+        };
+
+        QueueHandle_t queue;
+        SemaphoreHandle_t mutex;
+        uint32_t nextId;
+        History history[RENDER_HISTORY];
+
+        void setState(uint32_t id, RenderState state, esp_err_t err);
+        void merge(RenderCommand &command, const RenderCommand &newer);
+};
+
+#endif
@@ -1,50 +1,120 @@
 #include "utils.h"
 
-// SPIRAM Allocator for ArduinoJSON
+// SPIRAM Allocator for ArduinoJSON, charged to HEAP_TAG_JSON
 struct SpiRamAllocator
 {
     void *allocate(size_t size)
     {
-        return heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+        return heapTagMalloc(HEAP_TAG_JSON, size);
     }
 
     void deallocate(void *pointer)
     {
-        heap_caps_free(pointer);
+        heapTagFree(HEAP_TAG_JSON, pointer);
     }
 
     void *reallocate(void *ptr, size_t new_size)
     {
-        return heap_caps_realloc(ptr, new_size, MALLOC_CAP_SPIRAM);
+        return heapTagRealloc(HEAP_TAG_JSON, ptr, new_size);
     }
 };
 using SpiRamJsonDocument = BasicJsonDocument<SpiRamAllocator>;
 
+// mbedTLS allocates through these with CONFIG_MBEDTLS_CUSTOM_MEM_ALLOC (sdkconfig.esp32dev),
+// in internal RAM like CONFIG_MBEDTLS_INTERNAL_MEM_ALLOC did, charged to HEAP_TAG_TLS
+extern "C" void *esp_mbedtls_mem_calloc(size_t n, size_t size)
+{
+    return heapTagCalloc(HEAP_TAG_TLS, n, size, false);
+}
+
+extern "C" void esp_mbedtls_mem_free(void *ptr)
+{
+    heapTagFree(HEAP_TAG_TLS, ptr);
+}
+
 // for signing FW on Github
 const __attribute__((section(".rodata_custom_desc"))) PanelPartition panelPartition = {MAGIC_COOKIE};
+static_assert(sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t) == FIRMWARE_COOKIE_OFFSET &&
+                  sizeof(panelPartition.cookie) == FIRMWARE_COOKIE_SIZE,
+              "FirmwareStream looks for the cookie elsewhere");
 
 // Create a new Panel object with optional devMode
 Panel::Panel() : 
     server(80),
+    emojiSession(emojiTransport),
+    animationSession(animationTransport),
+    updateSession(updateTransport),
+    updateChecker(updateSession, CHECK_FOR_UPDATES_INTERVAL * 1000, CHECK_FOR_UPDATES_BACKOFF_MAX * 1000),
+    firmwareVerifier(FIRMWARE_SIGNING_KEY),
+    rolloutTag(),
+    rolloutStart(0),
     serial(String(ESP.getEfuseMac() % 0x1000000, HEX)),
     wifiReady(false),
+    emojiMutex(NULL),
+    prefetchCancel(false),
+    displayMutex(NULL),
+    marqueeActive(false),
+    ditherActive(false),
+    reinits(0),
+    lastReinitUs(0),
+    maxReinitUs(0),
+    droppedFrames(0),
+    renderTime("status_render_seconds", "Render task time per command"),
+    requestLatency("status_request_latency_seconds", "API request to committed frame"),
+    frameTime("status_frame_seconds", "Marquee and animation frame draw and commit"),
+    ditherTime("status_dither_frame_seconds", "Temporal dither frame"),
+    profileMutex(NULL),
+    chartNames(),
+    chartCpu(),
+    chartStack(),
+    chartCount(0),
+    heapMutex(NULL),
+    firmwareMutex(NULL),
+    firmwareActive(false),
+    firmwareRequest(NULL),
+    firmwareProgress(-1),
+    otaCookieChecked(false),
+    peerUploads(0),
+    animationReady(false),
+    animationActive(false),
+    animationSource(),
     dashboard(&server),
     otaToggle(&dashboard, BUTTON_CARD, "OTA Update Enabled"),
     GHUpdateToggle(&dashboard, BUTTON_CARD, "Github Update Enabled"),
     developmentToggle(&dashboard, BUTTON_CARD, "Use Development Builds"),
     signedFWOnlyToggle(&dashboard, BUTTON_CARD, "Signed FW only"),
+    peerUpdatesToggle(&dashboard, BUTTON_CARD, "Peer updates"),
     fwVersion(&dashboard, "Firmware Version", FW_VERSION),
     brightnessSlider(&dashboard, SLIDER_CARD, "Brightness:", "", 0, 255),
     emojiInput(&dashboard, TEXT_INPUT_CARD, "Emoji", "Enter text here"),
     textInput(&dashboard, TEXT_INPUT_CARD, "Text Input", "Enter text here"),
+    favoritesInput(&dashboard, TEXT_INPUT_CARD, "Favorite Emojis", "Space separated emojis"),
+    marqueeSlider(&dashboard, SLIDER_CARD, "Marquee Speed (px/s):", "", 0, MARQUEE_SPEED_MAX),
+    gammaSlider(&dashboard, SLIDER_CARD, "Gamma (x10):", "", COLOR_GAMMA_MIN, COLOR_GAMMA_MAX),
+    redSlider(&dashboard, SLIDER_CARD, "White Balance Red:", "", 0, 255),
+    greenSlider(&dashboard, SLIDER_CARD, "White Balance Green:", "", 0, 255),
+    blueSlider(&dashboard, SLIDER_CARD, "White Balance Blue:", "", 0, 255),
+    ditherToggle(&dashboard, BUTTON_CARD, "Dithering"),
+    temporalToggle(&dashboard, BUTTON_CARD, "Temporal Dithering"),
     latchSlider(&dashboard, SLIDER_CARD, "Latch Blanking:", "", 1, 4),
     use20MHzToggle(&dashboard, BUTTON_CARD, "Use 20MHz Clock"),
+    depthSlider(&dashboard, SLIDER_CARD, "Color Depth (bits):", "", COLOR_DEPTH_MIN, COLOR_DEPTH_BITS),
     rebootButton(&dashboard, BUTTON_CARD, "Reboot Panel"),
     resetWifiButton(&dashboard, BUTTON_CARD, "Reset Wifi"),
     crashMe(&dashboard, BUTTON_CARD, "Crash Panel"),
+    cpuChart(&dashboard, BAR_CHART, "Task CPU (% of a core)"),
+    stackChart(&dashboard, BAR_CHART, "Least Free Stack (bytes)"),
     systemTab(&dashboard, "System"),
-    developerTab(&dashboard, "Development")
+    developerTab(&dashboard, "Development"),
+    tasksTab(&dashboard, "Tasks"),
+    prefetchTask(NULL),
+    animateTask(NULL),
+    animationTask(NULL),
+    ditherTask(NULL),
+    profileTask(NULL)
 {
+    for (int i = 0; i < PROFILE_TASKS_MAX; i++)
+        chartNameList[i] = chartNames[i];
 }
 
 // initialize all cube tasks and functions
@@ -53,29 +123,81 @@ void Panel::init()
     pinMode(CONTROL_BUTTON, INPUT_PULLUP);
     Serial.begin(115200);
     initPrefs();
+    emojiCache.begin();
+    emojiBundle.begin(EMOJI_BUNDLE_PATH);
+    emojiMutex = xSemaphoreCreateMutex();
+    displayMutex = xSemaphoreCreateMutex();
+    emojiSession.setHost(EMOJI_HOST);
+    animationReady = animation.begin();
     initDisplay();
     initWifi();
 
     showDebug();
     delay(5000);
     // blank panel after debug
-    dma_display->fillScreenRGB888(0, 0, 0);
+    display.clear();
+    display.commit();
     //
 
+    renderQueue.begin();
+    xTaskCreate(
+        [](void *o)
+        { static_cast<Panel *>(o)->render(); }, // This is disgusting, but it works
+        "Render",                                // Name of the task (for debugging)
+        RENDER_STACK,                            // Stack size (bytes)
+        this,                                    // Parameter to pass
+        2,                                       // Task priority
+        &renderTask                              // Task handle
+    );
+    // below the web server and WiFi, a late frame is better than a dropped request
+    xTaskCreate(
+        [](void *o)
+        { static_cast<Panel *>(o)->animate(); }, // This is disgusting, but it works
+        "Animate",                                // Name of the task (for debugging)
+        ANIMATE_STACK,                            // Stack size (bytes)
+        this,                                     // Parameter to pass
+        1,                                        // Task priority
+        &animateTask                              // Task handle
+    );
+    // flips are cheap, but must come at a steady rate or the dither patterns flicker
+    xTaskCreate(
+        [](void *o)
+        { static_cast<Panel *>(o)->dither(); }, // This is disgusting, but it works
+        "Dither",                                // Name of the task (for debugging)
+        DITHER_STACK,                            // Stack size (bytes)
+        this,                                    // Parameter to pass
+        2,                                       // Task priority
+        &ditherTask                              // Task handle
+    );
+
+    // the API reads what the memory printer and profiler tasks sample
+    heapMutex = xSemaphoreCreateMutex();
+    profileMutex = xSemaphoreCreateMutex();
+    firmwareMutex = xSemaphoreCreateMutex();
     initAPI();
     initUI();
     initUpdates();
+    startPrefetch();
 
     // Start the task to show the selected pattern
     xTaskCreate(
         [](void *o)
         { static_cast<Panel *>(o)->printMem(); }, // This is disgusting, but it works
         "Memory Printer",                        // Name of the task (for debugging)
-        3000,                                    // Stack size (bytes)
+        MEMORY_PRINTER_STACK,                    // Stack size (bytes)
         this,                                    // Parameter to pass
         1,                                       // Task priority
         &printMemTask                            // Task handle
     );
+    xTaskCreate(
+        [](void *o)
+        { static_cast<Panel *>(o)->profile(); }, // This is disgusting, but it works
+        "Profiler",                               // Name of the task (for debugging)
+        PROFILER_STACK,                           // Stack size (bytes)
+        this,                                     // Parameter to pass
+        1,                                        // Task priority
+        &profileTask                              // Task handle
+    );
 }
 
 // Initialize Preferences Library
@@ -83,11 +205,19 @@ bool Panel::initPrefs()
 {
     bool status = prefs.begin("panel");
 
-    if ((!prefs.isKey("panelPrefs")) || (prefs.getBytesLength("panelPrefs") != sizeof(PanelPrefs))) {
+    // an older layout keeps its settings, the fields added since start at their defaults
+    uint8_t blob[64];
+    size_t size = prefs.isKey("panelPrefs") ? prefs.getBytesLength("panelPrefs") : 0;
+    if (!size || size > sizeof(blob) || prefs.getBytes("panelPrefs", blob, size) != size ||
+        !loadPanelPrefs(&this->panelPrefs, blob, size)) {
+        this->panelPrefs = PanelPrefs();
         this->panelPrefs.print("No valid preferences found, creating new");
         prefs.putBytes("panelPrefs", &panelPrefs, sizeof(PanelPrefs));
     }
-    prefs.getBytes("panelPrefs", &panelPrefs, sizeof(PanelPrefs));
+    else if (size != sizeof(PanelPrefs)) {
+        ESP_LOGI(__func__, "Preferences migrated from a %u byte layout", size);
+        prefs.putBytes("panelPrefs", &panelPrefs, sizeof(PanelPrefs));
+    }
     this->panelPrefs.print("Loaded Preferences");
     return status;
 }
@@ -104,6 +234,23 @@ bool Panel::initDisplay()
 {
     bool status = false;
     ESP_LOGI(__func__,"Configuring HUB_75");
+    HUB75_I2S_CFG mxconfig = displayConfig();
+    dma_display = new MatrixPanel_I2S_DMA(mxconfig);
+    dma_display->setLatBlanking(panelPrefs.latchBlanking);
+
+    // Allocate memory and start DMA display
+    if (dma_display->begin() && display.begin(dma_display, mxconfig.double_buff)) {
+        status = true;
+    } else {
+        ESP_LOGE(__func__, "****** !KABOOM! I2S memory allocation failed ***********");
+    }
+    setBrightness(this->panelPrefs.brightness);
+    return status;
+}
+
+// HUB75 driver configuration from the preferences
+HUB75_I2S_CFG Panel::displayConfig()
+{
     HUB75_I2S_CFG::i2s_pins _pins = {R1_PIN, G1_PIN, B1_PIN, R2_PIN, G2_PIN, B2_PIN, A_PIN, B_PIN, C_PIN, D_PIN, E_PIN, LAT_PIN, OE_PIN, CLK_PIN};
     HUB75_I2S_CFG mxconfig(PANEL_WIDTH, PANEL_HEIGHT, 1, _pins);
     if(panelPrefs.use20MHz) {
@@ -112,17 +259,94 @@ bool Panel::initDisplay()
         mxconfig.i2sspeed = HUB75_I2S_CFG::HZ_10M;
     }
     mxconfig.clkphase = false;
+    mxconfig.latch_blanking = panelPrefs.latchBlanking;
+    mxconfig.min_refresh_rate = PANEL_MIN_REFRESH;
+    mxconfig.setPixelColorDepthBits(panelPrefs.colorDepth);
+    // frames are composed off-screen by Display and flipped in at the end of a refresh
+    mxconfig.double_buff = true;
+    return mxconfig;
+}
+
+// Restart the DMA driver with the clock, latch blanking and color depth from the
+// preferences, without a reboot. The driver's buffers are freed before the new ones are
+// allocated, there is no room for both; the current frame is kept in Display's back buffer
+// and committed again. If the new configuration does not fit the previous one is restored,
+// if that fails too the panel stays dark until a configuration that fits is set.
+esp_err_t Panel::reinitDisplay()
+{
+    HUB75_I2S_CFG mxconfig = displayConfig();
+    xSemaphoreTake(displayMutex, portMAX_DELAY);
+    int64_t start = esp_timer_get_time();
+    HUB75_I2S_CFG previous = dma_display->getCfg();
+    esp_err_t err = ESP_OK;
+    delete dma_display;
     dma_display = new MatrixPanel_I2S_DMA(mxconfig);
+    if (!dma_display->begin())
+    {
+        ESP_LOGE(__func__, "No memory for %u MHz at %u bits, restoring the previous configuration",
+                 mxconfig.i2sspeed / 1000000, mxconfig.getPixelColorDepthBits());
+        err = ESP_ERR_NO_MEM;
+        delete dma_display;
+        mxconfig = previous;
+        dma_display = new MatrixPanel_I2S_DMA(mxconfig);
+        if (!dma_display->begin())
+        {
+            ESP_LOGE(__func__, "****** !KABOOM! I2S memory allocation failed ***********");
+            // the driver that is left never started, nothing may draw to it or flip it
+            display.setPanel(NULL, false);
+            ditherActive = false;
+            xSemaphoreGive(displayMutex);
+            return ESP_FAIL;
+        }
+        panelPrefs.use20MHz = mxconfig.i2sspeed == HUB75_I2S_CFG::HZ_20M;
+        panelPrefs.colorDepth = mxconfig.getPixelColorDepthBits();
+        this->updatePrefs();
+    }
     dma_display->setLatBlanking(panelPrefs.latchBlanking);
+    dma_display->setBrightness8(panelPrefs.brightness);
+    display.setPanel(dma_display, mxconfig.double_buff);
+    // the color tables depend on the depth
+    display.setColor(colorSettings(), panelPrefs.brightness);
+    display.commit();
+    ditherActive = display.isTemporal();
+    uint32_t elapsedUs = esp_timer_get_time() - start;
+    xSemaphoreGive(displayMutex);
+
+    // ticks of the animation and dither tasks that came and went while they were blocked
+    uint32_t dropped = 0;
+    if (marqueeActive || animationActive)
+        dropped += elapsedUs / (1000000 / MARQUEE_FPS);
+    if (ditherActive)
+        dropped += elapsedUs / (1000000 / DITHER_FPS);
+    reinits++;
+    lastReinitUs = elapsedUs;
+    if (elapsedUs > maxReinitUs)
+        maxReinitUs = elapsedUs;
+    droppedFrames += dropped;
+    ESP_LOGI(__func__, "Display restarted at %u MHz, %u bits in %u us, %u frames dropped", mxconfig.i2sspeed / 1000000,
+             mxconfig.getPixelColorDepthBits(), elapsedUs, dropped);
+    if (ditherActive && ditherTask)
+        xTaskNotifyGive(ditherTask);
+    return err;
+}
 
-    // Allocate memory and start DMA display
-    if (dma_display->begin()) {
-        status = true;
-    } else {
-        ESP_LOGE(__func__, "****** !KABOOM! I2S memory allocation failed ***********");
-    }
-    setBrightness(this->panelPrefs.brightness);
-    return status;
+// set clock and color depth, persisted and applied by restarting the driver
+esp_err_t Panel::setDisplayTiming(bool use20MHz, uint8_t colorDepth)
+{
+    panelPrefs.use20MHz = use20MHz;
+    panelPrefs.colorDepth = constrain(colorDepth, COLOR_DEPTH_MIN, COLOR_DEPTH_BITS);
+    this->updatePrefs();
+    return this->reinitDisplay();
+}
+
+// set latch blanking, the driver applies it to the running refresh
+void Panel::setLatchBlanking(uint8_t blanking)
+{
+    panelPrefs.latchBlanking = blanking;
+    this->updatePrefs();
+    xSemaphoreTake(displayMutex, portMAX_DELAY);
+    dma_display->setLatBlanking(blanking);
+    xSemaphoreGive(displayMutex);
 }
 
 // Initialize wifi and prompt for connection if needed
@@ -133,10 +357,10 @@ bool Panel::initWifi()
     wifiManager.setClass("invert");
     wifiManager.setAPCallback([&](WiFiManager *myWiFiManager)
         {
-            dma_display->fillScreen(BLACK);
-            dma_display->setTextColor(WHITE);
-            dma_display->setCursor(0, 0);
-            dma_display->printf("\n\nConnect to\n   WiFi\n\nSSID: %s", myWiFiManager->getConfigPortalSSID().c_str());
+            char message[96];
+            snprintf(message, sizeof(message), "\n\nConnect to\n   WiFi\n\nSSID: %s", myWiFiManager->getConfigPortalSSID().c_str());
+            display.drawMessage(message);
+            display.commit();
         });
 
     bool status = wifiManager.autoConnect("Panel");
@@ -153,7 +377,7 @@ bool Panel::initWifi()
     if (httpCode > 0) {
         if (httpCode == HTTP_CODE_OK) {
             String payload = http.getString();
-            DynamicJsonDocument doc(1024);
+            SpiRamJsonDocument doc(1024);
             deserializeJson(doc, payload);
             gmtOffset_sec = doc["raw_offset"].as<int>();
             daylightOffset_sec = doc["dst_offset"].as<int>();
@@ -208,6 +432,11 @@ void Panel::initUI()
             this->setSignedFWOnly(value);
             this->signedFWOnlyToggle.update(value);
             this->dashboard.sendUpdates(); });
+    this->peerUpdatesToggle.attachCallback([&](int value)
+                                           {
+            this->setPeerUpdates(value);
+            this->peerUpdatesToggle.update(this->panelPrefs.peerUpdates);
+            this->dashboard.sendUpdates(); });
     brightnessSlider.attachCallback([&](int value)
                                      {
             this->setBrightness(value);
@@ -215,24 +444,70 @@ void Panel::initUI()
             this->dashboard.sendUpdates(); });
     emojiInput.attachCallback([&](const char *value)
                             {
-            this->setEmoji(value);
+            RenderCommand command = {};
+            command.fields = RENDER_EMOJI;
+            strlcpy(command.emoji, value, sizeof(command.emoji));
+            this->renderQueue.enqueue(command);
                              });
     textInput.attachCallback([&](const char *value)
                             {
-            this->setText(value);
+            RenderCommand command = {};
+            command.fields = RENDER_TEXT;
+            strlcpy(command.text, value, sizeof(command.text));
+            this->renderQueue.enqueue(command);
                              });
+    favoritesInput.attachCallback([&](const char *value)
+                            {
+            this->setFavorites(value);
+            this->favoritesInput.update(value);
+            this->dashboard.sendUpdates(); });
+    marqueeSlider.attachCallback([&](int value)
+                                 {
+            this->setMarqueeSpeed(value);
+            this->marqueeSlider.update(value);
+            this->dashboard.sendUpdates(); });
+    gammaSlider.attachCallback([&](int value)
+                                {
+            this->setColor(value, this->panelPrefs.whiteBalance, this->panelPrefs.dither, this->panelPrefs.temporalDither);
+            this->gammaSlider.update(value);
+            this->dashboard.sendUpdates(); });
+    Card *whiteSliders[3] = {&redSlider, &greenSlider, &blueSlider};
+    for (int c = 0; c < 3; c++)
+    {
+        whiteSliders[c]->attachCallback([this, c](int value)
+                                        {
+            uint8_t whiteBalance[3];
+            memcpy(whiteBalance, this->panelPrefs.whiteBalance, sizeof(whiteBalance));
+            whiteBalance[c] = value;
+            this->setColor(this->panelPrefs.gamma, whiteBalance, this->panelPrefs.dither, this->panelPrefs.temporalDither);
+            Card *sliders[3] = {&this->redSlider, &this->greenSlider, &this->blueSlider};
+            sliders[c]->update(value);
+            this->dashboard.sendUpdates(); });
+    }
+    ditherToggle.attachCallback([&](int value)
+                                {
+            this->setColor(this->panelPrefs.gamma, this->panelPrefs.whiteBalance, value, this->panelPrefs.temporalDither);
+            this->ditherToggle.update(value);
+            this->dashboard.sendUpdates(); });
+    temporalToggle.attachCallback([&](int value)
+                                  {
+            this->setColor(this->panelPrefs.gamma, this->panelPrefs.whiteBalance, this->panelPrefs.dither, value);
+            this->temporalToggle.update(value);
+            this->dashboard.sendUpdates(); });
     latchSlider.attachCallback([&](int value)
                                      {
-            this->dma_display->setLatBlanking(value);
-            this->panelPrefs.latchBlanking = value;
-            this->updatePrefs();
+            this->setLatchBlanking(value);
             this->latchSlider.update(value);
             this->dashboard.sendUpdates(); });
     use20MHzToggle.attachCallback([&](int value)
                                   {
-            this->panelPrefs.use20MHz = value;
-            this->updatePrefs();
-            this->use20MHzToggle.update(value);
+            this->setDisplayTiming(value, this->panelPrefs.colorDepth);
+            this->use20MHzToggle.update(this->panelPrefs.use20MHz);
+            this->dashboard.sendUpdates(); });
+    depthSlider.attachCallback([&](int value)
+                               {
+            this->setDisplayTiming(this->panelPrefs.use20MHz, value);
+            this->depthSlider.update(this->panelPrefs.colorDepth);
             this->dashboard.sendUpdates(); });
     rebootButton.attachCallback([&](int value)
                                 {
@@ -256,24 +531,73 @@ void Panel::initUI()
     this->GHUpdateToggle.update(this->panelPrefs.github);
     this->brightnessSlider.update(this->panelPrefs.brightness);
     this->signedFWOnlyToggle.update(this->panelPrefs.signedFWOnly);
+    this->peerUpdatesToggle.update(this->panelPrefs.peerUpdates);
     this->latchSlider.update(this->panelPrefs.latchBlanking);
     this->use20MHzToggle.update(this->panelPrefs.use20MHz);
+    this->depthSlider.update(this->panelPrefs.colorDepth);
+    this->favoritesInput.update(prefs.getString("favorites", FAVORITES_DEFAULT).c_str());
+    this->marqueeSlider.update(this->panelPrefs.marqueeSpeed);
+    this->gammaSlider.update(this->panelPrefs.gamma);
+    this->redSlider.update(this->panelPrefs.whiteBalance[0]);
+    this->greenSlider.update(this->panelPrefs.whiteBalance[1]);
+    this->blueSlider.update(this->panelPrefs.whiteBalance[2]);
+    this->ditherToggle.update(this->panelPrefs.dither);
+    this->temporalToggle.update(this->panelPrefs.temporalDither);
     this->rebootButton.update(true);
     this->resetWifiButton.update(true);
 
     this->rebootButton.setTab(&systemTab);
     this->resetWifiButton.setTab(&systemTab);
+    this->favoritesInput.setTab(&systemTab);
+    this->marqueeSlider.setTab(&systemTab);
+    this->gammaSlider.setTab(&systemTab);
+    this->redSlider.setTab(&systemTab);
+    this->greenSlider.setTab(&systemTab);
+    this->blueSlider.setTab(&systemTab);
+    this->ditherToggle.setTab(&systemTab);
+    this->temporalToggle.setTab(&systemTab);
     this->otaToggle.setTab(&developerTab);
     this->developmentToggle.setTab(&developerTab);
     this->GHUpdateToggle.setTab(&developerTab);
     this->signedFWOnlyToggle.setTab(&developerTab);
+    this->peerUpdatesToggle.setTab(&developerTab);
     this->crashMe.setTab(&developerTab);
     this->latchSlider.setTab(&developerTab);
     this->use20MHzToggle.setTab(&developerTab);
+    this->depthSlider.setTab(&developerTab);
+    this->cpuChart.setTab(&tasksTab);
+    this->stackChart.setTab(&tasksTab);
 
     dashboard.sendUpdates();
 
     MDNS.addService("http", "tcp", 80);
+    advertisePeer();
+}
+
+// stack size a task was created with, 0 for tasks not started by Panel
+static uint32_t taskStackSize(const char *name)
+{
+    static const struct
+    {
+        const char *name;
+        uint32_t size;
+    } stacks[] = {
+        {"Render", RENDER_STACK},
+        {"Animate", ANIMATE_STACK},
+        {"Dither", DITHER_STACK},
+        {"Memory Printer", MEMORY_PRINTER_STACK},
+        {"Check For OTA", OTA_STACK},
+        {"Check For Updates", UPDATES_STACK},
+        {"Animation", ANIMATION_STACK},
+        {"Prefetch", PREFETCH_STACK},
+        {"Profiler", PROFILER_STACK},
+    };
+    for (const auto &stack : stacks)
+    {
+        if (!strcmp(stack.name, name))
+            return stack.size;
+    }
+    return 0;
 }
 
 /**
@@ -320,14 +644,14 @@ void Panel::initAPI()
         ESP_LOGI(__func__,"POST %s", request->url().c_str());
         if (request->hasArg("emoji"))
         {
-            if (this->setEmoji(request->arg("emoji").c_str()))
-            {
-                request->send(200, "application/json", String("{\"emoji\":\"") + request->arg("emoji") + "\"");
-            }
-            else
+            RenderCommand command = {};
+            command.fields = RENDER_EMOJI;
+            if (strlcpy(command.emoji, request->arg("emoji").c_str(), sizeof(command.emoji)) >= sizeof(command.emoji))
             {
                 request->send(400, "application/json", "{\"error\": \"Invalid emoji\"}");
+                return;
             }
+            this->queueRender(request, command);
         }
         else
         {
@@ -335,6 +659,49 @@ void Panel::initAPI()
         }
     });
 
+    // emoji cache statistics
+    sprintf(uri, "%s/v1/cache", API_ENDPOINT);
+    server.on(uri, HTTP_GET, [&](AsyncWebServerRequest *request)
+              {
+        EmojiCacheStats stats = this->emojiCache.getStats();
+        char json[256];
+        snprintf(json, sizeof(json), "{\"ramHits\":%u,\"flashHits\":%u,\"misses\":%u,\"evictions\":%u,\"ramEntries\":%u,\"flashEntries\":%u,\"flashCapacity\":%u,\"flashBytes\":%u,\"bundleHits\":%u,\"bundleEntries\":%u}",
+                 stats.ramHits, stats.flashHits, stats.misses, stats.evictions, stats.ramEntries, stats.flashEntries, stats.flashCapacity, stats.flashBytes,
+                 this->emojiBundle.getHits(), this->emojiBundle.getCount());
+        request->send(200, "application/json", json); });
+
+    // get/set favorite emojis, space separated
+    sprintf(uri, "%s/v1/favorites", API_ENDPOINT);
+    server.on(uri, HTTP_GET, [&](AsyncWebServerRequest *request)
+              {
+        request->send(200, "application/json", String("{\"favorites\":\"") + this->prefs.getString("favorites", FAVORITES_DEFAULT) + "\"}");
+    });
+    server.on(uri, HTTP_POST, [&](AsyncWebServerRequest *request)
+              {
+        ESP_LOGI(__func__,"POST %s", request->url().c_str());
+        if (!request->hasArg("favorites") || request->arg("favorites").length() >= FAVORITES_MAX_LEN)
+        {
+            request->send(400, "application/json", "{\"error\": \"Invalid favorites\"}");
+            return;
+        }
+        this->setFavorites(request->arg("favorites").c_str());
+        this->favoritesInput.update(request->arg("favorites").c_str());
+        this->dashboard.sendUpdates();
+        request->send(200, "application/json", String("{\"favorites\":\"") + request->arg("favorites") + "\"}");
+    });
+
+    // emoji fetch connection reuse and latency
+    sprintf(uri, "%s/v1/fetch", API_ENDPOINT);
+    server.on(uri, HTTP_GET, [&](AsyncWebServerRequest *request)
+              {
+        HttpsSessionStats stats = this->emojiSession.getStats();
+        char json[256];
+        snprintf(json, sizeof(json), "{\"fetches\":%u,\"failures\":%u,\"handshakes\":%u,\"resumed\":%u,\"reused\":%u,\"lastFetchUs\":%u,\"avgFetchUs\":%u,\"lastHandshakeUs\":%u,\"avgHandshakeUs\":%u}",
+                 stats.fetches, stats.failures, stats.handshakes, stats.resumed, stats.reused,
+                 stats.lastFetchUs, stats.fetches ? (uint32_t)(stats.totalFetchUs / stats.fetches) : 0,
+                 stats.lastHandshakeUs, stats.handshakes ? (uint32_t)(stats.totalHandshakeUs / stats.handshakes) : 0);
+        request->send(200, "application/json", json); });
+
     // get/set text with JSON, query string, or POST
     sprintf(uri, "%s/v1/text", API_ENDPOINT);
     server.on(uri, HTTP_GET, [&](AsyncWebServerRequest *request)
@@ -347,8 +714,10 @@ void Panel::initAPI()
         ESP_LOGI(__func__,"POST %s", request->url().c_str());
         if (request->hasArg("text"))
         {
-            this->setText(request->arg("text").c_str());
-            request->send(200, "application/json", String("{\"text\":\"") + request->arg("text") + "\"");
+            RenderCommand command = {};
+            command.fields = RENDER_TEXT;
+            strlcpy(command.text, request->arg("text").c_str(), sizeof(command.text));
+            this->queueRender(request, command);
         }
         else
         {
@@ -357,6 +726,505 @@ void Panel::initAPI()
     });
 
 
+    // get/set marquee speed, with frame timing of the current scroll
+    sprintf(uri, "%s/v1/marquee", API_ENDPOINT);
+    server.on(uri, HTTP_GET, [&](AsyncWebServerRequest *request)
+              {
+        FrameStats stats = this->marqueeTimer.getStats(esp_timer_get_time());
+        char json[256];
+        snprintf(json, sizeof(json), "{\"speed\":%u,\"active\":%s,\"periodUs\":%u,\"frames\":%u,\"late\":%u,\"avgJitterUs\":%u,\"maxJitterUs\":%u,\"avgFrameUs\":%u,\"maxFrameUs\":%u,\"cpuPpm\":%u}",
+                 this->panelPrefs.marqueeSpeed, this->marqueeActive ? "true" : "false", stats.periodUs, stats.frames, stats.late,
+                 stats.avgJitterUs, stats.maxJitterUs, stats.avgFrameUs, stats.maxFrameUs, stats.cpuPpm);
+        request->send(200, "application/json", json); });
+    server.on(uri, HTTP_POST, [&](AsyncWebServerRequest *request)
+              {
+        ESP_LOGI(__func__,"POST %s", request->url().c_str());
+        if (!request->hasArg("speed"))
+        {
+            request->send(400, "application/json", "{\"error\": \"No speed parameter\"}");
+            return;
+        }
+        this->setMarqueeSpeed(constrain(request->arg("speed").toInt(), 0, MARQUEE_SPEED_MAX));
+        this->marqueeSlider.update(this->panelPrefs.marqueeSpeed);
+        this->dashboard.sendUpdates();
+        request->send(200, "application/json", String("{\"speed\":") + this->panelPrefs.marqueeSpeed + "}");
+    });
+
+    // get/set gamma (tenths), white balance and dithering
+    sprintf(uri, "%s/v1/color", API_ENDPOINT);
+    server.on(uri, HTTP_GET, [&](AsyncWebServerRequest *request)
+              {
+        char json[192];
+        snprintf(json, sizeof(json), "{\"gamma\":%u,\"red\":%u,\"green\":%u,\"blue\":%u,\"dither\":%s,\"temporal\":%s,\"ditherBits\":%u}",
+                 this->panelPrefs.gamma, this->panelPrefs.whiteBalance[0], this->panelPrefs.whiteBalance[1], this->panelPrefs.whiteBalance[2],
+                 this->panelPrefs.dither ? "true" : "false", this->panelPrefs.temporalDither ? "true" : "false", this->display.getDitherBits());
+        request->send(200, "application/json", json); });
+    server.on(uri, HTTP_POST, [&](AsyncWebServerRequest *request)
+              {
+        ESP_LOGI(__func__,"POST %s", request->url().c_str());
+        uint8_t gamma = this->panelPrefs.gamma;
+        uint8_t whiteBalance[3];
+        bool dither = this->panelPrefs.dither;
+        bool temporal = this->panelPrefs.temporalDither;
+        memcpy(whiteBalance, this->panelPrefs.whiteBalance, sizeof(whiteBalance));
+        if (request->hasArg("gamma"))
+            gamma = constrain(request->arg("gamma").toInt(), COLOR_GAMMA_MIN, COLOR_GAMMA_MAX);
+        static const char *const channels[3] = {"red", "green", "blue"};
+        for (int c = 0; c < 3; c++)
+        {
+            if (request->hasArg(channels[c]))
+                whiteBalance[c] = constrain(request->arg(channels[c]).toInt(), 0, 255);
+        }
+        if (request->hasArg("dither"))
+            dither = request->arg("dither") == "true" || request->arg("dither") == "1";
+        if (request->hasArg("temporal"))
+            temporal = request->arg("temporal") == "true" || request->arg("temporal") == "1";
+        this->setColor(gamma, whiteBalance, dither, temporal);
+        this->gammaSlider.update(gamma);
+        this->redSlider.update(whiteBalance[0]);
+        this->greenSlider.update(whiteBalance[1]);
+        this->blueSlider.update(whiteBalance[2]);
+        this->ditherToggle.update(dither);
+        this->temporalToggle.update(temporal);
+        this->dashboard.sendUpdates();
+        request->send(200, "application/json", String("{\"gamma\":") + gamma + ",\"red\":" + whiteBalance[0] + ",\"green\":" + whiteBalance[1] +
+                                               ",\"blue\":" + whiteBalance[2] + ",\"dither\":" + (dither ? "true" : "false") +
+                                               ",\"temporal\":" + (temporal ? "true" : "false") + "}");
+    });
+
+    // refresh rate of the current panel configuration and of the other depth and clock
+    // choices, with the CPU time temporal dithering takes and what live restarts cost
+    sprintf(uri, "%s/v1/refresh", API_ENDPOINT);
+    server.on(uri, HTTP_GET, [&](AsyncWebServerRequest *request)
+              {
+        xSemaphoreTake(this->displayMutex, portMAX_DELAY);
+        HUB75_I2S_CFG cfg = this->dma_display->getCfg();
+        xSemaphoreGive(this->displayMutex);
+        Hub75Timing current = hub75Timing(PANEL_WIDTH, PANEL_HEIGHT, cfg.getPixelColorDepthBits(), cfg.i2sspeed, cfg.min_refresh_rate);
+        FrameStats stats = this->ditherTimer.getStats(esp_timer_get_time());
+        String json = String("{\"depth\":") + current.depthBits + ",\"clockMHz\":" + cfg.i2sspeed / 1000000 + ",\"latchBlanking\":" + this->panelPrefs.latchBlanking +
+                      ",\"refreshHz\":" + current.refreshHz + ",\"transitionBit\":" + current.transitionBit + ",\"dmaBytes\":" + current.dmaBytes +
+                      ",\"dither\":{\"active\":" + (this->ditherActive ? "true" : "false") + ",\"periodUs\":" + stats.periodUs + ",\"frames\":" + stats.frames +
+                      ",\"late\":" + stats.late + ",\"avgFrameUs\":" + stats.avgFrameUs + ",\"maxFrameUs\":" + stats.maxFrameUs + ",\"cpuPpm\":" + stats.cpuPpm +
+                      "},\"reinit\":{\"count\":" + this->reinits + ",\"lastUs\":" + this->lastReinitUs + ",\"maxUs\":" + this->maxReinitUs +
+                      ",\"droppedFrames\":" + this->droppedFrames + "},\"options\":[";
+        static const uint32_t clocks[2] = {HUB75_I2S_CFG::HZ_10M, HUB75_I2S_CFG::HZ_20M};
+        for (uint8_t depth = COLOR_DEPTH_MIN; depth <= COLOR_DEPTH_BITS; depth++)
+        {
+            for (int c = 0; c < 2; c++)
+            {
+                Hub75Timing option = hub75Timing(PANEL_WIDTH, PANEL_HEIGHT, depth, clocks[c], cfg.min_refresh_rate);
+                json += String(depth == COLOR_DEPTH_MIN && !c ? "" : ",") + "{\"depth\":" + depth + ",\"clockMHz\":" + clocks[c] / 1000000 +
+                        ",\"refreshHz\":" + option.refreshHz + ",\"transitionBit\":" + option.transitionBit + "}";
+            }
+        }
+        json += "]}";
+        request->send(200, "application/json", json); });
+    server.on(uri, HTTP_POST, [&](AsyncWebServerRequest *request)
+              {
+        ESP_LOGI(__func__,"POST %s", request->url().c_str());
+        uint8_t depth = this->panelPrefs.colorDepth;
+        bool use20MHz = this->panelPrefs.use20MHz;
+        if (request->hasArg("latchBlanking"))
+            this->setLatchBlanking(constrain(request->arg("latchBlanking").toInt(), 1, 4));
+        if (request->hasArg("depth"))
+            depth = constrain(request->arg("depth").toInt(), COLOR_DEPTH_MIN, COLOR_DEPTH_BITS);
+        if (request->hasArg("use20MHz"))
+            use20MHz = request->arg("use20MHz") == "true" || request->arg("use20MHz") == "1";
+        // latch blanking alone does not need a restart
+        esp_err_t err = ESP_OK;
+        if (depth != this->panelPrefs.colorDepth || use20MHz != this->panelPrefs.use20MHz)
+            err = this->setDisplayTiming(use20MHz, depth);
+        this->latchSlider.update(this->panelPrefs.latchBlanking);
+        this->depthSlider.update(this->panelPrefs.colorDepth);
+        this->use20MHzToggle.update(this->panelPrefs.use20MHz);
+        this->dashboard.sendUpdates();
+        request->send(err == ESP_OK ? 200 : 507, "application/json", String("{\"depth\":") + this->panelPrefs.colorDepth + ",\"use20MHz\":" +
+                                               (this->panelPrefs.use20MHz ? "true" : "false") + ",\"latchBlanking\":" + this->panelPrefs.latchBlanking +
+                                               ",\"reinitUs\":" + this->lastReinitUs + ",\"error\":\"" + esp_err_to_name(err) + "\"}");
+    });
+
+    // Prometheus scrape target. Histograms are filled as frames are drawn, everything else
+    // is only looked up here, so there is nothing to pay for while nobody scrapes.
+    sprintf(uri, "%s/v1/metrics", API_ENDPOINT);
+    server.on(uri, HTTP_GET, [&](AsyncWebServerRequest *request)
+              {
+        xSemaphoreTake(this->displayMutex, portMAX_DELAY);
+        HUB75_I2S_CFG cfg = this->dma_display->getCfg();
+        DisplayStats displayStats = this->display.getStats();
+        xSemaphoreGive(this->displayMutex);
+        Hub75Timing timing = hub75Timing(PANEL_WIDTH, PANEL_HEIGHT, cfg.getPixelColorDepthBits(), cfg.i2sspeed, cfg.min_refresh_rate);
+        AnimationStats animationStats = this->animation.getStats();
+        UpdateCheckStats updateStats = this->updateChecker.getStats();
+        const struct
+        {
+            const char *name;
+            const char *type;
+            const char *help;
+            double value;
+        } metrics[] = {
+            {"status_panel_refresh_hz", "gauge", "Refresh rate estimated from the driver configuration", (double)timing.refreshHz},
+            {"status_panel_dma_bytes", "gauge", "DMA buffer memory of the driver configuration", (double)timing.dmaBytes * (cfg.double_buff ? 2 : 1)},
+            {"status_panel_color_depth_bits", "gauge", "Driver bit planes", (double)cfg.getPixelColorDepthBits()},
+            {"status_panel_clock_hz", "gauge", "Driver output clock", (double)cfg.i2sspeed},
+            {"status_display_commits_total", "counter", "Frames committed", (double)displayStats.commits},
+            {"status_display_flips_total", "counter", "DMA buffer flips", (double)displayStats.flips},
+            {"status_display_pixels_total", "counter", "Pixels written to the driver", (double)displayStats.pixels},
+            {"status_display_reinits_total", "counter", "Live driver restarts", (double)this->reinits},
+            {"status_display_dropped_frames_total", "counter", "Frames not shown during driver restarts", (double)this->droppedFrames},
+            {"status_animation_underruns_total", "counter", "Animation frames due before they were decoded", (double)animationStats.underruns},
+            {"status_update_checks_total", "counter", "Release feed checks", (double)updateStats.checks},
+            {"status_update_unchanged_total", "counter", "Release feed checks answered with 304", (double)updateStats.unchanged},
+            {"status_update_failures_total", "counter", "Failed release feed checks and updates", (double)updateStats.failures},
+            {"status_heap_free_bytes", "gauge", "Free internal heap", (double)heap_caps_get_free_size(MALLOC_CAP_INTERNAL)},
+            {"status_heap_dma_free_bytes", "gauge", "Free DMA capable heap", (double)heap_caps_get_free_size(MALLOC_CAP_DMA)},
+            {"status_heap_largest_free_block_bytes", "gauge", "Largest free internal heap block", (double)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL)},
+        };
+        const Histogram *histograms[] = {&this->renderTime, &this->requestLatency, &this->frameTime, &this->ditherTime};
+
+        // one metric at a time, the scrape runs in the web server task
+        static char text[2048];
+        AsyncResponseStream *response = request->beginResponseStream("text/plain; version=0.0.4");
+        for (const auto &metric : metrics)
+        {
+            formatMetric(text, sizeof(text), metric.name, metric.type, metric.help, metric.value);
+            response->print(text);
+        }
+        for (const Histogram *histogram : histograms)
+        {
+            histogram->format(text, sizeof(text));
+            response->print(text);
+        }
+        request->send(response); });
+
+    // Heap use per allocation tag, and free memory, largest block and fragmentation (per
+    // mille) of both regions with the tagged live bytes at each kept snapshot, newest first
+    sprintf(uri, "%s/v1/heap", API_ENDPOINT);
+    server.on(uri, HTTP_GET, [&](AsyncWebServerRequest *request)
+              {
+        AsyncResponseStream *response = request->beginResponseStream("application/json");
+        response->printf("{\"intervalMs\":%u,\"tags\":{", HEAP_SAMPLE_INTERVAL_MS);
+        for (int tag = 0; tag < HEAP_TAGS; tag++)
+        {
+            HeapTagStats stats = heapTagStats((HeapTag)tag);
+            response->printf("%s\"%s\":{\"live\":%u,\"peak\":%u,\"allocs\":%u,\"frees\":%u,\"failures\":%u,\"allocated\":%llu}", tag ? "," : "",
+                             heapTagName((HeapTag)tag), stats.live, stats.peak, stats.allocs, stats.frees, stats.failures, stats.allocated);
+        }
+        response->print("},\"history\":[");
+        xSemaphoreTake(this->heapMutex, portMAX_DELAY);
+        int64_t now = esp_timer_get_time();
+        for (int age = 0; age < this->heapHistory.size(); age++)
+        {
+            const HeapSnapshot &snapshot = this->heapHistory.get(age);
+            const HeapRegion *regions[] = {&snapshot.internal, &snapshot.spiram};
+            response->printf("%s{\"ageMs\":%u", age ? "," : "", (uint32_t)((now - snapshot.timeUs) / 1000));
+            for (int region = 0; region < 2; region++)
+            {
+                response->printf(",\"%s\":{\"free\":%u,\"largestBlock\":%u,\"fragmentation\":%u}", region ? "spiram" : "internal",
+                                 regions[region]->freeBytes, regions[region]->largestBlock, regions[region]->fragmentation);
+            }
+            response->print(",\"live\":{");
+            for (int tag = 0; tag < HEAP_TAGS; tag++)
+                response->printf("%s\"%s\":%u", tag ? "," : "", heapTagName((HeapTag)tag), snapshot.live[tag]);
+            response->print("}}");
+        }
+        xSemaphoreGive(this->heapMutex);
+        response->print("]}");
+        request->send(response); });
+
+    // Tasks seen by the profiler: stack size (when started by Panel), the least free stack so
+    // far, and CPU per mille of one core for each kept snapshot, newest first
+    sprintf(uri, "%s/v1/tasks", API_ENDPOINT);
+    server.on(uri, HTTP_GET, [&](AsyncWebServerRequest *request)
+              {
+        AsyncResponseStream *response = request->beginResponseStream("application/json");
+        xSemaphoreTake(this->profileMutex, portMAX_DELAY);
+        int snapshots = this->profiler.size();
+        response->printf("{\"intervalMs\":%u,\"snapshots\":%d,\"untracked\":%u,\"tasks\":[", PROFILE_INTERVAL_MS, snapshots, this->profiler.getUntracked());
+        bool first = true;
+        for (int slot = 0; slot < PROFILE_TASKS_MAX; slot++)
+        {
+            const ProfiledTask &task = this->profiler.getTask(slot);
+            if (!task.alive)
+                continue;
+            uint32_t stackSize = taskStackSize(task.name);
+            response->printf("%s{\"name\":\"%s\",\"priority\":%u,\"stackFree\":%u,", first ? "" : ",", task.name, task.priority, task.stackFree);
+            if (stackSize)
+                response->printf("\"stackSize\":%u,\"stackUsed\":%u,", stackSize, stackSize - task.stackFree);
+            response->print("\"cpu\":[");
+            for (int age = 0; age < snapshots; age++)
+            {
+                uint16_t cpu = this->profiler.get(age).cpuPermille[slot];
+                // the slot may have belonged to a task that ended before
+                if (cpu == 0xFFFF)
+                    break;
+                response->printf("%s%u", age ? "," : "", cpu);
+            }
+            response->print("]}");
+            first = false;
+        }
+        xSemaphoreGive(this->profileMutex);
+        response->print("]}");
+        request->send(response); });
+
+    // play an animated emoji (GIF name in flash or https:// URL), with decode and playback statistics
+    sprintf(uri, "%s/v1/animation", API_ENDPOINT);
+    server.on(uri, HTTP_GET, [&](AsyncWebServerRequest *request)
+              {
+        AnimationStats stats = this->animation.getStats();
+        char json[384];
+        snprintf(json, sizeof(json), "{\"animation\":\"%s\",\"active\":%s,\"decoded\":%u,\"played\":%u,\"loops\":%u,\"underruns\":%u,\"avgDecodeUs\":%u,\"maxDecodeUs\":%u}",
+                 this->animationSource, this->animationActive ? "true" : "false", stats.decoded, stats.played, stats.loops, stats.underruns,
+                 stats.avgDecodeUs, stats.maxDecodeUs);
+        request->send(200, "application/json", json); });
+    server.on(uri, HTTP_POST, [&](AsyncWebServerRequest *request)
+              {
+        ESP_LOGI(__func__,"POST %s", request->url().c_str());
+        if (!request->hasArg("animation"))
+        {
+            request->send(400, "application/json", "{\"error\": \"No animation parameter\"}");
+            return;
+        }
+        RenderCommand command = {};
+        command.fields = RENDER_ANIMATION;
+        if (strlcpy(command.animation, request->arg("animation").c_str(), sizeof(command.animation)) >= sizeof(command.animation))
+        {
+            request->send(400, "application/json", "{\"error\": \"Invalid animation\"}");
+            return;
+        }
+        this->queueRender(request, command);
+    });
+
+    // set emoji, text and brightness in one update
+    sprintf(uri, "%s/v1/render", API_ENDPOINT);
+    server.on(uri, HTTP_POST, [&](AsyncWebServerRequest *request)
+              {
+        ESP_LOGI(__func__,"POST %s", request->url().c_str());
+        RenderCommand command = {};
+        if (request->hasArg("emoji"))
+        {
+            command.fields |= RENDER_EMOJI;
+            if (strlcpy(command.emoji, request->arg("emoji").c_str(), sizeof(command.emoji)) >= sizeof(command.emoji))
+            {
+                request->send(400, "application/json", "{\"error\": \"Invalid emoji\"}");
+                return;
+            }
+        }
+        if (request->hasArg("animation"))
+        {
+            command.fields = (command.fields & ~RENDER_EMOJI) | RENDER_ANIMATION;
+            if (strlcpy(command.animation, request->arg("animation").c_str(), sizeof(command.animation)) >= sizeof(command.animation))
+            {
+                request->send(400, "application/json", "{\"error\": \"Invalid animation\"}");
+                return;
+            }
+        }
+        if (request->hasArg("text"))
+        {
+            command.fields |= RENDER_TEXT;
+            strlcpy(command.text, request->arg("text").c_str(), sizeof(command.text));
+        }
+        if (request->hasArg("brightness"))
+        {
+            command.fields |= RENDER_BRIGHTNESS;
+            command.brightness = constrain(request->arg("brightness").toInt(), 0, 255);
+        }
+        if (!command.fields)
+        {
+            request->send(400, "application/json", "{\"error\": \"No emoji, animation, text or brightness parameter\"}");
+            return;
+        }
+        this->queueRender(request, command);
+    });
+
+    // status of a queued render request
+    sprintf(uri, "%s/v1/request", API_ENDPOINT);
+    server.on(uri, HTTP_GET, [&](AsyncWebServerRequest *request)
+              {
+        uint32_t id = request->arg("id").toInt();
+        esp_err_t err = ESP_OK;
+        RenderState state = this->renderQueue.getState(id, &err);
+        if (state == RENDER_UNKNOWN)
+        {
+            request->send(404, "application/json", "{\"error\": \"Unknown request id\"}");
+            return;
+        }
+        char json[128];
+        snprintf(json, sizeof(json), "{\"id\":%u,\"state\":\"%s\",\"error\":\"%s\"}", id, RenderQueue::stateName(state), esp_err_to_name(err));
+        request->send(200, "application/json", json);
+    });
+
+    // firmware upload over the LAN (with OTA enabled): a plain, compressed or delta image as the
+    // request body, e.g. curl -H 'Content-Type: application/octet-stream' --data-binary @esp32.patch
+    // (form encoded bodies are parsed as parameters). ArduinoOTA writes straight to flash with
+    // no way in for a decoder or a signature, it keeps taking plain images.
+    sprintf(uri, "%s/v1/firmware", API_ENDPOINT);
+    server.on(uri, HTTP_POST, [&](AsyncWebServerRequest *request)
+              {
+        if (!this->panelPrefs.ota)
+        {
+            request->send(403, "application/json", "{\"error\": \"OTA updates are disabled\"}");
+            return;
+        }
+        char json[160];
+        if (this->firmwareRequest != request)
+        {
+            // never started, or rejected on the way
+            const char *error = this->firmwareStream.getError();
+            snprintf(json, sizeof(json), "{\"error\": \"%s\"}", error ? error : "Another update is running");
+            request->send(error ? 400 : 409, "application/json", json);
+            return;
+        }
+        this->firmwareRequest = NULL;
+        FirmwareFormat format = this->firmwareStream.getFormat();
+        FirmwareStreamStats stats = this->firmwareStream.getStats();
+        esp_err_t err = this->endFirmware();
+        if (err != ESP_OK)
+        {
+            const char *error = this->firmwareStream.getError();
+            snprintf(json, sizeof(json), "{\"error\": \"%s\"}", error ? error : esp_err_to_name(err));
+            request->send(400, "application/json", json);
+            return;
+        }
+        snprintf(json, sizeof(json), "{\"format\":\"%s\",\"received\":%u,\"written\":%u,\"sourceRead\":%u}",
+                 FirmwareStream::formatName(format), stats.received, stats.written, stats.sourceRead);
+        request->onDisconnect([]()
+                              { ESP.restart(); });
+        request->send(200, "application/json", json); },
+              NULL,
+              [&](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+              {
+        if (!this->panelPrefs.ota)
+            return;
+        if (!index)
+        {
+            if (!this->beginFirmware("LAN"))
+                return;
+            this->firmwareRequest = request;
+            request->onDisconnect([this, request]()
+                                  {
+                // the client went away mid upload
+                if (this->firmwareRequest == request)
+                {
+                    this->firmwareRequest = NULL;
+                    this->abortFirmware();
+                } });
+        }
+        if (this->firmwareRequest == request && !this->writeFirmware(data, len, total))
+        {
+            this->firmwareRequest = NULL;
+            this->abortFirmware();
+        } });
+
+    // the running image for panels updating from this one (peer updates), signed as it came.
+    // Peers take signed images only, so without a kept signature there is nothing to serve
+    server.on(uri, HTTP_GET, [&](AsyncWebServerRequest *request)
+              {
+        if (!this->panelPrefs.peerUpdates || !FIRMWARE_SIGNING_KEY[0])
+        {
+            request->send(403, "application/json", "{\"error\": \"Peer updates are disabled\"}");
+            return;
+        }
+        if (this->peerUploads >= PEER_UPLOADS_MAX)
+        {
+            AsyncWebServerResponse *response = request->beginResponse(503, "application/json", "{\"error\": \"Busy\"}");
+            response->addHeader("Retry-After", "30");
+            request->send(response);
+            return;
+        }
+        const esp_partition_t *running = esp_ota_get_running_partition();
+        esp_partition_pos_t position = {running->address, running->size};
+        esp_image_metadata_t metadata;
+        if (esp_image_get_metadata(&position, &metadata) != ESP_OK)
+        {
+            request->send(500, "application/json", "{\"error\": \"Unreadable image\"}");
+            return;
+        }
+        // SFS1 envelope, see firmwareSign()
+        struct
+        {
+            uint8_t data[6 + FIRMWARE_SIGNATURE_MAX];
+            size_t len;
+        } envelope = {};
+        FirmwareSignature signature;
+        if (prefs.getBytes("fwSignature", &signature, sizeof(signature)) == sizeof(signature) &&
+            !strcmp(signature.label, running->label) && signature.size <= FIRMWARE_SIGNATURE_MAX)
+            envelope.len = firmwareSign((const uint8_t *)"", 0, signature.signature, signature.size, envelope.data, sizeof(envelope.data));
+        // peers take signed images only
+        if (!envelope.len)
+        {
+            request->send(404, "application/json", "{\"error\": \"No signature for the running image\"}");
+            return;
+        }
+        size_t imageLen = metadata.image_len;
+        ESP_LOGI(__func__, "Serving %u byte signed image from %s to %s", imageLen, running->label,
+                 request->client()->remoteIP().toString().c_str());
+        AsyncWebServerResponse *response = request->beginResponse("application/octet-stream", envelope.len + imageLen,
+                                                                  [running, envelope, imageLen](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+                                                                  {
+            size_t len = 0;
+            if (index < envelope.len)
+            {
+                len = min(maxLen, envelope.len - index);
+                memcpy(buffer, &envelope.data[index], len);
+                return len;
+            }
+            index -= envelope.len;
+            len = min(maxLen, imageLen - index);
+            if (esp_partition_read(running, index, buffer, len) != ESP_OK)
+                return 0;
+            return len; });
+        this->peerUploads++;
+        request->onDisconnect([this]()
+                              { this->peerUploads--; });
+        request->send(response); });
+
+    // update source, staged rollout and peer update settings and where the panel is at
+    sprintf(uri, "%s/v1/updates", API_ENDPOINT);
+    server.on(uri, HTTP_GET, [&](AsyncWebServerRequest *request)
+              {
+        String source = prefs.getString("updateSource", UPDATE_SOURCE);
+        UpdateCheckStats stats = this->updateChecker.getStats();
+        int64_t startsIn = this->rolloutTag[0] ? this->rolloutStart - time(NULL) : 0;
+        char json[512];
+        snprintf(json, sizeof(json), "{\"source\":\"%s\",\"github\":%s,\"cohort\":%u,\"rolloutHours\":%u,\"peer\":%s,\"peerUploads\":%u,"
+                 "\"waiting\":\"%s\",\"startsIn\":%lld,\"checks\":%u,\"unchanged\":%u,\"changed\":%u,\"failures\":%u,\"lastStatus\":%d,\"nextCheckS\":%u}",
+                 source.c_str(), source.length() ? "false" : "true", this->rollout.getCohort(), this->panelPrefs.rolloutHours,
+                 this->panelPrefs.peerUpdates ? "true" : "false", this->peerUploads, this->rolloutTag, startsIn > 0 ? startsIn : 0,
+                 stats.checks, stats.unchanged, stats.changed, stats.failures, stats.lastStatus, stats.lastDelayMs / 1000);
+        request->send(200, "application/json", json); });
+    server.on(uri, HTTP_POST, [&](AsyncWebServerRequest *request)
+              {
+        ESP_LOGI(__func__,"POST %s", request->url().c_str());
+        if (request->hasArg("source"))
+        {
+            UpdateSource source;
+            String url = request->arg("source");
+            if (!parseUpdateSource(url.c_str(), &source))
+            {
+                request->send(400, "application/json", "{\"error\": \"Invalid source\"}");
+                return;
+            }
+            // read by the update task on its next check
+            prefs.putString("updateSource", url);
+        }
+        if (request->hasArg("rolloutHours"))
+        {
+            this->panelPrefs.rolloutHours = constrain(request->arg("rolloutHours").toInt(), 0, 168);
+            this->updatePrefs();
+        }
+        if (request->hasArg("peer"))
+        {
+            bool peer = request->arg("peer") == "true" || request->arg("peer") == "1";
+            if (peer && !FIRMWARE_SIGNING_KEY[0])
+            {
+                request->send(400, "application/json", "{\"error\": \"Peer updates need a FIRMWARE_SIGNING_KEY build\"}");
+                return;
+            }
+            this->setPeerUpdates(peer);
+        }
+        request->send(200, "application/json", "{\"status\": \"ok\"}"); });
+
     // redirect to docs on api root request
     server.on(API_ENDPOINT, HTTP_GET, [&](AsyncWebServerRequest *request)
               { request->redirect("https://github.com/elliotmatson/LED_Cube"); });
@@ -367,7 +1235,47 @@ void Panel::setBrightness(uint8_t brightness)
 {
     this->panelPrefs.brightness = brightness;
     this->updatePrefs();
+    xSemaphoreTake(displayMutex, portMAX_DELAY);
     dma_display->setBrightness8(brightness);
+    xSemaphoreGive(displayMutex);
+    // dithering follows the bit planes the new brightness leaves visible
+    this->applyColor();
+}
+
+// set gamma (tenths), white balance and dithering, persisted and applied from the next commit
+void Panel::setColor(uint8_t gamma, const uint8_t whiteBalance[3], bool dither, bool temporal)
+{
+    panelPrefs.gamma = constrain(gamma, COLOR_GAMMA_MIN, COLOR_GAMMA_MAX);
+    memcpy(panelPrefs.whiteBalance, whiteBalance, sizeof(panelPrefs.whiteBalance));
+    panelPrefs.dither = dither;
+    panelPrefs.temporalDither = temporal;
+    this->updatePrefs();
+    this->applyColor();
+}
+
+// color pipeline from the preferences and the depth the driver runs at, call with the display mutex held
+ColorSettings Panel::colorSettings()
+{
+    ColorSettings settings = {};
+    settings.gamma = panelPrefs.gamma;
+    memcpy(settings.whiteBalance, panelPrefs.whiteBalance, sizeof(settings.whiteBalance));
+    settings.dither = panelPrefs.dither;
+    settings.temporal = panelPrefs.temporalDither;
+    settings.depthBits = dma_display->getCfg().getPixelColorDepthBits();
+    return settings;
+}
+
+// rebuild the color tables from the preferences and brightness, then redraw with them
+void Panel::applyColor()
+{
+    xSemaphoreTake(displayMutex, portMAX_DELAY);
+    display.setColor(colorSettings(), panelPrefs.brightness);
+    display.commit();
+    ditherActive = display.isTemporal();
+    xSemaphoreGive(displayMutex);
+    // the dither task is not running yet while initDisplay sets the brightness
+    if (ditherActive && ditherTask)
+        xTaskNotifyGive(ditherTask);
 }
 
 // get brightness of display
@@ -395,37 +1303,48 @@ void Panel::setOTA(bool ota)
 
                     // NOTE: if updating SPIFFS this would be the place to unmount SPIFFS using SPIFFS.end()
                     ESP_LOGI(__func__,"Start updating %s", type.c_str());
-                    dma_display->fillScreenRGB888(0, 0, 0);
-                    dma_display->setFont(NULL);
-                    dma_display->setCursor(6, 21);
-                    dma_display->setTextColor(0xFFFF);
-                    dma_display->setTextSize(3);
-                    dma_display->print("OTA"); })
+                    this->otaCookieChecked = false;
+                    // espota has no room for a signature, signed images come by POST /api/v1/firmware
+                    if (this->panelPrefs.signedFWOnly && FIRMWARE_SIGNING_KEY[0] && ArduinoOTA.getCommand() == U_FLASH)
+                    {
+                        ESP_LOGE(__func__, "Signed firmware only, ArduinoOTA images are unsigned");
+                        Update.abort();
+                        return;
+                    }
+                    this->stopMarquee();
+                    this->stopAnimation();
+                    xSemaphoreTake(displayMutex, portMAX_DELAY);
+                    display.drawBanner("OTA");
+                    display.commit();
+                    xSemaphoreGive(displayMutex); })
             .onEnd([&]()
                    {
                     ESP_LOGI(__func__,"End"); 
+                    xSemaphoreTake(displayMutex, portMAX_DELAY);
                     for(int i = getBrightness(); i > 0; i=i-3) {
                         dma_display->setBrightness8(max(i, 0));
-                    } })
+                    }
+                    xSemaphoreGive(displayMutex); })
             .onProgress([&](unsigned int progress, unsigned int total)
                         { 
                     this->dashboard.sendUpdates();
                     ESP_LOGI(__func__,"Progress: %u%%\r", (progress / (total / 100)));
 
-                    if (this->panelPrefs.signedFWOnly && progress == total)
+                    // Update writes a sector at a time, the cookie is in flash once the first one is
+                    if (this->panelPrefs.signedFWOnly && ArduinoOTA.getCommand() == U_FLASH && !this->otaCookieChecked &&
+                        (progress >= SPI_FLASH_SEC_SIZE || progress == total))
                     {
                         PanelPartition newPanelPartition;
-                        esp_partition_read(esp_ota_get_next_update_partition(NULL), sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t), &newPanelPartition, sizeof(newPanelPartition));
-                        ESP_LOGI(__func__,"Checking for Panel FW Signature: \nNew:%s\nold:%s", newPanelPartition.cookie, panelPartition.cookie);
-                        if (strcmp(newPanelPartition.cookie, panelPartition.cookie))
+                        esp_partition_read(esp_ota_get_next_update_partition(NULL), FIRMWARE_COOKIE_OFFSET, &newPanelPartition.cookie, sizeof(newPanelPartition.cookie));
+                        ESP_LOGI(__func__,"Checking for Panel FW Signature after %u bytes: \nNew:%.32s\nold:%s", progress, newPanelPartition.cookie, panelPartition.cookie);
+                        if (strncmp(newPanelPartition.cookie, panelPartition.cookie, sizeof(newPanelPartition.cookie)))
                             Update.abort();
+                        this->otaCookieChecked = true;
                     }
-                    // Draw a progress bar on edges of the display
-                    int i = map(progress, 0, total, 0, 256);
-                    dma_display->drawFastHLine(0, 0, constrain(i, 0, 63), 0xFFFF);
-                    dma_display->drawFastVLine(63, 0, constrain(i - 64, 0, 63), 0xFFFF);
-                    dma_display->drawFastHLine(63 - constrain(i - 128, 0, 63), 63, constrain(i - 128, 0, 63), 0xFFFF);
-                    dma_display->drawFastVLine(0, 63 - constrain(i - 192, 0, 63), constrain(i - 192, 0, 63), 0xFFFF);
+                    xSemaphoreTake(displayMutex, portMAX_DELAY);
+                    display.drawProgress(progress, total);
+                    display.commit();
+                    xSemaphoreGive(displayMutex);
                     
                      })
             .onError([&](ota_error_t error)
@@ -442,7 +1361,7 @@ void Panel::setOTA(bool ota)
         xTaskCreate(
             [](void* o){ static_cast<Panel*>(o)->checkForOTA(); }, // This is disgusting, but it works
             "Check For OTA", // Name of the task (for debugging)
-            6000,            // Stack size (bytes)
+            OTA_STACK,       // Stack size (bytes)
             this,            // Parameter to pass
             5,               // Task priority
             &checkForOTATask // Task handle
@@ -470,51 +1389,15 @@ void Panel::setGHUpdate(bool github)
     this->updatePrefs();
     if(github) {
         ESP_LOGI(__func__,"Github Update enabled...");
-        httpUpdate.onStart([&]()
-                           {
-            ESP_LOGI(__func__,"Start updating");
-            dma_display->fillScreenRGB888(0, 0, 0);
-            dma_display->setFont(NULL);
-            dma_display->setCursor(6, 21);
-            dma_display->setTextColor(0xFFFF);
-            dma_display->setTextSize(3);
-            dma_display->print("GHA"); });
-        httpUpdate.onEnd([&]()
-        { 
-            ESP_LOGI(__func__,"End"); 
-            for(int i = getBrightness(); i > 0; i=i-3) {
-                dma_display->setBrightness8(max(i, 0));
-            }
-        });
-        httpUpdate.onProgress([&](unsigned int progress, unsigned int total)
-                              { 
-            ESP_LOGI(__func__,"Progress: %u%%\r", (progress / (total / 100)));
-
-            if (this->panelPrefs.signedFWOnly && progress == total)
-            {
-                PanelPartition newPanelPartition;
-                esp_partition_read(esp_ota_get_next_update_partition(NULL), sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t), &newPanelPartition, sizeof(newPanelPartition));
-                ESP_LOGI(__func__,"Checking for Panel FW Signature: \nNew:%s\nold:%s", newPanelPartition.cookie, panelPartition.cookie);
-                if (strcmp(newPanelPartition.cookie, panelPartition.cookie))
-                    Update.abort();
-            }
-
-            // Draw a progress bar on edges of the display
-            int i = map(progress, 0, total, 0, 256);
-            dma_display->drawFastHLine(0, 0, constrain(i, 0, 63), 0xFFFF);
-            dma_display->drawFastVLine(63, 0, constrain(i - 64, 0, 63), 0xFFFF);
-            dma_display->drawFastHLine(63 - constrain(i - 128, 0, 63), 63, constrain(i - 128, 0, 63), 0xFFFF);
-            dma_display->drawFastVLine(0, 63 - constrain(i - 192, 0, 63), constrain(i - 192, 0, 63), 0xFFFF);
-        });
-            xTaskCreate(
-                [](void *o)
-                { static_cast<Panel *>(o)->checkForUpdates(); }, // This is disgusting, but it works
-                "Check For Updates",                             // Name of the task (for debugging)
-                8000,                                            // Stack size (bytes)
-                this,                                            // Parameter to pass
-                5,                                               // Task priority
-                &checkForUpdatesTask                             // Task handle
-            );
+        xTaskCreate(
+            [](void *o)
+            { static_cast<Panel *>(o)->checkForUpdates(); }, // This is disgusting, but it works
+            "Check For Updates",                             // Name of the task (for debugging)
+            UPDATES_STACK,                                   // Stack size (bytes)
+            this,                                            // Parameter to pass
+            5,                                               // Task priority
+            &checkForUpdatesTask                             // Task handle
+        );
     } else {
         ESP_LOGI(__func__,"Github Updates Disabled");
         if(checkForUpdatesTask) {
@@ -537,6 +1420,31 @@ void Panel::setSignedFWOnly(bool signedFWOnly)
     this->updatePrefs();
 }
 
+// set peer updates, which stay off without FIRMWARE_SIGNING_KEY: peer images come over
+// plain HTTP from whoever announces one, only the signature makes them trustworthy
+void Panel::setPeerUpdates(bool peerUpdates)
+{
+    if (peerUpdates && !FIRMWARE_SIGNING_KEY[0])
+    {
+        ESP_LOGW(__func__, "Peer updates need FIRMWARE_SIGNING_KEY");
+        peerUpdates = false;
+    }
+    panelPrefs.peerUpdates = peerUpdates;
+    this->updatePrefs();
+    advertisePeer();
+}
+
+// Announce the running release to panels looking for it, with peer updates on. Development
+// builds are no release anyone looks for.
+void Panel::advertisePeer()
+{
+    mdns_service_remove("_" PEER_SERVICE, "_tcp");
+    if (!panelPrefs.peerUpdates || !FIRMWARE_SIGNING_KEY[0] || !strcmp(FW_VERSION, "DEV"))
+        return;
+    MDNS.addService(PEER_SERVICE, "tcp", 80);
+    MDNS.addServiceTxt(PEER_SERVICE, "tcp", "version", FW_VERSION);
+}
+
 // update preferences stored in NVS
 void Panel::updatePrefs()
 {
@@ -547,20 +1455,19 @@ void Panel::updatePrefs()
 // shows debug info on display
 void Panel::showDebug()
 {
-    dma_display->fillScreenRGB888(0, 0, 0);
-    dma_display->setCursor(0, 0);
-    dma_display->setTextColor(0xFFFF);
-    dma_display->setTextSize(1);
-    dma_display->printf("%s\nH%s\nS%s\nSN: %s\nH: %d\nP: %d",
-                        WiFi.localIP().toString().c_str(),
-                        prefs.getString("HW").c_str(),
-                        FW_VERSION,
-                        serial.c_str(),
-                        ESP.getFreeHeap(),
-                        ESP.getFreePsram());
+    char message[160];
+    snprintf(message, sizeof(message), "%s\nH%s\nS%s\nSN: %s\nH: %d\nP: %d",
+             WiFi.localIP().toString().c_str(),
+             prefs.getString("HW").c_str(),
+             FW_VERSION,
+             serial.c_str(),
+             ESP.getFreeHeap(),
+             ESP.getFreePsram());
+    display.drawMessage(message);
+    display.commit();
 }
 
-// shows coordinates on display for debugging
+// shows coordinates on display for debugging, draws straight to the DMA buffer
 void Panel::showCoordinates() {
     dma_display->fillScreenRGB888(0, 0, 0);
     dma_display->setTextColor(RED);
@@ -597,9 +1504,12 @@ void Panel::showCoordinates() {
     dma_display->printf("%d,%d", 127, 63);
     dma_display->setCursor(156, 47);
     dma_display->printf("%d,%d", 191, 63);
+    dma_display->flipDMABuffer();
+    display.invalidate();
 }
 
-// Show a basic test sequence for testing panels
+// Show a basic test sequence for testing panels, draws straight to the DMA buffer.
+// Only meaningful with double_buff disabled in initDisplay.
 void Panel::showTestSequence()
 {
   dma_display->fillScreenRGB888(255, 0, 0);
@@ -646,87 +1556,296 @@ void Panel::showTestSequence()
   }
 }
 
-// Task to check for updates
+// Task to check for updates: a conditional request on the release feed of GitHub or the
+// mirror set (the latest release, or all releases in development mode) and only when that
+// changed, a look at the firmware itself. Validators are kept in NVS, so a reboot does not
+// start over. The feed is scanned as it streams in, however many releases it lists. A new
+// release is taken at this panel's turn in the rollout, the feed is read again then.
 void Panel::checkForUpdates()
 {
+    // GitHub rejects API requests without a User-Agent
+    updateSession.setHeaders("User-Agent: " HOSTNAME "/" FW_VERSION "\r\nAccept: application/vnd.github+json\r\n");
+    UpdateCache cache = {};
+    if (prefs.getBytesLength("updateCache") == sizeof(cache))
+        prefs.getBytes("updateCache", &cache, sizeof(cache));
+    updateChecker.setCache(cache);
+    updateChecker.seed(esp_random());
     for (;;)
     {
-        HTTPClient http;
-        WiFiClientSecure client;
-        client.setCACertBundle(rootca_crt_bundle_start);
-
-        String firmwareUrl = "";
-        ESP_LOGI(__func__,"Branch = %s", this->panelPrefs.development ? "development" : "main");
-        String boardFile = "/esp32.bin";
-        if(this->panelPrefs.development) {
-            // https://api.github.com/repos/elliotmatson/LED_Cube/releases
-            String jsonUrl = String("https://api.github.com/repos/") + REPO_URL + String("/releases");
-            ESP_LOGI(__func__,"%s", jsonUrl.c_str());
-            http.useHTTP10(true);
-            if (http.begin(client, jsonUrl)) {
-                SpiRamJsonDocument filter(200);
-                filter[0]["name"] = true;
-                filter[0]["prerelease"] = true;
-                filter[0]["assets"] = true;
-                filter[0]["published_at"] = true;
-                http.GET();
-                SpiRamJsonDocument doc(4096);
-                deserializeJson(doc, http.getStream(), DeserializationOption::Filter(filter));
-                JsonArray releases = doc.as<JsonArray>();
-                int newestPrereleaseIndex = -1;
-                String newestPrereleaseDate = "";
-                for (int i=0; i<releases.size(); i++)
-                {
-                    JsonObject release = releases[i].as<JsonObject>();
-                    if (release["prerelease"].as<bool>() && release["published_at"].as<String>() > newestPrereleaseDate)
-                    {
-                        newestPrereleaseIndex = i;
-                        newestPrereleaseDate = release["published_at"].as<String>();
-                    }
-                }
-                JsonObject newestPrerelease = releases[newestPrereleaseIndex].as<JsonObject>();
-                ESP_LOGI(__func__,"Newest Prerelease: %s  date:%s", newestPrerelease["name"].as<String>().c_str(), newestPrerelease["published_at"].as<String>().c_str());
-                // https://github.com/elliotmatson/LED_Cube/releases/download/v0.2.3/esp32.bin
-                firmwareUrl = String("https://github.com/") + REPO_URL + String("/releases/download/") + newestPrerelease["name"].as<String>() + boardFile;
-                http.end();
-            }
-        } else {
-            firmwareUrl = String("https://github.com/") + REPO_URL + String("/releases/latest/download/") + boardFile;
+        UpdateSource source;
+        String url = prefs.getString("updateSource", UPDATE_SOURCE);
+        if (!parseUpdateSource(url.c_str(), &source))
+        {
+            ESP_LOGE(__func__, "Bad update source %s, using GitHub", url.c_str());
+            parseUpdateSource("", &source);
         }
-        ESP_LOGI(__func__,"%s", firmwareUrl.c_str());
-
-        if (http.begin(client, firmwareUrl) && firmwareUrl != "") {
-            int httpCode = http.sendRequest("HEAD");
-            if (httpCode < 300 || httpCode > 400 || (http.getLocation().indexOf(String(FW_VERSION)) > 0) || (firmwareUrl.indexOf(String(FW_VERSION)) > 0))
+        updateSession.setTransport(source.tls ? (TlsTransport &)updateTransport : updateLanTransport);
+        updateSession.setHost(source.host, source.port);
+        // the whole MAC, serial is its low half, the vendor part every panel shares
+        char panelId[17];
+        snprintf(panelId, sizeof(panelId), "%012llx", ESP.getEfuseMac());
+        rollout.begin(panelId, this->panelPrefs.rolloutHours * 3600, ROLLOUT_START_WINDOW);
+
+        char path[UPDATE_PATH_MAX];
+        updateFeedPath(source, REPO_URL, this->panelPrefs.development, path, sizeof(path));
+        releaseFeed.reset(this->panelPrefs.development, UPDATE_ASSET);
+        UpdateCheckResult result = updateChecker.check(path, &releaseFeed);
+        uint32_t waitS = 0;
+        if (result == UPDATE_CHANGED)
+        {
+            ReleaseInfo release;
+            if (!releaseFeed.finished())
             {
-                ESP_LOGI(__func__,"Not updating from (sc=%d): %s", httpCode, http.getLocation().c_str());
-                http.end();
+                ESP_LOGE(__func__, "Release feed unreadable: %s", releaseFeed.getError() ? releaseFeed.getError() : "truncated");
+                result = UPDATE_FAILED;
             }
-            else
+            else if (!releaseFeed.getRelease(&release))
+                ESP_LOGI(__func__, "None of %u releases has %s", releaseFeed.getReleases(), UPDATE_ASSET);
+            else if (!strcmp(release.tag, FW_VERSION))
+                ESP_LOGI(__func__, "Running the newest release %s", release.tag);
+            // development panels take prereleases as they come
+            else if (!this->panelPrefs.development && (waitS = rollout.wait(release.tag, release.publishedAt, time(NULL))))
             {
-                ESP_LOGI(__func__,"Updating from (sc=%d): %s", httpCode, http.getLocation().c_str());
+                snprintf(rolloutTag, sizeof(rolloutTag), "%s", release.tag);
+                rolloutStart = rollout.startTime(release.tag, release.publishedAt);
+                ESP_LOGI(__func__, "%s reaches cohort %u in %u s", release.tag, rollout.getCohort(), waitS);
+                // not acted on, the validators are not taken
+                result = UPDATE_UNCHANGED;
+            }
+            else if (updateRelease(source, release.tag) != ESP_OK)
+                result = UPDATE_FAILED;
+        }
+        if (!waitS)
+            rolloutTag[0] = '\0';
+        uint32_t delayMs = updateChecker.done(result);
+        // nothing until the next check, the TLS context is freed and the session ticket makes
+        // the next handshake a resumed one
+        updateSession.close();
+        if (updateChecker.takeCacheChanged())
+            prefs.putBytes("updateCache", &updateChecker.getCache(), sizeof(UpdateCache));
+        // a newer release may come meanwhile, look at least hourly
+        if (waitS > delayMs / 1000)
+            delayMs = min(waitS, (uint32_t)CHECK_FOR_UPDATES_BACKOFF_MAX) * 1000;
+        ESP_LOGI(__func__, "Next update check in %u s", delayMs / 1000);
+        vTaskDelay(pdMS_TO_TICKS(delayMs));
+    }
+}
 
-                httpUpdate.setFollowRedirects(HTTPC_FORCE_FOLLOW_REDIRECTS);
-                t_httpUpdate_return ret = httpUpdate.update(client, firmwareUrl);
+// Update to the release tagged tag and reboot: from a panel on the LAN already running it
+// with peer updates on, otherwise the smallest form attached to the release at the source,
+// a delta from the running release, the compressed image, the image.
+esp_err_t Panel::updateRelease(const UpdateSource &source, const char *tag)
+{
+    if (this->panelPrefs.peerUpdates && updateFromPeers(tag) == ESP_OK)
+    {
+        ESP_LOGI(__func__, "Updated to %s from a peer, rebooting", tag);
+        ESP.restart();
+    }
+    char patchAsset[RELEASE_TAG_MAX + 16];
+    snprintf(patchAsset, sizeof(patchAsset), UPDATE_ASSET_PATCH, FW_VERSION);
+    // development builds are not releases, nothing was diffed against them
+    const char *assets[] = {strcmp(FW_VERSION, "DEV") ? patchAsset : NULL, UPDATE_ASSET_COMPRESSED, UPDATE_ASSET};
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    for (const char *asset : assets)
+    {
+        if (!asset)
+            continue;
+        // https://github.com/elliotmatson/LED_Cube/releases/download/v0.2.3/esp32.bin
+        char firmwareUrl[UPDATE_URL_MAX];
+        if (!updateAssetUrl(source, REPO_URL, tag, asset, firmwareUrl, sizeof(firmwareUrl)))
+            return ESP_ERR_INVALID_SIZE;
+        err = downloadFirmware(firmwareUrl, source.github ? "GHA" : "LAN");
+        if (err == ESP_OK)
+        {
+            ESP_LOGI(__func__, "Updated to %s, rebooting", tag);
+            ESP.restart();
+        }
+        // a patch may not fit a build flashed by hand, the full image still does
+        if (err != ESP_ERR_NOT_FOUND && asset != patchAsset)
+            break;
+    }
+    return err;
+}
 
-                switch (ret)
-                {
-                case HTTP_UPDATE_FAILED:
-                    ESP_LOGE(__func__,"Http Update Failed (Error=%d): %s", httpUpdate.getLastError(), httpUpdate.getLastErrorString().c_str());
-                    break;
+// Fetch the image of release tag from panels on the LAN that announce exactly that release,
+// starting at a random one so the first to update are not asked by everyone. A busy peer
+// answers 503 and the next is asked, after PEER_TRIES it is left to the source. Anyone on
+// the LAN can announce anything, so only images signed with FIRMWARE_SIGNING_KEY are taken.
+esp_err_t Panel::updateFromPeers(const char *tag)
+{
+    if (!FIRMWARE_SIGNING_KEY[0])
+        return ESP_ERR_NOT_SUPPORTED;
+    int peers = MDNS.queryService(PEER_SERVICE, "tcp");
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    int first = peers > 0 ? esp_random() % peers : 0;
+    for (int i = 0, tries = 0; i < peers && tries < PEER_TRIES; i++)
+    {
+        int peer = (first + i) % peers;
+        String version = MDNS.txt(peer, "version");
+        // an older release would be installed, and the newer one fetched from it again
+        if (strcmp(version.c_str(), tag))
+            continue;
+        tries++;
+        char url[64];
+        snprintf(url, sizeof(url), "http://%s:%u/api/v1/firmware", MDNS.IP(peer).toString().c_str(), MDNS.port(peer));
+        err = downloadFirmware(url, "LAN", true);
+        if (err == ESP_OK)
+            return ESP_OK;
+    }
+    ESP_LOGI(__func__, "%d peers, none had %s to give", peers > 0 ? peers : 0, tag);
+    return err;
+}
 
-                case HTTP_UPDATE_NO_UPDATES:
-                    ESP_LOGI(__func__,"No Update!");
-                    break;
+// Stream the firmware at url into the OTA partition, ESP_ERR_NOT_FOUND if there is none.
+// label is shown on the panel meanwhile, signedOnly as for beginFirmware.
+esp_err_t Panel::downloadFirmware(const char *url, const char *label, bool signedOnly)
+{
+    WiFiClient client;
+    WiFiClientSecure secureClient;
+    secureClient.setCACertBundle(rootca_crt_bundle_start);
+    HTTPClient http;
+    http.setFollowRedirects(HTTPC_FORCE_FOLLOW_REDIRECTS);
+    if (!http.begin(strncmp(url, "https://", 8) ? client : secureClient, url))
+        return ESP_ERR_INVALID_ARG;
+    int code = http.GET();
+    if (code != HTTP_CODE_OK)
+    {
+        ESP_LOGI(__func__, "%s: %d", url, code);
+        http.end();
+        return code == HTTP_CODE_NOT_FOUND ? ESP_ERR_NOT_FOUND : ESP_ERR_INVALID_RESPONSE;
+    }
+    if (!beginFirmware(label, signedOnly))
+    {
+        http.end();
+        return ESP_ERR_INVALID_STATE;
+    }
+    ESP_LOGI(__func__, "Updating from %s", url);
+    int total = http.getSize(); // -1 when chunked
+    FirmwareWriter writer([&](const uint8_t *data, size_t len)
+                          { return this->writeFirmware(data, len, total > 0 ? total : 0); });
+    int written = http.writeToStream(&writer);
+    http.end();
+    if (written < 0 || (total > 0 && written != total))
+    {
+        ESP_LOGE(__func__, "Download failed after %u bytes (%d)", firmwareStream.getStats().received, written);
+        abortFirmware();
+        return ESP_FAIL;
+    }
+    return endFirmware();
+}
 
-                case HTTP_UPDATE_OK:
-                    ESP_LOGI(__func__,"Update OK!");
-                    break;
-                }
-            }
+// Start taking a firmware stream, false if another update is running. signedOnly requires
+// a FIRMWARE_SIGNING_KEY signature whatever "Signed FW only" is set to, false without a key.
+bool Panel::beginFirmware(const char *label, bool signedOnly)
+{
+    if (signedOnly && !FIRMWARE_SIGNING_KEY[0])
+    {
+        ESP_LOGE(__func__, "No FIRMWARE_SIGNING_KEY to check the image from %s with", label);
+        return false;
+    }
+    if (xSemaphoreTake(firmwareMutex, 0) != pdTRUE)
+    {
+        ESP_LOGW(__func__, "Another update is running");
+        return false;
+    }
+    if (!firmwareStream.begin())
+    {
+        xSemaphoreGive(firmwareMutex);
+        return false;
+    }
+    firmwareStream.reset(&otaPartition, &runningPartition);
+    // checked on the bytes as they are decoded, before any reach flash
+    if (this->panelPrefs.signedFWOnly || signedOnly)
+        firmwareStream.require(panelPartition.cookie, FIRMWARE_SIGNING_KEY[0] ? &firmwareVerifier : NULL);
+    firmwareActive = true;
+    firmwareProgress = -1;
+    ESP_LOGI(__func__, "Start updating (%s)", label);
+    this->stopMarquee();
+    this->stopAnimation();
+    xSemaphoreTake(displayMutex, portMAX_DELAY);
+    display.drawBanner(label);
+    display.commit();
+    xSemaphoreGive(displayMutex);
+    return true;
+}
+
+// Feed the next piece of the stream, total is its length if known. False once it is rejected.
+bool Panel::writeFirmware(const uint8_t *data, size_t len, size_t total)
+{
+    if (!firmwareStream.write(data, len))
+    {
+        ESP_LOGE(__func__, "Firmware rejected after %u bytes: %s", firmwareStream.getStats().received,
+                 firmwareStream.getError() ? firmwareStream.getError() : "write failed");
+        return false;
+    }
+    if (!total)
+        return true;
+    int progress = (uint64_t)firmwareStream.getStats().received * 100 / total;
+    if (progress != firmwareProgress)
+    {
+        firmwareProgress = progress;
+        ESP_LOGI(__func__, "Progress: %d%% (%s)", progress, FirmwareStream::formatName(firmwareStream.getFormat()));
+        xSemaphoreTake(displayMutex, portMAX_DELAY);
+        display.drawProgress(progress, 100);
+        display.commit();
+        xSemaphoreGive(displayMutex);
+    }
+    return true;
+}
+
+// Check and activate the image after the last byte, the caller reboots on ESP_OK
+esp_err_t Panel::endFirmware()
+{
+    if (!firmwareActive)
+        return ESP_ERR_INVALID_STATE;
+    esp_err_t err = ESP_OK;
+    // also where the signature is checked, nothing boots without it
+    if (!firmwareStream.finish())
+    {
+        ESP_LOGE(__func__, "Firmware not accepted: %s", firmwareStream.getError());
+        err = firmwareStream.isSigned() || this->panelPrefs.signedFWOnly ? ESP_ERR_INVALID_VERSION : ESP_ERR_INVALID_SIZE;
+    }
+    if (err == ESP_OK)
+        err = otaPartition.end();
+    else
+        otaPartition.abort();
+    // passed on to peers with the image, once it runs
+    if (err == ESP_OK && firmwareStream.isSigned())
+    {
+        FirmwareSignature signature = {};
+        snprintf(signature.label, sizeof(signature.label), "%s", otaPartition.getPartition()->label);
+        signature.size = firmwareStream.getSignatureSize();
+        memcpy(signature.signature, firmwareStream.getSignature(), signature.size);
+        prefs.putBytes("fwSignature", &signature, sizeof(signature));
+    }
+    else if (err == ESP_OK)
+        prefs.remove("fwSignature");
+    FirmwareStreamStats stats = firmwareStream.getStats();
+    ESP_LOGI(__func__, "%s %s: %u bytes received, %u byte image, %u bytes read from the running image",
+             err == ESP_OK ? "Installed" : "Discarded", FirmwareStream::formatName(firmwareStream.getFormat()), stats.received,
+             stats.written, stats.sourceRead);
+    firmwareStream.end();
+    firmwareActive = false;
+    xSemaphoreGive(firmwareMutex);
+    if (err == ESP_OK)
+    {
+        xSemaphoreTake(displayMutex, portMAX_DELAY);
+        for(int i = getBrightness(); i > 0; i=i-3) {
+            dma_display->setBrightness8(max(i, 0));
         }
-        vTaskDelay((CHECK_FOR_UPDATES_INTERVAL * 1000) / portTICK_PERIOD_MS);
+        xSemaphoreGive(displayMutex);
     }
+    return err;
+}
+
+void Panel::abortFirmware()
+{
+    if (!firmwareActive)
+        return;
+    otaPartition.abort();
+    firmwareStream.end();
+    firmwareActive = false;
+    xSemaphoreGive(firmwareMutex);
 }
 
 // Task to handle OTA updates
@@ -744,189 +1863,580 @@ void Panel::printMem()
     for (;;) {
         ESP_LOGI(__func__, "Free Heap: %d / %d, Used PSRAM: %d / %d", ESP.getFreeHeap(), ESP.getHeapSize(), heap_caps_get_total_size(MALLOC_CAP_SPIRAM) - heap_caps_get_free_size(MALLOC_CAP_SPIRAM), heap_caps_get_total_size(MALLOC_CAP_SPIRAM));
         ESP_LOGI(__func__, "Largest free block in Heap: %d, PSRAM: %d", ESP.getMaxAllocHeap(), heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
-        /*char *buf = new char[2048];
-        vTaskGetRunTimeStats(buf);
-        Serial.println(buf);
-        delete[] buf;
-        buf = new char[2048];
-        vTaskList(buf);
-        Serial.println(buf);
-        delete[] buf;*/
-        vTaskDelay(10000 / portTICK_PERIOD_MS);
+        HeapRegion internal = {heap_caps_get_free_size(MALLOC_CAP_INTERNAL), heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL), 0};
+        HeapRegion spiram = {heap_caps_get_free_size(MALLOC_CAP_SPIRAM), heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM), 0};
+        xSemaphoreTake(heapMutex, portMAX_DELAY);
+        heapHistory.sample(esp_timer_get_time(), internal, spiram);
+        const HeapSnapshot &snapshot = heapHistory.get(0);
+        ESP_LOGI(__func__, "Fragmentation (per mille) Heap: %u, PSRAM: %u", snapshot.internal.fragmentation, snapshot.spiram.fragmentation);
+        xSemaphoreGive(heapMutex);
+        for (int tag = 0; tag < HEAP_TAGS; tag++)
+        {
+            HeapTagStats stats = heapTagStats((HeapTag)tag);
+            ESP_LOGI(__func__, "%-9s live %u, peak %u, %u allocs, %u frees, %u failed", heapTagName((HeapTag)tag), stats.live, stats.peak, stats.allocs, stats.frees, stats.failures);
+        }
+        vTaskDelay(HEAP_SAMPLE_INTERVAL_MS / portTICK_PERIOD_MS);
     }
 }
 
-esp_err_t Panel::setEmoji(const char *emoji)
+// Profiler task: every PROFILE_INTERVAL_MS, snapshot the CPU load and stack high water mark
+// of every task into the profiler ring, for GET /api/v1/tasks and the Tasks tab. Reads the
+// scheduler into fixed arrays, nothing is allocated per sample.
+void Panel::profile()
 {
-    esp_err_t err = ESP_OK;
-    ESP_LOGI(__func__, "Emoji Input: %s", emoji);
-    // print emoji as hex
-    for (int i = 0; i < strlen(emoji); i++)
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+    TickType_t wake = xTaskGetTickCount();
+    for (;;)
     {
-        ESP_LOGI(__func__, "0x%02X ", emoji[i]);
+        uint32_t totalRuntime = 0;
+        // 0 when the array is too small for all tasks
+        UBaseType_t count = uxTaskGetSystemState(profileStatus, PROFILE_STATUS_MAX, &totalRuntime);
+        if (!count)
+            ESP_LOGW(__func__, "%u tasks, only %u fit in a sample", uxTaskGetNumberOfTasks(), PROFILE_STATUS_MAX);
+        for (UBaseType_t i = 0; i < count; i++)
+        {
+            TaskSample &sample = profileSamples[i];
+            sample.name = profileStatus[i].pcTaskName;
+            sample.id = profileStatus[i].xTaskNumber;
+            sample.runtime = profileStatus[i].ulRunTimeCounter;
+            sample.stackFree = profileStatus[i].usStackHighWaterMark; // bytes on ESP-IDF
+            sample.priority = profileStatus[i].uxCurrentPriority;
+        }
+        xSemaphoreTake(profileMutex, portMAX_DELAY);
+        profiler.sample(esp_timer_get_time(), profileSamples, count, totalRuntime);
+        xSemaphoreGive(profileMutex);
+        updateTaskCharts();
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(PROFILE_INTERVAL_MS));
     }
-    dma_display->fillRect(0, 0, 64, 32, BLACK);
+#else
+    ESP_LOGW(__func__, "Task profiling needs CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS");
+    profileTask = NULL;
+    vTaskDelete(NULL);
+#endif
+}
 
-    uint8_t len = strlen(emoji);
-    // detect utf-8 encoding, and convert to code points
-    if ((uint8_t)emoji[0] > 0x7F)
+// Show the newest snapshot on the Tasks tab. The names are copied into the chart buffers
+// only when the task list changes, and updates are sent only when something changed and a
+// browser is connected; a new one gets the current charts with the layout.
+void Panel::updateTaskCharts()
+{
+    bool namesChanged = false;
+    bool valuesChanged = false;
+    size_t count = 0;
+    xSemaphoreTake(profileMutex, portMAX_DELAY);
+    const ProfileSnapshot &snapshot = profiler.get(0);
+    for (int slot = 0; slot < PROFILE_TASKS_MAX; slot++)
     {
-        // count code points in string
-        uint8_t codepointCount = 0;
-        for (int i = 0; i < len; i++)
+        const ProfiledTask &task = profiler.getTask(slot);
+        if (!task.alive)
+            continue;
+        if (strcmp(chartNames[count], task.name))
         {
-            if ((uint8_t)emoji[i] >= 0xC0 && (uint8_t)emoji[i] <= 0xDF)
-            {
-                i++;
-            }
-            else if ((uint8_t)emoji[i] >= 0xE0 && (uint8_t)emoji[i] <= 0xEF)
-            {
-                i += 2;
-            }
-            else if ((uint8_t)emoji[i] >= 0xF0 && (uint8_t)emoji[i] <= 0xF7)
-            {
-                i += 3;
-            }
-            codepointCount++;
+            strlcpy(chartNames[count], task.name, sizeof(chartNames[count]));
+            namesChanged = true;
+        }
+        float cpu = snapshot.cpuPermille[slot] / 10.0f;
+        if (chartCpu[count] != cpu || chartStack[count] != (int)task.stackFree)
+        {
+            chartCpu[count] = cpu;
+            chartStack[count] = task.stackFree;
+            valuesChanged = true;
         }
-        ESP_LOGI(__func__, "Codepoint Count: %d", codepointCount);
+        count++;
+    }
+    xSemaphoreGive(profileMutex);
+    if (count != chartCount)
+    {
+        chartCount = count;
+        namesChanged = true;
+    }
+    if (namesChanged)
+    {
+        cpuChart.updateX(chartNameList, count);
+        stackChart.updateX(chartNameList, count);
+    }
+    if (namesChanged || valuesChanged)
+    {
+        cpuChart.updateY(chartCpu, count);
+        stackChart.updateY(chartStack, count);
+        if (dashboard.hasClient())
+            dashboard.sendUpdates();
+    }
+}
 
-        // convert utf-8 to code points
-        uint32_t codepoints[codepointCount];
-        uint8_t codepointIndex = 0;
-        for (int i = 0; i < len; i++)
+// Drop origin connections nothing was fetched over for a while, each holds a TLS context of
+// tens of KB (see GET /api/v1/heap). Runs on the render task, which starts every download.
+void Panel::closeIdleSessions()
+{
+    // shared with the prefetch task
+    xSemaphoreTake(emojiMutex, portMAX_DELAY);
+    emojiSession.closeIfIdle();
+    xSemaphoreGive(emojiMutex);
+    // only the animation task fetches over it, and only the render task starts that
+    if (!animationTask)
+        animationSession.closeIfIdle();
+}
+
+// Task applying queued status updates, keeps slow emoji downloads out of the web server
+void Panel::render()
+{
+    RenderCommand command;
+    for (;;)
+    {
+        if (!renderQueue.receive(command, pdMS_TO_TICKS(HTTPS_IDLE_TIMEOUT_MS)))
+        {
+            closeIdleSessions();
+            continue;
+        }
+        // a real request beats warming the cache
+        prefetchCancel = true;
+        int64_t startUs = esp_timer_get_time();
+        esp_err_t err = ESP_OK;
+        if (command.fields & RENDER_BRIGHTNESS)
+            this->setBrightness(command.brightness);
+        if (command.fields & RENDER_EMOJI)
+            err = this->setEmoji(command.emoji);
+        if (command.fields & RENDER_ANIMATION)
+            err = this->setAnimation(command.animation);
+        if (command.fields & RENDER_TEXT)
         {
-            if ((uint8_t)emoji[i] >= 0xC0 && (uint8_t)emoji[i] <= 0xDF)
+            esp_err_t textErr = this->setText(command.text);
+            if (err == ESP_OK)
+                err = textErr;
+        }
+        renderQueue.complete(command.id, err);
+        int64_t doneUs = esp_timer_get_time();
+        renderTime.record(doneUs - startUs);
+        requestLatency.record(doneUs - command.queuedUs);
+    }
+}
+
+// queue a render command and answer 202 with the id to poll
+void Panel::queueRender(AsyncWebServerRequest *request, RenderCommand &command)
+{
+    uint32_t id = renderQueue.enqueue(command);
+    char json[96];
+    snprintf(json, sizeof(json), "{\"id\":%u,\"status\":\"%s/v1/request?id=%u\"}", id, API_ENDPOINT, id);
+    request->send(202, "application/json", json);
+}
+
+// store the favorites list in NVS and warm the cache with it
+void Panel::setFavorites(const char *favorites)
+{
+    prefs.putString("favorites", favorites);
+    this->startPrefetch();
+}
+
+// Animation task: sleeps until setText starts a scroll or setAnimation an animated emoji,
+// then ticks every 1000 / MARQUEE_FPS ms. The marquee position advances with the time
+// actually elapsed, so a late frame does not slow the text down. Animation frames are shown
+// on the first tick after the delay of the previous one is up.
+void Panel::animate()
+{
+    const TickType_t period = pdMS_TO_TICKS(1000 / MARQUEE_FPS);
+    for (;;)
+    {
+        if (!marqueeActive && !animationActive)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        int64_t lastUs = 0;
+        int64_t frameDueUs = 0;
+        uint64_t position = 0; // pixels * 1e6
+        bool scrolling = false;
+        TickType_t wake = xTaskGetTickCount();
+        while (marqueeActive || animationActive)
+        {
+            vTaskDelayUntil(&wake, period);
+            int64_t nowUs = esp_timer_get_time();
+            if (marqueeActive && !scrolling)
             {
-                codepoints[codepointIndex] = (emoji[i] & 0x1F) << 6;
-                codepoints[codepointIndex] |= (emoji[i + 1] & 0x3F);
-                i++;
+                marqueeTimer.begin(1000000 / MARQUEE_FPS, nowUs - 1000000 / MARQUEE_FPS);
+                position = 0;
+                lastUs = nowUs;
             }
-            else if ((uint8_t)emoji[i] >= 0xE0 && (uint8_t)emoji[i] <= 0xEF)
+            scrolling = marqueeActive;
+            if (scrolling)
             {
-                codepoints[codepointIndex] = (emoji[i] & 0x0F) << 12;
-                codepoints[codepointIndex] |= (emoji[i + 1] & 0x3F) << 6;
-                codepoints[codepointIndex] |= (emoji[i + 2] & 0x3F);
-                i += 2;
+                marqueeTimer.frameStart(nowUs);
+                position += (uint64_t)(nowUs - lastUs) * this->panelPrefs.marqueeSpeed;
+                lastUs = nowUs;
             }
-            else if ((uint8_t)emoji[i] >= 0xF0 && (uint8_t)emoji[i] <= 0xF7)
+            xSemaphoreTake(displayMutex, portMAX_DELAY);
+            bool changed = false;
+            // setText may have replaced the text while we waited
+            if (scrolling && marqueeActive)
             {
-                codepoints[codepointIndex] = (emoji[i] & 0x07) << 18;
-                codepoints[codepointIndex] |= (emoji[i + 1] & 0x3F) << 12;
-                codepoints[codepointIndex] |= (emoji[i + 2] & 0x3F) << 6;
-                codepoints[codepointIndex] |= (emoji[i + 3] & 0x3F);
-                i += 3;
+                display.drawMarquee(position / 1000000);
+                changed = true;
             }
-            codepointIndex++;
+            if (animationActive && nowUs >= frameDueUs)
+                changed |= this->playAnimation(nowUs, &frameDueUs);
+            if (changed)
+                display.commit();
+            xSemaphoreGive(displayMutex);
+            if (changed)
+                frameTime.record(esp_timer_get_time() - nowUs);
+            if (scrolling)
+                marqueeTimer.frameEnd(esp_timer_get_time());
         }
+    }
+}
 
-        // print code points
-        for (int i = 0; i < codepointCount; i++)
+// Temporal dither task: sleeps until applyColor turns temporal dithering on, then shows the
+// other dither phase every 1000 / DITHER_FPS ms. Between frames that changed this is only
+// a buffer flip, the timer keeps track of what it costs when they do.
+void Panel::dither()
+{
+    const TickType_t period = pdMS_TO_TICKS(1000 / DITHER_FPS);
+    for (;;)
+    {
+        if (!ditherActive)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        TickType_t wake = xTaskGetTickCount();
+        ditherTimer.begin(1000000 / DITHER_FPS, esp_timer_get_time());
+        while (ditherActive)
         {
-            ESP_LOGI(__func__, "Codepoint: U+%05X", codepoints[i]);
+            vTaskDelayUntil(&wake, period);
+            int64_t startUs = esp_timer_get_time();
+            ditherTimer.frameStart(startUs);
+            xSemaphoreTake(displayMutex, portMAX_DELAY);
+            display.ditherFrame();
+            xSemaphoreGive(displayMutex);
+            int64_t endUs = esp_timer_get_time();
+            ditherTimer.frameEnd(endUs);
+            ditherTime.record(endUs - startUs);
         }
+    }
+}
+
+// Draw the next decoded animation frame and schedule the one after it, true if the display
+// changed. Called with the display mutex held, once the current frame is due.
+bool Panel::playAnimation(int64_t nowUs, int64_t *dueUs)
+{
+    const RingFrame *frame = animation.next();
+    if (!frame)
+    {
+        // the producer has stopped (end of a broken source), keep its last frame up
+        if (!animationTask)
+            animationActive = false;
+        // frames are late from the network or flash, not just not started yet
+        else if (animation.getStats().played && *dueUs)
+            animation.underrun();
+        *dueUs = 0;
+        return false;
+    }
+    display.drawEmoji(frame->rgb);
+    int64_t delayUs = frame->delayMs * 1000;
+    // catch up after a stall instead of rushing through the frames that queued up
+    *dueUs = (*dueUs && nowUs - *dueUs < delayUs ? *dueUs : nowUs) + delayUs;
+    animation.played();
+    return true;
+}
 
-        // Add first codepoint to emoji string
-        String codepointsString = String(codepoints[0], HEX);
-        int i = 1;
-        // detect following skintone modifiers
-        if (codepointCount > 1 && codepoints[1] >= 0x1F3FB && codepoints[1] <= 0x1F3FF)
+// set the marquee speed in pixels per second, 0 stops scrolling (applies from the next text)
+void Panel::setMarqueeSpeed(uint8_t speed)
+{
+    panelPrefs.marqueeSpeed = speed;
+    this->updatePrefs();
+    if (!speed)
+        this->stopMarquee();
+}
+
+// stop scrolling and wait for a frame in progress, e.g. before drawing a full screen banner
+void Panel::stopMarquee()
+{
+    marqueeActive = false;
+    xSemaphoreTake(displayMutex, portMAX_DELAY);
+    xSemaphoreGive(displayMutex);
+}
+
+// Play an animated emoji in the top half until the next emoji or animation: the name of a GIF
+// in ANIMATION_DIR or an https:// URL. Frames are decoded while the source is read, see
+// animation.h, so the first one shows before the whole file is in.
+esp_err_t Panel::setAnimation(const char *source)
+{
+    ESP_LOGI(__func__, "Animation Input: %s", source);
+    this->stopAnimation();
+    if (!animationReady)
+        return ESP_ERR_NO_MEM;
+    if (strncmp(source, "https://", 8))
+    {
+        char path[sizeof(ANIMATION_DIR) + RENDER_ANIMATION_MAX + 4];
+        snprintf(path, sizeof(path), "%s/%s.gif", ANIMATION_DIR, source);
+        if (!source[0] || strchr(source, '/') || access(path, R_OK))
         {
-            codepointsString += "_" + String(codepoints[1], HEX);
-            i++;
+            ESP_LOGE(__func__, "No animation %s", path);
+            this->emojiInput.update("Invalid Animation");
+            this->dashboard.sendUpdates();
+            return ESP_ERR_NOT_FOUND;
         }
-        // detect regional indicator symbols
-        if (codepointCount > 1 && codepoints[1] >= 0x1F1E6 && codepoints[1] <= 0x1F1FF)
+    }
+    strlcpy(animationSource, source, sizeof(animationSource));
+    animation.start();
+    xTaskCreate(
+        [](void *o)
+        { static_cast<Panel *>(o)->streamAnimation(); }, // This is disgusting, but it works
+        "Animation",                                      // Name of the task (for debugging)
+        ANIMATION_STACK,                                  // Stack size (bytes)
+        this,                                             // Parameter to pass
+        1,                                                // Task priority
+        &animationTask                                    // Task handle
+    );
+    // after the handle is set, playback takes a missing producer for the end of the animation
+    animationActive = true;
+    xTaskNotifyGive(animateTask);
+    this->emojiInput.update(source);
+    this->dashboard.sendUpdates();
+    return ESP_OK;
+}
+
+// Producer task of an animation: decodes the source into the frame ring again and again until
+// stopAnimation() cancels it. Blocks in AnimationStream::frame() while the ring is full.
+void Panel::streamAnimation()
+{
+    bool remote = !strncmp(animationSource, "https://", 8);
+    char path[sizeof(ANIMATION_DIR) + RENDER_ANIMATION_MAX + 4];
+    if (!remote)
+        snprintf(path, sizeof(path), "%s/%s.gif", ANIMATION_DIR, animationSource);
+    for (;;)
+    {
+        esp_err_t err = remote ? this->streamAnimationUrl(animationSource) : this->streamAnimationFile(path);
+        if (animation.isCancelled())
+            break;
+        if (err != ESP_OK || !animation.getStats().decoded)
         {
-            codepointsString += "_" + String(codepoints[1], HEX);
-            i++;
+            ESP_LOGE(__func__, "Animation %s failed: %s", animationSource, animation.getError() ? animation.getError() : esp_err_to_name(err));
+            break;
         }
+        animation.rewind();
+    }
+    AnimationStats stats = animation.getStats();
+    ESP_LOGI(__func__, "Animation stopped after %u frames, %u loops, decode avg %u us max %u us", stats.decoded, stats.loops, stats.avgDecodeUs, stats.maxDecodeUs);
+    animationTask = NULL;
+    vTaskDelete(NULL);
+}
+
+// One pass over a GIF in flash
+esp_err_t Panel::streamAnimationFile(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return ESP_ERR_NOT_FOUND;
+    uint8_t buffer[ANIMATION_READ_SIZE];
+    size_t n;
+    bool ok = true;
+    while (ok && !animation.finished() && (n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        ok = animation.write(buffer, n);
+    fclose(file);
+    return animation.finished() ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+}
 
-        // detect zero width joiners, add next codepoint(s) to emoji string
-        while (i < codepointCount)
+// One pass over a GIF downloaded from https://host[:port]/path, decoded as it arrives
+esp_err_t Panel::streamAnimationUrl(const char *url)
+{
+    char host[HTTPS_HOST_MAX];
+    const char *start = url + 8;
+    const char *path = strchr(start, '/');
+    size_t hostLen = path ? path - start : strlen(start);
+    if (!hostLen || hostLen >= sizeof(host))
+        return ESP_ERR_INVALID_ARG;
+    memcpy(host, start, hostLen);
+    host[hostLen] = '\0';
+    uint16_t port = 443;
+    char *colon = strchr(host, ':');
+    if (colon)
+    {
+        *colon = '\0';
+        port = atoi(colon + 1);
+    }
+    animationSession.setHost(host, port);
+
+    size_t length = 0;
+    int res = animationSession.get(path ? path : "/", animation, &length);
+    ESP_LOGD(__func__, "HTTP Code: %d, %u bytes in %u us", res, length, animationSession.getStats().lastFetchUs);
+    if (res == HTTPS_ERR_CONNECT)
+        return ESP_ERR_INVALID_STATE;
+    if (res != HTTP_CODE_OK && res != HTTPS_ERR_ABORTED)
+        return ESP_ERR_NOT_FOUND;
+    return animation.finished() ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+}
+
+// stop the animated emoji, leaving its current frame up, and wait for the producer to exit
+void Panel::stopAnimation()
+{
+    animation.cancel();
+    while (animationTask)
+        vTaskDelay(pdMS_TO_TICKS(ANIMATION_WAIT_MS));
+    animationActive = false;
+    xSemaphoreTake(displayMutex, portMAX_DELAY);
+    xSemaphoreGive(displayMutex);
+}
+
+// start warming the cache with the favorites, unless it is already running or there is no network
+void Panel::startPrefetch()
+{
+    if (prefetchTask || !wifiReady)
+        return;
+    prefetchCancel = false;
+    xTaskCreate(
+        [](void *o)
+        { static_cast<Panel *>(o)->prefetch(); }, // This is disgusting, but it works
+        "Prefetch",                                // Name of the task (for debugging)
+        PREFETCH_STACK,                            // Stack size (bytes)
+        this,                                      // Parameter to pass
+        tskIDLE_PRIORITY + 1,                      // Task priority
+        &prefetchTask                              // Task handle
+    );
+}
+
+// Task downloading favorites missing from the cache into the flash tier, one at a time with a
+// pause in between. Gives up as soon as the render task picks up a real request.
+void Panel::prefetch()
+{
+    char favorites[FAVORITES_MAX_LEN];
+    strlcpy(favorites, prefs.getString("favorites", FAVORITES_DEFAULT).c_str(), sizeof(favorites));
+    vTaskDelay(pdMS_TO_TICKS(PREFETCH_START_DELAY_MS));
+
+    int fetched = 0;
+    int cached = 0;
+    char *save;
+    for (char *token = strtok_r(favorites, " ,", &save); token && !prefetchCancel; token = strtok_r(NULL, " ,", &save))
+    {
+        char key[EMOJI_KEY_MAX];
+        if (!emojiKey(token, key, sizeof(key)))
+            continue;
+        if (this->emojiCache.contains(key) || this->emojiBundle.contains(key))
         {
-            // if zero width joiner, add joiner and next codepoint
-            if (codepoints[i] == 0x200D && i + 1 < codepointCount)
-            {
-                codepointsString += "_200D_" + String(codepoints[i + 1], HEX);
-                i += 2;
-            }
-            // if skintone modifier, add modifier to emoji string
-            else if (codepoints[i] >= 0x1F3FB && codepoints[i] <= 0x1F3FF)
-            {
-                codepointsString += "_" + String(codepoints[i], HEX);
-                i++;
-            }
-            // else, exit loop
-            else
-            {
-                break;
-            }
+            cached++;
+            continue;
+        }
+        size_t size;
+        if (this->downloadEmoji(key, prefetchPacked, &size) == ESP_OK)
+        {
+            this->emojiCache.put(key, prefetchPacked, size, false);
+            fetched++;
         }
-        ESP_LOGI(__func__, "Emoji: %s", codepointsString.c_str());
+        vTaskDelay(pdMS_TO_TICKS(PREFETCH_INTERVAL_MS));
+    }
+    ESP_LOGI(__func__, "Prefetch %s: %d downloaded, %d already cached", prefetchCancel ? "cancelled" : "done", fetched, cached);
+    prefetchTask = NULL;
+    vTaskDelete(NULL);
+}
 
-        // download emoji from codepoint using https://emojiapi.dev/
-        // https://emojiapi.dev/api/v1/{emoticon_code_or_name}/{size}.{jpg,png,raw,tiff,webp}
-        String emojiUrl = String("https://emojiapi.dev/api/v1/") + codepointsString + "/32.raw";
-        ESP_LOGI(__func__, "Emoji URL: %s", emojiUrl.c_str());
-        client.setCACertBundle(rootca_crt_bundle_start);
+esp_err_t Panel::setEmoji(const char *emoji)
+{
+    esp_err_t err = ESP_OK;
+    ESP_LOGI(__func__, "Emoji Input: %s", emoji);
+    this->stopAnimation();
+    // print emoji as hex
+    for (int i = 0; i < strlen(emoji); i++)
+    {
+        ESP_LOGI(__func__, "0x%02X ", emoji[i]);
+    }
 
-        if (https.begin(client, emojiUrl))
+    char codepoints[EMOJI_KEY_MAX];
+    if (emojiKey(emoji, codepoints, sizeof(codepoints)))
+    {
+        if (this->emojiCache.get(codepoints, emojiPacked, &emojiPackedSize))
         {
-            ESP_LOGI(__func__, "Downloading emoji...");
-            int res = https.GET();
-            ESP_LOGI(__func__, "HTTP Code: %d", res);
-            if (https.getSize() > 0 && res == HTTP_CODE_OK)
-            {
-                ESP_LOGI(__func__, "Emoji Size: %d", https.getSize());
-                for (int i = 0; i < 32; i++)
-                {
-                    for (int j = 0; j < 32; j++)
-                    {
-                        if (https.getStream().available() >= 4)
-                        {
-                            uint8_t r = https.getStream().read();
-                            uint8_t g = https.getStream().read();
-                            uint8_t b = https.getStream().read();
-                            uint8_t a = https.getStream().read();
-                            dma_display->drawPixelRGB888(j + 16, i, r * a / 255, g * a / 255, b * a / 255);
-                        }
-                    }
-                }
-                this->emojiInput.update(emoji);
-            }
-            else
-            {
-                ESP_LOGE(__func__, "Failed to download emoji");
-                this->emojiInput.update("Invalid Emoji");
-                err = ESP_ERR_NOT_FOUND;
-            }
-            https.end();
+            ESP_LOGI(__func__, "Emoji cache hit");
+        }
+        else if (this->emojiBundle.get(codepoints, emojiPacked, &emojiPackedSize))
+        {
+            ESP_LOGI(__func__, "Emoji bundle hit");
         }
         else
         {
-            ESP_LOGE(__func__, "Failed to connect to emoji server");
-            this->emojiInput.update("Invalid Emoji");
-            err = ESP_ERR_INVALID_STATE;
+            err = this->downloadEmoji(codepoints, emojiPacked, &emojiPackedSize);
+            if (err == ESP_OK)
+                this->emojiCache.put(codepoints, emojiPacked, emojiPackedSize);
         }
     }
     else
     {
-        this->emojiInput.update("Invalid Emoji");
         err = ESP_ERR_INVALID_ARG;
     }
+
+    // compose the new frame only once the download is done, then swap it in
+    xSemaphoreTake(displayMutex, portMAX_DELAY);
+    if (err == ESP_OK && !display.drawPackedEmoji(emojiPacked, emojiPackedSize))
+    {
+        ESP_LOGE(__func__, "Corrupt packed emoji");
+        err = ESP_ERR_INVALID_CRC;
+    }
+    if (err == ESP_OK)
+    {
+        this->emojiInput.update(emoji);
+    }
+    else
+    {
+        display.clearEmoji();
+        this->emojiInput.update("Invalid Emoji");
+    }
+    ESP_LOGI(__func__, "Pixels updated: %u", display.commit());
+    xSemaphoreGive(displayMutex);
     this->dashboard.sendUpdates();
     return err;
 }
 
+// download emoji from codepoint using https://emojiapi.dev/, apply alpha and pack it (see emojipack.h).
+// The TLS connection stays open between downloads, see /api/v1/fetch for handshake counts.
+esp_err_t Panel::downloadEmoji(const char *codepoints, uint8_t *packed, size_t *size)
+{
+    esp_err_t err = ESP_OK;
+    char path[96];
+    snprintf(path, sizeof(path), EMOJI_PATH, codepoints);
+    ESP_LOGI(__func__, "Emoji URL: https://%s%s", EMOJI_HOST, path);
+
+    // the session and download buffer are shared with the prefetch task
+    xSemaphoreTake(emojiMutex, portMAX_DELAY);
+    size_t length = 0;
+    int res = emojiSession.get(path, emojiRGBA, sizeof(emojiRGBA), &length);
+    ESP_LOGI(__func__, "HTTP Code: %d, %u bytes in %u us", res, length, emojiSession.getStats().lastFetchUs);
+    if (res == HTTPS_ERR_CONNECT)
+    {
+        ESP_LOGE(__func__, "Failed to connect to emoji server");
+        err = ESP_ERR_INVALID_STATE;
+    }
+    else if (res != HTTP_CODE_OK)
+    {
+        ESP_LOGE(__func__, "Failed to download emoji");
+        err = ESP_ERR_NOT_FOUND;
+    }
+    else if (length != sizeof(emojiRGBA))
+    {
+        ESP_LOGE(__func__, "Emoji download truncated: %d of %d bytes", length, sizeof(emojiRGBA));
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    else
+    {
+        emojiFromRGBA(emojiRGBA, emojiFrame, EMOJI_SIZE * EMOJI_SIZE);
+        *size = emojiPack(emojiFrame, packed);
+        ESP_LOGI(__func__, "Packed emoji: %u bytes", *size);
+    }
+    xSemaphoreGive(emojiMutex);
+    return err;
+}
+
 esp_err_t Panel::setText(const char *text)
 {
     esp_err_t err = ESP_OK;
     ESP_LOGI(__func__, "Text Input: %s", text);
-    dma_display->fillRect(0, 32, 64, 32, BLACK);
-    dma_display->setTextColor(WHITE);
-    dma_display->setCursor(0, 32);
-    dma_display->printf("%s", text);
+    xSemaphoreTake(displayMutex, portMAX_DELAY);
+    marqueeActive = false;
+    // text that does not fit scrolls, if the marquee is enabled
+    if (!display.drawText(text) && this->panelPrefs.marqueeSpeed && display.setMarquee(text))
+    {
+        marqueeActive = true;
+        xTaskNotifyGive(animateTask);
+    }
+    ESP_LOGI(__func__, "Pixels updated: %u", display.commit());
+    xSemaphoreGive(displayMutex);
     this->textInput.update(text);
     this->dashboard.sendUpdates();
     return err;
@@ -4,9 +4,9 @@
 
 #include <sdkconfig.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <Arduino.h>
 #include <HTTPClient.h>
-#include <HTTPUpdate.h>
 #include <ArduinoOTA.h>
 #include <ESP32-HUB75-MatrixPanel-I2S-DMA.h>
 #include <Preferences.h>
@@ -17,6 +17,8 @@
 #include <WiFiClientSecure.h>
 #include <WiFi.h>
 #include <esp_ota_ops.h>
+#include <esp_image_format.h>
+#include <esp_timer.h>
 #include <ESPmDNS.h>
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
@@ -25,7 +27,27 @@
 #include "AsyncJson.h"
 #include <ArduinoJson.h>
 
+#include "animation.h"
 #include "config.h"
+#include "display.h"
+#include "emoji.h"
+#include "emojibundle.h"
+#include "emojicache.h"
+#include "esptls.h"
+#include "firmwarestream.h"
+#include "frametimer.h"
+#include "heaptrack.h"
+#include "httpssession.h"
+#include "hub75timing.h"
+#include "metrics.h"
+#include "otaflash.h"
+#include "prefs.h"
+#include "releasefeed.h"
+#include "renderqueue.h"
+#include "rollout.h"
+#include "taskprofile.h"
+#include "tcptransport.h"
+#include "updatecheck.h"
 
 #if __has_include("secrets.h")
 #include "secrets.h"
@@ -34,21 +56,6 @@
 // get ESP-IDF Certificate Bundle
 extern const uint8_t rootca_crt_bundle_start[] asm("_binary_x509_crt_bundle_start");
 
-// Preferences struct for storing and loading in nvs
-struct PanelPrefs
-{
-    uint8_t brightness = 255;
-    bool development = 0;
-    bool ota = 0;
-    bool github = 1;
-    bool signedFWOnly = 1;
-    uint8_t latchBlanking = 1;
-    bool use20MHz = 0;
-    void print(String prefix) {
-        ESP_LOGI(__func__, "%s\nBrightness: %d\nDevelopment: %d\nOTA: %d\nGithub: %d\nSigned FW Only: %d\n", prefix.c_str(), brightness, development, ota, github, signedFWOnly);
-    }
-};
-
 // Partition struct for verifying firmware is intended for this device
 struct PanelPartition
 {
@@ -56,6 +63,14 @@ struct PanelPartition
     char reserved[224]; // Reserved for future use, total of 256 bytes
 };
 
+// Signature an OTA slot's image was installed with, served along with it to peers
+struct FirmwareSignature
+{
+    char label[17]; // of the partition
+    uint16_t size;
+    uint8_t signature[FIRMWARE_SIGNATURE_MAX];
+};
+
 class Panel {
     public:
         Panel();
@@ -64,15 +79,79 @@ class Panel {
     private:
         // Objects
         MatrixPanel_I2S_DMA *dma_display;
+        Display display;
         AsyncWebServer server;
-        HTTPClient https;
-        WiFiClientSecure client;
+        EspTlsTransport emojiTransport;
+        HttpsSession emojiSession;
+        EspTlsTransport animationTransport;
+        HttpsSession animationSession;
+        EspTlsTransport updateTransport;
+        TcpTransport updateLanTransport; // http:// mirrors
+        HttpsSession updateSession;
+        UpdateChecker updateChecker;
+        ReleaseFeed releaseFeed;
+        Rollout rollout;
+        char rolloutTag[RELEASE_TAG_MAX]; // release the panel waits for its turn on
+        int64_t rolloutStart;
+        // firmware updates from GitHub or POST /api/v1/firmware: plain, compressed or delta
+        FirmwareStream firmwareStream;
+        RunningPartition runningPartition;
+        OtaPartition otaPartition;
+        MbedTlsVerifier firmwareVerifier;
+        AnimationStream animation;
         WiFiManager wifiManager;
         PanelPrefs panelPrefs;
+        EmojiCache emojiCache;
+        EmojiBundle emojiBundle;
+        RenderQueue renderQueue;
 
         // Variables
         String serial;
         bool wifiReady;
+        uint8_t emojiRGBA[EMOJI_SIZE * EMOJI_SIZE * 4];
+        uint8_t emojiFrame[EMOJI_FRAME_BYTES];
+        uint8_t emojiPacked[EMOJI_PACKED_MAX];
+        size_t emojiPackedSize;
+        uint8_t prefetchPacked[EMOJI_PACKED_MAX];
+        SemaphoreHandle_t emojiMutex;
+        volatile bool prefetchCancel;
+        SemaphoreHandle_t displayMutex;
+        volatile bool marqueeActive;
+        FrameTimer marqueeTimer;
+        volatile bool ditherActive;
+        FrameTimer ditherTimer;
+        // live driver restarts: how many, how long the panel was dark, frames not shown meanwhile
+        uint32_t reinits;
+        uint32_t lastReinitUs;
+        uint32_t maxReinitUs;
+        uint32_t droppedFrames;
+        // served at /api/v1/metrics
+        Histogram renderTime;
+        Histogram requestLatency;
+        Histogram frameTime;
+        Histogram ditherTime;
+        TaskProfiler profiler;
+        SemaphoreHandle_t profileMutex;
+        TaskStatus_t profileStatus[PROFILE_STATUS_MAX];
+        TaskSample profileSamples[PROFILE_STATUS_MAX];
+        // what the Tasks tab shows, the charts keep pointers to the names
+        char chartNames[PROFILE_TASKS_MAX][PROFILE_NAME_LEN];
+        const char *chartNameList[PROFILE_TASKS_MAX];
+        float chartCpu[PROFILE_TASKS_MAX];
+        int chartStack[PROFILE_TASKS_MAX];
+        size_t chartCount;
+        // sampled by the memory printer, served at /api/v1/heap
+        HeapHistory heapHistory;
+        SemaphoreHandle_t heapMutex;
+        SemaphoreHandle_t firmwareMutex; // one update at a time
+        bool firmwareActive;
+        AsyncWebServerRequest *firmwareRequest; // upload the running update comes from
+        int firmwareProgress; // percent last shown
+        bool otaCookieChecked; // of the image ArduinoOTA is writing
+        volatile uint8_t peerUploads; // panels fetching the running image from this one
+        bool animationReady;
+        volatile bool animationActive;
+        char animationSource[RENDER_ANIMATION_MAX];
 
         // UI Components
         ESPDash dashboard;
@@ -80,22 +159,41 @@ class Panel {
         Card GHUpdateToggle;
         Card developmentToggle;
         Card signedFWOnlyToggle;
+        Card peerUpdatesToggle;
         Statistic fwVersion;
         Card brightnessSlider;
         Card emojiInput;
         Card textInput;
+        Card favoritesInput;
+        Card marqueeSlider;
+        Card gammaSlider;
+        Card redSlider;
+        Card greenSlider;
+        Card blueSlider;
+        Card ditherToggle;
+        Card temporalToggle;
         Card latchSlider;
         Card use20MHzToggle;
+        Card depthSlider;
         Card rebootButton;
         Card resetWifiButton;
         Card crashMe;
+        Chart cpuChart;
+        Chart stackChart;
         Tab systemTab;
         Tab developerTab;
+        Tab tasksTab;
 
         // FreeRTOS Tasks
         TaskHandle_t checkForUpdatesTask;
         TaskHandle_t checkForOTATask;
         TaskHandle_t printMemTask;
+        TaskHandle_t renderTask;
+        TaskHandle_t prefetchTask;
+        TaskHandle_t animateTask;
+        TaskHandle_t animationTask;
+        TaskHandle_t ditherTask;
+        TaskHandle_t profileTask;
         Preferences prefs;
 
         // Functions
@@ -104,23 +202,58 @@ class Panel {
         void showTestSequence();
         void setBrightness(uint8_t brightness);
         uint8_t getBrightness();
+        void setColor(uint8_t gamma, const uint8_t whiteBalance[3], bool dither, bool temporal);
+        void applyColor();
+        ColorSettings colorSettings();
+        void setLatchBlanking(uint8_t blanking);
+        esp_err_t setDisplayTiming(bool use20MHz, uint8_t colorDepth);
         void setDevelopment(bool development);
         void setOTA(bool ota);
         void setGHUpdate(bool github);
         void setSignedFWOnly(bool signedFWOnly);
+        void setPeerUpdates(bool peerUpdates);
+        void advertisePeer();
         bool initPrefs();
         void initUpdates();
         bool initDisplay();
+        HUB75_I2S_CFG displayConfig();
+        esp_err_t reinitDisplay();
         bool initWifi();
         void initUI();
         void initAPI();
+        void closeIdleSessions();
         void checkForUpdates();
+        esp_err_t updateRelease(const UpdateSource &source, const char *tag);
+        esp_err_t updateFromPeers(const char *tag);
+        esp_err_t downloadFirmware(const char *url, const char *label, bool signedOnly = false);
+        bool beginFirmware(const char *label, bool signedOnly = false);
+        bool writeFirmware(const uint8_t *data, size_t len, size_t total);
+        esp_err_t endFirmware();
+        void abortFirmware();
         void checkForOTA();
         void updatePrefs();
         void printMem();
+        void profile();
+        void updateTaskCharts();
+        void render();
+        void queueRender(AsyncWebServerRequest *request, RenderCommand &command);
+        void prefetch();
+        void startPrefetch();
+        void setFavorites(const char *favorites);
+        void animate();
+        void dither();
+        void setMarqueeSpeed(uint8_t speed);
+        void stopMarquee();
+        bool playAnimation(int64_t nowUs, int64_t *dueUs);
+        void streamAnimation();
+        esp_err_t streamAnimationFile(const char *path);
+        esp_err_t streamAnimationUrl(const char *url);
+        void stopAnimation();
 
         esp_err_t setEmoji(const char *emoji);
+        esp_err_t downloadEmoji(const char *codepoints, uint8_t *packed, size_t *size);
         esp_err_t setText(const char *text);
+        esp_err_t setAnimation(const char *source);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,3496 @@
+/*
+ * Host simulator for the panel core (pio run -e native).
+ *
+ *   status_sim render [-e emoji] [-r emoji.raw] [-t text] [-p percent] [-o snapshot.png|.ppm]
+ *   status_sim bench [iterations]
+ *   status_sim pack [-n iterations] [emoji.raw ...]
+ *   status_sim bundle [-o data/bundle] [-u host[:port] | --stand-in] [-n iterations] <emoji/bundle.txt | key.raw ...>
+ *   status_sim fetch [-u host[:port]] [-n count] [-s sleep_ms] [--idle ms] [--server-idle ms] [--close] [--no-resume]
+ *   status_sim serve [-p port] [-c cert.pem] [--idle ms]
+ *   status_sim segment [-n iterations] [text ...]
+ *   status_sim text [-n iterations] [text ...]
+ *   status_sim marquee [-t text] [-s px_per_s] [-f fps] [-d seconds] [-o snapshot.png|.ppm]
+ *   status_sim gif [-n iterations] [-o data/gif/spinner.gif] [file.gif ...]
+ *   status_sim color [-n iterations] [-g gamma_x10] [-w r,g,b] [-b brightness] [-o snapshot.png|.ppm]
+ *   status_sim dither [-n iterations] [-d depth] [-b brightness] [-o snapshot.png|.ppm]
+ *   status_sim reinit [-n iterations]
+ *   status_sim metrics [-n iterations] [-v]
+ *   status_sim tasks [-n iterations]
+ *   status_sim heap [-n iterations] [-r releases]
+ *   status_sim updates [-n checks] [-r releases]
+ *   status_sim releases [-m MB] [-n iterations]
+ *   status_sim patch [-n iterations] [-o esp32.patch] [-z esp32.bin.lz] [running.bin new.bin]
+ *   status_sim sign [-n iterations] [-k private.pem esp32.bin stream ...]
+ *   status_sim rollout [-n panels] [-p fleet] [-H hours]
+ *
+ * Renders into the simulated HUB75 framebuffer so layout and rendering cost can be
+ * checked without a panel attached. fetch runs the emoji download path against an
+ * HTTPS origin, by default a local stand-in server started in-process. The behavior of
+ * the core on its own is covered by the unit tests in test/ (pio test -e native).
+ */
+#include <algorithm>
+#include <chrono>
+#include <malloc.h>
+#include <math.h>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <openssl/crypto.h>
+#include <openssl/pem.h>
+
+#include <ESP32-HUB75-MatrixPanel-I2S-DMA.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "animation.h"
+#include "colorlut.h"
+#include "display.h"
+#include "emoji.h"
+#include "emojibundle.h"
+#include "emojipack.h"
+#include "firmwarestream.h"
+#include "framebuffer.h"
+#include "frametimer.h"
+#include "gifdecoder.h"
+#include "grapheme.h"
+#include "heaptrack.h"
+#include "httpssession.h"
+#include "hub75timing.h"
+#include "metrics.h"
+#include "mirror.h"
+#include "prefs.h"
+#include "releasefeed.h"
+#include "rollout.h"
+#include "signing.h"
+#include "taskprofile.h"
+#include "tcptransport.h"
+#include "text.h"
+#include "tls.h"
+#include "updatecheck.h"
+
+#define PANEL_WIDTH 64
+#define PANEL_HEIGHT 64
+#define BUNDLE_MAX 512
+#define SPIFFS_PARTITION_BYTES 0x30000 // partitions.csv
+
+static uint8_t emojiRGBA[EMOJI_SIZE * EMOJI_SIZE * 4];
+static uint8_t emojiFrame[EMOJI_FRAME_BYTES];
+
+// Stand-in emoji when no .raw file is given: yellow disc with soft edge
+static void testEmoji(uint8_t *rgba)
+{
+    for (int y = 0; y < EMOJI_SIZE; y++)
+    {
+        for (int x = 0; x < EMOJI_SIZE; x++)
+        {
+            float d = hypotf(x - 15.5f, y - 15.5f);
+            float a = d < 14.0f ? 1.0f : (d < 16.0f ? (16.0f - d) / 2.0f : 0.0f);
+            uint8_t *px = &rgba[(y * EMOJI_SIZE + x) * 4];
+            px[0] = 255;
+            px[1] = 200 - y * 3;
+            px[2] = 40;
+            px[3] = a * 255;
+        }
+    }
+}
+
+// Shape for the synthetic corpus: color of a point, alpha 0 outside
+struct Sample
+{
+    float r, g, b, a;
+};
+
+// One of four styles emoji sets use: shaded face, flat icon, striped flag, gradient object
+static Sample corpusSample(int n, float x, float y)
+{
+    float hue = (n * 37 % 100) / 100.0f;
+    float d = hypotf(x - 16, y - 16);
+    switch (n % 4)
+    {
+    case 0:
+    {
+        // radial shaded disc with eyes and a mouth
+        if (d > 15)
+            return {0, 0, 0, 0};
+        float shade = 1.0f - d / 30.0f;
+        bool eye = hypotf(x - 11, (y - 12) * 0.6f) < 2.2f || hypotf(x - 21, (y - 12) * 0.6f) < 2.2f;
+        bool mouth = fabsf(hypotf(x - 16, y - 14) - 9) < 1.2f && y > 18;
+        if (eye || mouth)
+            return {80, 50, 20, 1};
+        return {255 * shade, (200 - 60 * hue) * shade, 40 * shade, 1};
+    }
+    case 1:
+    {
+        // flat heart in two colors
+        float u = (x - 16) / 13, v = (y - 17) / 13;
+        float f = powf(u * u + v * v - 0.5f, 3) - u * u * v * v * v;
+        if (f > 0)
+            return {0, 0, 0, 0};
+        return v < -0.3f ? Sample{255, 120, 150, 1} : Sample{220 + 30 * hue, 30, 60, 1};
+    }
+    case 2:
+    {
+        // three striped flag with a pole
+        if (x >= 2 && x < 4 && y >= 4 && y < 30)
+            return {120, 120, 120, 1};
+        if (x < 4 || x > 30 || y < 6 || y > 22)
+            return {0, 0, 0, 0};
+        int stripe = (int)((y - 6) / 5.34f);
+        const float colors[3][3] = {{255 * hue, 40, 40}, {250, 250, 250}, {40, 80, 255 * (1 - hue)}};
+        return {colors[stripe][0], colors[stripe][1], colors[stripe][2], 1};
+    }
+    default:
+    {
+        // cup with a vertical gradient and soft shadow
+        if (x > 6 && x < 24 && y > 8 && y < 28)
+            return {140 + 3 * y, 90 + 2 * y + 40 * hue, 60 + y, 1};
+        if (fabsf(hypotf(x - 24, y - 17) - 4) < 1.3f)
+            return {200, 200, 210, 1};
+        if (y >= 28 && y < 31 && x > 3 && x < 28)
+            return {60, 60, 60, 0.5f};
+        return {0, 0, 0, 0};
+    }
+    }
+}
+
+// Render corpus tile n with 4x4 supersampling, so edges carry anti-aliasing colors
+static void corpusEmoji(int n, uint8_t *rgba)
+{
+    for (int y = 0; y < EMOJI_SIZE; y++)
+    {
+        for (int x = 0; x < EMOJI_SIZE; x++)
+        {
+            float r = 0, g = 0, b = 0, a = 0;
+            for (int s = 0; s < 16; s++)
+            {
+                Sample sample = corpusSample(n, x + (s % 4 + 0.5f) / 4, y + (s / 4 + 0.5f) / 4);
+                r += sample.r * sample.a;
+                g += sample.g * sample.a;
+                b += sample.b * sample.a;
+                a += sample.a;
+            }
+            uint8_t *px = &rgba[(y * EMOJI_SIZE + x) * 4];
+            px[0] = a ? fminf(r / a, 255) : 0;
+            px[1] = a ? fminf(g / a, 255) : 0;
+            px[2] = a ? fminf(b / a, 255) : 0;
+            px[3] = a / 16 * 255;
+        }
+    }
+}
+
+static bool loadRaw(const char *path, uint8_t *rgba)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+    size_t size = EMOJI_SIZE * EMOJI_SIZE * 4;
+    bool ok = fread(rgba, 1, size, file) == size;
+    fclose(file);
+    return ok;
+}
+
+static bool saveSnapshot(MatrixPanel_I2S_DMA &panel, const char *path)
+{
+    size_t len = strlen(path);
+    if (len > 4 && !strcmp(path + len - 4, ".ppm"))
+        return panel.savePPM(path);
+    return panel.savePNG(path);
+}
+
+// Byte-at-a-time source, mimics reading from the HTTPS stream
+class ByteStream {
+    public:
+        ByteStream(const uint8_t *data, size_t size) : data(data), size(size), pos(0) {}
+        virtual ~ByteStream() {}
+        virtual int available() { return size - pos; }
+        virtual int read() { return pos < size ? data[pos++] : -1; }
+        void rewind() { pos = 0; }
+
+    private:
+        const uint8_t *data;
+        size_t size;
+        size_t pos;
+};
+
+// The original setEmoji loop: four stream reads, a division per channel and a draw per pixel
+static void legacyDrawEmoji(ByteStream &stream, MatrixPanel_I2S_DMA &panel)
+{
+    for (int i = 0; i < 32; i++)
+    {
+        for (int j = 0; j < 32; j++)
+        {
+            if (stream.available() >= 4)
+            {
+                uint8_t r = stream.read();
+                uint8_t g = stream.read();
+                uint8_t b = stream.read();
+                uint8_t a = stream.read();
+                panel.drawPixelRGB888(j + 16, i, r * a / 255, g * a / 255, b * a / 255);
+            }
+        }
+    }
+}
+
+// The original emojiKey: VLA of codepoints, no validation, ZWJ and skin tones only
+static bool legacyEmojiKey(const char *emoji, char *key, size_t size)
+{
+    auto append = [&](uint32_t codepoint)
+    {
+        size_t len = strlen(key);
+        snprintf(key + len, size - len, len ? "_%x" : "%x", codepoint);
+    };
+    key[0] = '\0';
+    uint8_t len = strlen(emoji);
+    if ((uint8_t)emoji[0] <= 0x7F)
+        return false;
+    uint8_t codepointCount = 0;
+    for (int i = 0; i < len; i++)
+    {
+        if ((uint8_t)emoji[i] >= 0xC0 && (uint8_t)emoji[i] <= 0xDF)
+            i++;
+        else if ((uint8_t)emoji[i] >= 0xE0 && (uint8_t)emoji[i] <= 0xEF)
+            i += 2;
+        else if ((uint8_t)emoji[i] >= 0xF0 && (uint8_t)emoji[i] <= 0xF7)
+            i += 3;
+        codepointCount++;
+    }
+    ESP_LOGI(__func__, "Codepoint Count: %d", codepointCount);
+    uint32_t codepoints[codepointCount];
+    uint8_t codepointIndex = 0;
+    for (int i = 0; i < len; i++)
+    {
+        if ((uint8_t)emoji[i] >= 0xC0 && (uint8_t)emoji[i] <= 0xDF)
+        {
+            codepoints[codepointIndex] = (emoji[i] & 0x1F) << 6 | (emoji[i + 1] & 0x3F);
+            i++;
+        }
+        else if ((uint8_t)emoji[i] >= 0xE0 && (uint8_t)emoji[i] <= 0xEF)
+        {
+            codepoints[codepointIndex] = (emoji[i] & 0x0F) << 12 | (emoji[i + 1] & 0x3F) << 6 | (emoji[i + 2] & 0x3F);
+            i += 2;
+        }
+        else if ((uint8_t)emoji[i] >= 0xF0 && (uint8_t)emoji[i] <= 0xF7)
+        {
+            codepoints[codepointIndex] = (emoji[i] & 0x07) << 18 | (emoji[i + 1] & 0x3F) << 12 |
+                                         (emoji[i + 2] & 0x3F) << 6 | (emoji[i + 3] & 0x3F);
+            i += 3;
+        }
+        codepointIndex++;
+    }
+    for (int i = 0; i < codepointCount; i++)
+        ESP_LOGI(__func__, "Codepoint: U+%05X", codepoints[i]);
+
+    append(codepoints[0]);
+    int i = 1;
+    if (codepointCount > 1 && codepoints[1] >= 0x1F3FB && codepoints[1] <= 0x1F3FF)
+        append(codepoints[i++]);
+    if (codepointCount > 1 && codepoints[1] >= 0x1F1E6 && codepoints[1] <= 0x1F1FF)
+        append(codepoints[i++]);
+    while (i < codepointCount)
+    {
+        if (codepoints[i] == 0x200D && i + 1 < codepointCount)
+        {
+            size_t keyLen = strlen(key);
+            snprintf(key + keyLen, size - keyLen, "_200D_%x", codepoints[i + 1]);
+            i += 2;
+        }
+        else if (codepoints[i] >= 0x1F3FB && codepoints[i] <= 0x1F3FF)
+            append(codepoints[i++]);
+        else
+            break;
+    }
+    ESP_LOGI(__func__, "Emoji: %s", key);
+    return true;
+}
+
+// Time fn over iterations and print the average in microseconds
+template <typename F>
+static void bench(const char *name, int iterations, F fn)
+{
+    // a per op time needs at least one op
+    iterations = std::max(iterations, 1);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        fn(i);
+    auto end = std::chrono::steady_clock::now();
+    double us = std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+    printf("%-24s %10.3f us/op\n", name, us);
+}
+
+static const char *program;
+static const char *const commands[] = {
+    "render [-e emoji] [-r emoji.raw] [-t text] [-p percent] [-o snapshot.png|.ppm]",
+    "bench [iterations]",
+    "pack [-n iterations] [emoji.raw ...]",
+    "bundle [-o data/bundle] [-u host[:port] | --stand-in] [-n iterations] <emoji/bundle.txt | key.raw ...>",
+    "fetch [-u host[:port]] [-n count] [-s sleep_ms] [--idle ms] [--server-idle ms] [--close] [--no-resume]",
+    "serve [-p port] [-c cert.pem] [--idle ms]",
+    "segment [-n iterations] [text ...]",
+    "text [-n iterations] [text ...]",
+    "marquee [-t text] [-s px_per_s] [-f fps] [-d seconds] [-o snapshot.png|.ppm]",
+    "gif [-n iterations] [-o data/gif/spinner.gif] [file.gif ...]",
+    "color [-n iterations] [-g gamma_x10] [-w r,g,b] [-b brightness] [-o snapshot.png|.ppm]",
+    "dither [-n iterations] [-d depth] [-b brightness] [-o snapshot.png|.ppm]",
+    "reinit [-n iterations]",
+    "metrics [-n iterations] [-v]",
+    "tasks [-n iterations]",
+    "heap [-n iterations] [-r releases]",
+    "updates [-n checks] [-r releases]",
+    "releases [-m MB] [-n iterations]",
+    "patch [-n iterations] [-o esp32.patch] [-z esp32.bin.lz] [running.bin new.bin]",
+    "sign [-n iterations] [-k private.pem esp32.bin stream ...]",
+    "rollout [-n panels] [-p fleet] [-H hours]",
+};
+
+// Print the usage of command, or of every command for NULL, and fail
+static int usage(const char *command)
+{
+    size_t len = command ? strlen(command) : 0;
+    const char *prefix = "usage:";
+    for (const char *line : commands)
+    {
+        if (command && (strncmp(line, command, len) || (line[len] && line[len] != ' ')))
+            continue;
+        fprintf(stderr, "%-6s %s %s\n", prefix, program, line);
+        prefix = "";
+    }
+    return 1;
+}
+
+static int render(int argc, char **argv, MatrixPanel_I2S_DMA &panel, Display &display)
+{
+    const char *emoji = NULL;
+    const char *raw = NULL;
+    const char *text = NULL;
+    const char *output = "snapshot.png";
+    int percent = -1;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "-e"))
+            emoji = argv[i + 1];
+        else if (!strcmp(argv[i], "-r"))
+            raw = argv[i + 1];
+        else if (!strcmp(argv[i], "-t"))
+            text = argv[i + 1];
+        else if (!strcmp(argv[i], "-p"))
+            percent = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-o"))
+            output = argv[i + 1];
+    }
+
+    if (emoji)
+    {
+        char key[EMOJI_KEY_MAX];
+        if (!emojiKey(emoji, key, sizeof(key)))
+        {
+            ESP_LOGE(__func__, "Invalid emoji: %s", emoji);
+            return 1;
+        }
+        printf("key: %s\n", key);
+    }
+
+    if (raw && !loadRaw(raw, emojiRGBA))
+    {
+        ESP_LOGE(__func__, "Failed to read %s", raw);
+        return 1;
+    }
+    if (!raw)
+        testEmoji(emojiRGBA);
+    emojiFromRGBA(emojiRGBA, emojiFrame, EMOJI_SIZE * EMOJI_SIZE);
+    display.drawEmoji(emojiFrame);
+
+    if (text)
+        display.drawText(text);
+    if (percent >= 0)
+        display.drawProgress(percent, 100);
+    display.commit();
+
+    if (!saveSnapshot(panel, output))
+    {
+        ESP_LOGE(__func__, "Failed to write %s", output);
+        return 1;
+    }
+    printf("wrote %s (%u pixel writes, %u flips)\n", output, panel.getPixelWrites(), panel.getFlips());
+    return 0;
+}
+
+static int benchmark(int iterations, MatrixPanel_I2S_DMA &panel, Display &display)
+{
+    char key[EMOJI_KEY_MAX];
+    esp_log_level_set("*", ESP_LOG_WARN);
+    testEmoji(emojiRGBA);
+
+    bench("emojiKey", iterations, [&](int)
+          { emojiKey("\xF0\x9F\xA7\x91\xE2\x80\x8D\xF0\x9F\x92\xBB", key, sizeof(key)); });
+    bench("emojiFromRGBA", iterations, [&](int)
+          { emojiFromRGBA(emojiRGBA, emojiFrame, EMOJI_SIZE * EMOJI_SIZE); });
+    bench("drawEmoji", iterations, [&](int)
+          { display.drawEmoji(emojiFrame); });
+    ByteStream stream(emojiRGBA, sizeof(emojiRGBA));
+    bench("emoji legacy per-pixel", iterations, [&](int)
+          { stream.rewind(); legacyDrawEmoji(stream, panel); });
+    bench("emoji blitRGBA", iterations, [&](int)
+          { display.blitRGBA(EMOJI_X, EMOJI_Y, EMOJI_SIZE, EMOJI_SIZE, emojiRGBA); });
+    bench("drawText", iterations, [&](int)
+          { display.drawText("In a meeting"); });
+    bench("drawProgress", iterations, [&](int i)
+          { display.drawProgress(i % 101, 100); });
+    bench("commit unchanged", iterations, [&](int)
+          { display.commit(); });
+    const char *texts[] = {"In a meeting", "Lunch"};
+    uint64_t pixels = 0;
+    bench("commit text change", iterations, [&](int i)
+          { display.drawText(texts[i & 1]); pixels += display.commit(); });
+    printf("%-24s %10.1f px/op\n", "  pixels written", (double)pixels / iterations);
+    return 0;
+}
+
+// Start the local emoji origin on a free port and point transport, host and port at it
+static bool startStandIn(EmojiServer &server, uint32_t idleMs, OpenSslTransport &transport, char *host, size_t hostSize, uint16_t *port)
+{
+    if (!server.begin(0, idleMs))
+    {
+        ESP_LOGE(__func__, "Failed to start local emoji server");
+        return false;
+    }
+    std::thread([&server]()
+                { server.run(); })
+        .detach();
+    transport.trust(server.getCertificate());
+    snprintf(host, hostSize, "127.0.0.1");
+    *port = server.getPort();
+    return true;
+}
+
+// Download emoji tiles through HttpsSession and report connection reuse and latency
+static int fetch(int argc, char **argv)
+{
+    char host[HTTPS_HOST_MAX] = "";
+    uint16_t port = 443;
+    int count = 10;
+    int sleepMs = 0;
+    int idleMs = HTTPS_IDLE_TIMEOUT_MS;
+    int serverIdleMs = 60000;
+    bool keepAlive = true;
+    bool resume = true;
+    for (int i = 0; i < argc; i++)
+    {
+        bool value = i + 1 < argc;
+        if (!strcmp(argv[i], "--close"))
+            keepAlive = false;
+        else if (!strcmp(argv[i], "--no-resume"))
+            resume = false;
+        else if (!strcmp(argv[i], "-u") && value)
+        {
+            snprintf(host, sizeof(host), "%s", argv[++i]);
+            char *colon = strchr(host, ':');
+            if (colon)
+            {
+                *colon = '\0';
+                port = atoi(colon + 1);
+            }
+        }
+        else if (!strcmp(argv[i], "-n") && value)
+            count = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && value)
+            sleepMs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--idle") && value)
+            idleMs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--server-idle") && value)
+            serverIdleMs = atoi(argv[++i]);
+    }
+    if (count <= 0 || sleepMs < 0 || idleMs <= 0 || serverIdleMs <= 0)
+        return usage("fetch");
+
+    OpenSslTransport transport;
+    transport.setResume(resume);
+    EmojiServer server;
+    if (!host[0] && !startStandIn(server, serverIdleMs, transport, host, sizeof(host), &port))
+        return 1;
+
+    HttpsSession session(transport);
+    session.setHost(host, port);
+    session.setIdleTimeout(idleMs);
+    session.setKeepAlive(keepAlive);
+
+    const char *keys[] = {"1f600", "1f9d1_200d_1f4bb", "1f44d", "2615"};
+    char path[96];
+    size_t length;
+    printf("fetching %d tiles from %s:%u (keep-alive %s, resume %s)\n", count, host, port, keepAlive ? "on" : "off", resume ? "on" : "off");
+    for (int i = 0; i < count; i++)
+    {
+        if (i && sleepMs)
+            usleep(sleepMs * 1000);
+        HttpsSessionStats before = session.getStats();
+        snprintf(path, sizeof(path), "/api/v1/%s/32.raw", keys[i % 4]);
+        int status = session.get(path, emojiRGBA, sizeof(emojiRGBA), &length);
+        HttpsSessionStats after = session.getStats();
+        const char *connection = after.handshakes == before.handshakes ? "reused" : (after.resumed != before.resumed ? "resumed" : "full handshake");
+        printf("%3d  %3d  %5zu bytes  %9.3f ms  %s\n", i, status, length, after.lastFetchUs / 1000.0, connection);
+    }
+
+    // the owning task drops the connection once idle, not only on the next fetch
+    bool idleClosed = true;
+    if (keepAlive && idleMs <= 1000 && session.isConnected())
+    {
+        idleClosed = !session.closeIfIdle();
+        usleep((idleMs + 10) * 1000);
+        idleClosed = idleClosed && session.closeIfIdle() && !session.isConnected();
+        printf("idle connection %s after %d ms\n", idleClosed ? "closed" : "kept", idleMs);
+    }
+
+    HttpsSessionStats stats = session.getStats();
+    printf("fetches %u, failures %u, handshakes %u (%u resumed), reused %u\n",
+           stats.fetches, stats.failures, stats.handshakes, stats.resumed, stats.reused);
+    printf("avg fetch %.3f ms, avg handshake %.3f ms\n",
+           stats.fetches ? stats.totalFetchUs / 1000.0 / stats.fetches : 0,
+           stats.handshakes ? stats.totalHandshakeUs / 1000.0 / stats.handshakes : 0);
+    session.close();
+    return stats.failures || !idleClosed ? 1 : 0;
+}
+
+// Build the offline emoji bundle from a list of emojis fetched from the origin, or from
+// <key>.raw tiles, then time bundle lookups against fetches over a kept alive connection
+static int bundle(int argc, char **argv, Display &display)
+{
+    const char *output = "data/bundle";
+    char host[HTTPS_HOST_MAX] = "emojiapi.dev";
+    uint16_t port = 443;
+    bool standIn = false;
+    int iterations = 1000;
+    const char *inputs[64];
+    int inputCount = 0;
+    for (int i = 0; i < argc; i++)
+    {
+        bool value = i + 1 < argc;
+        if (!strcmp(argv[i], "-o") && value)
+            output = argv[++i];
+        else if (!strcmp(argv[i], "-n") && value)
+            iterations = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--stand-in"))
+            standIn = true;
+        else if (!strcmp(argv[i], "-u") && value)
+        {
+            snprintf(host, sizeof(host), "%s", argv[++i]);
+            char *colon = strchr(host, ':');
+            if (colon)
+            {
+                *colon = '\0';
+                port = atoi(colon + 1);
+            }
+        }
+        else if (inputCount < 64)
+            inputs[inputCount++] = argv[i];
+    }
+    if (iterations <= 0)
+        return usage("bundle");
+    if (!inputCount)
+    {
+        ESP_LOGE(__func__, "No emoji list or tiles given");
+        return usage("bundle");
+    }
+
+    static char keys[BUNDLE_MAX][EMOJI_KEY_MAX];
+    static uint8_t packed[BUNDLE_MAX][EMOJI_PACKED_MAX];
+    static const char *keyList[BUNDLE_MAX];
+    static const uint8_t *packedList[BUNDLE_MAX];
+    static size_t sizes[BUNDLE_MAX];
+    int count = 0;
+
+    OpenSslTransport transport;
+    EmojiServer server;
+    if (standIn && !startStandIn(server, 60000, transport, host, sizeof(host), &port))
+        return 1;
+    HttpsSession session(transport);
+    session.setHost(host, port);
+
+    auto add = [&](const char *key)
+    {
+        snprintf(keys[count], EMOJI_KEY_MAX, "%s", key);
+        emojiFromRGBA(emojiRGBA, emojiFrame, EMOJI_SIZE * EMOJI_SIZE);
+        sizes[count] = emojiPack(emojiFrame, packed[count]);
+        keyList[count] = keys[count];
+        packedList[count] = packed[count];
+        count++;
+    };
+    for (int i = 0; i < inputCount && count < BUNDLE_MAX; i++)
+    {
+        const char *input = inputs[i];
+        size_t len = strlen(input);
+        if (len > 4 && !strcmp(input + len - 4, ".raw"))
+        {
+            // tile named by its key, e.g. tiles/1f600.raw
+            char key[EMOJI_KEY_MAX];
+            const char *name = strrchr(input, '/');
+            name = name ? name + 1 : input;
+            snprintf(key, sizeof(key), "%.*s", (int)(strlen(name) - 4), name);
+            if (!loadRaw(input, emojiRGBA))
+            {
+                ESP_LOGE(__func__, "Failed to read %s", input);
+                return 1;
+            }
+            add(key);
+            continue;
+        }
+
+        FILE *list = fopen(input, "r");
+        if (!list)
+        {
+            ESP_LOGE(__func__, "Failed to read %s", input);
+            return 1;
+        }
+        char line[256];
+        while (fgets(line, sizeof(line), list) && count < BUNDLE_MAX)
+        {
+            char *emoji = strtok(line, " \t\r\n");
+            char key[EMOJI_KEY_MAX];
+            char path[96];
+            size_t length;
+            if (!emoji || emoji[0] == '#')
+                continue;
+            if (!emojiKey(emoji, key, sizeof(key)))
+            {
+                ESP_LOGW(__func__, "Skipping %s, not an emoji", emoji);
+                continue;
+            }
+            snprintf(path, sizeof(path), "/api/v1/%s/32.raw", key);
+            int status = session.get(path, emojiRGBA, sizeof(emojiRGBA), &length);
+            if (status != 200 || length != sizeof(emojiRGBA))
+            {
+                ESP_LOGW(__func__, "Skipping %s, HTTP %d with %zu bytes", key, status, length);
+                continue;
+            }
+            add(key);
+        }
+        fclose(list);
+    }
+
+    if (!count || !EmojiBundle::write(output, keyList, packedList, sizes, count))
+    {
+        ESP_LOGE(__func__, "Failed to write %s", output);
+        return 1;
+    }
+    FILE *file = fopen(output, "rb");
+    fseek(file, 0, SEEK_END);
+    long bytes = ftell(file);
+    fclose(file);
+    printf("wrote %s: %d emojis, %ld bytes (%.0f%% of the spiffs partition)\n", output, count, bytes, 100.0 * bytes / SPIFFS_PARTITION_BYTES);
+
+    // lookup + draw from the bundle vs. the network path on a warm loopback connection
+    esp_log_level_set("*", ESP_LOG_WARN);
+    EmojiBundle reader;
+    if (!reader.begin(output))
+        return 1;
+    uint8_t buffer[EMOJI_PACKED_MAX];
+    size_t size;
+    int misses = 0;
+    bench("bundle get + draw", iterations, [&](int i)
+          {
+        if (reader.get(keys[i % count], buffer, &size))
+            display.drawPackedEmoji(buffer, size);
+        else
+            misses++; });
+    if (misses)
+    {
+        ESP_LOGE(__func__, "%d bundle lookups failed", misses);
+        return 1;
+    }
+
+    OpenSslTransport loopback;
+    EmojiServer origin;
+    char originHost[HTTPS_HOST_MAX];
+    uint16_t originPort;
+    if (!startStandIn(origin, 60000, loopback, originHost, sizeof(originHost), &originPort))
+        return 1;
+    HttpsSession warm(loopback);
+    warm.setHost(originHost, originPort);
+    size_t length;
+    warm.get("/api/v1/1f600/32.raw", emojiRGBA, sizeof(emojiRGBA), &length);
+    char path[96];
+    bench("kept-alive fetch + draw", iterations / 10 + 1, [&](int i)
+          {
+        snprintf(path, sizeof(path), "/api/v1/%s/32.raw", keys[i % count]);
+        warm.get(path, emojiRGBA, sizeof(emojiRGBA), &length);
+        emojiFromRGBA(emojiRGBA, emojiFrame, EMOJI_SIZE * EMOJI_SIZE);
+        size = emojiPack(emojiFrame, buffer);
+        display.drawPackedEmoji(buffer, size); });
+    return 0;
+}
+
+// Run the local emoji origin stand-in until killed
+static int serve(int argc, char **argv)
+{
+    int port = 8443;
+    int idleMs = 60000;
+    const char *certPath = NULL;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "-p"))
+            port = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-c"))
+            certPath = argv[i + 1];
+        else if (!strcmp(argv[i], "--idle"))
+            idleMs = atoi(argv[i + 1]);
+    }
+    if (port < 0 || port > 65535 || idleMs <= 0)
+        return usage("serve");
+    EmojiServer server;
+    if (!server.begin(port, idleMs))
+    {
+        ESP_LOGE(__func__, "Failed to listen on port %d", port);
+        return 1;
+    }
+    if (certPath)
+    {
+        FILE *file = fopen(certPath, "w");
+        if (!file || !PEM_write_X509(file, server.getCertificate()))
+        {
+            ESP_LOGE(__func__, "Failed to write %s", certPath);
+            return 1;
+        }
+        fclose(file);
+    }
+    printf("serving emoji tiles on https://127.0.0.1:%u/api/v1/<codepoints>/32.raw\n", server.getPort());
+    fflush(stdout);
+    server.run();
+    return 0;
+}
+
+// Pack a corpus of emojis (the given .raw files, or the synthetic set) and report size and speed
+static int packBenchmark(int argc, char **argv, Display &display)
+{
+    int iterations = 2000;
+    const char *files[256];
+    int fileCount = 0;
+    for (int i = 0; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (fileCount < 256)
+            files[fileCount++] = argv[i];
+    }
+    if (iterations <= 0)
+        return usage("pack");
+    int count = fileCount ? fileCount : 64;
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    static uint8_t frames[256][EMOJI_FRAME_BYTES];
+    static uint8_t packed[256][EMOJI_PACKED_MAX];
+    size_t sizes[256];
+    size_t total = 0;
+    size_t smallest = EMOJI_PACKED_MAX;
+    size_t largest = 0;
+    int lossless = 0;
+    int maxError = 0;
+    uint8_t decoded[EMOJI_FRAME_BYTES];
+    for (int i = 0; i < count; i++)
+    {
+        if (fileCount)
+        {
+            if (!loadRaw(files[i], emojiRGBA))
+            {
+                ESP_LOGE(__func__, "Failed to read %s", files[i]);
+                return 1;
+            }
+        }
+        else
+            corpusEmoji(i, emojiRGBA);
+        emojiFromRGBA(emojiRGBA, frames[i], EMOJI_SIZE * EMOJI_SIZE);
+        sizes[i] = emojiPack(frames[i], packed[i]);
+        if (!emojiUnpack(packed[i], sizes[i], decoded))
+        {
+            ESP_LOGE(__func__, "Emoji %d failed to decode", i);
+            return 1;
+        }
+        int error = 0;
+        for (int j = 0; j < EMOJI_FRAME_BYTES; j++)
+            error = fmax(error, abs(decoded[j] - frames[i][j]));
+        lossless += error == 0;
+        maxError = error > maxError ? error : maxError;
+        total += sizes[i];
+        smallest = sizes[i] < smallest ? sizes[i] : smallest;
+        largest = sizes[i] > largest ? sizes[i] : largest;
+    }
+
+    printf("%d emojis (%s)\n", count, fileCount ? "files" : "synthetic corpus");
+    printf("%-24s %10.1f bytes (min %zu, max %zu)\n", "packed size", (double)total / count, smallest, largest);
+    printf("%-24s %10.2fx vs RGBA, %.2fx vs RGB888 frame\n", "compression",
+           (double)count * sizeof(emojiRGBA) / total, (double)count * EMOJI_FRAME_BYTES / total);
+    printf("%-24s %10d of %d (max channel error %d)\n", "lossless", lossless, count, maxError);
+
+    bench("emojiPack", iterations, [&](int i)
+          { emojiPack(frames[i % count], packed[i % count]); });
+    bench("emojiUnpack", iterations, [&](int i)
+          { emojiUnpack(packed[i % count], sizes[i % count], decoded); });
+    bench("drawPackedEmoji", iterations, [&](int i)
+          { display.drawPackedEmoji(packed[i % count], sizes[i % count]); });
+    bench("drawEmoji (RGB888)", iterations, [&](int i)
+          { display.drawEmoji(frames[i % count]); });
+    return 0;
+}
+
+// Emoji sequences covering each kind of cluster, with the key emojiapi.dev names it by
+static const struct
+{
+    const char *emoji;
+    const char *key;
+} segmentSamples[] = {
+    {"\U0001F600", "1f600"},                                              // grinning face
+    {"\U0001F44D\U0001F3FD", "1f44d_1f3fd"},                              // thumbs up, skin tone
+    {"\U0001F9D1\u200D\U0001F4BB", "1f9d1_200D_1f4bb"},                   // technologist
+    {"\U0001F469\U0001F3FE\u200D\U0001F692", "1f469_1f3fe_200D_1f692"},   // firefighter, skin tone
+    {"\U0001F468\u200D\U0001F469\u200D\U0001F467\u200D\U0001F466", "1f468_200D_1f469_200D_1f467_200D_1f466"}, // family
+    {"\U0001F1E9\U0001F1EA", "1f1e9_1f1ea"},                              // flag: Germany
+    {"\u2764\uFE0F", "2764"},                                             // red heart, emoji presentation
+    {"\U0001F3F3\uFE0F\u200D\U0001F308", "1f3f3_200D_1f308"},             // rainbow flag
+    {"#\uFE0F\u20E3", "23_20e3"},                                         // keycap
+    {"\U0001F3F4\U000E0067\U000E0062\U000E0065\U000E006E\U000E0067\U000E007F",
+     "1f3f4_e0067_e0062_e0065_e006e_e0067_e007f"},                        // flag: England
+};
+#define SEGMENT_SAMPLES (sizeof(segmentSamples) / sizeof(segmentSamples[0]))
+
+static int segment(int argc, char **argv)
+{
+    int iterations = 100000;
+    int first = argc;
+    for (int i = 0; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else
+        {
+            first = i;
+            break;
+        }
+    }
+    if (iterations <= 0)
+        return usage("segment");
+
+    char key[EMOJI_KEY_MAX];
+    char legacy[EMOJI_KEY_MAX];
+    // keys and clusters of the given strings
+    if (first < argc)
+    {
+        for (int i = first; i < argc; i++)
+        {
+            const char *text = argv[i];
+            size_t len = strlen(text);
+            printf("%s:", text);
+            for (size_t pos = 0, n; (n = graphemeNext(text + pos, len - pos)); pos += n)
+                printf(" [%.*s]", (int)n, text + pos);
+            bool ok = emojiKey(text, key, sizeof(key));
+            printf("\n  key %s\n", ok ? key : "(not an emoji)");
+        }
+        return 0;
+    }
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    printf("%-48s %-24s %s\n", "expected", "emojiKey", "legacy");
+    for (size_t i = 0; i < SEGMENT_SAMPLES; i++)
+    {
+        bool ok = emojiKey(segmentSamples[i].emoji, key, sizeof(key)) && !strcmp(key, segmentSamples[i].key);
+        legacyEmojiKey(segmentSamples[i].emoji, legacy, sizeof(legacy));
+        printf("%-48s %-24s %s\n", segmentSamples[i].key, ok ? "ok" : key, strcmp(legacy, segmentSamples[i].key) ? legacy : "ok");
+    }
+
+    bench("legacy emojiKey", iterations, [&](int i)
+          { legacyEmojiKey(segmentSamples[i % SEGMENT_SAMPLES].emoji, legacy, sizeof(legacy)); });
+    bench("emojiKey", iterations, [&](int i)
+          { emojiKey(segmentSamples[i % SEGMENT_SAMPLES].emoji, key, sizeof(key)); });
+    const char *text = "\U0001F9D1\u200D\U0001F4BB In a meeting \U0001F1E9\U0001F1EA";
+    size_t len = strlen(text);
+    bench("graphemeNext text", iterations, [&](int)
+          {
+        for (size_t pos = 0, n; (n = graphemeNext(text + pos, len - pos)); pos += n)
+            ; });
+    return 0;
+}
+
+// Per string cost of the old print path (Adafruit GFX metrics, pixel by pixel) against
+// the glyph atlas engine, both drawing into the 64x32 text region of a bare framebuffer
+static int textBenchmark(int argc, char **argv)
+{
+    int iterations = 100000;
+    int first = 0;
+    if (argc > 1 && !strcmp(argv[0], "-n"))
+    {
+        iterations = atoi(argv[1]);
+        first = 2;
+    }
+    if (iterations <= 0)
+        return usage("text");
+    static const char *const defaults[] = {
+        "Lunch",
+        "In a meeting",
+        "Out of office until Monday",
+        "Café \U0001F355 at 12:30, back by two",
+    };
+    const char *const *texts = first < argc ? argv + first : defaults;
+    int count = first < argc ? argc - first : sizeof(defaults) / sizeof(defaults[0]);
+
+    Framebuffer frame(DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    if (!frame.begin())
+        return 1;
+    const int16_t height = DISPLAY_HEIGHT - TEXT_Y;
+    for (int t = 0; t < count; t++)
+    {
+        const char *text = texts[t];
+        TextLayout layout;
+        fitText(text, DISPLAY_WIDTH, height, &layout);
+        printf("\"%s\": scale %u, %u lines%s\n", text, layout.scale, layout.lineCount, layout.clipped ? ", clipped" : "");
+        bench("  print", iterations, [&](int)
+              {
+            frame.fillRect(0, TEXT_Y, DISPLAY_WIDTH, height, 0, 0, 0);
+            frame.setTextColor(255, 255, 255);
+            frame.setTextSize(1);
+            frame.setCursor(0, TEXT_Y);
+            frame.print(text); });
+        bench("  fitText", iterations, [&](int)
+              { fitText(text, DISPLAY_WIDTH, height, &layout); });
+        bench("  fitText + draw", iterations, [&](int)
+              {
+            frame.fillRect(0, TEXT_Y, DISPLAY_WIDTH, height, 0, 0, 0);
+            fitText(text, DISPLAY_WIDTH, height, &layout);
+            drawTextLayout(frame, text, layout, 0, TEXT_Y, DISPLAY_WIDTH, height, 255, 255, 255); });
+    }
+    return 0;
+}
+
+// Scroll text the way the marquee task does, frames on a fixed tick from a sleeping loop,
+// and report frame jitter, frame cost and the CPU share of the animation
+static int marquee(int argc, char **argv, MatrixPanel_I2S_DMA &panel, Display &display)
+{
+    const char *text = "Out of office until Monday, ping me on chat for anything urgent";
+    int speed = 24;
+    int fps = 50;
+    int seconds = 3;
+    const char *output = NULL;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "-t"))
+            text = argv[i + 1];
+        else if (!strcmp(argv[i], "-s"))
+            speed = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-f"))
+            fps = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-d"))
+            seconds = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-o"))
+            output = argv[i + 1];
+    }
+    if (fps <= 0 || speed <= 0 || seconds < 0)
+        return usage("marquee");
+
+    if (display.drawText(text))
+    {
+        printf("\"%s\" fits, nothing to scroll\n", text);
+        return 0;
+    }
+    int64_t start = esp_timer_get_time();
+    if (!display.setMarquee(text))
+    {
+        ESP_LOGE(__func__, "Failed to pre-render the marquee strip");
+        return 1;
+    }
+    printf("strip %d px, pre-rendered in %lld us\n", display.getMarqueeWidth(), (long long)(esp_timer_get_time() - start));
+    display.commit();
+
+    FrameTimer timer;
+    int64_t lastUs = esp_timer_get_time();
+    int64_t endUs = lastUs + (int64_t)seconds * 1000000;
+    uint64_t position = 0;
+    uint64_t pixels = 0;
+    timer.begin(1000000 / fps, lastUs);
+    auto wake = std::chrono::steady_clock::now();
+    while (esp_timer_get_time() < endUs)
+    {
+        wake += std::chrono::microseconds(1000000 / fps);
+        std::this_thread::sleep_until(wake);
+        int64_t nowUs = esp_timer_get_time();
+        timer.frameStart(nowUs);
+        position += (uint64_t)(nowUs - lastUs) * speed;
+        lastUs = nowUs;
+        display.drawMarquee(position / 1000000);
+        pixels += display.commit();
+        timer.frameEnd(esp_timer_get_time());
+    }
+    FrameStats stats = timer.getStats(esp_timer_get_time());
+    printf("%u frames at %d fps, %d px/s: %u late\n", stats.frames, fps, speed, stats.late);
+    printf("  jitter  avg %6u us  max %6u us\n", stats.avgJitterUs, stats.maxJitterUs);
+    printf("  frame   avg %6u us  max %6u us  %.1f px written\n", stats.avgFrameUs, stats.maxFrameUs, stats.frames ? (double)pixels / stats.frames : 0.0);
+    printf("  cpu     %.3f%%\n", stats.cpuPpm / 10000.0);
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    bench("marquee frame", 10000, [&](int i)
+          { display.drawMarquee(i); display.commit(); });
+    bench("re-layout frame", 10000, [&](int)
+          { display.drawText(text); display.commit(); });
+    if (output)
+    {
+        display.drawMarquee(position / 1000000);
+        display.commit();
+        if (!saveSnapshot(panel, output))
+        {
+            ESP_LOGE(__func__, "Failed to write %s", output);
+            return 1;
+        }
+        printf("wrote %s\n", output);
+    }
+    return 0;
+}
+
+// Per pixel float pipeline the tables replace: gamma, white balance and a division per channel
+static void referenceColor(const ColorSettings &settings, const uint8_t *px, uint8_t *out)
+{
+    for (int c = 0; c < 3; c++)
+        out[c] = (uint8_t)(powf(px[c] / 255.0f, settings.gamma / 10.0f) * settings.whiteBalance[c] * 255 / 255.0f + 0.5f);
+}
+
+// Compare the color tables with the float pipeline, show how dithering keeps dim ramps
+// apart at low brightness, and time a full redraw through them
+static int colorCheck(int argc, char **argv, MatrixPanel_I2S_DMA &panel, Display &display)
+{
+    int iterations = 2000;
+    const char *output = NULL;
+    ColorSettings settings = {22, {255, 255, 255}, true, false, COLOR_DEPTH_BITS};
+    int brightness = 255;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "-n"))
+            iterations = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-g"))
+            settings.gamma = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-b"))
+            brightness = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-w"))
+            sscanf(argv[i + 1], "%hhu,%hhu,%hhu", &settings.whiteBalance[0], &settings.whiteBalance[1], &settings.whiteBalance[2]);
+        else if (!strcmp(argv[i], "-o"))
+            output = argv[i + 1];
+    }
+    if (iterations <= 0 || settings.gamma < COLOR_GAMMA_MIN || settings.gamma > COLOR_GAMMA_MAX || brightness < 0 ||
+        brightness > 255)
+        return usage("color");
+
+    // how far the 4x4 average of each value lands from the exact one
+    static const uint8_t levels[] = {255, 128, 64, 32, 16, 8};
+    for (uint8_t b : levels)
+    {
+        for (int dither = 0; dither < 2; dither++)
+        {
+            ColorSettings s = settings;
+            s.dither = dither;
+            ColorLut lut;
+            lut.build(s, b);
+            int step = 1 << lut.getDroppedBits();
+            double maxError = 0;
+            int distinct = 0;
+            double last = -1;
+            for (int v = 0; v < 256; v++)
+            {
+                double sum = 0;
+                for (int y = 0; y < 4; y++)
+                {
+                    for (int x = 0; x < 4; x++)
+                    {
+                        // what the panel shows once the dark bit planes are gone
+                        uint8_t level = lut.apply(0, v, x, y);
+                        sum += level & ~(step - 1);
+                    }
+                }
+                double mean = sum / 16;
+                double exact = powf(v / 255.0f, s.gamma / 10.0f) * s.whiteBalance[0];
+                if (fabs(mean - exact) > maxError)
+                    maxError = fabs(mean - exact);
+                if (v < 64 && mean != last)
+                    distinct++;
+                last = v < 64 ? mean : last;
+            }
+            printf("brightness %3u %-9s %u dark planes: max error %5.2f levels, %2d distinct shades in 0..63\n", b,
+                   dither ? "dither" : "no dither", lut.getDroppedBits(), maxError, distinct);
+        }
+    }
+
+    // same result as the float pipeline without dithering
+    ColorSettings plain = settings;
+    plain.dither = false;
+    ColorLut lut;
+    lut.build(plain, 255);
+    int mismatches = 0;
+    for (int v = 0; v < 256; v++)
+    {
+        uint8_t px[3] = {(uint8_t)v, (uint8_t)v, (uint8_t)v};
+        uint8_t expected[3];
+        referenceColor(plain, px, expected);
+        for (int c = 0; c < 3; c++)
+            mismatches += abs(lut.apply(c, v, 0, 0) - expected[c]) > 1;
+    }
+    printf("tables vs float pipeline: %d values off by more than 1\n", mismatches);
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    testEmoji(emojiRGBA);
+    emojiFromRGBA(emojiRGBA, emojiFrame, EMOJI_SIZE * EMOJI_SIZE);
+    display.drawEmoji(emojiFrame);
+    display.drawText("In a meeting");
+    bench("color tables build", iterations, [&](int)
+          { lut.build(settings, brightness); });
+    bench("full redraw, identity", iterations, [&](int)
+          { display.invalidate(); display.commit(); });
+    display.setColor(settings, brightness);
+    bench("full redraw, corrected", iterations, [&](int)
+          { display.invalidate(); display.commit(); });
+    static uint8_t rgb[DISPLAY_WIDTH * DISPLAY_HEIGHT * 3];
+    const uint8_t *source = panel.getFramebuffer();
+    bench("float pipeline per frame", iterations, [&](int)
+          {
+        for (int p = 0; p < DISPLAY_WIDTH * DISPLAY_HEIGHT; p++)
+            referenceColor(settings, &source[p * 3], &rgb[p * 3]); });
+
+    if (output)
+    {
+        // dim ramps in the text half, to compare banding with and without dithering
+        display.clear();
+        display.drawEmoji(emojiFrame);
+        for (int y = TEXT_Y; y < DISPLAY_HEIGHT; y++)
+        {
+            for (int x = 0; x < DISPLAY_WIDTH; x++)
+            {
+                uint8_t v = x;
+                uint8_t px[3] = {y < 40 ? v : (uint8_t)0, y >= 40 && y < 48 ? v : (uint8_t)0, y >= 48 && y < 56 ? v : (uint8_t)0};
+                if (y >= 56)
+                    px[0] = px[1] = px[2] = v;
+                display.blit(x, y, 1, 1, px);
+            }
+        }
+        display.commit();
+        if (!saveSnapshot(panel, output))
+        {
+            ESP_LOGE(__func__, "Failed to write %s", output);
+            return 1;
+        }
+        printf("wrote %s\n", output);
+    }
+    return 0;
+}
+
+// Error of dithered dark ramps at one brightness: grain is how far single pixels stay from
+// the exact value once the eye averages the phases, error is the 4x4 tile average
+static void ditherQuality(const ColorSettings &settings, uint8_t brightness, double *grain, double *maxError, int *shades)
+{
+    ColorLut lut;
+    lut.build(settings, brightness);
+    int step = 1 << lut.getDroppedBits();
+    double squares = 0;
+    double last = -1;
+    *maxError = 0;
+    *shades = 0;
+    for (int v = 0; v < 256; v++)
+    {
+        double exact = powf(v / 255.0f, settings.gamma / 10.0f) * 255;
+        double sum = 0;
+        for (int y = 0; y < 4; y++)
+        {
+            for (int x = 0; x < 4; x++)
+            {
+                double pixel = 0;
+                for (int p = 0; p < COLOR_TEMPORAL_PHASES; p++)
+                {
+                    lut.setPhase(p);
+                    pixel += lut.apply(0, v, x, y) & ~(step - 1);
+                }
+                pixel /= COLOR_TEMPORAL_PHASES;
+                squares += (pixel - exact) * (pixel - exact);
+                sum += pixel;
+            }
+        }
+        double mean = sum / 16;
+        if (fabs(mean - exact) > *maxError)
+            *maxError = fabs(mean - exact);
+        if (v < 64 && mean != last)
+            (*shades)++;
+        last = v < 64 ? mean : last;
+    }
+    *grain = sqrt(squares / (256 * 16)) / step;
+}
+
+// Refresh rate of every color depth and clock choice, what temporal dithering adds over
+// spatial dithering at each brightness, and what a dither frame costs on the simulator
+static int ditherCheck(int argc, char **argv)
+{
+    int iterations = 20000;
+    int depth = COLOR_DEPTH_BITS;
+    int brightness = 16;
+    const char *output = NULL;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "-n"))
+            iterations = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-d"))
+            depth = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-b"))
+            brightness = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-o"))
+            output = argv[i + 1];
+    }
+    if (iterations <= 0 || depth < COLOR_DEPTH_MIN || depth > COLOR_DEPTH_BITS || brightness < 0 || brightness > 255)
+        return usage("dither");
+
+    static const uint32_t clocks[] = {HUB75_I2S_CFG::HZ_10M, HUB75_I2S_CFG::HZ_20M};
+    printf("depth clock  refresh  transition bit  DMA buffer\n");
+    for (int d = COLOR_DEPTH_MIN; d <= COLOR_DEPTH_BITS; d++)
+    {
+        for (uint32_t clock : clocks)
+        {
+            Hub75Timing timing = hub75Timing(PANEL_WIDTH, PANEL_HEIGHT, d, clock, 60);
+            printf("%5d %2u MHz %5u Hz  %14u  %7u KB\n", d, clock / 1000000, timing.refreshHz, timing.transitionBit, timing.dmaBytes / 1024);
+        }
+    }
+
+    // grain and tile average error with spatial dithering alone and with temporal on top
+    static const uint8_t levels[] = {255, 64, 16, 8};
+    for (uint8_t b : levels)
+    {
+        double grain[2];
+        double maxError[2];
+        int shades[2];
+        for (int temporal = 0; temporal < 2; temporal++)
+        {
+            ColorSettings settings = {22, {255, 255, 255}, true, (bool)temporal, (uint8_t)depth};
+            ditherQuality(settings, b, &grain[temporal], &maxError[temporal], &shades[temporal]);
+            printf("depth %d brightness %3u %-8s grain %4.2f steps, max error %5.2f levels, %2d shades in 0..63\n", depth, b,
+                   temporal ? "temporal" : "spatial", grain[temporal], maxError[temporal], shades[temporal]);
+        }
+    }
+
+    HUB75_I2S_CFG mxconfig(PANEL_WIDTH, PANEL_HEIGHT, 1);
+    mxconfig.double_buff = true;
+    mxconfig.setPixelColorDepthBits(depth);
+    MatrixPanel_I2S_DMA panel(mxconfig);
+    Display display;
+    if (!panel.begin() || !display.begin(&panel, true))
+    {
+        ESP_LOGE(__func__, "Failed to start the simulated panel");
+        return 1;
+    }
+    ColorSettings settings = {22, {255, 255, 255}, true, true, (uint8_t)depth};
+    display.setColor(settings, brightness);
+    testEmoji(emojiRGBA);
+    emojiFromRGBA(emojiRGBA, emojiFrame, EMOJI_SIZE * EMOJI_SIZE);
+    display.drawEmoji(emojiFrame);
+    for (int y = TEXT_Y; y < DISPLAY_HEIGHT; y++)
+    {
+        for (int x = 0; x < DISPLAY_WIDTH; x++)
+        {
+            uint8_t px[3] = {(uint8_t)(x * 2), (uint8_t)(x * 2), (uint8_t)(x * 2)};
+            display.blit(x, y, 1, 1, px);
+        }
+    }
+    display.commit();
+    display.ditherFrame();
+
+    // a static frame should only be flipped, the two buffers showing the complementary patterns
+    static uint8_t shown[DISPLAY_WIDTH * DISPLAY_HEIGHT * 3];
+    memcpy(shown, panel.getFramebuffer(), sizeof(shown));
+    panel.resetPixelWrites();
+    uint32_t flips = panel.getFlips();
+    int differing = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        display.ditherFrame();
+        if (i == 0)
+        {
+            for (size_t p = 0; p < sizeof(shown); p++)
+                differing += shown[p] != panel.getFramebuffer()[p];
+        }
+    }
+    printf("static frame: %u pixels written in 100 dither frames, %u flips, %d channels differ between phases\n",
+           panel.getPixelWrites(), panel.getFlips() - flips, differing);
+
+    bench("dither frame, static", iterations, [&](int)
+          { display.ditherFrame(); });
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        display.ditherFrame();
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+    printf("%-24s %10.0f ppm CPU at 60 fps\n", "dither frame, static", us * 60);
+    bench("commit text change", std::max(iterations / 10, 1), [&](int i)
+          { display.drawText(i & 1 ? "Busy" : "Free"); display.commit(); });
+    bench("commit + dither frame", std::max(iterations / 10, 1), [&](int i)
+          { display.drawText(i & 1 ? "Busy" : "Free"); display.commit(); display.ditherFrame(); });
+
+    if (output)
+    {
+        if (!saveSnapshot(panel, output))
+        {
+            ESP_LOGE(__func__, "Failed to write %s", output);
+            return 1;
+        }
+        printf("wrote %s\n", output);
+    }
+    return 0;
+}
+
+// Restart the simulated driver with other clock and depth settings the way
+// Panel::reinitDisplay does, compare the frame that comes back with what a fresh driver
+// shows, and time the restart
+static int reinitCheck(int argc, char **argv)
+{
+    int iterations = 1000;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "-n"))
+            iterations = atoi(argv[i + 1]);
+    }
+    if (iterations <= 0)
+        return usage("reinit");
+
+    static const struct
+    {
+        HUB75_I2S_CFG::clk_speed clock;
+        uint8_t depth;
+    } configs[] = {{HUB75_I2S_CFG::HZ_20M, 8}, {HUB75_I2S_CFG::HZ_10M, 6}, {HUB75_I2S_CFG::HZ_20M, 5}, {HUB75_I2S_CFG::HZ_10M, 8}};
+    const int count = sizeof(configs) / sizeof(configs[0]);
+    HUB75_I2S_CFG mxconfig(PANEL_WIDTH, PANEL_HEIGHT, 1);
+    mxconfig.double_buff = true;
+    ColorSettings settings = {22, {255, 255, 255}, true, false, COLOR_DEPTH_BITS};
+    testEmoji(emojiRGBA);
+    emojiFromRGBA(emojiRGBA, emojiFrame, EMOJI_SIZE * EMOJI_SIZE);
+    auto compose = [&](Display &display)
+    {
+        display.drawEmoji(emojiFrame);
+        display.drawText("In a meeting");
+    };
+
+    MatrixPanel_I2S_DMA *panel = new MatrixPanel_I2S_DMA(mxconfig);
+    Display display;
+    if (!panel->begin() || !display.begin(panel, true))
+    {
+        ESP_LOGE(__func__, "Failed to start the simulated panel");
+        delete panel;
+        return 1;
+    }
+    display.setColor(settings, 255);
+    compose(display);
+    display.commit();
+
+    // what Panel::reinitDisplay does with the driver and the display
+    auto restart = [&](int i)
+    {
+        mxconfig.i2sspeed = configs[i % count].clock;
+        mxconfig.setPixelColorDepthBits(configs[i % count].depth);
+        settings.depthBits = configs[i % count].depth;
+        delete panel;
+        panel = new MatrixPanel_I2S_DMA(mxconfig);
+        if (!panel->begin())
+            return (uint32_t)0;
+        display.setPanel(panel, mxconfig.double_buff);
+        display.setColor(settings, 255);
+        return display.commit();
+    };
+
+    for (int i = 0; i < count; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        uint32_t pixels = restart(i);
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        MatrixPanel_I2S_DMA fresh(mxconfig);
+        Display reference;
+        if (!fresh.begin() || !reference.begin(&fresh, true))
+        {
+            ESP_LOGE(__func__, "Failed to start the simulated panel");
+            delete panel;
+            return 1;
+        }
+        reference.setColor(settings, 255);
+        compose(reference);
+        reference.commit();
+        int differing = 0;
+        for (int p = 0; p < DISPLAY_WIDTH * DISPLAY_HEIGHT * 3; p++)
+            differing += panel->getFramebuffer()[p] != fresh.getFramebuffer()[p];
+        printf("%2u MHz %u bits: %4u pixels restored in %6.1f us, %d channels differ from a fresh start\n",
+               configs[i].clock / 1000000, configs[i].depth, pixels, us, differing);
+    }
+    bench("driver restart", iterations, restart);
+    delete panel;
+    return 0;
+}
+
+// Time record() on one thread and on several at once, and a scrape of a histogram filled
+// with spread out durations
+static int metricsCheck(int argc, char **argv)
+{
+    int iterations = 1000000;
+    bool verbose = false;
+    for (int i = 0; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-v"))
+            verbose = true;
+    }
+    if (iterations <= 0)
+        return usage("metrics");
+
+    Histogram histogram("status_test_seconds", "Test durations");
+    srand(1);
+    for (int i = 0; i < 10000; i++)
+        histogram.record(1u << (rand() % 24) | rand() % 1024);
+
+    // relaxed adds from several tasks, scraped while they record
+    Histogram shared("status_shared_seconds", "Concurrent durations");
+    std::thread threads[4];
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < 4; t++)
+    {
+        threads[t] = std::thread([&shared, iterations, t]()
+                                 {
+            for (int i = 0; i < iterations / 4; i++)
+                shared.record((i * 7919 + t) % 100000); });
+    }
+    char scrape[4096];
+    int scrapes = 0;
+    while (shared.getCount() < (uint32_t)(iterations / 4) * 4)
+    {
+        shared.format(scrape, sizeof(scrape));
+        scrapes++;
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    printf("4 threads: %u records in %.0f us, %d scrapes meanwhile\n", shared.getCount(), us, scrapes);
+
+    bench("histogram record", iterations, [&](int i)
+          { histogram.record(i & 0xFFFFF); });
+    bench("histogram format", 10000, [&](int)
+          { histogram.format(scrape, sizeof(scrape)); });
+    bench("gauge format", 10000, [&](int i)
+          { formatMetric(scrape, sizeof(scrape), "status_panel_refresh_hz", "gauge", "Refresh rate", i); });
+    if (verbose)
+    {
+        formatMetric(scrape, sizeof(scrape), "status_panel_refresh_hz", "gauge", "Refresh rate estimated from the driver configuration", 75);
+        fputs(scrape, stdout);
+        histogram.format(scrape, sizeof(scrape));
+        fputs(scrape, stdout);
+    }
+    return 0;
+}
+
+// Cost of a task profiler sample with a full task list, and of the profiler state
+static int tasksCheck(int argc, char **argv)
+{
+    int iterations = 100000;
+    for (int i = 0; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+    }
+    if (iterations <= 0)
+        return usage("tasks");
+
+    static char names[PROFILE_TASKS_MAX][PROFILE_NAME_LEN];
+    TaskSample samples[PROFILE_TASKS_MAX];
+    for (int t = 0; t < PROFILE_TASKS_MAX; t++)
+    {
+        snprintf(names[t], sizeof(names[t]), "task%d", t);
+        samples[t] = {names[t], 100u + t, 0, 1000, 1};
+    }
+    static TaskProfiler profiler;
+    printf("%d tasks, %d snapshots: %d bytes of profiler state\n", PROFILE_TASKS_MAX, PROFILE_HISTORY, (int)sizeof(TaskProfiler));
+    bench("profiler sample", iterations, [&](int i)
+          {
+        for (int t = 0; t < PROFILE_TASKS_MAX; t++)
+            samples[t].runtime += t * 10;
+        profiler.sample(i, samples, PROFILE_TASKS_MAX, i * 1000); });
+    return 0;
+}
+
+// OpenSSL allocations of the heap command, charged to HEAP_TAG_TLS like mbedTLS on the device
+static void *tlsMalloc(size_t size, const char *, int)
+{
+    return heapTagMalloc(HEAP_TAG_TLS, size, false);
+}
+
+static void *tlsRealloc(void *pointer, size_t size, const char *, int)
+{
+    return heapTagRealloc(HEAP_TAG_TLS, pointer, size, false);
+}
+
+static void tlsFree(void *pointer, const char *, int)
+{
+    heapTagFree(HEAP_TAG_TLS, pointer);
+}
+
+static void heapTagsNow(HeapTagStats stats[HEAP_TAGS])
+{
+    for (int tag = 0; tag < HEAP_TAGS; tag++)
+        stats[tag] = heapTagStats((HeapTag)tag);
+}
+
+// Allocations per operation of a replayed flow, by tag
+static void heapReport(const char *flow, int ops, const HeapTagStats before[HEAP_TAGS])
+{
+    for (int tag = 0; tag < HEAP_TAGS; tag++)
+    {
+        HeapTagStats after = heapTagStats((HeapTag)tag);
+        uint32_t allocs = after.allocs - before[tag].allocs;
+        if (!allocs)
+            continue;
+        printf("%-16s %-9s %8.1f allocs/op %10.1f bytes/op  peak %7u  live %+d\n", flow, heapTagName((HeapTag)tag), (double)allocs / ops,
+               (double)(after.allocated - before[tag].allocated) / ops, after.peak, (int)(after.live - before[tag].live));
+    }
+}
+
+// Replay the setEmoji and checkForUpdates network flows against the local stand-in origin
+// and report heap allocations per operation by tag. The origin runs in a child process so
+// only the device side of the TLS connections is charged. ArduinoJson is not part of the
+// host build, the update check charges the filter and document capacities of the device.
+static int heapCheck(int argc, char **argv, Display &display)
+{
+    int iterations = 20;
+    int releases = 30;
+    for (int i = 0; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            releases = atoi(argv[++i]);
+    }
+    if (iterations <= 1 || releases < 0)
+        return usage("heap");
+
+    int pipeFds[2];
+    if (pipe(pipeFds))
+    {
+        ESP_LOGE(__func__, "Failed to create a pipe to the stand-in origin");
+        return 1;
+    }
+    pid_t child = fork();
+    if (!child)
+    {
+        close(pipeFds[0]);
+        EmojiServer server;
+        server.setReleases(releases);
+        if (!server.begin(0, 60000))
+            _exit(1);
+        FILE *out = fdopen(pipeFds[1], "w");
+        fprintf(out, "%u\n", server.getPort());
+        PEM_write_X509(out, server.getCertificate());
+        fclose(out);
+        server.run();
+        _exit(0);
+    }
+    close(pipeFds[1]);
+
+    int failures = 0;
+    if (!CRYPTO_set_mem_functions(tlsMalloc, tlsRealloc, tlsFree))
+    {
+        printf("OpenSSL allocated before the hooks were set, TLS is not tagged\n");
+        failures++;
+    }
+    unsigned port = 0;
+    FILE *in = fdopen(pipeFds[0], "r");
+    X509 *cert = fscanf(in, "%u\n", &port) == 1 ? PEM_read_X509(in, NULL, NULL, NULL) : NULL;
+    fclose(in);
+    if (!cert)
+    {
+        ESP_LOGE(__func__, "Stand-in origin did not start");
+        kill(child, SIGTERM);
+        waitpid(child, NULL, 0);
+        return 1;
+    }
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    HeapTagStats before[HEAP_TAGS];
+    {
+        // setEmoji: cache misses, downloaded over the kept alive emoji session, packed and drawn
+        OpenSslTransport transport;
+        transport.trust(cert);
+        HttpsSession session(transport);
+        session.setHost("127.0.0.1", port);
+        const char *emojis[] = {"\xF0\x9F\x98\x80", "\xF0\x9F\xA7\x91\xE2\x80\x8D\xF0\x9F\x92\xBB", "\xF0\x9F\x91\x8D", "\xE2\x98\x95"};
+        static uint8_t packed[EMOJI_PACKED_MAX];
+        char key[EMOJI_KEY_MAX];
+        char path[96];
+        size_t length;
+        heapTagsNow(before);
+        for (int i = 0; i < iterations; i++)
+        {
+            // the first download pays for the connection
+            if (i == 1)
+            {
+                heapReport("setEmoji connect", 1, before);
+                heapTagsNow(before);
+            }
+            emojiKey(emojis[i % 4], key, sizeof(key));
+            snprintf(path, sizeof(path), "/api/v1/%s/32.raw", key);
+            if (session.get(path, emojiRGBA, sizeof(emojiRGBA), &length) != 200 || length != sizeof(emojiRGBA))
+                failures++;
+            emojiFromRGBA(emojiRGBA, emojiFrame, EMOJI_SIZE * EMOJI_SIZE);
+            if (!display.drawPackedEmoji(packed, emojiPack(emojiFrame, packed)))
+                failures++;
+            display.commit();
+        }
+        heapReport("setEmoji", iterations - 1, before);
+        heapTagsNow(before);
+        session.close();
+    }
+    heapReport("  session closed", 1, before);
+
+    // checkForUpdates in development mode: a conditional request on the release list a
+    // minute apart, so on a resumed connection. Only the first sees a changed feed, scans it
+    // for the newest prerelease as it streams in and goes on to its firmware on another connection.
+    char path[128];
+    snprintf(path, sizeof(path), "/repos/%s/releases", "elliotmatson/esp32-hub75-status");
+    uint32_t tlsLiveAfterFirst = 0;
+    {
+        OpenSslTransport transport;
+        transport.trust(cert);
+        HttpsSession session(transport);
+        session.setHost("127.0.0.1", port);
+        UpdateChecker checker(session, 60000, 3600000);
+        ReleaseFeed feed;
+        heapTagsNow(before);
+        for (int i = 0; i < iterations; i++)
+        {
+            if (i == 1)
+            {
+                heapReport("update changed", 1, before);
+                heapTagsNow(before);
+            }
+            session.close();
+            feed.reset(true, "esp32.bin");
+            UpdateCheckResult result = checker.check(path, &feed);
+            ReleaseInfo release;
+            if (result == UPDATE_CHANGED && feed.getRelease(&release))
+            {
+                OpenSslTransport firmwareTransport;
+                firmwareTransport.trust(cert);
+                HttpsSession firmwareSession(firmwareTransport);
+                firmwareSession.setHost("127.0.0.1", port);
+                char firmware[128];
+                snprintf(firmware, sizeof(firmware), "/elliotmatson/esp32-hub75-status/releases/download/%s/esp32.bin", release.tag);
+                size_t length;
+                firmwareSession.get(firmware, NULL, 0, &length);
+            }
+            if (result != (i ? UPDATE_UNCHANGED : UPDATE_CHANGED))
+                failures++;
+            checker.done(result);
+            if (!i)
+                tlsLiveAfterFirst = heapTagStats(HEAP_TAG_TLS).live;
+        }
+        heapReport("update unchanged", iterations - 1, before);
+        session.close();
+    }
+    // after the first check, whatever OpenSSL caches is in place, later checks must not grow
+    int growth = (int)(heapTagStats(HEAP_TAG_TLS).live - tlsLiveAfterFirst);
+    printf("TLS live growth over %d more checks: %d bytes, JSON live %u\n", iterations - 1, growth, heapTagStats(HEAP_TAG_JSON).live);
+    if (growth > 0 || heapTagStats(HEAP_TAG_JSON).live)
+        failures++;
+    X509_free(cert);
+    kill(child, SIGTERM);
+    waitpid(child, NULL, 0);
+
+    // fragmentation score and the snapshot ring
+    static const struct
+    {
+        uint32_t freeBytes;
+        uint32_t largest;
+        uint16_t expected;
+    } regions[] = {{0, 0, 0}, {1000, 1000, 0}, {1000, 500, 500}, {100000, 1000, 990}, {4000000, 4000000, 0}, {120000, 119999, 1}};
+    for (const auto &region : regions)
+    {
+        if (heapFragmentation(region.freeBytes, region.largest) != region.expected)
+        {
+            printf("free %u, largest %u: %u per mille, expected %u\n", region.freeBytes, region.largest,
+                   heapFragmentation(region.freeBytes, region.largest), region.expected);
+            failures++;
+        }
+    }
+    static HeapHistory history;
+    for (int i = 0; i < HEAP_HISTORY + 3; i++)
+        history.sample(i * 10000000LL, {200000, (uint32_t)(200000 - i * 5000), 0}, {4000000, 4000000, 0});
+    const HeapSnapshot &newest = history.get(0);
+    printf("%d snapshots kept, newest internal fragmentation %u per mille, oldest %u\n", history.size(),
+           newest.internal.fragmentation, history.get(history.size() - 1).internal.fragmentation);
+    if (history.size() != HEAP_HISTORY || newest.internal.fragmentation != 850 || history.get(HEAP_HISTORY - 1).internal.fragmentation != 75 ||
+        newest.live[HEAP_TAG_FRAME] != heapTagStats(HEAP_TAG_FRAME).live)
+        failures++;
+
+    bench("malloc/free", 1000000, [&](int i)
+          { void *volatile block = malloc(64 + (i & 255)); free(block); });
+    bench("heapTagMalloc/free", 1000000, [&](int i)
+          { heapTagFree(HEAP_TAG_JSON, heapTagMalloc(HEAP_TAG_JSON, 64 + (i & 255))); });
+    return failures ? 1 : 0;
+}
+
+// Poll the stand-in GitHub API like checkForUpdates does: the first check sees the feed, the
+// following ones must be 304s on resumed connections until a release is added. An outage
+// must back off and recover, and validators must survive a reboot.
+static int updatesCheck(int argc, char **argv)
+{
+    int checks = 20;
+    int releases = 30;
+    for (int i = 0; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            checks = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            releases = atoi(argv[++i]);
+    }
+    if (checks <= 0 || releases <= 0)
+        return usage("updates");
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    OpenSslTransport transport;
+    EmojiServer server;
+    server.setReleases(releases);
+    char host[HTTPS_HOST_MAX];
+    uint16_t port;
+    if (!startStandIn(server, 60000, transport, host, sizeof(host), &port))
+        return 1;
+    HttpsSession session(transport);
+    session.setHost(host, port);
+    session.setHeaders("User-Agent: status/DEV\r\nAccept: application/vnd.github+json\r\n");
+    const uint32_t intervalMs = 60000;
+    const uint32_t maxBackoffMs = 3600000;
+    UpdateChecker checker(session, intervalMs, maxBackoffMs);
+    checker.seed(1);
+    const char *feed = "/repos/elliotmatson/esp32-hub75-status/releases";
+    int failures = 0;
+
+    // checks are a minute apart, past the idle timeout, so every one reconnects
+    auto poll = [&](UpdateChecker &checker, const char *path, UpdateCheckResult expected, const char *what)
+    {
+        session.close();
+        UpdateCheckResult result = checker.check(path);
+        uint32_t delayMs = checker.done(result);
+        if (result != expected)
+        {
+            printf("%s: result %d (status %d), expected %d\n", what, result, checker.getStats().lastStatus, expected);
+            failures++;
+        }
+        return delayMs;
+    };
+
+    poll(checker, feed, UPDATE_CHANGED, "first check");
+    if (!checker.takeCacheChanged() || !checker.getCache().validators.etag[0])
+        failures++;
+    uint32_t requests = server.getReleaseRequests();
+    uint64_t bytes = server.getReleaseBytes();
+    HttpsSessionStats before = session.getStats();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < checks; i++)
+    {
+        if (poll(checker, feed, UPDATE_UNCHANGED, "unchanged feed") != intervalMs)
+            failures++;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / checks;
+    HttpsSessionStats after = session.getStats();
+    printf("first check: %llu byte feed (%d releases), ETag %s\n", (unsigned long long)bytes, releases, checker.getCache().validators.etag);
+    printf("%d unchanged checks: %u requests, %u not modified, %llu body bytes, %u of %u handshakes resumed, %.3f ms/check\n", checks,
+           server.getReleaseRequests() - requests, server.getNotModified(), (unsigned long long)(server.getReleaseBytes() - bytes),
+           after.resumed - before.resumed, after.handshakes - before.handshakes, ms);
+    if (server.getNotModified() != (uint32_t)checks || server.getReleaseBytes() != bytes || checker.takeCacheChanged())
+        failures++;
+
+    // a new release changes the feed once
+    server.setReleases(releases + 1);
+    poll(checker, feed, UPDATE_CHANGED, "new release");
+    poll(checker, feed, UPDATE_UNCHANGED, "after new release");
+    if (!checker.takeCacheChanged())
+        failures++;
+
+    // an outage: each retry waits about twice as long, the first success resets the interval
+    server.failReleases(5);
+    uint32_t delays[5];
+    for (int i = 0; i < 5; i++)
+    {
+        delays[i] = poll(checker, feed, UPDATE_FAILED, "outage");
+        uint32_t backoff = intervalMs << (i + 1);
+        if (delays[i] < backoff / 2 || delays[i] > backoff)
+        {
+            printf("failure %d: %u ms, expected %u to %u\n", i + 1, delays[i], backoff / 2, backoff);
+            failures++;
+        }
+    }
+    printf("backoff after 5 failures: %u %u %u %u %u s\n", delays[0] / 1000, delays[1] / 1000, delays[2] / 1000, delays[3] / 1000, delays[4] / 1000);
+    if (poll(checker, feed, UPDATE_UNCHANGED, "after outage") != intervalMs || checker.getStats().consecutiveFailures)
+        failures++;
+
+    // validators loaded from NVS after a reboot, and a switch to the latest release feed
+    UpdateChecker rebooted(session, intervalMs, maxBackoffMs);
+    rebooted.setCache(checker.getCache());
+    poll(rebooted, feed, UPDATE_UNCHANGED, "after reboot");
+    poll(rebooted, "/repos/elliotmatson/esp32-hub75-status/releases/latest", UPDATE_CHANGED, "other feed");
+    poll(rebooted, "/repos/elliotmatson/esp32-hub75-status/releases/latest", UPDATE_UNCHANGED, "other feed again");
+    printf("%s\n", failures ? "FAILED" : "ok");
+    session.close();
+    return failures ? 1 : 0;
+}
+
+// Synthetic GitHub release list of at least size bytes, shaped like the real one with the
+// traps a careless scanner falls for: tag_name and name keys in nested objects and in
+// escaped release notes, drafts, tags too long to keep, and dates in no particular order.
+// The newest release each mode should pick is worked out on the side.
+struct ReleaseFeedSample
+{
+    std::string json;
+    int releases;
+    ReleaseInfo newest;       // any release with the asset
+    ReleaseInfo newestPre;    // prereleases only
+};
+
+static ReleaseFeedSample releaseFeedSample(size_t size, bool prereleases)
+{
+    ReleaseFeedSample sample = {"[", 0, {"", -1, false}, {"", -1, false}};
+    char part[1024];
+    while (sample.json.size() < size)
+    {
+        int i = sample.releases++;
+        // 2019 to 2026, second resolution
+        int64_t published = 1546300800LL + (int64_t)(rand() % 8000) * 30000 + rand() % 30000;
+        time_t seconds = published;
+        struct tm tm;
+        gmtime_r(&seconds, &tm);
+        char date[32];
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &tm);
+        bool draft = rand() % 10 == 0;
+        bool prerelease = prereleases && rand() % 3 == 0;
+        bool longTag = rand() % 50 == 0;
+        char tag[96];
+        snprintf(tag, sizeof(tag), longTag ? "v%d.%d.0-nightly-build-with-a-rather-long-suffix-%08d" : "v%d.%d.%d", i / 100, i % 100, i);
+        int assets = rand() % 4;
+        bool hasAsset = false;
+
+        snprintf(part, sizeof(part),
+                 "%s\n  {\n    \"url\": \"https://api.github.com/repos/elliotmatson/esp32-hub75-status/releases/%d\",\n"
+                 "    \"author\": {\"login\": \"elliotmatson\", \"id\": 1234, \"tag_name\": \"v9.9.9\", \"site_admin\": false},\n"
+                 "    \"id\": %d, \"node_id\": \"RE_kwDOH%07d\", \"name\": \"esp32.bin\",\n"
+                 "    \"tag_name\": \"%s\", \"target_commitish\": \"main\", \"draft\": %s, \"prerelease\": %s,\n"
+                 "    \"created_at\": \"2018-01-01T00:00:00Z\", \"published_at\": \"%s%sZ\",\n    \"assets\": [",
+                 i ? "," : "", 1000 + i, 1000 + i, i, tag, draft ? "true" : "false", prerelease ? "true" : "false",
+                 date, rand() % 4 ? "" : ".125");
+        sample.json += part;
+        for (int a = 0; a < assets; a++)
+        {
+            static const char *const names[] = {"esp32.bin", "esp32s3.bin", "source.zip", "esp32.bin.sig"};
+            const char *name = names[rand() % 4];
+            hasAsset |= !strcmp(name, "esp32.bin");
+            snprintf(part, sizeof(part),
+                     "%s{\"url\": \"https://api.github.com/repos/x/y/releases/assets/%d\", \"id\": %d, \"name\": \"%s\", \"label\": null,\n"
+                     "      \"uploader\": {\"login\": \"github-actions[bot]\", \"name\": \"esp32.bin\", \"type\": \"Bot\"},\n"
+                     "      \"size\": %d, \"download_count\": %d, \"created_at\": \"2018-01-01T00:00:00Z\"}",
+                     a ? ", " : "", i * 4 + a, i * 4 + a, name, 1200000 + rand() % 100000, rand() % 1000);
+            sample.json += part;
+        }
+        // long notes with every kind of escape, including what looks like the fields
+        sample.json += "],\n    \"body\": \"## What\\u2019s changed\\r\\n* \\\"tag_name\\\": \\\"v99.0.0\\\", \\\"draft\\\": false\\r\\n";
+        for (int line = rand() % 20; line > 0; line--)
+            sample.json += "* Fixed a thing in the render path \\\\ and the [marquee](https://example.com/a/b) \\t\\u00e9\\r\\n";
+        sample.json += "\",\n    \"reactions\": {\"+1\": 3, \"-1\": 0, \"total_count\": 3e0}, \"mentions_count\": -1.5E+2\n  }";
+
+        if (draft || longTag || !hasAsset)
+            continue;
+        ReleaseInfo info = {};
+        memcpy(info.tag, tag, strlen(tag) + 1);
+        info.publishedAt = published;
+        info.prerelease = prerelease;
+        if (info.publishedAt > sample.newest.publishedAt)
+            sample.newest = info;
+        if (prerelease && info.publishedAt > sample.newestPre.publishedAt)
+            sample.newestPre = info;
+    }
+    sample.json += "\n]\n";
+    return sample;
+}
+
+// Push a document into feed in random pieces, mostly network sized with runs of tiny ones
+static bool feedInPieces(ReleaseFeed &feed, const std::string &json)
+{
+    for (size_t at = 0; at < json.size();)
+    {
+        size_t n = rand() % 8 ? 1 + rand() % 1460 : 1 + rand() % 3;
+        n = std::min(n, json.size() - at);
+        if (!feed.write((const uint8_t *)&json[at], n))
+            return false;
+        at += n;
+    }
+    return true;
+}
+
+// Stream release lists of several MB through the scanner checkForUpdates uses, in random
+// pieces, and check it picks the same release as a full parse would, in a fixed amount of
+// memory, at what throughput. The stand-in release feed end to end after.
+static int releasesCheck(int argc, char **argv)
+{
+    int megabytes = 4;
+    int iterations = 5;
+    for (int i = 0; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            megabytes = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+    }
+    if (megabytes <= 0 || iterations <= 0)
+        return usage("releases");
+    esp_log_level_set("*", ESP_LOG_WARN);
+    int failures = 0;
+    srand(1);
+
+    auto expect = [&](const char *what, const ReleaseFeed &feed, const char *tag)
+    {
+        ReleaseInfo release;
+        bool found = feed.getRelease(&release);
+        if (!feed.finished() || found != (tag != NULL) || (found && strcmp(release.tag, tag)))
+        {
+            printf("%s: %s, picked %s, expected %s\n", what, feed.finished() ? "finished" : feed.getError() ? feed.getError() : "unfinished",
+                   found ? release.tag : "none", tag ? tag : "none");
+            failures++;
+        }
+    };
+
+    ReleaseFeed feed;
+    double seconds = 0;
+    uint64_t bytes = 0;
+    for (int i = 0; i < iterations; i++)
+    {
+        ReleaseFeedSample sample = releaseFeedSample((size_t)megabytes << 20, i % 2 == 0);
+        for (int prereleases = 0; prereleases < 2; prereleases++)
+        {
+            const ReleaseInfo &newest = prereleases ? sample.newestPre : sample.newest;
+            feed.reset(prereleases, "esp32.bin");
+            struct mallinfo2 heapBefore = mallinfo2();
+            auto start = std::chrono::steady_clock::now();
+            bool ok = feedInPieces(feed, sample.json);
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            struct mallinfo2 heapAfter = mallinfo2();
+            bytes += sample.json.size();
+            if (!ok || heapAfter.uordblks != heapBefore.uordblks || heapAfter.hblkhd != heapBefore.hblkhd)
+            {
+                printf("feed %d: %s, heap in use %zu -> %zu\n", i, ok ? "ok" : feed.getError(), heapBefore.uordblks, heapAfter.uordblks);
+                failures++;
+            }
+            if (feed.getReleases() != (uint32_t)sample.releases)
+                failures++;
+            expect(prereleases ? "newest prerelease" : "newest release", feed, newest.publishedAt < 0 ? NULL : newest.tag);
+            ReleaseInfo release;
+            if (feed.getRelease(&release) && (release.publishedAt != newest.publishedAt || release.prerelease != newest.prerelease))
+                failures++;
+        }
+        if (!i)
+            printf("%.1f MB feed, %d releases, newest %s, newest prerelease %s\n", sample.json.size() / 1048576.0, sample.releases,
+                   sample.newest.tag, sample.newestPre.publishedAt < 0 ? "none" : sample.newestPre.tag);
+    }
+    printf("%.1f MB scanned at %.1f MB/s, scanner state %zu bytes whatever the feed size\n", bytes / 1048576.0, bytes / 1048576.0 / seconds,
+           sizeof(ReleaseFeed));
+
+    // end to end: the stand-in release list through a conditional check, like checkForUpdates
+    OpenSslTransport transport;
+    EmojiServer server;
+    const int releases = 2000;
+    server.setReleases(releases);
+    char host[HTTPS_HOST_MAX];
+    uint16_t port;
+    if (!startStandIn(server, 60000, transport, host, sizeof(host), &port))
+        return 1;
+    HttpsSession session(transport);
+    session.setHost(host, port);
+    UpdateChecker checker(session, 60000, 3600000);
+    // the stand-in dates version v0.N.0 to 2024-(N % 12 + 1)-(N % 28 + 1), every third a prerelease
+    int newest = 0;
+    for (int version = releases; version > 0; version--)
+    {
+        if (version % 3 == 0 && (!newest || (version % 12) * 28 + version % 28 > (newest % 12) * 28 + newest % 28))
+            newest = version;
+    }
+    char tag[RELEASE_TAG_MAX];
+    snprintf(tag, sizeof(tag), "v0.%d.0", newest);
+    feed.reset(true, "esp32.bin");
+    UpdateCheckResult result = checker.check("/repos/elliotmatson/esp32-hub75-status/releases", &feed);
+    checker.done(result);
+    printf("stand-in: %u byte feed, %u releases\n", (unsigned)server.getReleaseBytes(), feed.getReleases());
+    if (result != UPDATE_CHANGED || feed.getReleases() != (uint32_t)releases)
+        failures++;
+    expect("stand-in newest prerelease", feed, tag);
+    snprintf(tag, sizeof(tag), "v0.%d.0", releases);
+    feed.reset(false, "esp32.bin");
+    result = checker.check("/repos/elliotmatson/esp32-hub75-status/releases/latest", &feed);
+    if (result != UPDATE_CHANGED)
+        failures++;
+    expect("stand-in latest", feed, tag);
+    session.close();
+    printf("%s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
+
+// Running image and OTA partition in memory for the patch command
+class MemorySource : public FirmwareSource {
+    public:
+        MemorySource(const std::string &image) : image(image) {}
+
+        bool read(uint32_t offset, uint8_t *data, size_t len) override
+        {
+            if (offset > image.size() || len > image.size() - offset)
+                return false;
+            memcpy(data, &image[offset], len);
+            return true;
+        }
+
+    private:
+        const std::string &image;
+};
+
+class MemoryTarget : public FirmwareTarget {
+    public:
+        std::string image;
+        bool begun = false;
+        uint32_t writes = 0;
+
+        bool begin(uint32_t size) override
+        {
+            begun = true;
+            image.clear();
+            image.reserve(size);
+            return true;
+        }
+
+        bool write(const uint8_t *data, size_t len) override
+        {
+            image.append((const char *)data, len);
+            writes++;
+            return true;
+        }
+};
+
+static bool readImage(const char *path, std::string *image)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+    char buffer[65536];
+    size_t n;
+    image->clear();
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        image->append(buffer, n);
+    fclose(file);
+    return !image->empty();
+}
+
+// Next build of an image without a second build at hand: new code inserted in a few places,
+// with every aligned word that looks like an address into the image moved along, as the
+// linker does to literal pools and vtables. Real builds are better, see patchCheck.
+static std::string nextBuild(const std::string &image)
+{
+    std::string next = image;
+    size_t at[3] = {image.size() / 5, image.size() / 2, image.size() * 4 / 5};
+    size_t added[3];
+    for (int i = 2; i >= 0; i--)
+    {
+        at[i] &= ~(size_t)3;
+        added[i] = (200 + rand() % 1800) & ~3;
+        std::string code(added[i], 0);
+        for (char &c : code)
+            c = rand();
+        next.insert(at[i], code);
+    }
+    for (size_t offset = 0; offset + 4 <= next.size(); offset += 4)
+    {
+        uint32_t word;
+        memcpy(&word, &next[offset], 4);
+        if (word < 0x1000 || word >= image.size())
+            continue;
+        for (int i = 0; i < 3; i++)
+            word += word >= at[i] ? added[i] : 0;
+        memcpy(&next[offset], &word, 4);
+    }
+    return next;
+}
+
+// Push a stream through FirmwareStream in network sized pieces, true if the target got the image
+static bool applyFirmware(FirmwareStream &stream, MemoryTarget &target, MemorySource *source, const std::string &data)
+{
+    stream.reset(&target, source);
+    for (size_t at = 0; at < data.size();)
+    {
+        size_t n = std::min((size_t)(1 + rand() % 1460), data.size() - at);
+        if (!stream.write((const uint8_t *)&data[at], n))
+            return false;
+        at += n;
+    }
+    return stream.finish();
+}
+
+// Patch size and apply time for an image and its next build: plain, LZSS compressed and as a
+// delta against the running image. Pass the esp32.bin of two consecutive builds (the
+// running one first), without them the simulator binary and a modelled next build are used.
+// -o and -z write the patch and the compressed image, for release assets.
+static int patchCheck(int argc, char **argv)
+{
+    int iterations = 5;
+    const char *patchPath = NULL;
+    const char *compressedPath = NULL;
+    const char *paths[2] = {NULL, NULL};
+    int files = 0;
+    for (int i = 0; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            patchPath = argv[++i];
+        else if (!strcmp(argv[i], "-z") && i + 1 < argc)
+            compressedPath = argv[++i];
+        else if (files < 2)
+            paths[files++] = argv[i];
+    }
+    if (iterations <= 0 || files == 1)
+        return usage("patch");
+    srand(1);
+    int failures = 0;
+
+    std::string running;
+    std::string next;
+    if (files)
+    {
+        if (!readImage(paths[0], &running) || !readImage(paths[1], &next))
+        {
+            printf("cannot read %s or %s\n", paths[0], paths[1]);
+            return 1;
+        }
+    }
+    else
+    {
+        if (!readImage("/proc/self/exe", &running))
+        {
+            printf("cannot read /proc/self/exe\n");
+            return 1;
+        }
+        // esptool images start with 0xE9
+        running[0] = 0xE9;
+        next = nextBuild(running);
+        printf("no images given, modelling the next build of this binary (3 insertions, addresses moved)\n");
+    }
+
+    std::string compressed(next.size() + next.size() / 8 + 64, 0);
+    std::string patch(next.size() * 2 + 1024, 0);
+    auto start = std::chrono::steady_clock::now();
+    compressed.resize(firmwareCompress((const uint8_t *)next.data(), next.size(), (uint8_t *)&compressed[0], compressed.size()));
+    double compressMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    patch.resize(firmwareDiff((const uint8_t *)running.data(), running.size(), (const uint8_t *)next.data(), next.size(),
+                              (uint8_t *)&patch[0], patch.size()));
+    double diffMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (compressed.empty() || patch.empty())
+    {
+        printf("encoding failed\n");
+        return 1;
+    }
+
+    FirmwareStream stream;
+    if (!stream.begin())
+    {
+        printf("no memory for the decoder\n");
+        return 1;
+    }
+    MemorySource source(running);
+    const struct
+    {
+        const char *name;
+        const std::string *data;
+        double encodeMs;
+    } formats[] = {{"image", &next, 0}, {"compressed", &compressed, compressMs}, {"patch", &patch, diffMs}};
+    printf("running image %zu bytes, new image %zu bytes\n", running.size(), next.size());
+    printf("%-10s %9s %7s %10s %10s %12s %12s\n", "format", "bytes", "share", "encode ms", "apply ms", "source read", "at 100 KB/s");
+    for (const auto &format : formats)
+    {
+        if (format.data == &next && (uint8_t)next[0] != FIRMWARE_IMAGE_MAGIC)
+        {
+            printf("%-10s %9zu  not an esptool image, only compressed or patched\n", format.name, next.size());
+            continue;
+        }
+        MemoryTarget target;
+        double ms = 0;
+        for (int i = 0; i < iterations; i++)
+        {
+            start = std::chrono::steady_clock::now();
+            bool ok = applyFirmware(stream, target, &source, *format.data);
+            ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (!ok || target.image != next || stream.getFormat() == FIRMWARE_UNKNOWN)
+            {
+                printf("%s: %s\n", format.name, stream.getError() ? stream.getError() : "image differs");
+                failures++;
+                break;
+            }
+        }
+        printf("%-10s %9zu %6.1f%% %10.1f %10.2f %12u %10.1f s\n", format.name, format.data->size(), 100.0 * format.data->size() / next.size(),
+               format.encodeMs, ms / iterations, stream.getStats().sourceRead, format.data->size() / 102400.0);
+    }
+    printf("decoder memory %u bytes while updating, none otherwise\n", heapTagStats(HEAP_TAG_FIRMWARE).peak);
+    if (heapTagStats(HEAP_TAG_FIRMWARE).allocs != 1)
+        failures++;
+
+    stream.end();
+    if (heapTagStats(HEAP_TAG_FIRMWARE).live)
+        failures++;
+
+    auto save = [&](const char *path, const std::string &data)
+    {
+        FILE *file = fopen(path, "wb");
+        if (!file || fwrite(data.data(), 1, data.size(), file) != data.size())
+            failures++;
+        if (file)
+            fclose(file);
+        printf("wrote %s\n", path);
+    };
+    if (patchPath)
+        save(patchPath, patch);
+    if (compressedPath)
+        save(compressedPath, compressed);
+    printf("%s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
+
+// Push a stream in pieces the size of a TCP segment, as a download arrives, true if accepted
+static bool feedFirmware(FirmwareStream &stream, const std::string &data)
+{
+    for (size_t at = 0; at < data.size(); at += 1460)
+    {
+        if (!stream.write((const uint8_t *)&data[at], std::min((size_t)1460, data.size() - at)))
+            return false;
+    }
+    return stream.finish();
+}
+
+static std::string signStream(const FirmwareSigner &signer, const std::string &image, const std::string &stream)
+{
+    std::string signature = signer.sign((const uint8_t *)image.data(), image.size());
+    std::string out(stream.size() + 6 + FIRMWARE_SIGNATURE_MAX, 0);
+    out.resize(firmwareSign((const uint8_t *)stream.data(), stream.size(), (const uint8_t *)signature.data(), signature.size(),
+                            (uint8_t *)&out[0], out.size()));
+    return out;
+}
+
+// Sign release assets: the signature of image goes in front of each stream built from it
+// (status_sim patch -o/-z), replacing an older one, and the key to build in is printed
+static int signAssets(const char *keyPath, const char *imagePath, int count, char **paths)
+{
+    FirmwareSigner signer;
+    std::string image;
+    if (!signer.load(keyPath))
+    {
+        printf("cannot read a P-256 private key from %s\n", keyPath);
+        return 1;
+    }
+    if (!readImage(imagePath, &image) || (uint8_t)image[0] != FIRMWARE_IMAGE_MAGIC)
+    {
+        printf("%s is not an esptool image\n", imagePath);
+        return 1;
+    }
+    uint32_t crc = firmwareCrc32(0, (const uint8_t *)image.data(), image.size());
+    for (int i = 0; i < count; i++)
+    {
+        std::string stream;
+        if (!readImage(paths[i], &stream))
+        {
+            printf("cannot read %s\n", paths[i]);
+            return 1;
+        }
+        if (!stream.compare(0, 4, FIRMWARE_SIGNED_MAGIC) && stream.size() > 6)
+            stream.erase(0, 6 + ((uint8_t)stream[4] | (uint8_t)stream[5] << 8));
+        // compressed images and patches carry the CRC of the image they decode to
+        bool matches = stream == image || ((!stream.compare(0, 4, FIRMWARE_COMPRESSED_MAGIC) || !stream.compare(0, 4, FIRMWARE_PATCH_MAGIC)) &&
+                                           stream.size() >= 20 && !memcmp(&stream[8], &crc, 4));
+        if (!matches)
+        {
+            printf("%s is not built from %s\n", paths[i], imagePath);
+            return 1;
+        }
+        std::string out = signStream(signer, image, stream);
+        FILE *file = fopen(paths[i], "wb");
+        bool ok = file && !out.empty() && fwrite(out.data(), 1, out.size(), file) == out.size();
+        if (file)
+            fclose(file);
+        if (!ok)
+        {
+            printf("cannot write %s\n", paths[i]);
+            return 1;
+        }
+        printf("signed %s\n", paths[i]);
+    }
+    std::string key = signer.publicKey();
+    printf("#define FIRMWARE_SIGNING_KEY \"");
+    for (char c : key)
+        printf(c == '\n' ? "\\n" : "%c", c);
+    printf("\"\n");
+    return 0;
+}
+
+// How soon an update that must not be installed is turned away. The cookie and the signature
+// are checked on the image as it is decoded: a stream for another device stops at the cookie,
+// an unsigned one at its first bytes, both before the partition is begun, and a bad signature
+// after the last byte, before the image is activated. Before, every image was downloaded and
+// flashed in full and its cookie read back from flash. With -k, signs release assets instead.
+static int signCheck(int argc, char **argv)
+{
+    int iterations = 5;
+    const char *keyPath = NULL;
+    int first = argc;
+    for (int i = 0; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-k") && i + 1 < argc)
+            keyPath = argv[++i];
+        else
+        {
+            first = i;
+            break;
+        }
+    }
+    if (keyPath)
+        return first < argc ? signAssets(keyPath, argv[first], argc - first - 1, &argv[first + 1]) : usage("sign");
+    if (iterations <= 0 || first < argc)
+        return usage("sign");
+    srand(1);
+    int failures = 0;
+
+    // the model image carries the panel cookie where the linker puts .rodata_custom_desc
+    char cookie[FIRMWARE_COOKIE_SIZE] = "status_FW";
+    std::string running;
+    if (!readImage("/proc/self/exe", &running))
+    {
+        printf("cannot read /proc/self/exe\n");
+        return 1;
+    }
+    running[0] = FIRMWARE_IMAGE_MAGIC;
+    std::string next = nextBuild(running);
+    running.replace(FIRMWARE_COOKIE_OFFSET, sizeof(cookie), cookie, sizeof(cookie));
+    next.replace(FIRMWARE_COOKIE_OFFSET, sizeof(cookie), cookie, sizeof(cookie));
+    std::string foreign = next;
+    memcpy(&foreign[FIRMWARE_COOKIE_OFFSET], "other_FW", 9);
+
+    std::string compressed(next.size() + next.size() / 8 + 64, 0);
+    compressed.resize(firmwareCompress((const uint8_t *)next.data(), next.size(), (uint8_t *)&compressed[0], compressed.size()));
+    std::string patch(next.size() * 2 + 1024, 0);
+    patch.resize(firmwareDiff((const uint8_t *)running.data(), running.size(), (const uint8_t *)next.data(), next.size(),
+                              (uint8_t *)&patch[0], patch.size()));
+    std::string foreignCompressed(foreign.size() + foreign.size() / 8 + 64, 0);
+    foreignCompressed.resize(firmwareCompress((const uint8_t *)foreign.data(), foreign.size(), (uint8_t *)&foreignCompressed[0],
+                                              foreignCompressed.size()));
+
+    FirmwareSigner signer;
+    FirmwareSigner otherSigner;
+    if (!signer.generate() || !otherSigner.generate())
+    {
+        printf("cannot generate a P-256 key\n");
+        return 1;
+    }
+    std::string publicKey = signer.publicKey();
+    OpenSslVerifier verifier(publicKey.c_str());
+    std::string signedImage = signStream(signer, next, next);
+    std::string signedCompressed = signStream(signer, next, compressed);
+    std::string signedPatch = signStream(signer, next, patch);
+    if (compressed.empty() || patch.empty() || signedImage.empty() || signedCompressed.empty() || signedPatch.empty())
+    {
+        printf("encoding failed\n");
+        return 1;
+    }
+
+    FirmwareStream stream;
+    if (!stream.begin())
+    {
+        printf("no memory for the decoder\n");
+        return 1;
+    }
+    MemorySource source(running);
+    printf("image %zu bytes, signature %zu bytes, time at 100 KB/s\n", next.size(), signedImage.size() - next.size() - 6);
+    printf("%-26s %-28s %9s %9s %9s %10s\n", "stream", "result", "received", "flashed", "at 100KB", "check ms");
+
+    const struct
+    {
+        const char *name;
+        const std::string *data;
+        bool accepted;
+        bool early; // rejected before the partition is begun
+    } cases[] = {
+        {"signed image", &signedImage, true, false},
+        {"signed compressed", &signedCompressed, true, false},
+        {"signed patch", &signedPatch, true, false},
+        {"unsigned image", &next, false, true},
+        {"unsigned patch", &patch, false, true},
+        {"other panel's image", &foreign, false, true},
+        {"other panel's compressed", &foreignCompressed, false, true},
+    };
+    for (const auto &test : cases)
+    {
+        MemoryTarget target;
+        double ms = 0;
+        bool accepted = false;
+        for (int i = 0; i < iterations; i++)
+        {
+            // another panel's images are turned away by the cookie alone
+            stream.reset(&target, &source);
+            stream.require(cookie, test.data == &foreign || test.data == &foreignCompressed ? NULL : &verifier);
+            auto start = std::chrono::steady_clock::now();
+            accepted = feedFirmware(stream, *test.data);
+            ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        uint32_t received = stream.getStats().received;
+        printf("%-26s %-28s %9u %9zu %7.2f s %10.2f\n", test.name, accepted ? "installed" : stream.getError(), received,
+               target.image.size(), received / 102400.0, ms / iterations);
+        if (accepted != test.accepted || (accepted && target.image != next) || (test.early && (target.begun || received > 1460)))
+            failures++;
+    }
+
+    // signed by someone else, or changed after signing: all of it is downloaded and written,
+    // but finish fails and the partition is never made bootable
+    std::string tampered = signedImage;
+    tampered[tampered.size() / 2] ^= 0x10;
+    FirmwareSigner *signers[] = {&otherSigner, NULL};
+    for (FirmwareSigner *other : signers)
+    {
+        std::string data = other ? signStream(*other, next, next) : tampered;
+        MemoryTarget target;
+        stream.reset(&target, &source);
+        stream.require(cookie, &verifier);
+        auto start = std::chrono::steady_clock::now();
+        bool accepted = feedFirmware(stream, data);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("%-26s %-28s %9u %9zu %7.2f s %10.2f\n", other ? "signed with another key" : "changed after signing",
+               accepted ? "installed" : stream.getError(), stream.getStats().received, target.image.size(),
+               stream.getStats().received / 102400.0, ms);
+        if (accepted || strcmp(stream.getError(), "bad signature"))
+            failures++;
+    }
+    // the check this replaces: the whole image downloaded and flashed, then the cookie read back
+    printf("%-26s %-28s %9zu %9zu %7.2f s\n", "before: cookie read back", "not firmware for this panel", foreign.size(),
+           foreign.size(), foreign.size() / 102400.0);
+
+    // SHA-256 on top of decoding, per MB of image
+    MemoryTarget target;
+    double plainMs = 0;
+    double signedMs = 0;
+    for (int i = 0; i < iterations; i++)
+    {
+        stream.reset(&target, &source);
+        auto start = std::chrono::steady_clock::now();
+        feedFirmware(stream, compressed);
+        plainMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        stream.reset(&target, &source);
+        stream.require(cookie, &verifier);
+        start = std::chrono::steady_clock::now();
+        feedFirmware(stream, signedCompressed);
+        signedMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    printf("signature check adds %.2f ms per MB of image on this host\n", (signedMs - plainMs) / iterations / (next.size() / 1048576.0));
+
+    // damage anywhere in a signed stream, the signature included, never installs another image
+    // (a compressed stream can still decode to the signed one)
+    int rejected = 0;
+    for (int i = 0; i < 200; i++)
+    {
+        std::string damaged = i % 2 ? signedCompressed : signedImage;
+        damaged[rand() % damaged.size()] ^= 1 << rand() % 8;
+        MemoryTarget damagedTarget;
+        stream.reset(&damagedTarget, &source);
+        stream.require(cookie, &verifier);
+        if (!feedFirmware(stream, damaged))
+            rejected++;
+        else if (damagedTarget.image != next || i % 2 == 0)
+            failures++;
+    }
+    printf("damaged signed streams: %d of 200 rejected, no other image accepted\n", rejected);
+    // a signature is not required without a key, and one that is there is skipped
+    stream.reset(&target, &source);
+    stream.require(cookie, NULL);
+    if (!feedFirmware(stream, signedPatch) || target.image != next || !stream.isSigned())
+        failures++;
+    stream.end();
+    if (heapTagStats(HEAP_TAG_FIRMWARE).live)
+        failures++;
+    printf("%s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
+
+// Seconds since 1970 for the fleet of the rollout command, running scale times faster than
+// the wall clock from epoch on, so hours of rollout pass in seconds
+class SimClock {
+    public:
+        SimClock(int64_t epoch, double scale) : epoch(epoch), scale(scale), start(std::chrono::steady_clock::now()) {}
+        double now() const { return epoch + std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * scale; }
+        void sleep(double seconds) const { std::this_thread::sleep_for(std::chrono::duration<double>(seconds / scale)); }
+
+    private:
+        int64_t epoch;
+        double scale;
+        std::chrono::steady_clock::time_point start;
+};
+
+// Panel ids as checkForUpdates makes them, "%012llx" of getEfuseMac(): the MAC bytes in
+// little endian order, the Espressif OUI 24:0a:c4 in the low half
+static std::string rolloutId(uint32_t nic)
+{
+    uint64_t mac = 0x24 | 0x0a << 8 | 0xc4 << 16 | (uint64_t)(nic >> 16 & 0xff) << 24 | (uint64_t)(nic >> 8 & 0xff) << 32 |
+                   (uint64_t)(nic & 0xff) << 40;
+    char id[17];
+    snprintf(id, sizeof(id), "%012llx", (unsigned long long)mac);
+    return id;
+}
+
+// Most downloads running at once when each takes durationS from its start
+static uint32_t peakConcurrent(std::vector<double> starts, double durationS)
+{
+    std::sort(starts.begin(), starts.end());
+    uint32_t peak = 0;
+    for (size_t i = 0, first = 0; i < starts.size(); i++)
+    {
+        while (starts[first] + durationS <= starts[i])
+            first++;
+        peak = std::max(peak, (uint32_t)(i - first + 1));
+    }
+    return peak;
+}
+
+struct FleetResult
+{
+    int updated;
+    int fromPeers;
+    int early;      // started before their turn
+    double lateS;   // most any started after it
+    double spreadS; // from the first start to the last
+    uint32_t feedChecks;
+    uint64_t peerBytes;
+    MirrorStats mirror;
+    double realS;
+};
+
+// Update a fleet of panel threads from a local mirror the way checkForUpdates does, each with
+// its own session, checker, feed scanner and rollout on a clock running scale times faster.
+// With peers, updated panels serve their image to the others, up to 2 at once (PEER_UPLOADS_MAX)
+// and 3 tried (PEER_TRIES) before the mirror.
+static FleetResult runFleet(const std::vector<std::string> &ids, uint32_t windowS, uint32_t startWindowS, bool peers, double scale,
+                            uint32_t rate, const std::string &image, const std::string &signedImage, const std::string &publicKey)
+{
+    const char *repo = "elliotmatson/esp32-hub75-status";
+    const int64_t publishedAt = 1767225600; // 2026-01-01T00:00:00Z
+    char json[256];
+    snprintf(json, sizeof(json), "{\"tag_name\":\"v1.1.0\",\"draft\":false,\"prerelease\":false,\"published_at\":\"2026-01-01T00:00:00Z\","
+                                 "\"assets\":[{\"name\":\"esp32.bin\",\"size\":%zu}]}", signedImage.size());
+    MirrorServer mirror;
+    mirror.setRate(rate);
+    mirror.setFile("/status/releases/latest", json, false);
+    mirror.setFile("/status/releases/download/v1.1.0/esp32.bin", signedImage, true);
+    FleetResult result = {};
+    if (!mirror.begin())
+        return result;
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/status", mirror.getPort());
+
+    struct Panel
+    {
+        double startedAt;
+        int64_t turn;
+        bool updated;
+        bool fromPeer;
+        uint32_t feedChecks;
+        std::unique_ptr<MirrorServer> server;
+    };
+    std::vector<Panel> panels(ids.size());
+    std::mutex peersMutex;
+    std::vector<uint16_t> peerPorts;
+    SimClock clock(publishedAt, scale);
+    const double deadline = publishedAt + windowS + startWindowS + 600;
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        threads.emplace_back([&, i]()
+                             {
+            Panel &panel = panels[i];
+            std::minstd_rand random(i + 1);
+            Rollout rollout;
+            rollout.begin(ids[i].c_str(), windowS, startWindowS);
+            UpdateSource source;
+            parseUpdateSource(url, &source);
+            TcpTransport transport;
+            HttpsSession session(transport);
+            session.setHost(source.host, source.port);
+            UpdateChecker checker(session, 60000, 3600000);
+            checker.seed(random());
+            ReleaseFeed feed;
+            FirmwareStream stream;
+            MemoryTarget target;
+            OpenSslVerifier verifier(publicKey.c_str());
+            char path[UPDATE_PATH_MAX];
+            if (!stream.begin() || !updateFeedPath(source, repo, false, path, sizeof(path)))
+                return;
+
+            // GET path into the OTA partition, 200 if the image arrived whole and signed
+            auto fetch = [&](HttpsSession &session, const char *path)
+            {
+                stream.reset(&target, NULL);
+                stream.require(NULL, &verifier);
+                size_t length;
+                int status = session.get(path, stream, &length);
+                if (status == 200 && (!stream.finish() || target.image != image))
+                    return -1;
+                return status;
+            };
+            auto download = [&](const char *tag)
+            {
+                if (peers)
+                {
+                    std::vector<uint16_t> ports;
+                    {
+                        std::lock_guard<std::mutex> lock(peersMutex);
+                        ports = peerPorts;
+                    }
+                    size_t first = ports.empty() ? 0 : random() % ports.size();
+                    for (size_t k = 0; k < ports.size() && k < 3; k++)
+                    {
+                        TcpTransport peerTransport;
+                        HttpsSession peerSession(peerTransport);
+                        peerSession.setHost("127.0.0.1", ports[(first + k) % ports.size()]);
+                        if (fetch(peerSession, "/api/v1/firmware") == 200)
+                        {
+                            panel.fromPeer = true;
+                            return true;
+                        }
+                    }
+                }
+                char assetUrl[UPDATE_URL_MAX];
+                UpdateSource asset;
+                return updateAssetUrl(source, repo, tag, "esp32.bin", assetUrl, sizeof(assetUrl)) &&
+                       parseUpdateSource(assetUrl, &asset) && fetch(session, asset.path) == 200;
+            };
+
+            // booted at some point in the check interval
+            clock.sleep(random() % 60);
+            while (!panel.updated && clock.now() < deadline)
+            {
+                feed.reset(false, "esp32.bin");
+                UpdateCheckResult result = checker.check(path, &feed);
+                panel.feedChecks++;
+                uint32_t waitS = 0;
+                ReleaseInfo release;
+                if (result == UPDATE_CHANGED)
+                {
+                    if (!feed.finished() || !feed.getRelease(&release))
+                        result = UPDATE_FAILED;
+                    else if ((waitS = rollout.wait(release.tag, release.publishedAt, (int64_t)clock.now())))
+                        result = UPDATE_UNCHANGED;
+                    else
+                    {
+                        panel.startedAt = clock.now();
+                        panel.turn = rollout.startTime(release.tag, release.publishedAt);
+                        panel.updated = download(release.tag);
+                        if (!panel.updated)
+                            result = UPDATE_FAILED;
+                    }
+                }
+                uint32_t delayMs = checker.done(result);
+                if (waitS > delayMs / 1000)
+                    delayMs = std::min(waitS, (uint32_t)3600) * 1000;
+                if (!panel.updated)
+                    clock.sleep(delayMs / 1000.0);
+            }
+            session.close();
+            if (!panel.updated || !peers)
+                return;
+            // the running image and the signature it came with, as GET /api/v1/firmware sends them
+            std::string served(image.size() + 6 + FIRMWARE_SIGNATURE_MAX, 0);
+            served.resize(firmwareSign((const uint8_t *)image.data(), image.size(), stream.getSignature(), stream.getSignatureSize(),
+                                       (uint8_t *)&served[0], served.size()));
+            panel.server.reset(new MirrorServer());
+            panel.server->setRate(rate);
+            panel.server->setUploadLimit(2);
+            panel.server->setFile("/api/v1/firmware", served, true);
+            if (panel.server->begin())
+            {
+                std::lock_guard<std::mutex> lock(peersMutex);
+                peerPorts.push_back(panel.server->getPort());
+            } });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    result.realS = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double first = 0;
+    double last = 0;
+    for (Panel &panel : panels)
+    {
+        result.feedChecks += panel.feedChecks;
+        if (panel.server)
+        {
+            panel.server->stop();
+            result.peerBytes += panel.server->getStats().downloadBytes;
+        }
+        if (!panel.updated)
+            continue;
+        first = result.updated ? std::min(first, panel.startedAt) : panel.startedAt;
+        last = result.updated ? std::max(last, panel.startedAt) : panel.startedAt;
+        result.updated++;
+        result.fromPeers += panel.fromPeer;
+        // the clock is read as whole seconds
+        if (panel.startedAt < panel.turn - 1)
+            result.early++;
+        result.lateS = std::max(result.lateS, panel.startedAt - panel.turn);
+    }
+    result.spreadS = last - first;
+    mirror.stop();
+    result.mirror = mirror.getStats();
+    return result;
+}
+
+// Staged rollout across a fleet: how evenly panel ids spread over the cohorts, and how the
+// peak of downloads at once falls with the rollout window. Then a fleet of panel threads
+// updates from a local plain HTTP mirror, all at once, staged, and staged with panels
+// passing the signed image on to each other, counting what the mirror serves.
+static int rolloutCheck(int argc, char **argv)
+{
+    int fleet = 32;
+    int hours = 1;
+    int panels = 10000;
+    for (int i = 0; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-p") && i + 1 < argc)
+            fleet = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-H") && i + 1 < argc)
+            hours = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            panels = atoi(argv[++i]);
+    }
+    if (fleet <= 0 || hours <= 0 || panels < ROLLOUT_COHORTS)
+        return usage("rollout");
+    esp_log_level_set("*", ESP_LOG_WARN);
+    srand(1);
+    int failures = 0;
+
+    // a production batch (consecutive MACs) and MACs from all over
+    const char *tags[] = {"v1.1.0", "v1.2.0"};
+    const int64_t publishedAt = 1767225600;
+    std::vector<std::string> sequential;
+    std::vector<std::string> scattered;
+    uint32_t batch = 0x1a2b00;
+    for (int i = 0; i < panels; i++)
+    {
+        sequential.push_back(rolloutId(batch + i));
+        scattered.push_back(rolloutId(rand() & 0xffffff));
+    }
+    printf("%-11s %6s %9s %9s %8s %12s %14s\n", "ids", "panels", "min/100", "max/100", "chi2", "same start", "start in turn");
+    for (int set = 0; set < 2; set++)
+    {
+        const std::vector<std::string> &ids = set ? scattered : sequential;
+        uint32_t counts[ROLLOUT_COHORTS] = {};
+        int sameStart = 0;
+        int outside = 0;
+        for (const std::string &id : ids)
+        {
+            Rollout rollout;
+            rollout.begin(id.c_str(), 24 * 3600, 900);
+            counts[rollout.getCohort()]++;
+            int64_t turn = rollout.startTime(tags[0], publishedAt);
+            int64_t base = publishedAt + (int64_t)24 * 3600 * rollout.getCohort() / ROLLOUT_COHORTS;
+            outside += turn < base || turn >= base + 900;
+            // a new release is a new draw of the start, in the same cohort
+            sameStart += rollout.startTime(tags[1], publishedAt) == turn;
+        }
+        double expected = (double)ids.size() / ROLLOUT_COHORTS;
+        double chi2 = 0;
+        for (uint32_t count : counts)
+            chi2 += (count - expected) * (count - expected) / expected;
+        printf("%-11s %6zu %9u %9u %8.1f %12d %14zu\n", set ? "scattered" : "sequential", ids.size(), *std::min_element(counts, counts + ROLLOUT_COHORTS),
+               *std::max_element(counts, counts + ROLLOUT_COHORTS), chi2, sameStart, ids.size() - outside);
+    }
+    // the serial shown on the panel is the low half of the MAC, the vendor part
+    std::set<uint8_t> serialCohorts;
+    for (int i = 0; i < panels; i++)
+    {
+        char serial[8];
+        snprintf(serial, sizeof(serial), "%x", (uint32_t)(strtoull(sequential[i].c_str(), NULL, 16) % 0x1000000));
+        serialCohorts.insert(rolloutCohort(serial));
+    }
+    printf("cohorts of the same panels by serial (getEfuseMac() %% 0x1000000): %zu\n", serialCohorts.size());
+
+    // downloads at once for the whole fleet, each a minute long (a 240 KB image at 4 KB/s),
+    // panels polling a minute apart: all at once they all start within that minute
+    printf("\n%-14s %8s %12s %12s %12s\n", "rollout", "panels", "peak at once", "half by", "all by");
+    for (int rolloutHours : {0, 1, 6, 24})
+    {
+        std::vector<double> starts;
+        for (int i = 0; i < panels; i++)
+        {
+            Rollout rollout;
+            rollout.begin(scattered[i].c_str(), rolloutHours * 3600, rolloutHours ? 900 : 0);
+            double boot = (rand() % 60000) / 1000.0;
+            int64_t turn = rollout.startTime(tags[0], publishedAt) - publishedAt;
+            // the first check at or after the turn
+            starts.push_back(turn <= boot ? boot : boot + ceil((turn - boot) / 60.0) * 60);
+        }
+        std::sort(starts.begin(), starts.end());
+        uint32_t peak = peakConcurrent(starts, 60);
+        printf("%-14s %8d %12u %11.0fs %11.0fs\n", rolloutHours ? (std::to_string(rolloutHours) + " h").c_str() : "all at once", panels, peak,
+               starts[starts.size() / 2], starts.back());
+    }
+
+    // the fleet, on a clock that runs the rollout in about 5 s
+    std::string image;
+    if (!readImage("/proc/self/exe", &image))
+    {
+        printf("cannot read /proc/self/exe\n");
+        return 1;
+    }
+    image.resize(std::min(image.size(), (size_t)256 * 1024));
+    image[0] = FIRMWARE_IMAGE_MAGIC;
+    FirmwareSigner signer;
+    if (!signer.generate())
+    {
+        printf("cannot generate a P-256 key\n");
+        return 1;
+    }
+    std::string signedImage = signStream(signer, image, image);
+    std::string publicKey = signer.publicKey();
+    std::vector<std::string> fleetIds(scattered.begin(), scattered.begin() + std::min(fleet, panels));
+    const uint32_t windowS = hours * 3600;
+    const uint32_t startWindowS = 900;
+    const double scale = (windowS + startWindowS + 60) / 5.0;
+    const uint32_t rate = 1000000;
+    printf("\n%d panels, %zu byte signed image at %u KB/s per download, %u s rollout with %u s start window, %.0fx time\n",
+           (int)fleetIds.size(), signedImage.size(), rate / 1000, windowS, startWindowS, scale);
+    printf("%-14s %8s %6s %7s %9s %8s %10s %10s %8s %7s\n", "mode", "updated", "early", "late s", "spread s", "peak dl", "mirror KB",
+           "peers KB", "feed req", "real s");
+    const struct
+    {
+        const char *name;
+        bool staged;
+        bool peers;
+    } modes[] = {{"all at once", false, false}, {"staged", true, false}, {"staged, peers", true, true}};
+    uint32_t peaks[3];
+    for (int m = 0; m < 3; m++)
+    {
+        FleetResult r = runFleet(fleetIds, modes[m].staged ? windowS : 0, modes[m].staged ? startWindowS : 0, modes[m].peers, scale, rate,
+                                 image, signedImage, publicKey);
+        peaks[m] = r.mirror.peakDownloads;
+        printf("%-14s %5d/%-2zu %6d %7.0f %9.0f %8u %10llu %10llu %8u %7.1f\n", modes[m].name, r.updated, fleetIds.size(), r.early, r.lateS,
+               r.spreadS, r.mirror.peakDownloads, (unsigned long long)(r.mirror.downloadBytes / 1000), (unsigned long long)(r.peerBytes / 1000),
+               r.feedChecks, r.realS);
+        if (r.updated != (int)fleetIds.size() || r.early)
+            failures++;
+        // a check a minute, and some scheduling slack at this speed
+        if (modes[m].staged && r.lateS > 180)
+            failures++;
+        // most come from the panels, none twice from the mirror
+        if (modes[m].peers && (r.mirror.downloads > fleetIds.size() / 4 + 1 || r.peerBytes < r.mirror.downloadBytes))
+            failures++;
+        if (!modes[m].peers && r.mirror.downloads != fleetIds.size())
+            failures++;
+    }
+    if (fleetIds.size() >= 8 && peaks[1] * 2 > peaks[0])
+        failures++;
+    printf("%s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
+
+// Minimal GIF writer for the gif command: one global palette, an optional looping
+// extension (skipped by the decoder) and LZW with a clear code whenever the table fills
+class GifWriter {
+    public:
+        GifWriter(uint8_t *out, size_t capacity) : out(out), capacity(capacity), size(0) {}
+
+        void header(uint16_t width, uint16_t height, const uint8_t *palette, int paletteBits)
+        {
+            this->paletteBits = paletteBits;
+            put((const uint8_t *)"GIF89a", 6);
+            putWord(width);
+            putWord(height);
+            put(0x80 | (paletteBits - 1));
+            put(0);
+            put(0);
+            put(palette, 3 << paletteBits);
+            static const uint8_t loop[] = {0x21, 0xFF, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 3, 1, 0, 0, 0};
+            put(loop, sizeof(loop));
+        }
+
+        void frame(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *pixels, uint16_t delayCs,
+                   uint8_t disposal, int transparent, bool interlaced)
+        {
+            put(0x21);
+            put(0xF9);
+            put(4);
+            put(disposal << 2 | (transparent >= 0));
+            putWord(delayCs);
+            put(transparent >= 0 ? transparent : 0);
+            put(0);
+            put(0x2C);
+            putWord(x);
+            putWord(y);
+            putWord(w);
+            putWord(h);
+            put(interlaced ? 0x40 : 0);
+            if (!interlaced)
+            {
+                lzw(pixels, (size_t)w * h);
+                return;
+            }
+            uint8_t *rows = (uint8_t *)malloc((size_t)w * h);
+            size_t n = 0;
+            static const int start[4] = {0, 4, 2, 1};
+            static const int step[4] = {8, 8, 4, 2};
+            for (int pass = 0; pass < 4; pass++)
+            {
+                for (int row = start[pass]; row < h; row += step[pass])
+                {
+                    memcpy(&rows[n], &pixels[row * w], w);
+                    n += w;
+                }
+            }
+            lzw(rows, n);
+            free(rows);
+        }
+
+        size_t finish()
+        {
+            put(0x3B);
+            return size;
+        }
+
+    private:
+        uint8_t *out;
+        size_t capacity;
+        size_t size;
+        int paletteBits;
+        uint8_t block[255];
+        size_t blockSize;
+        uint32_t bits;
+        int bitCount;
+        int codeSize;
+        static uint16_t child[GIF_MAX_CODES * 256]; // code of prefix + byte, 0 if not in the table
+
+        void put(uint8_t b)
+        {
+            if (size < capacity)
+                out[size] = b;
+            size++;
+        }
+        void put(const uint8_t *data, size_t len)
+        {
+            for (size_t i = 0; i < len; i++)
+                put(data[i]);
+        }
+        void putWord(uint16_t w)
+        {
+            put(w & 0xFF);
+            put(w >> 8);
+        }
+
+        void code(int c)
+        {
+            bits |= (uint32_t)c << bitCount;
+            bitCount += codeSize;
+            while (bitCount >= 8)
+            {
+                data(bits & 0xFF);
+                bits >>= 8;
+                bitCount -= 8;
+            }
+        }
+        void data(uint8_t b)
+        {
+            block[blockSize++] = b;
+            if (blockSize == sizeof(block))
+                flush();
+        }
+        void flush()
+        {
+            if (!blockSize)
+                return;
+            put(blockSize);
+            put(block, blockSize);
+            blockSize = 0;
+        }
+
+        void lzw(const uint8_t *pixels, size_t n)
+        {
+            int minCodeSize = paletteBits < 2 ? 2 : paletteBits;
+            int clear = 1 << minCodeSize;
+            int next = clear + 2;
+            put(minCodeSize);
+            blockSize = 0;
+            bits = 0;
+            bitCount = 0;
+            codeSize = minCodeSize + 1;
+            memset(child, 0, sizeof(child));
+            code(clear);
+            int prefix = pixels[0];
+            for (size_t i = 1; i < n; i++)
+            {
+                uint16_t *c = &child[prefix * 256 + pixels[i]];
+                if (*c)
+                {
+                    prefix = *c;
+                    continue;
+                }
+                code(prefix);
+                if (next < GIF_MAX_CODES)
+                {
+                    *c = next++;
+                    if (next - 1 == 1 << codeSize)
+                        codeSize++;
+                }
+                else
+                {
+                    code(clear);
+                    memset(child, 0, sizeof(child));
+                    next = clear + 2;
+                    codeSize = minCodeSize + 1;
+                }
+                prefix = pixels[i];
+            }
+            code(prefix);
+            code(clear + 1);
+            if (bitCount)
+                data(bits);
+            flush();
+            put(0);
+        }
+};
+uint16_t GifWriter::child[GIF_MAX_CODES * 256];
+
+#define GIF_FRAMES 12
+#define GIF_OUT_MAX (1 << 20)
+#define GIF_TRANSPARENT 15
+
+// 16 colors: black, a white to blue fade for the spinner, red for the cursor, magenta unused
+static const uint8_t gifPalette[16 * 3] = {
+    0, 0, 0, 255, 255, 255, 220, 225, 255, 185, 195, 255, 150, 165, 250, 115, 135, 240, 80, 105, 225, 50, 75, 205,
+    30, 50, 180, 240, 40, 40, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 0, 255};
+
+// Frame i of the stand-in spinner: eight dots on a ring, the bright one moving clockwise
+static void spinnerFrame(int i, uint8_t *pixels)
+{
+    memset(pixels, 0, EMOJI_SIZE * EMOJI_SIZE);
+    for (int d = 0; d < 8; d++)
+    {
+        float cx = 15.5f + 11.0f * cosf(d * (float)M_PI / 4);
+        float cy = 15.5f + 11.0f * sinf(d * (float)M_PI / 4);
+        for (int y = 0; y < EMOJI_SIZE; y++)
+        {
+            for (int x = 0; x < EMOJI_SIZE; x++)
+            {
+                if (hypotf(x - cx, y - cy) < 3.2f)
+                    pixels[y * EMOJI_SIZE + x] = 1 + ((i - d) & 7);
+            }
+        }
+    }
+}
+
+static void indexedToRGB(const uint8_t *pixels, uint8_t *rgb)
+{
+    for (int p = 0; p < EMOJI_SIZE * EMOJI_SIZE; p++)
+        memcpy(&rgb[p * 3], &gifPalette[pixels[p] * 3], 3);
+}
+
+// Stand-in animations covering the decoder paths, each with the frames it must produce
+enum GifVariant
+{
+    GIF_FULL,       // 32x32, every frame complete
+    GIF_DELTA,      // changed rectangle only, unchanged pixels transparent
+    GIF_INTERLACED,
+    GIF_RESTORE,    // cursor over a still background, restored after every frame
+    GIF_BACKGROUND, // frames cleared to black after display, only the dots are sent
+    GIF_SCALED,     // 128x128, sampled down
+    GIF_CENTERED,   // 20x20 middle of the spinner, centered
+    GIF_VARIANTS
+};
+static const char *const gifVariantNames[GIF_VARIANTS] = {"full", "delta", "interlaced", "restore", "background", "scaled 128x128", "centered 20x20"};
+
+static size_t buildGif(GifVariant variant, uint8_t *out, uint8_t expected[GIF_FRAMES][EMOJI_FRAME_BYTES])
+{
+    static uint8_t frames[GIF_FRAMES][EMOJI_SIZE * EMOJI_SIZE];
+    static uint8_t pixels[128 * 128];
+    int screen = variant == GIF_SCALED ? 128 : (variant == GIF_CENTERED ? 20 : EMOJI_SIZE);
+    GifWriter writer(out, GIF_OUT_MAX);
+    writer.header(screen, screen, gifPalette, 4);
+    for (int i = 0; i < GIF_FRAMES; i++)
+    {
+        spinnerFrame(i, frames[i]);
+        uint8_t *frame = frames[i];
+        switch (variant)
+        {
+        case GIF_FULL:
+        case GIF_INTERLACED:
+            writer.frame(0, 0, EMOJI_SIZE, EMOJI_SIZE, frame, 8, 1, -1, variant == GIF_INTERLACED);
+            break;
+        case GIF_DELTA:
+        {
+            if (!i)
+            {
+                writer.frame(0, 0, EMOJI_SIZE, EMOJI_SIZE, frame, 8, 1, -1, false);
+                break;
+            }
+            int x0 = EMOJI_SIZE, y0 = EMOJI_SIZE, x1 = -1, y1 = -1;
+            for (int p = 0; p < EMOJI_SIZE * EMOJI_SIZE; p++)
+            {
+                if (frame[p] == frames[i - 1][p])
+                    continue;
+                x0 = std::min(x0, p % EMOJI_SIZE);
+                x1 = std::max(x1, p % EMOJI_SIZE);
+                y0 = std::min(y0, p / EMOJI_SIZE);
+                y1 = std::max(y1, p / EMOJI_SIZE);
+            }
+            int w = x1 - x0 + 1, h = y1 - y0 + 1;
+            for (int y = 0; y < h; y++)
+            {
+                for (int x = 0; x < w; x++)
+                {
+                    int p = (y0 + y) * EMOJI_SIZE + x0 + x;
+                    pixels[y * w + x] = frame[p] == frames[i - 1][p] ? GIF_TRANSPARENT : frame[p];
+                }
+            }
+            writer.frame(x0, y0, w, h, pixels, 8, 1, GIF_TRANSPARENT, false);
+            break;
+        }
+        case GIF_RESTORE:
+        {
+            if (!i)
+            {
+                writer.frame(0, 0, EMOJI_SIZE, EMOJI_SIZE, frames[0], 8, 1, -1, false);
+                break;
+            }
+            // a 6x6 cursor with a transparent hole, moving down the diagonal
+            memcpy(frame, frames[0], sizeof(frames[0]));
+            for (int p = 0; p < 36; p++)
+            {
+                bool hole = p % 6 >= 2 && p % 6 < 4 && p / 6 >= 2 && p / 6 < 4;
+                pixels[p] = hole ? GIF_TRANSPARENT : 9;
+                if (!hole)
+                    frame[(i * 2 + p / 6) * EMOJI_SIZE + i * 2 + p % 6] = 9;
+            }
+            writer.frame(i * 2, i * 2, 6, 6, pixels, 8, 3, GIF_TRANSPARENT, false);
+            break;
+        }
+        case GIF_BACKGROUND:
+            for (int p = 0; p < EMOJI_SIZE * EMOJI_SIZE; p++)
+                pixels[p] = frame[p] ? frame[p] : GIF_TRANSPARENT;
+            writer.frame(0, 0, EMOJI_SIZE, EMOJI_SIZE, pixels, 8, 2, GIF_TRANSPARENT, false);
+            break;
+        case GIF_SCALED:
+            for (int p = 0; p < 128 * 128; p++)
+                pixels[p] = frame[(p / 128 / 4) * EMOJI_SIZE + p % 128 / 4];
+            writer.frame(0, 0, 128, 128, pixels, 8, 1, -1, false);
+            break;
+        case GIF_CENTERED:
+            for (int p = 0; p < 20 * 20; p++)
+                pixels[p] = frame[(p / 20 + 6) * EMOJI_SIZE + p % 20 + 6];
+            for (int p = 0; p < EMOJI_SIZE * EMOJI_SIZE; p++)
+            {
+                int x = p % EMOJI_SIZE, y = p / EMOJI_SIZE;
+                if (x < 6 || x >= 26 || y < 6 || y >= 26)
+                    frame[p] = 0;
+            }
+            writer.frame(0, 0, 20, 20, pixels, 8, 1, -1, false);
+            break;
+        default:
+            break;
+        }
+        indexedToRGB(frame, expected[i]);
+    }
+    return writer.finish();
+}
+
+// Checks decoded frames against the expected ones, or just counts them
+class CheckSink : public GifFrameSink {
+    public:
+        CheckSink(uint8_t (*expected)[EMOJI_FRAME_BYTES], int count) : expected(expected), count(count), frames(0), mismatches(0), totalDelayMs(0) {}
+        bool frame(const uint8_t *rgb, uint16_t delayMs) override
+        {
+            if (expected && (frames >= count || memcmp(rgb, expected[frames], EMOJI_FRAME_BYTES)))
+                mismatches++;
+            frames++;
+            totalDelayMs += delayMs;
+            return true;
+        }
+
+        uint8_t (*expected)[EMOJI_FRAME_BYTES];
+        int count;
+        int frames;
+        int mismatches;
+        uint32_t totalDelayMs;
+};
+
+// Feed a GIF in random sized pieces, from single bytes up to a network read
+static bool decodeChunked(GifDecoder &decoder, GifFrameSink &sink, const uint8_t *gif, size_t size)
+{
+    decoder.reset(&sink);
+    for (size_t pos = 0; pos < size;)
+    {
+        size_t n = rand() % 4 ? 1 + rand() % 16 : 1 + rand() % 1460;
+        if (n > size - pos)
+            n = size - pos;
+        if (!decoder.write(gif + pos, n))
+            return false;
+        pos += n;
+    }
+    return decoder.finished();
+}
+
+// Average decode time per frame, written in flash sized reads
+static double decodeFrameUs(GifDecoder &decoder, const uint8_t *gif, size_t size, int iterations, int *frames)
+{
+    CheckSink sink(NULL, 0);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        decoder.reset(&sink);
+        for (size_t pos = 0; pos < size && !decoder.finished(); pos += 512)
+        {
+            if (!decoder.write(gif + pos, size - pos < 512 ? size - pos : 512))
+                return -1;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    *frames = sink.frames / iterations;
+    return std::chrono::duration<double, std::micro>(end - start).count() / sink.frames;
+}
+
+// Producer thread looping a GIF into an AnimationStream while this thread plays it as fast
+// as frames come out. Checks order and content across the ring, then a cancel mid-stream.
+static int streamCheck(const uint8_t *gif, size_t size, uint8_t expected[GIF_FRAMES][EMOJI_FRAME_BYTES], int loops)
+{
+    AnimationStream stream;
+    if (!stream.begin())
+    {
+        ESP_LOGE(__func__, "No memory for the animation ring");
+        return 1;
+    }
+    stream.start();
+    std::thread producer([&]()
+                         {
+        for (int loop = 0; loop < loops && !stream.isCancelled(); loop++)
+        {
+            if (loop)
+                stream.rewind();
+            for (size_t pos = 0; pos < size && !stream.finished(); pos += 256)
+            {
+                if (!stream.write(gif + pos, size - pos < 256 ? size - pos : 256))
+                    return;
+            }
+        } });
+    int failures = 0;
+    int played = 0;
+    while (played < loops * GIF_FRAMES)
+    {
+        const RingFrame *frame = stream.next();
+        if (!frame)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        if (memcmp(frame->rgb, expected[played % GIF_FRAMES], EMOJI_FRAME_BYTES) || frame->delayMs != 80)
+            failures++;
+        stream.played();
+        played++;
+        // let the producer run ahead now and then, it has to stop at the ring size
+        if (played % 50 == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    producer.join();
+    AnimationStats stats = stream.getStats();
+    printf("stream: %d frames over %u loops through a %d slot ring, %d wrong\n", played, stats.loops + 1, FRAME_RING_SLOTS, failures);
+
+    // a producer blocked on a full ring gives up when cancelled
+    stream.start();
+    std::thread blocked([&]()
+                        {
+        for (;;)
+        {
+            if (!stream.write(gif, size))
+                return;
+            stream.rewind();
+        } });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    stream.cancel();
+    blocked.join();
+    printf("cancel: producer stopped with %u frames decoded, %u played\n", stream.getStats().decoded, stream.getStats().played);
+    return failures;
+}
+
+// Round trip the stand-in animations through the streaming decoder, fed in random pieces,
+// then time decoding per frame for them and any GIF files given
+static int gif(int argc, char **argv)
+{
+    int iterations = 200;
+    const char *output = NULL;
+    int first = 0;
+    while (first + 1 < argc && argv[first][0] == '-')
+    {
+        if (!strcmp(argv[first], "-n"))
+            iterations = atoi(argv[first + 1]);
+        else if (!strcmp(argv[first], "-o"))
+            output = argv[first + 1];
+        first += 2;
+    }
+    if (iterations <= 0)
+        return usage("gif");
+
+    static uint8_t expected[GIF_FRAMES][EMOJI_FRAME_BYTES];
+    uint8_t *buffer = (uint8_t *)malloc(GIF_OUT_MAX);
+    GifDecoder decoder;
+    if (!buffer || !decoder.begin())
+    {
+        ESP_LOGE(__func__, "No memory for the GIF decoder");
+        free(buffer);
+        return 1;
+    }
+    esp_log_level_set("*", ESP_LOG_WARN);
+    printf("decoder %zu bytes + ring %zu bytes, for any animation length\n", sizeof(GifDecoder) + GifDecoder::tablesSize(),
+           sizeof(RingFrame) * FRAME_RING_SLOTS);
+
+    srand(1);
+    int failures = 0;
+    for (int v = 0; v < GIF_VARIANTS; v++)
+    {
+        size_t size = buildGif((GifVariant)v, buffer, expected);
+        int wrong = 0;
+        bool ok = true;
+        for (int round = 0; round < 20; round++)
+        {
+            CheckSink sink(expected, GIF_FRAMES);
+            ok &= decodeChunked(decoder, sink, buffer, size) && sink.frames == GIF_FRAMES;
+            wrong += sink.mismatches;
+        }
+        int frames = 0;
+        double us = decodeFrameUs(decoder, buffer, size, iterations, &frames);
+        printf("%-24s %6zu bytes %10.3f us/frame  %s\n", gifVariantNames[v], size, us, ok && !wrong ? "ok" : "FAILED");
+        failures += !ok || wrong;
+    }
+
+    // truncated and corrupted streams fail cleanly
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    size_t size = buildGif(GIF_DELTA, buffer, expected);
+    int rejected = 0;
+    for (int i = 0; i < 2000; i++)
+    {
+        uint8_t *copy = (uint8_t *)malloc(size);
+        memcpy(copy, buffer, size);
+        size_t len = rand() % 2 ? rand() % size : size;
+        for (int flips = rand() % 4; flips >= 0; flips--)
+            copy[rand() % size] ^= 1 << rand() % 8;
+        CheckSink sink(NULL, 0);
+        decoder.reset(&sink);
+        rejected += !decoder.write(copy, len) || !decoder.finished();
+        free(copy);
+    }
+    printf("corrupt: %d of 2000 damaged streams rejected or incomplete, none crashed\n", rejected);
+
+    failures += streamCheck(buffer, size, expected, 100);
+
+    for (int i = first; i < argc; i++)
+    {
+        FILE *file = fopen(argv[i], "rb");
+        size_t fileSize = file ? fread(buffer, 1, GIF_OUT_MAX, file) : 0;
+        if (file)
+            fclose(file);
+        CheckSink sink(NULL, 0);
+        if (!decodeChunked(decoder, sink, buffer, fileSize))
+        {
+            printf("%s: %s\n", argv[i], decoder.getError() ? decoder.getError() : "incomplete");
+            failures++;
+            continue;
+        }
+        int frames = 0;
+        double us = decodeFrameUs(decoder, buffer, fileSize, iterations, &frames);
+        printf("%-24s %6zu bytes %10.3f us/frame  %d frames, %u ms\n", argv[i], fileSize, us, frames, sink.totalDelayMs);
+    }
+
+    if (output)
+    {
+        size = buildGif(GIF_DELTA, buffer, expected);
+        FILE *file = fopen(output, "wb");
+        if (!file || fwrite(buffer, 1, size, file) != size)
+        {
+            ESP_LOGE(__func__, "Failed to write %s", output);
+            return 1;
+        }
+        fclose(file);
+        printf("wrote %s\n", output);
+    }
+    free(buffer);
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    program = argv[0];
+    HUB75_I2S_CFG mxconfig(PANEL_WIDTH, PANEL_HEIGHT, 1);
+    mxconfig.double_buff = true;
+    MatrixPanel_I2S_DMA panel(mxconfig);
+    Display display;
+    if (!panel.begin() || !display.begin(&panel, true))
+    {
+        ESP_LOGE(__func__, "Failed to start the simulated panel");
+        return 1;
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "bench"))
+        return benchmark(argc > 2 ? atoi(argv[2]) : 10000, panel, display);
+    if (argc > 1 && !strcmp(argv[1], "render"))
+        return render(argc - 2, argv + 2, panel, display);
+    if (argc > 1 && !strcmp(argv[1], "pack"))
+        return packBenchmark(argc - 2, argv + 2, display);
+    if (argc > 1 && !strcmp(argv[1], "bundle"))
+        return bundle(argc - 2, argv + 2, display);
+    if (argc > 1 && !strcmp(argv[1], "fetch"))
+        return fetch(argc - 2, argv + 2);
+    if (argc > 1 && !strcmp(argv[1], "serve"))
+        return serve(argc - 2, argv + 2);
+    if (argc > 1 && !strcmp(argv[1], "segment"))
+        return segment(argc - 2, argv + 2);
+    if (argc > 1 && !strcmp(argv[1], "text"))
+        return textBenchmark(argc - 2, argv + 2);
+    if (argc > 1 && !strcmp(argv[1], "marquee"))
+        return marquee(argc - 2, argv + 2, panel, display);
+    if (argc > 1 && !strcmp(argv[1], "gif"))
+        return gif(argc - 2, argv + 2);
+    if (argc > 1 && !strcmp(argv[1], "color"))
+        return colorCheck(argc - 2, argv + 2, panel, display);
+    if (argc > 1 && !strcmp(argv[1], "dither"))
+        return ditherCheck(argc - 2, argv + 2);
+    if (argc > 1 && !strcmp(argv[1], "reinit"))
+        return reinitCheck(argc - 2, argv + 2);
+    if (argc > 1 && !strcmp(argv[1], "metrics"))
+        return metricsCheck(argc - 2, argv + 2);
+    if (argc > 1 && !strcmp(argv[1], "tasks"))
+        return tasksCheck(argc - 2, argv + 2);
+    if (argc > 1 && !strcmp(argv[1], "heap"))
+        return heapCheck(argc - 2, argv + 2, display);
+    if (argc > 1 && !strcmp(argv[1], "updates"))
+        return updatesCheck(argc - 2, argv + 2);
+    if (argc > 1 && !strcmp(argv[1], "releases"))
+        return releasesCheck(argc - 2, argv + 2);
+    if (argc > 1 && !strcmp(argv[1], "patch"))
+        return patchCheck(argc - 2, argv + 2);
+    if (argc > 1 && !strcmp(argv[1], "sign"))
+        return signCheck(argc - 2, argv + 2);
+    if (argc > 1 && !strcmp(argv[1], "rollout"))
+        return rolloutCheck(argc - 2, argv + 2);
+
+    PanelPrefs prefs;
+    prefs.print("Default Preferences");
+    if (argc > 1)
+        fprintf(stderr, "unknown command %s\n", argv[1]);
+    usage(NULL);
+    return 1;
+}
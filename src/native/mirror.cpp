@@ -0,0 +1,245 @@
+#include <chrono>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "mirror.h"
+
+MirrorServer::MirrorServer() :
+    listenFd(-1),
+    port(0),
+    serving(0),
+    rate(0),
+    uploadLimit(0),
+    uploads(0),
+    requests(0),
+    notModified(0),
+    downloads(0),
+    busy(0),
+    peakDownloads(0),
+    feedBytes(0),
+    downloadBytes(0)
+{
+}
+
+MirrorServer::~MirrorServer()
+{
+    stop();
+}
+
+bool MirrorServer::begin(uint16_t port)
+{
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    socklen_t len = sizeof(address);
+    if (bind(listenFd, (struct sockaddr *)&address, sizeof(address)) || listen(listenFd, 64) ||
+        getsockname(listenFd, (struct sockaddr *)&address, &len))
+    {
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    this->port = ntohs(address.sin_port);
+    acceptor = std::thread([this]()
+                           { run(); });
+    return true;
+}
+
+void MirrorServer::stop()
+{
+    if (listenFd < 0)
+        return;
+    // wakes accept() and every read the connections are blocked in
+    shutdown(listenFd, SHUT_RDWR);
+    acceptor.join();
+    close(listenFd);
+    listenFd = -1;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int fd : connections)
+            shutdown(fd, SHUT_RDWR);
+    }
+    while (serving)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+void MirrorServer::setFile(const std::string &path, const std::string &body, bool download)
+{
+    File file;
+    file.body = std::make_shared<const std::string>(body);
+    // the content changes, so does the tag
+    uint32_t hash = 2166136261u;
+    for (char c : body)
+        hash = (hash ^ (uint8_t)c) * 16777619u;
+    snprintf(file.etag, sizeof(file.etag), "\"%08x\"", hash);
+    file.download = download;
+    std::lock_guard<std::mutex> lock(mutex);
+    files[path] = file;
+}
+
+MirrorStats MirrorServer::getStats() const
+{
+    MirrorStats stats;
+    stats.requests = requests;
+    stats.notModified = notModified;
+    stats.downloads = downloads;
+    stats.busy = busy;
+    stats.peakDownloads = peakDownloads;
+    stats.feedBytes = feedBytes;
+    stats.downloadBytes = downloadBytes;
+    return stats;
+}
+
+// Accept connections until stopped, one thread each
+void MirrorServer::run()
+{
+    for (;;)
+    {
+        int fd = accept(listenFd, NULL, NULL);
+        if (fd < 0)
+            break;
+        std::lock_guard<std::mutex> lock(mutex);
+        connections.insert(fd);
+        serving++;
+        std::thread([this, fd]()
+                    { serve(fd); })
+            .detach();
+    }
+}
+
+// Write all of data, false if the client went away
+static bool sendAll(int fd, const char *data, size_t len)
+{
+    while (len)
+    {
+        ssize_t n = ::send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+void MirrorServer::serve(int fd)
+{
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    char request[2048];
+    size_t used = 0;
+    bool keepAlive = true;
+    while (keepAlive)
+    {
+        char *end;
+        while (!(end = (char *)memmem(request, used, "\r\n\r\n", 4)))
+        {
+            ssize_t n = used < sizeof(request) ? recv(fd, &request[used], sizeof(request) - used, 0) : 0;
+            if (n <= 0)
+            {
+                keepAlive = false;
+                break;
+            }
+            used += n;
+        }
+        if (!keepAlive)
+            break;
+        *end = '\0';
+        keepAlive = !strcasestr(request, "Connection: close");
+        requests++;
+
+        char path[256];
+        File file = {};
+        bool found = false;
+        if (sscanf(request, "GET %255s HTTP/1.", path) == 1)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = files.find(path);
+            if (it != files.end())
+            {
+                file = it->second;
+                found = true;
+            }
+        }
+        const char *connection = keepAlive ? "keep-alive" : "close";
+        char header[256];
+        int len;
+        const char *match = strcasestr(request, "\r\nIf-None-Match: ");
+        bool sent;
+        if (!found)
+        {
+            len = snprintf(header, sizeof(header), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: %s\r\n\r\n", connection);
+            sent = sendAll(fd, header, len);
+        }
+        else if (match && !strncmp(match + 17, file.etag, strlen(file.etag)))
+        {
+            notModified++;
+            len = snprintf(header, sizeof(header), "HTTP/1.1 304 Not Modified\r\nETag: %s\r\nConnection: %s\r\n\r\n", file.etag, connection);
+            sent = sendAll(fd, header, len);
+        }
+        else if (file.download && uploadLimit && ++uploads > uploadLimit)
+        {
+            uploads--;
+            busy++;
+            len = snprintf(header, sizeof(header), "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 30\r\nContent-Length: 0\r\nConnection: %s\r\n\r\n",
+                           connection);
+            sent = sendAll(fd, header, len);
+        }
+        else
+        {
+            if (file.download && !uploadLimit)
+                uploads++;
+            len = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nETag: %s\r\nContent-Length: %zu\r\nConnection: %s\r\n\r\n",
+                           file.download ? "application/octet-stream" : "application/json", file.etag, file.body->size(), connection);
+            sent = sendAll(fd, header, len) && send(fd, file);
+            if (file.download)
+                uploads--;
+        }
+        if (!sent)
+            break;
+        size_t consumed = end + 4 - request;
+        memmove(request, &request[consumed], used - consumed);
+        used -= consumed;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        connections.erase(fd);
+        close(fd);
+    }
+    serving--;
+}
+
+// Body of a file, downloads no faster than the rate
+bool MirrorServer::send(int fd, const File &file)
+{
+    const std::string &body = *file.body;
+    if (!file.download)
+    {
+        feedBytes += body.size();
+        return sendAll(fd, body.data(), body.size());
+    }
+    uint32_t now = uploads;
+    uint32_t peak = peakDownloads;
+    while (now > peak && !peakDownloads.compare_exchange_weak(peak, now))
+        ;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t at = 0; at < body.size();)
+    {
+        size_t n = std::min((size_t)4096, body.size() - at);
+        if (!sendAll(fd, &body[at], n))
+            return false;
+        at += n;
+        downloadBytes += n;
+        if (rate)
+            std::this_thread::sleep_until(start + std::chrono::microseconds((uint64_t)at * 1000000 / rate));
+    }
+    downloads++;
+    return true;
+}
@@ -0,0 +1,75 @@
+#ifndef NATIVE_MIRROR_H
+#define NATIVE_MIRROR_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+struct MirrorStats
+{
+    uint32_t requests;
+    uint32_t notModified;
+    uint32_t downloads;     // of files added as downloads, answered in full
+    uint32_t busy;          // turned away with 503 at the upload limit
+    uint32_t peakDownloads; // most at once
+    uint64_t feedBytes;     // bodies of the other files
+    uint64_t downloadBytes;
+};
+
+// Plain HTTP stand-in on 127.0.0.1 for a release mirror on the LAN, or for a panel passing
+// its image on to peers (GET /api/v1/firmware). Serves files by path, with an ETag and 304
+// for conditional requests. Downloads are sent at a fixed rate each, and beyond the upload
+// limit answered 503 with a Retry-After, as a panel does. Keeps connections alive.
+class MirrorServer {
+    public:
+        MirrorServer();
+        ~MirrorServer();
+        // 0 picks a port
+        bool begin(uint16_t port = 0);
+        // closes every connection and waits for them
+        void stop();
+        uint16_t getPort() const { return port; }
+        // download: counted as one and held to the rate and the upload limit
+        void setFile(const std::string &path, const std::string &body, bool download);
+        void setRate(uint32_t bytesPerSecond) { rate = bytesPerSecond; }
+        // 0: no limit
+        void setUploadLimit(uint32_t uploads) { uploadLimit = uploads; }
+        MirrorStats getStats() const;
+
+    private:
+        struct File
+        {
+            std::shared_ptr<const std::string> body;
+            char etag[16];
+            bool download;
+        };
+
+        int listenFd;
+        uint16_t port;
+        std::thread acceptor;
+        mutable std::mutex mutex; // files and connections
+        std::map<std::string, File> files;
+        std::set<int> connections;
+        std::atomic<int> serving; // connection threads still running
+        std::atomic<uint32_t> rate;
+        std::atomic<uint32_t> uploadLimit;
+        std::atomic<uint32_t> uploads;
+        std::atomic<uint32_t> requests;
+        std::atomic<uint32_t> notModified;
+        std::atomic<uint32_t> downloads;
+        std::atomic<uint32_t> busy;
+        std::atomic<uint32_t> peakDownloads;
+        std::atomic<uint64_t> feedBytes;
+        std::atomic<uint64_t> downloadBytes;
+
+        void run();
+        void serve(int fd);
+        bool send(int fd, const File &file);
+};
+
+#endif
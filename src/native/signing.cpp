@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <openssl/bio.h>
+#include <openssl/pem.h>
+
+#include "signing.h"
+
+OpenSslVerifier::OpenSslVerifier(const char *publicKey) :
+    key(NULL),
+    ctx(EVP_MD_CTX_new())
+{
+    BIO *bio = BIO_new_mem_buf(publicKey, -1);
+    key = PEM_read_bio_PUBKEY(bio, NULL, NULL, NULL);
+    BIO_free(bio);
+}
+
+OpenSslVerifier::~OpenSslVerifier()
+{
+    EVP_MD_CTX_free(ctx);
+    EVP_PKEY_free(key);
+}
+
+bool OpenSslVerifier::start()
+{
+    return key && EVP_DigestVerifyInit(ctx, NULL, EVP_sha256(), NULL, key) == 1;
+}
+
+bool OpenSslVerifier::update(const uint8_t *data, size_t len)
+{
+    return EVP_DigestVerifyUpdate(ctx, data, len) == 1;
+}
+
+bool OpenSslVerifier::verify(const uint8_t *signature, size_t len)
+{
+    return EVP_DigestVerifyFinal(ctx, signature, len) == 1;
+}
+
+FirmwareSigner::FirmwareSigner() :
+    key(NULL)
+{
+}
+
+FirmwareSigner::~FirmwareSigner()
+{
+    EVP_PKEY_free(key);
+}
+
+bool FirmwareSigner::generate()
+{
+    EVP_PKEY_free(key);
+    key = EVP_EC_gen("P-256");
+    return key != NULL;
+}
+
+bool FirmwareSigner::load(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return false;
+    EVP_PKEY_free(key);
+    key = PEM_read_PrivateKey(file, NULL, NULL, NULL);
+    fclose(file);
+    // the panel verifies P-256 signatures only
+    char group[32] = "";
+    if (key && (!EVP_PKEY_get_utf8_string_param(key, "group", group, sizeof(group), NULL) || strcmp(group, "prime256v1")))
+    {
+        EVP_PKEY_free(key);
+        key = NULL;
+    }
+    return key != NULL;
+}
+
+std::string FirmwareSigner::publicKey() const
+{
+    BIO *bio = BIO_new(BIO_s_mem());
+    std::string pem;
+    if (key && PEM_write_bio_PUBKEY(bio, key) == 1)
+    {
+        char *data;
+        long len = BIO_get_mem_data(bio, &data);
+        pem.assign(data, len);
+    }
+    BIO_free(bio);
+    return pem;
+}
+
+std::string FirmwareSigner::sign(const uint8_t *image, size_t len) const
+{
+    std::string signature;
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    size_t size = 0;
+    if (key && EVP_DigestSignInit(ctx, NULL, EVP_sha256(), NULL, key) == 1 && EVP_DigestSign(ctx, NULL, &size, image, len) == 1)
+    {
+        signature.resize(size);
+        if (EVP_DigestSign(ctx, (unsigned char *)&signature[0], &size, image, len) == 1)
+            signature.resize(size);
+        else
+            signature.clear();
+    }
+    EVP_MD_CTX_free(ctx);
+    return signature;
+}
@@ -0,0 +1,42 @@
+#ifndef NATIVE_SIGNING_H
+#define NATIVE_SIGNING_H
+
+#include <string>
+#include <openssl/evp.h>
+
+#include "firmwarestream.h"
+
+// FirmwareVerifier over OpenSSL, the host counterpart of MbedTlsVerifier
+class OpenSslVerifier : public FirmwareVerifier {
+    public:
+        // PEM, as in FIRMWARE_SIGNING_KEY
+        OpenSslVerifier(const char *publicKey);
+        ~OpenSslVerifier();
+        bool start() override;
+        bool update(const uint8_t *data, size_t len) override;
+        bool verify(const uint8_t *signature, size_t len) override;
+
+    private:
+        EVP_PKEY *key;
+        EVP_MD_CTX *ctx;
+};
+
+// Release signing key of 'status_sim sign': ECDSA P-256 over the SHA-256 of an image
+class FirmwareSigner {
+    public:
+        FirmwareSigner();
+        ~FirmwareSigner();
+        // a throwaway key
+        bool generate();
+        // PEM private key file, e.g. from openssl ecparam -name prime256v1 -genkey -noout
+        bool load(const char *path);
+        // PEM, for FIRMWARE_SIGNING_KEY
+        std::string publicKey() const;
+        // DER encoded, empty on failure
+        std::string sign(const uint8_t *image, size_t len) const;
+
+    private:
+        EVP_PKEY *key;
+};
+
+#endif
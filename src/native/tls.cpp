@@ -0,0 +1,350 @@
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <esp_log.h>
+
+#include "emoji.h"
+#include "tls.h"
+
+static void setTimeout(int fd, uint32_t ms)
+{
+    struct timeval timeout = {(time_t)(ms / 1000), (suseconds_t)(ms % 1000 * 1000)};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+OpenSslTransport::OpenSslTransport() :
+    ctx(SSL_CTX_new(TLS_client_method())),
+    ssl(NULL),
+    fd(-1),
+    pinned(false),
+    resume(true),
+    wasResumed(false),
+    session(NULL)
+{
+    // writes to a connection the server dropped must fail, not kill the process
+    signal(SIGPIPE, SIG_IGN);
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
+    SSL_CTX_set_default_verify_paths(ctx);
+    // TLS 1.3 tickets arrive after the handshake, collect them from the callback
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx, newSession);
+}
+
+OpenSslTransport::~OpenSslTransport()
+{
+    close();
+    SSL_SESSION_free(session);
+    SSL_CTX_free(ctx);
+}
+
+void OpenSslTransport::trust(X509 *cert)
+{
+    X509_STORE *store = X509_STORE_new();
+    X509_STORE_add_cert(store, cert);
+    SSL_CTX_set_cert_store(ctx, store);
+    pinned = true;
+}
+
+int OpenSslTransport::newSession(SSL *ssl, SSL_SESSION *session)
+{
+    OpenSslTransport *transport = static_cast<OpenSslTransport *>(SSL_get_app_data(ssl));
+    SSL_SESSION_free(transport->session);
+    transport->session = session;
+    return 1;
+}
+
+bool OpenSslTransport::connect(const char *host, uint16_t port, uint32_t timeoutMs)
+{
+    close();
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    struct addrinfo hints = {};
+    struct addrinfo *addresses;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, service, &hints, &addresses))
+        return false;
+    for (struct addrinfo *address = addresses; address && fd < 0; address = address->ai_next)
+    {
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0)
+            continue;
+        setTimeout(fd, timeoutMs);
+        if (::connect(fd, address->ai_addr, address->ai_addrlen))
+        {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (fd < 0)
+        return false;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    ssl = SSL_new(ctx);
+    SSL_set_app_data(ssl, this);
+    SSL_set_fd(ssl, fd);
+    SSL_set_tlsext_host_name(ssl, host);
+    // a pinned certificate (local stand-in) is not checked against the host name
+    if (!pinned)
+        SSL_set1_host(ssl, host);
+    if (resume && session)
+        SSL_set_session(ssl, session);
+    if (SSL_connect(ssl) != 1)
+    {
+        ESP_LOGE(__func__, "TLS handshake with %s failed: %s", host, ERR_reason_error_string(ERR_get_error()));
+        close();
+        return false;
+    }
+    wasResumed = SSL_session_reused(ssl);
+    return true;
+}
+
+int OpenSslTransport::write(const uint8_t *data, size_t len)
+{
+    return ssl ? SSL_write(ssl, data, len) : -1;
+}
+
+int OpenSslTransport::read(uint8_t *data, size_t len)
+{
+    if (!ssl)
+        return -1;
+    int n = SSL_read(ssl, data, len);
+    if (n <= 0 && SSL_get_error(ssl, n) == SSL_ERROR_ZERO_RETURN)
+        return 0;
+    return n;
+}
+
+void OpenSslTransport::close()
+{
+    if (ssl)
+    {
+        SSL_shutdown(ssl);
+        SSL_free(ssl);
+        ssl = NULL;
+    }
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
+
+EmojiServer::EmojiServer() :
+    ctx(NULL),
+    cert(NULL),
+    listenFd(-1),
+    port(0),
+    idleMs(0),
+    releases(10),
+    releaseFailures(0),
+    releaseRequests(0),
+    notModified(0),
+    releaseBytes(0),
+    handshakes(0),
+    resumedHandshakes(0)
+{
+}
+
+EmojiServer::~EmojiServer()
+{
+    if (listenFd >= 0)
+        close(listenFd);
+    X509_free(cert);
+    SSL_CTX_free(ctx);
+}
+
+// Create a P-256 key and a self-signed certificate, then listen on 127.0.0.1:port (0 picks one)
+bool EmojiServer::begin(uint16_t port, uint32_t idleMs)
+{
+    this->idleMs = idleMs;
+    EVP_PKEY *key = EVP_EC_gen("P-256");
+    cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)"localhost", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_sign(cert, key, EVP_sha256());
+
+    ctx = SSL_CTX_new(TLS_server_method());
+    bool ok = SSL_CTX_use_certificate(ctx, cert) == 1 && SSL_CTX_use_PrivateKey(ctx, key) == 1;
+    EVP_PKEY_free(key);
+    if (!ok)
+        return false;
+
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    socklen_t len = sizeof(address);
+    if (bind(listenFd, (struct sockaddr *)&address, sizeof(address)) || listen(listenFd, 8) ||
+        getsockname(listenFd, (struct sockaddr *)&address, &len))
+        return false;
+    this->port = ntohs(address.sin_port);
+    return true;
+}
+
+// GitHub shaped list of the newest limit of count releases, every third one a prerelease
+static std::string releaseList(int count, int limit)
+{
+    std::string json = "[";
+    char release[640];
+    for (int i = 0; i < count && i < limit; i++)
+    {
+        int version = count - i;
+        snprintf(release, sizeof(release),
+                 "%s{\"url\":\"https://api.github.com/repos/elliotmatson/esp32-hub75-status/releases/%d\",\"id\":%d,"
+                 "\"tag_name\":\"v0.%d.0\",\"name\":\"v0.%d.0\",\"draft\":false,\"prerelease\":%s,"
+                 "\"created_at\":\"2024-%02d-%02dT10:00:00Z\",\"published_at\":\"2024-%02d-%02dT12:00:00Z\","
+                 "\"assets\":[{\"name\":\"esp32.bin\",\"size\":%d,\"browser_download_url\":"
+                 "\"https://github.com/elliotmatson/esp32-hub75-status/releases/download/v0.%d.0/esp32.bin\"}],"
+                 "\"body\":\"Release notes for v0.%d.0, with a line or two about what changed.\"}",
+                 i ? "," : "", 1000 + version, 1000 + version, version, version, version % 3 ? "false" : "true",
+                 version % 12 + 1, version % 28 + 1, version % 12 + 1, version % 28 + 1, 1200000 + version, version, version);
+        json += release;
+    }
+    return json + "]";
+}
+
+// Accept connections forever, one thread each
+void EmojiServer::run()
+{
+    for (;;)
+    {
+        int fd = accept(listenFd, NULL, NULL);
+        if (fd < 0)
+            continue;
+        std::thread([this, fd]()
+                    { serve(fd); })
+            .detach();
+    }
+}
+
+void EmojiServer::serve(int fd)
+{
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setTimeout(fd, idleMs);
+    SSL *ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    if (SSL_accept(ssl) == 1)
+    {
+        handshakes++;
+        if (SSL_session_reused(ssl))
+            resumedHandshakes++;
+
+        char request[1024];
+        size_t used = 0;
+        bool keepAlive = true;
+        while (keepAlive)
+        {
+            char *end;
+            while (!(end = (char *)memmem(request, used, "\r\n\r\n", 4)))
+            {
+                int n = used < sizeof(request) ? SSL_read(ssl, &request[used], sizeof(request) - used) : 0;
+                if (n <= 0)
+                {
+                    keepAlive = false;
+                    break;
+                }
+                used += n;
+            }
+            if (!keepAlive)
+                break;
+            *end = '\0';
+            keepAlive = !strcasestr(request, "Connection: close");
+
+            char key[EMOJI_KEY_MAX];
+            char header[256];
+            char latest[8] = "";
+            char after = 0;
+            std::string body;
+            bool found = true;
+            if (sscanf(request, "GET /repos/%*[^/]/%*[^/]/releases%c", &after) == 1 && (after == ' ' ||
+                (after == '/' && sscanf(request, "GET /repos/%*[^/]/%*[^/]/releases/%7[^ ]", latest) == 1 && !strcmp(latest, "latest"))))
+            {
+                releaseRequests++;
+                int count = releases;
+                int len;
+                // the feed changes whenever a release is added
+                char etag[32];
+                snprintf(etag, sizeof(etag), "\"releases-%d%s\"", count, latest);
+                const char *match = strcasestr(request, "\r\nIf-None-Match: ");
+                if (releaseFailures > 0)
+                {
+                    releaseFailures--;
+                    len = snprintf(header, sizeof(header), "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: %s\r\n\r\n",
+                                   keepAlive ? "keep-alive" : "close");
+                }
+                else if (match && !strncmp(match + 17, etag, strlen(etag)))
+                {
+                    notModified++;
+                    len = snprintf(header, sizeof(header), "HTTP/1.1 304 Not Modified\r\nETag: %s\r\nConnection: %s\r\n\r\n", etag, keepAlive ? "keep-alive" : "close");
+                }
+                else
+                {
+                    body = releaseList(count, latest[0] ? 1 : count);
+                    // the latest release is an object, not a list
+                    if (latest[0])
+                        body = body.substr(1, body.size() - 2);
+                    releaseBytes += body.size();
+                    len = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nETag: %s\r\n"
+                                   "Last-Modified: Mon, %02d Jan 2024 12:00:00 GMT\r\nContent-Length: %zu\r\nConnection: %s\r\n\r\n",
+                                   etag, count % 28 + 1, body.size(), keepAlive ? "keep-alive" : "close");
+                }
+                if (SSL_write(ssl, header, len) <= 0 || (body.size() && SSL_write(ssl, body.data(), body.size()) <= 0))
+                    break;
+                size_t consumed = end + 4 - request;
+                memmove(request, &request[consumed], used - consumed);
+                used -= consumed;
+                continue;
+            }
+            if (sscanf(request, "GET /api/v1/%63[^/]/32.raw", key) == 1)
+            {
+                // flat color derived from the key, opaque
+                uint32_t hash = 2166136261u;
+                for (const char *c = key; *c; c++)
+                    hash = (hash ^ (uint8_t)*c) * 16777619u;
+                body.resize(EMOJI_SIZE * EMOJI_SIZE * 4);
+                for (size_t i = 0; i < body.size(); i += 4)
+                {
+                    body[i] = hash;
+                    body[i + 1] = hash >> 8;
+                    body[i + 2] = hash >> 16;
+                    body[i + 3] = (char)255;
+                }
+            }
+            else
+                found = false;
+            int len = snprintf(header, sizeof(header), "HTTP/1.1 %s\r\nContent-Length: %zu\r\nConnection: %s\r\n\r\n",
+                               found ? "200 OK" : "404 Not Found", body.size(), keepAlive ? "keep-alive" : "close");
+            if (SSL_write(ssl, header, len) <= 0 || (found && SSL_write(ssl, body.data(), body.size()) <= 0))
+                break;
+
+            size_t consumed = end + 4 - request;
+            memmove(request, &request[consumed], used - consumed);
+            used -= consumed;
+        }
+        SSL_shutdown(ssl);
+    }
+    SSL_free(ssl);
+    close(fd);
+}
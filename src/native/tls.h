@@ -0,0 +1,76 @@
+#ifndef NATIVE_TLS_H
+#define NATIVE_TLS_H
+
+#include <atomic>
+#include <stdint.h>
+#include <openssl/ssl.h>
+
+#include "httpssession.h"
+
+// TlsTransport over OpenSSL sockets, the host counterpart of EspTlsTransport.
+// Keeps the newest session ticket and offers it on the next connect.
+class OpenSslTransport : public TlsTransport {
+    public:
+        OpenSslTransport();
+        ~OpenSslTransport();
+        // trust only this certificate, e.g. the one of a local EmojiServer
+        void trust(X509 *cert);
+        void setResume(bool resume) { this->resume = resume; }
+        bool connect(const char *host, uint16_t port, uint32_t timeoutMs) override;
+        int write(const uint8_t *data, size_t len) override;
+        int read(uint8_t *data, size_t len) override;
+        void close() override;
+        bool resumed() override { return wasResumed; }
+
+    private:
+        SSL_CTX *ctx;
+        SSL *ssl;
+        int fd;
+        bool pinned;
+        bool resume;
+        bool wasResumed;
+        SSL_SESSION *session;
+
+        static int newSession(SSL *ssl, SSL_SESSION *session);
+};
+
+// Local HTTPS stand-in for the emoji origin with a throwaway self-signed certificate.
+// Answers GET /api/v1/<codepoints>/32.raw with a 4096 byte RGBA tile, and the GitHub
+// release list GET /repos/<owner>/<repo>/releases (and .../releases/latest) with
+// setReleases() made up releases, with an ETag and 304 for conditional requests.
+// Keeps connections alive and closes them after idleMs without a request.
+class EmojiServer {
+    public:
+        EmojiServer();
+        ~EmojiServer();
+        bool begin(uint16_t port, uint32_t idleMs);
+        void run();
+        uint16_t getPort() const { return port; }
+        X509 *getCertificate() const { return cert; }
+        uint32_t getHandshakes() const { return handshakes; }
+        uint32_t getResumed() const { return resumedHandshakes; }
+        void setReleases(int count) { releases = count; }
+        // answer the next count release requests with 503
+        void failReleases(int count) { releaseFailures = count; }
+        uint32_t getReleaseRequests() const { return releaseRequests; }
+        uint32_t getNotModified() const { return notModified; }
+        uint64_t getReleaseBytes() const { return releaseBytes; }
+
+    private:
+        SSL_CTX *ctx;
+        X509 *cert;
+        int listenFd;
+        uint16_t port;
+        uint32_t idleMs;
+        std::atomic<int> releases;
+        std::atomic<int> releaseFailures;
+        std::atomic<uint32_t> releaseRequests;
+        std::atomic<uint32_t> notModified;
+        std::atomic<uint64_t> releaseBytes; // bodies of release requests
+        std::atomic<uint32_t> handshakes;
+        std::atomic<uint32_t> resumedHandshakes;
+
+        void serve(int fd);
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include <math.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include "colorlut.h"
+
+static const ColorSettings defaults = {22, {255, 255, 255}, true, false, COLOR_DEPTH_BITS};
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// Largest distance of the 4x4 tile average of each value from the exact drive level, in
+// levels, and the distinct shades in 0..63, for what the panel shows once the dark bit
+// planes are gone. Temporal dithering averages the phases of each pixel first.
+static double tileError(const ColorSettings &settings, uint8_t brightness, int *shades, double *grain)
+{
+    ColorLut lut;
+    lut.build(settings, brightness);
+    int step = 1 << lut.getDroppedBits();
+    int phases = settings.temporal ? COLOR_TEMPORAL_PHASES : 1;
+    double maxError = 0;
+    double squares = 0;
+    double last = -1;
+    *shades = 0;
+    for (int v = 0; v < 256; v++)
+    {
+        double exact = powf(v / 255.0f, settings.gamma / 10.0f) * settings.whiteBalance[0];
+        double sum = 0;
+        for (int y = 0; y < 4; y++)
+        {
+            for (int x = 0; x < 4; x++)
+            {
+                double pixel = 0;
+                for (int p = 0; p < phases; p++)
+                {
+                    lut.setPhase(p);
+                    pixel += lut.apply(0, v, x, y) & ~(step - 1);
+                }
+                pixel /= phases;
+                squares += (pixel - exact) * (pixel - exact);
+                sum += pixel;
+            }
+        }
+        double mean = sum / 16;
+        maxError = fmax(maxError, fabs(mean - exact));
+        if (v < 64 && mean != last)
+            (*shades)++;
+        last = v < 64 ? mean : last;
+    }
+    if (grain)
+        *grain = sqrt(squares / (256 * 16)) / step;
+    return maxError;
+}
+
+// The 4x4 average of a dithered value lands within one visible level of the exact one,
+// and keeps more dark shades apart than plain rounding
+static void test_dither_average_within_a_step(void)
+{
+    static const uint8_t levels[] = {255, 128, 64, 32, 16, 8};
+    for (uint8_t brightness : levels)
+    {
+        ColorSettings plain = defaults;
+        plain.dither = false;
+        ColorLut lut;
+        lut.build(defaults, brightness);
+        int shades;
+        int plainShades;
+        double error = tileError(defaults, brightness, &shades, NULL);
+        tileError(plain, brightness, &plainShades, NULL);
+        TEST_ASSERT_TRUE_MESSAGE(error <= 1 << lut.getDroppedBits(), "dithered average off by more than a step");
+        TEST_ASSERT_GREATER_OR_EQUAL(plainShades, shades);
+    }
+}
+
+// Per pixel float pipeline the tables replace: gamma, white balance and a division per channel
+static void test_tables_match_float_pipeline(void)
+{
+    ColorSettings settings = defaults;
+    settings.dither = false;
+    static const uint8_t balances[][3] = {{255, 255, 255}, {255, 200, 160}};
+    for (const auto &balance : balances)
+    {
+        for (int c = 0; c < 3; c++)
+            settings.whiteBalance[c] = balance[c];
+        ColorLut lut;
+        lut.build(settings, 255);
+        for (int v = 0; v < 256; v++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                int expected = (uint8_t)(powf(v / 255.0f, settings.gamma / 10.0f) * settings.whiteBalance[c] * 255 / 255.0f + 0.5f);
+                TEST_ASSERT_LESS_OR_EQUAL(1, abs(lut.apply(c, v, 0, 0) - expected));
+            }
+        }
+    }
+}
+
+// Temporal dithering halves the grain and never moves the tile average further away
+static void test_temporal_dither_reduces_grain(void)
+{
+    static const uint8_t levels[] = {255, 64, 16, 8};
+    for (uint8_t depth = COLOR_DEPTH_MIN; depth <= COLOR_DEPTH_BITS; depth++)
+    {
+        for (uint8_t brightness : levels)
+        {
+            ColorSettings spatial = defaults;
+            spatial.depthBits = depth;
+            ColorSettings temporal = spatial;
+            temporal.temporal = true;
+            int shades;
+            double grain[2];
+            double error[2];
+            error[0] = tileError(spatial, brightness, &shades, &grain[0]);
+            error[1] = tileError(temporal, brightness, &shades, &grain[1]);
+            TEST_ASSERT_TRUE_MESSAGE(grain[1] <= grain[0], "temporal dither adds grain");
+            TEST_ASSERT_TRUE_MESSAGE(error[1] <= error[0] + 0.5, "temporal dither moves the average away");
+        }
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_dither_average_within_a_step);
+    RUN_TEST(test_tables_match_float_pipeline);
+    RUN_TEST(test_temporal_dither_reduces_grain);
+    return UNITY_END();
+}
@@ -0,0 +1,186 @@
+#include <math.h>
+#include <string.h>
+#include <unity.h>
+#include <ESP32-HUB75-MatrixPanel-I2S-DMA.h>
+
+#include "display.h"
+
+static uint8_t emojiFrame[EMOJI_FRAME_BYTES];
+static const ColorSettings defaults = {22, {255, 255, 255}, true, false, COLOR_DEPTH_BITS};
+
+static HUB75_I2S_CFG panelConfig()
+{
+    HUB75_I2S_CFG mxconfig(DISPLAY_WIDTH, DISPLAY_HEIGHT, 1);
+    mxconfig.double_buff = true;
+    return mxconfig;
+}
+
+// Yellow disc with a soft edge and the status text below it
+static void compose(Display &display)
+{
+    display.drawEmoji(emojiFrame);
+    display.drawText("In a meeting");
+}
+
+void setUp(void)
+{
+    uint8_t rgba[EMOJI_SIZE * EMOJI_SIZE * 4];
+    for (int y = 0; y < EMOJI_SIZE; y++)
+    {
+        for (int x = 0; x < EMOJI_SIZE; x++)
+        {
+            float d = hypotf(x - 15.5f, y - 15.5f);
+            uint8_t *px = &rgba[(y * EMOJI_SIZE + x) * 4];
+            px[0] = 255;
+            px[1] = 200 - y * 3;
+            px[2] = 40;
+            px[3] = d < 14.0f ? 255 : (d < 16.0f ? (16.0f - d) / 2.0f * 255 : 0);
+        }
+    }
+    emojiFromRGBA(rgba, emojiFrame, EMOJI_SIZE * EMOJI_SIZE);
+}
+
+void tearDown(void) {}
+
+// Only pixels that differ from what the panel shows are pushed: the hidden buffer catches
+// up with the previous commit once, after that an unchanged frame writes nothing
+static void test_commit_pushes_changed_pixels_only(void)
+{
+    MatrixPanel_I2S_DMA panel(panelConfig());
+    Display display;
+    TEST_ASSERT_TRUE(panel.begin() && display.begin(&panel, true));
+    compose(display);
+    display.commit();
+    display.commit();
+    TEST_ASSERT_EQUAL_UINT32(0, display.commit());
+    display.drawText("Lunch");
+    uint32_t pixels = display.commit();
+    TEST_ASSERT_GREATER_THAN(0, pixels);
+    TEST_ASSERT_LESS_THAN(DISPLAY_WIDTH * (DISPLAY_HEIGHT - TEXT_Y), pixels);
+    TEST_ASSERT_EQUAL_UINT32(pixels, display.commit());
+    TEST_ASSERT_EQUAL_UINT32(0, display.commit());
+}
+
+// A static frame is only flipped, and the two buffers show the complementary patterns
+static void test_temporal_dither_of_static_frame_only_flips(void)
+{
+    HUB75_I2S_CFG mxconfig = panelConfig();
+    mxconfig.setPixelColorDepthBits(6);
+    MatrixPanel_I2S_DMA panel(mxconfig);
+    Display display;
+    TEST_ASSERT_TRUE(panel.begin() && display.begin(&panel, true));
+    ColorSettings settings = defaults;
+    settings.temporal = true;
+    settings.depthBits = 6;
+    display.setColor(settings, 16);
+    display.drawEmoji(emojiFrame);
+    for (int y = TEXT_Y; y < DISPLAY_HEIGHT; y++)
+    {
+        for (int x = 0; x < DISPLAY_WIDTH; x++)
+        {
+            uint8_t px[3] = {(uint8_t)(x * 2), (uint8_t)(x * 2), (uint8_t)(x * 2)};
+            display.blit(x, y, 1, 1, px);
+        }
+    }
+    display.commit();
+    display.ditherFrame();
+
+    static uint8_t shown[DISPLAY_WIDTH * DISPLAY_HEIGHT * 3];
+    memcpy(shown, panel.getFramebuffer(), sizeof(shown));
+    panel.resetPixelWrites();
+    uint32_t flips = panel.getFlips();
+    int differing = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        display.ditherFrame();
+        if (i == 0)
+        {
+            for (size_t p = 0; p < sizeof(shown); p++)
+                differing += shown[p] != panel.getFramebuffer()[p];
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, panel.getPixelWrites());
+    TEST_ASSERT_EQUAL_UINT32(100, panel.getFlips() - flips);
+    TEST_ASSERT_GREATER_THAN(0, differing);
+}
+
+// Restarting the driver with other clock and depth settings the way Panel::reinitDisplay
+// does brings back the frame as a fresh driver shows it
+static void test_driver_restart_restores_the_frame(void)
+{
+    static const struct
+    {
+        HUB75_I2S_CFG::clk_speed clock;
+        uint8_t depth;
+    } configs[] = {{HUB75_I2S_CFG::HZ_20M, 8}, {HUB75_I2S_CFG::HZ_10M, 6}, {HUB75_I2S_CFG::HZ_20M, 5}, {HUB75_I2S_CFG::HZ_10M, 8}};
+    HUB75_I2S_CFG mxconfig = panelConfig();
+    ColorSettings settings = defaults;
+    MatrixPanel_I2S_DMA *panel = new MatrixPanel_I2S_DMA(mxconfig);
+    Display display;
+    TEST_ASSERT_TRUE(panel->begin() && display.begin(panel, true));
+    display.setColor(settings, 255);
+    compose(display);
+    display.commit();
+    for (const auto &config : configs)
+    {
+        mxconfig.i2sspeed = config.clock;
+        mxconfig.setPixelColorDepthBits(config.depth);
+        settings.depthBits = config.depth;
+        delete panel;
+        panel = new MatrixPanel_I2S_DMA(mxconfig);
+        TEST_ASSERT_TRUE(panel->begin());
+        display.setPanel(panel, mxconfig.double_buff);
+        display.setColor(settings, 255);
+        TEST_ASSERT_EQUAL_UINT32(DISPLAY_WIDTH * DISPLAY_HEIGHT, display.commit());
+
+        MatrixPanel_I2S_DMA fresh(mxconfig);
+        Display reference;
+        TEST_ASSERT_TRUE(fresh.begin() && reference.begin(&fresh, true));
+        reference.setColor(settings, 255);
+        compose(reference);
+        reference.commit();
+        TEST_ASSERT_EQUAL_MEMORY(fresh.getFramebuffer(), panel->getFramebuffer(), DISPLAY_WIDTH * DISPLAY_HEIGHT * 3);
+    }
+    delete panel;
+}
+
+// With no driver running, as Panel::reinitDisplay leaves it when no configuration fits,
+// commits draw nothing and the next driver gets the frame composed meanwhile
+static void test_commit_without_a_driver_waits_for_the_next(void)
+{
+    MatrixPanel_I2S_DMA *panel = new MatrixPanel_I2S_DMA(panelConfig());
+    Display display;
+    TEST_ASSERT_TRUE(panel->begin() && display.begin(panel, true));
+    ColorSettings settings = defaults;
+    settings.temporal = true;
+    display.setColor(settings, 16);
+    display.commit();
+    delete panel;
+    display.setPanel(NULL, false);
+    compose(display);
+    TEST_ASSERT_EQUAL_UINT32(0, display.commit());
+    TEST_ASSERT_EQUAL_UINT32(0, display.ditherFrame());
+
+    panel = new MatrixPanel_I2S_DMA(panelConfig());
+    TEST_ASSERT_TRUE(panel->begin());
+    display.setPanel(panel, true);
+    TEST_ASSERT_EQUAL_UINT32(DISPLAY_WIDTH * DISPLAY_HEIGHT, display.commit());
+    MatrixPanel_I2S_DMA fresh(panelConfig());
+    Display reference;
+    TEST_ASSERT_TRUE(fresh.begin() && reference.begin(&fresh, true));
+    reference.setColor(settings, 16);
+    compose(reference);
+    reference.commit();
+    TEST_ASSERT_EQUAL_MEMORY(fresh.getFramebuffer(), panel->getFramebuffer(), DISPLAY_WIDTH * DISPLAY_HEIGHT * 3);
+    delete panel;
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_commit_pushes_changed_pixels_only);
+    RUN_TEST(test_temporal_dither_of_static_frame_only_flips);
+    RUN_TEST(test_driver_restart_restores_the_frame);
+    RUN_TEST(test_commit_without_a_driver_waits_for_the_next);
+    return UNITY_END();
+}
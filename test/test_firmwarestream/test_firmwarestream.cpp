@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unity.h>
+
+#include "firmwarestream.h"
+#include "heaptrack.h"
+
+#define IMAGE_SIZE (128 * 1024)
+
+static const char cookie[FIRMWARE_COOKIE_SIZE] = "status_FW";
+
+// Running image and OTA partition in memory
+class MemorySource : public FirmwareSource {
+    public:
+        MemorySource(const std::string &image) : image(image) {}
+
+        bool read(uint32_t offset, uint8_t *data, size_t len) override
+        {
+            if (offset > image.size() || len > image.size() - offset)
+                return false;
+            memcpy(data, &image[offset], len);
+            return true;
+        }
+
+    private:
+        const std::string &image;
+};
+
+class MemoryTarget : public FirmwareTarget {
+    public:
+        std::string image;
+        bool begun = false;
+
+        bool begin(uint32_t size) override
+        {
+            begun = true;
+            image.clear();
+            image.reserve(size);
+            return true;
+        }
+
+        bool write(const uint8_t *data, size_t len) override
+        {
+            image.append((const char *)data, len);
+            return true;
+        }
+};
+
+// Stand-in for the ECDSA check: the signature is the FNV-1a hash of the image
+class HashVerifier : public FirmwareVerifier {
+    public:
+        static uint32_t hash(const uint8_t *data, size_t len, uint32_t hash = 2166136261u)
+        {
+            for (size_t i = 0; i < len; i++)
+                hash = (hash ^ data[i]) * 16777619u;
+            return hash;
+        }
+
+        bool start() override
+        {
+            state = 2166136261u;
+            return true;
+        }
+
+        bool update(const uint8_t *data, size_t len) override
+        {
+            state = hash(data, len, state);
+            return true;
+        }
+
+        bool verify(const uint8_t *signature, size_t len) override
+        {
+            return len == sizeof(state) && !memcmp(signature, &state, sizeof(state));
+        }
+
+    private:
+        uint32_t state;
+};
+
+static std::string running;
+static std::string next;
+static std::string compressed;
+static std::string patch;
+static FirmwareStream stream;
+
+// An esptool image of code-like data with the panel cookie where the linker puts it
+static std::string modelImage()
+{
+    std::string image(IMAGE_SIZE, 0);
+    for (size_t i = 0; i < image.size(); i++)
+        image[i] = i % 7 ? rand() % 16 : rand();
+    image[0] = FIRMWARE_IMAGE_MAGIC;
+    image.replace(FIRMWARE_COOKIE_OFFSET, sizeof(cookie), cookie, sizeof(cookie));
+    return image;
+}
+
+// Next build: new code inserted in a few places
+static std::string nextBuild(const std::string &image)
+{
+    std::string build = image;
+    for (size_t at : {image.size() * 4 / 5, image.size() / 2, image.size() / 5})
+    {
+        std::string code(200 + rand() % 1800, 0);
+        for (char &c : code)
+            c = rand();
+        build.insert(at & ~(size_t)3, code);
+    }
+    return build;
+}
+
+static std::string compress(const std::string &image)
+{
+    std::string out(image.size() + image.size() / 8 + 64, 0);
+    out.resize(firmwareCompress((const uint8_t *)image.data(), image.size(), (uint8_t *)&out[0], out.size()));
+    return out;
+}
+
+static std::string signStream(const std::string &image, const std::string &data)
+{
+    uint32_t signature = HashVerifier::hash((const uint8_t *)image.data(), image.size());
+    std::string out(data.size() + 6 + FIRMWARE_SIGNATURE_MAX, 0);
+    out.resize(firmwareSign((const uint8_t *)data.data(), data.size(), (const uint8_t *)&signature, sizeof(signature),
+                            (uint8_t *)&out[0], out.size()));
+    return out;
+}
+
+// Push a stream in network sized pieces, true if the target got the image
+static bool apply(MemoryTarget &target, MemorySource *source, const std::string &data, FirmwareVerifier *verifier = NULL,
+                  bool checkCookie = false)
+{
+    stream.reset(&target, source);
+    if (checkCookie || verifier)
+        stream.require(cookie, verifier);
+    for (size_t at = 0; at < data.size();)
+    {
+        size_t n = std::min((size_t)(1 + rand() % 1460), data.size() - at);
+        if (!stream.write((const uint8_t *)&data[at], n))
+            return false;
+        at += n;
+    }
+    return stream.finish();
+}
+
+void setUp(void)
+{
+    srand(1);
+    running = modelImage();
+    next = nextBuild(running);
+    compressed = compress(next);
+    patch.assign(next.size() * 2 + 1024, 0);
+    patch.resize(firmwareDiff((const uint8_t *)running.data(), running.size(), (const uint8_t *)next.data(), next.size(),
+                              (uint8_t *)&patch[0], patch.size()));
+    TEST_ASSERT_TRUE(!compressed.empty() && !patch.empty());
+    TEST_ASSERT_TRUE(stream.begin());
+}
+
+void tearDown(void)
+{
+    stream.end();
+    TEST_ASSERT_EQUAL_UINT32(0, heapTagStats(HEAP_TAG_FIRMWARE).live);
+}
+
+static void test_crc32(void)
+{
+    static const uint8_t check[] = "123456789";
+    TEST_ASSERT_EQUAL_UINT32(0xCBF43926, firmwareCrc32(0, check, 9));
+}
+
+// Every format decodes to the new image, patches smaller than the image
+static void test_formats_decode_to_the_image(void)
+{
+    MemorySource source(running);
+    const std::string *formats[] = {&next, &compressed, &patch};
+    for (const std::string *data : formats)
+    {
+        MemoryTarget target;
+        TEST_ASSERT_TRUE_MESSAGE(apply(target, &source, *data), stream.getError());
+        TEST_ASSERT_TRUE(target.image == next);
+    }
+    TEST_ASSERT_LESS_THAN(next.size() / 4, patch.size());
+}
+
+// A patch for another build, or without the running image, is turned away before the
+// partition is touched
+static void test_patch_needs_its_running_image(void)
+{
+    std::string other = running;
+    other[other.size() / 2] ^= 1;
+    MemorySource otherSource(other);
+    MemoryTarget target;
+    TEST_ASSERT_FALSE(apply(target, &otherSource, patch));
+    TEST_ASSERT_FALSE(target.begun);
+    TEST_ASSERT_EQUAL_STRING("patch is for another build", stream.getError());
+    TEST_ASSERT_FALSE(apply(target, NULL, patch));
+}
+
+// Damage and truncation anywhere never produce an accepted image
+static void test_damaged_streams_never_install_another_image(void)
+{
+    MemorySource source(running);
+    for (int i = 0; i < 200; i++)
+    {
+        std::string damaged = i % 2 ? compressed : patch;
+        if (i % 4 < 2)
+            damaged[20 + rand() % (damaged.size() - 20)] ^= 1 << rand() % 8;
+        else
+            damaged.resize(20 + rand() % (damaged.size() - 20));
+        MemoryTarget target;
+        if (apply(target, &source, damaged))
+            TEST_ASSERT_TRUE(target.image == next);
+    }
+    MemoryTarget target;
+    TEST_ASSERT_FALSE(apply(target, &source, std::string("<html>Not Found</html>")));
+    TEST_ASSERT_FALSE(apply(target, &source, std::string()));
+}
+
+// An unchanged build patches to almost nothing
+static void test_unchanged_build_patch_is_small(void)
+{
+    MemorySource source(running);
+    std::string same(running.size() + 1024, 0);
+    same.resize(firmwareDiff((const uint8_t *)running.data(), running.size(), (const uint8_t *)running.data(), running.size(),
+                             (uint8_t *)&same[0], same.size()));
+    TEST_ASSERT_FALSE(same.empty());
+    TEST_ASSERT_LESS_OR_EQUAL(running.size() / 50, same.size());
+    MemoryTarget target;
+    TEST_ASSERT_TRUE(apply(target, &source, same));
+    TEST_ASSERT_TRUE(target.image == running);
+}
+
+// Another panel's image stops at the cookie and an unsigned one at its first bytes, both
+// before the partition is begun. A bad signature fails after the last byte.
+static void test_cookie_and_signature_are_required(void)
+{
+    MemorySource source(running);
+    HashVerifier verifier;
+    std::string foreign = next;
+    memcpy(&foreign[FIRMWARE_COOKIE_OFFSET], "other_FW", 9);
+    const struct
+    {
+        const char *name;
+        std::string data;
+        FirmwareVerifier *verifier;
+        bool accepted;
+    } cases[] = {
+        {"signed image", signStream(next, next), &verifier, true},
+        {"signed compressed", signStream(next, compressed), &verifier, true},
+        {"signed patch", signStream(next, patch), &verifier, true},
+        {"unsigned image", next, &verifier, false},
+        {"unsigned patch", patch, &verifier, false},
+        {"other panel's image", foreign, NULL, false},
+        {"other panel's compressed", compress(foreign), NULL, false},
+    };
+    for (const auto &test : cases)
+    {
+        MemoryTarget target;
+        TEST_ASSERT_EQUAL_MESSAGE(test.accepted, apply(target, &source, test.data, test.verifier, true), test.name);
+        if (test.accepted)
+            TEST_ASSERT_TRUE(target.image == next);
+        else
+        {
+            TEST_ASSERT_FALSE_MESSAGE(target.begun, test.name);
+            TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(1460, stream.getStats().received, test.name);
+        }
+    }
+
+    std::string tampered = signStream(next, next);
+    tampered[tampered.size() / 2] ^= 0x10;
+    MemoryTarget target;
+    TEST_ASSERT_FALSE(apply(target, &source, tampered, &verifier));
+    TEST_ASSERT_EQUAL_STRING("bad signature", stream.getError());
+    // without a key a signature is not required, and one that is there is skipped
+    TEST_ASSERT_TRUE(apply(target, &source, signStream(next, patch), NULL, true));
+    TEST_ASSERT_TRUE(target.image == next && stream.isSigned());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_crc32);
+    RUN_TEST(test_formats_decode_to_the_image);
+    RUN_TEST(test_patch_needs_its_running_image);
+    RUN_TEST(test_damaged_streams_never_install_another_image);
+    RUN_TEST(test_unchanged_build_patch_is_small);
+    RUN_TEST(test_cookie_and_signature_are_required);
+    return UNITY_END();
+}
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "emoji.h"
+#include "grapheme.h"
+
+// Emoji sequences covering each kind of cluster, with the key emojiapi.dev names it by
+static const struct
+{
+    const char *emoji;
+    const char *key;
+} samples[] = {
+    {"\U0001F600", "1f600"},                                              // grinning face
+    {"\U0001F44D\U0001F3FD", "1f44d_1f3fd"},                              // thumbs up, skin tone
+    {"\U0001F9D1\u200D\U0001F4BB", "1f9d1_200D_1f4bb"},                   // technologist
+    {"\U0001F469\U0001F3FE\u200D\U0001F692", "1f469_1f3fe_200D_1f692"},   // firefighter, skin tone
+    {"\U0001F468\u200D\U0001F469\u200D\U0001F467\u200D\U0001F466", "1f468_200D_1f469_200D_1f467_200D_1f466"}, // family
+    {"\U0001F1E9\U0001F1EA", "1f1e9_1f1ea"},                              // flag: Germany
+    {"\u2764\uFE0F", "2764"},                                             // red heart, emoji presentation
+    {"\U0001F3F3\uFE0F\u200D\U0001F308", "1f3f3_200D_1f308"},             // rainbow flag
+    {"#\uFE0F\u20E3", "23_20e3"},                                         // keycap
+    {"\U0001F3F4\U000E0067\U000E0062\U000E0065\U000E006E\U000E0067\U000E007F",
+     "1f3f4_e0067_e0062_e0065_e006e_e0067_e007f"},                        // flag: England
+};
+#define SAMPLES (sizeof(samples) / sizeof(samples[0]))
+
+// Pieces the fuzzer strings together: cluster parts, ASCII, and malformed or truncated UTF-8
+static const char *const fuzzPieces[] = {
+    "\U0001F600", "\U0001F9D1", "\U0001F3FD", "\u200D", "\uFE0F", "\U0001F1E9", "\U0001F1EA", "\u2764",
+    "\u20E3", "\U000E0067", "\U000E007F", "e\u0301", "a", " ", "\r\n", "\n", "\xC3", "\xE2\x80",
+    "\xF0\x9F\x98", "\x80", "\xC0\xAF", "\xED\xA0\x80", "\xF4\x90\x80\x80", "\xFF",
+};
+#define FUZZ_PIECES (sizeof(fuzzPieces) / sizeof(fuzzPieces[0]))
+#define FUZZ_STRINGS 20000
+
+void setUp(void)
+{
+    srand(1);
+}
+
+void tearDown(void) {}
+
+static void test_keys_of_every_cluster_kind(void)
+{
+    char key[EMOJI_KEY_MAX];
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        TEST_ASSERT_TRUE_MESSAGE(emojiKey(samples[i].emoji, key, sizeof(key)), samples[i].key);
+        TEST_ASSERT_EQUAL_STRING(samples[i].key, key);
+        TEST_ASSERT_EQUAL_size_t(strlen(samples[i].emoji), graphemeNext(samples[i].emoji, strlen(samples[i].emoji)));
+    }
+}
+
+// Random strings of fuzzPieces: every cluster is inside the string and moves on, keys never
+// overrun a short buffer and stay terminated
+static void test_fuzzed_strings_stay_in_bounds(void)
+{
+    char text[256];
+    char key[EMOJI_KEY_MAX];
+    for (int n = 0; n < FUZZ_STRINGS; n++)
+    {
+        size_t len = 0;
+        int pieces = 1 + rand() % 12;
+        for (int i = 0; i < pieces; i++)
+        {
+            const char *piece = fuzzPieces[rand() % FUZZ_PIECES];
+            size_t pieceLen = strlen(piece);
+            if (len + pieceLen >= sizeof(text))
+                break;
+            memcpy(text + len, piece, pieceLen);
+            len += pieceLen;
+        }
+
+        // exact sized copy without a terminator, so a sanitizer build catches any overread
+        char *exact = (char *)malloc(len);
+        memcpy(exact, text, len);
+        size_t pos = 0;
+        bool advanced = true;
+        while (pos < len && advanced)
+        {
+            size_t cluster = graphemeNext(exact + pos, len - pos);
+            advanced = cluster && cluster <= len - pos;
+            pos += cluster;
+        }
+        free(exact);
+        TEST_ASSERT_TRUE_MESSAGE(advanced, "cluster empty or past the end");
+
+        text[len] = '\0';
+        size_t size = 1 + rand() % sizeof(key);
+        memset(key, 0x55, sizeof(key));
+        bool ok = emojiKey(text, key, size);
+        TEST_ASSERT_LESS_THAN(size, strnlen(key, size));
+        TEST_ASSERT_TRUE_MESSAGE(size == sizeof(key) || key[size] == 0x55, "key written past its buffer");
+        TEST_ASSERT_TRUE_MESSAGE(ok || !key[0], "key left behind for a non-emoji");
+    }
+}
+
+// Known clusters separated by ASCII come back out whole
+static void test_clusters_between_text_come_out_whole(void)
+{
+    char text[256];
+    for (int n = 0; n < FUZZ_STRINGS / 10; n++)
+    {
+        size_t len = 0;
+        int order[8];
+        for (int i = 0; i < 8; i++)
+        {
+            order[i] = rand() % SAMPLES;
+            len += sprintf(text + len, "%s%s", samples[order[i]].emoji, i & 1 ? " " : "");
+        }
+        const char *p = text;
+        for (int i = 0; i < 8; i++)
+        {
+            size_t expected = strlen(samples[order[i]].emoji);
+            TEST_ASSERT_EQUAL_size_t_MESSAGE(expected, graphemeNext(p, text + len - p), samples[order[i]].key);
+            p += expected;
+            if (i & 1)
+                p += graphemeNext(p, text + len - p);
+        }
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_keys_of_every_cluster_kind);
+    RUN_TEST(test_fuzzed_strings_stay_in_bounds);
+    RUN_TEST(test_clusters_between_text_come_out_whole);
+    return UNITY_END();
+}
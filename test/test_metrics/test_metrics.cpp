@@ -0,0 +1,91 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <unity.h>
+
+#include "metrics.h"
+
+void setUp(void)
+{
+    srand(1);
+}
+
+void tearDown(void) {}
+
+static void test_bucket_edges(void)
+{
+    static const struct
+    {
+        uint32_t us;
+        int bucket;
+    } edges[] = {{0, 0}, {1, 0}, {32, 0}, {33, 1}, {64, 1}, {65, 2}, {1000, 5}, {4194304, 17}, {4194305, HISTOGRAM_BUCKETS}, {UINT32_MAX, HISTOGRAM_BUCKETS}};
+    for (const auto &edge : edges)
+        TEST_ASSERT_EQUAL_INT(edge.bucket, Histogram::bucket(edge.us));
+}
+
+// The exposition parses back to cumulative buckets ending in the count, and the sum
+static void test_exposition_matches_recorded(void)
+{
+    Histogram histogram("status_test_seconds", "Test durations");
+    uint64_t sumUs = 0;
+    for (int i = 0; i < 10000; i++)
+    {
+        uint32_t us = 1u << (rand() % 24) | rand() % 1024;
+        histogram.record(us);
+        sumUs += us;
+    }
+    static char text[4096];
+    histogram.format(text, sizeof(text));
+    uint32_t last = 0;
+    int buckets = 0;
+    double sum = 0;
+    uint32_t count = 0;
+    for (char *line = strtok(text, "\n"); line; line = strtok(NULL, "\n"))
+    {
+        uint32_t value;
+        if (sscanf(line, "status_test_seconds_bucket{le=%*[^}]} %u", &value) == 1)
+        {
+            TEST_ASSERT_GREATER_OR_EQUAL_UINT32(last, value);
+            last = value;
+            buckets++;
+        }
+        sscanf(line, "status_test_seconds_sum %lf", &sum);
+        sscanf(line, "status_test_seconds_count %u", &count);
+    }
+    TEST_ASSERT_EQUAL_INT(HISTOGRAM_BUCKETS + 1, buckets);
+    TEST_ASSERT_EQUAL_UINT32(10000, count);
+    TEST_ASSERT_EQUAL_UINT32(count, last);
+    TEST_ASSERT_TRUE_MESSAGE(fabs(sum - sumUs / 1e6) <= 1e-3, "sum differs from the recorded durations");
+}
+
+// Relaxed adds from several tasks, scraped meanwhile, lose nothing
+static void test_concurrent_records_are_all_counted(void)
+{
+    const uint32_t perThread = 250000;
+    Histogram shared("status_shared_seconds", "Concurrent durations");
+    std::thread threads[4];
+    for (int t = 0; t < 4; t++)
+    {
+        threads[t] = std::thread([&shared, perThread, t]()
+                                 {
+            for (uint32_t i = 0; i < perThread; i++)
+                shared.record((i * 7919 + t) % 100000); });
+    }
+    char scrape[4096];
+    while (shared.getCount() < perThread * 4)
+        shared.format(scrape, sizeof(scrape));
+    for (std::thread &thread : threads)
+        thread.join();
+    TEST_ASSERT_EQUAL_UINT32(perThread * 4, shared.getCount());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bucket_edges);
+    RUN_TEST(test_exposition_matches_recorded);
+    RUN_TEST(test_concurrent_records_are_all_counted);
+    return UNITY_END();
+}
@@ -0,0 +1,78 @@
+#include <string.h>
+#include <unity.h>
+
+#include "prefs.h"
+
+// brightness 40, development, OTA, no GitHub, unsigned, latch 3, 20 MHz, then one value per
+// field added by each layout: marquee 10; gamma 1.8, white balance, no dither; temporal
+// dither, depth 6; rollout 2 h, peer updates
+static const uint8_t settings[] = {40, 1, 1, 0, 0, 3, 1, 10, 18, 250, 240, 230, 0, 1, 6, 2, 1};
+static const size_t sizes[] = PANEL_PREFS_SIZES;
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// Stored preferences of every earlier layout load with their settings kept and the fields
+// added since at their defaults
+static void test_every_layout_keeps_its_settings(void)
+{
+    const PanelPrefs defaults;
+    for (int version = 1; version <= PANEL_PREFS_VERSION; version++)
+    {
+        uint8_t blob[sizeof(PanelPrefs)];
+        size_t size = sizes[version - 1];
+        // the version field came with layout 6, in front
+        bool versioned = version >= 6;
+        if (versioned)
+            blob[0] = version;
+        memcpy(&blob[versioned], settings, size - versioned);
+        PanelPrefs prefs;
+        TEST_ASSERT_TRUE_MESSAGE(loadPanelPrefs(&prefs, blob, size), "layout refused");
+        uint8_t expected[sizeof(PanelPrefs)];
+        memcpy(expected, &defaults, sizeof(expected));
+        memcpy(&expected[1], settings, size - versioned);
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(expected, &prefs, sizeof(prefs), "settings lost");
+        TEST_ASSERT_EQUAL(PANEL_PREFS_VERSION, prefs.version);
+    }
+}
+
+// A newer layout loads the fields this build knows
+static void test_newer_layout_keeps_known_fields(void)
+{
+    uint8_t newer[sizeof(PanelPrefs) + 1];
+    newer[0] = PANEL_PREFS_VERSION + 1;
+    memcpy(&newer[1], settings, sizeof(settings));
+    newer[sizeof(newer) - 1] = 7;
+    PanelPrefs prefs;
+    TEST_ASSERT_TRUE(loadPanelPrefs(&prefs, newer, sizeof(newer)));
+    TEST_ASSERT_EQUAL(40, prefs.brightness);
+    TEST_ASSERT_EQUAL(1, prefs.peerUpdates);
+}
+
+// Sizes and versions that fit no layout are refused and leave the defaults alone
+static void test_unknown_blobs_are_refused(void)
+{
+    const PanelPrefs defaults;
+    const struct
+    {
+        uint8_t version;
+        size_t size;
+    } bad[] = {{0, 0}, {6, 6}, {6, 16}, {6, 19}, {3, 18}, {0, 18}, {PANEL_PREFS_VERSION + 1, sizeof(PanelPrefs)}};
+    for (const auto &test : bad)
+    {
+        uint8_t blob[32] = {test.version};
+        PanelPrefs untouched;
+        TEST_ASSERT_FALSE(loadPanelPrefs(&untouched, blob, test.size));
+        TEST_ASSERT_EQUAL_MEMORY(&defaults, &untouched, sizeof(defaults));
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_every_layout_keeps_its_settings);
+    RUN_TEST(test_newer_layout_keeps_known_fields);
+    RUN_TEST(test_unknown_blobs_are_refused);
+    return UNITY_END();
+}
@@ -0,0 +1,84 @@
+#include <string.h>
+#include <unity.h>
+
+#include "releasefeed.h"
+
+static ReleaseFeed feed;
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// Edge cases of the feed, pushed a byte at a time as well as whole
+static void test_edge_cases(void)
+{
+    static const struct
+    {
+        const char *what;
+        const char *json;
+        bool prereleases;
+        const char *tag; // NULL: no release picked
+        int outcome;     // 1 read to the end, 0 cut short, -1 rejected
+    } cases[] = {
+        {"empty list", " [ ] ", false, NULL, 1},
+        {"no prereleases", "[{\"tag_name\":\"v1.0.0\",\"published_at\":\"2024-01-01T00:00:00Z\",\"prerelease\":false,\"assets\":[{\"name\":\"esp32.bin\"}]}]",
+         true, NULL, 1},
+        {"latest object", "{\"tag_name\":\"v2.0.0\",\"published_at\":\"2024-01-01T00:00:00Z\",\"prerelease\":false,\"assets\":[{\"name\":\"esp32.bin\"}]}",
+         false, "v2.0.0", 1},
+        {"no asset", "{\"tag_name\":\"v2.0.0\",\"published_at\":\"2024-01-01T00:00:00Z\",\"assets\":[]}", false, NULL, 1},
+        {"no date", "[{\"tag_name\":\"v2.0.0\",\"assets\":[{\"name\":\"esp32.bin\"}]}]", false, NULL, 1},
+        {"bad date", "[{\"tag_name\":\"v2.0.0\",\"published_at\":\"2024-02-30T00:00:00Z\",\"assets\":[{\"name\":\"esp32.bin\"}]}]", false, NULL, 1},
+        {"newest last", "[{\"tag_name\":\"a\",\"published_at\":\"2023-12-31T23:59:59Z\",\"assets\":[{\"name\":\"esp32.bin\"}]},"
+                        "{\"tag_name\":\"b\",\"published_at\":\"2024-01-01T00:00:00Z\",\"assets\":[{\"name\":\"esp32.bin\"}]}]", false, "b", 1},
+        {"escaped tag", "[{\"tag_name\":\"v1\\\"\\/2\",\"published_at\":\"2024-01-01T00:00:00Z\",\"assets\":[{\"name\":\"esp32.bin\"}]}]", false, "v1\"/2", 1},
+        {"truncated", "[{\"tag_name\":\"v1.0.0\",\"published_at\":\"2024-01-01T00:00:00Z\",\"assets\":[{\"name\":\"esp32.b", false, NULL, 0},
+        {"trailing comma", "[{\"tag_name\":\"v1.0.0\",}]", false, NULL, -1},
+        {"missing value", "[{\"tag_name\": }]", false, NULL, -1},
+        {"mismatched", "[{\"tag_name\":\"v1.0.0\"]}", false, NULL, -1},
+        {"bad literal", "[{\"draft\":tru}]", false, NULL, -1},
+        {"bad escape", "[{\"body\":\"\\x\"}]", false, NULL, -1},
+        {"data after", "[]]", false, NULL, -1},
+        {"not a list", "\"releases\"", false, NULL, -1},
+        {"error page", "<html>rate limited</html>", false, NULL, -1},
+        {"nested too deep", "[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]", false, NULL, -1},
+    };
+    for (const auto &test : cases)
+    {
+        for (int whole = 0; whole < 2; whole++)
+        {
+            feed.reset(test.prereleases, "esp32.bin");
+            size_t len = strlen(test.json);
+            bool ok = true;
+            for (size_t at = 0; ok && at < len; at += whole ? len : 1)
+                ok = feed.write((const uint8_t *)&test.json[at], whole ? len : 1);
+            ReleaseInfo release;
+            bool found = feed.getRelease(&release);
+            TEST_ASSERT_EQUAL_MESSAGE(test.outcome > 0, feed.finished(), test.what);
+            TEST_ASSERT_EQUAL_MESSAGE(test.outcome >= 0, ok, test.what);
+            TEST_ASSERT_EQUAL_MESSAGE(test.tag != NULL, found, test.what);
+            if (test.tag)
+                TEST_ASSERT_EQUAL_STRING_MESSAGE(test.tag, release.tag, test.what);
+        }
+    }
+}
+
+static void test_timestamps(void)
+{
+    static const struct
+    {
+        const char *text;
+        int64_t expected;
+    } timestamps[] = {{"1970-01-01T00:00:00Z", 0}, {"2000-03-01T00:00:00Z", 951868800}, {"2024-05-01T12:00:00Z", 1714564800},
+                      {"2024-02-29T23:59:59.999Z", 1709251199}, {"2100-12-31T00:00:00Z", 4133894400}, {"2024-05-01 12:00:00Z", -1},
+                      {"2024-05-01T12:00:00+02:00", -1}, {"2024-5-1T12:00:00Z", -1}, {"2024-13-01T12:00:00Z", -1}, {"", -1}};
+    for (const auto &timestamp : timestamps)
+        TEST_ASSERT_EQUAL_INT64_MESSAGE(timestamp.expected, parseTimestamp(timestamp.text), timestamp.text);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_edge_cases);
+    RUN_TEST(test_timestamps);
+    return UNITY_END();
+}
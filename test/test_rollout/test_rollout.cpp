@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+#include <vector>
+
+#include "rollout.h"
+
+#define PANELS 10000
+
+static const int64_t publishedAt = 1767225600;
+
+// Panel ids as checkForUpdates makes them, "%012llx" of getEfuseMac(): the MAC bytes in
+// little endian order, the Espressif OUI 24:0a:c4 in the low half
+static void rolloutId(uint32_t nic, char *id, size_t size)
+{
+    uint64_t mac = 0x24 | 0x0a << 8 | 0xc4 << 16 | (uint64_t)(nic >> 16 & 0xff) << 24 | (uint64_t)(nic >> 8 & 0xff) << 32 |
+                   (uint64_t)(nic & 0xff) << 40;
+    snprintf(id, size, "%012llx", (unsigned long long)mac);
+}
+
+void setUp(void)
+{
+    srand(1);
+}
+
+void tearDown(void) {}
+
+static void test_update_sources(void)
+{
+    const struct
+    {
+        const char *url;
+        bool valid;
+        const char *feed;
+        const char *asset;
+    } sources[] = {
+        {"", true, "/repos/elliotmatson/esp32-hub75-status/releases/latest",
+         "https://github.com/elliotmatson/esp32-hub75-status/releases/download/v1.1.0/esp32.bin"},
+        {"http://updates.lan/status/", true, "/status/releases/latest", "http://updates.lan/status/releases/download/v1.1.0/esp32.bin"},
+        {"https://10.0.0.2:8443", true, "/releases/latest", "https://10.0.0.2:8443/releases/download/v1.1.0/esp32.bin"},
+        {"http://updates.lan:80/a", true, "/a/releases/latest", "http://updates.lan/a/releases/download/v1.1.0/esp32.bin"},
+        {"ftp://updates.lan", false, NULL, NULL},
+        {"http://", false, NULL, NULL},
+        {"http://updates.lan:0", false, NULL, NULL},
+        {"http://updates.lan:70000/", false, NULL, NULL},
+        {"http://updates.lan/a b", false, NULL, NULL},
+    };
+    for (const auto &test : sources)
+    {
+        UpdateSource source;
+        TEST_ASSERT_EQUAL_MESSAGE(test.valid, parseUpdateSource(test.url, &source), test.url);
+        if (!test.valid)
+            continue;
+        char feed[UPDATE_PATH_MAX] = "";
+        char asset[UPDATE_URL_MAX] = "";
+        updateFeedPath(source, "elliotmatson/esp32-hub75-status", false, feed, sizeof(feed));
+        updateAssetUrl(source, "elliotmatson/esp32-hub75-status", "v1.1.0", "esp32.bin", asset, sizeof(asset));
+        TEST_ASSERT_EQUAL_STRING(test.feed, feed);
+        TEST_ASSERT_EQUAL_STRING(test.asset, asset);
+    }
+}
+
+// The cohort of a panel id is fixed and spread evenly, for a production batch (consecutive
+// MACs) and MACs from all over. Start times follow the cohort with a spread inside each, and
+// a new release is a new draw of the start in the same cohort.
+static void test_cohorts_even_and_fixed(void)
+{
+    for (int set = 0; set < 2; set++)
+    {
+        uint32_t counts[ROLLOUT_COHORTS] = {};
+        int sameStart = 0;
+        for (int i = 0; i < PANELS; i++)
+        {
+            char id[17];
+            rolloutId(set ? rand() & 0xffffff : 0x1a2b00 + i, id, sizeof(id));
+            Rollout rollout;
+            Rollout again;
+            rollout.begin(id, 24 * 3600, 900);
+            again.begin(id, 24 * 3600, 900);
+            counts[rollout.getCohort()]++;
+            int64_t turn = rollout.startTime("v1.1.0", publishedAt);
+            TEST_ASSERT_EQUAL_UINT8(rolloutCohort(id), rollout.getCohort());
+            TEST_ASSERT_EQUAL_UINT8(rollout.getCohort(), again.getCohort());
+            TEST_ASSERT_EQUAL_INT64(turn, again.startTime("v1.1.0", publishedAt));
+            int64_t base = publishedAt + (int64_t)24 * 3600 * rollout.getCohort() / ROLLOUT_COHORTS;
+            TEST_ASSERT_TRUE_MESSAGE(turn >= base && turn < base + 900, "start outside the cohort's window");
+            sameStart += rollout.startTime("v1.2.0", publishedAt) == turn;
+        }
+        double expected = (double)PANELS / ROLLOUT_COHORTS;
+        double chi2 = 0;
+        for (uint32_t count : counts)
+            chi2 += (count - expected) * (count - expected) / expected;
+        // 99 degrees of freedom, p = 0.001
+        TEST_ASSERT_TRUE_MESSAGE(chi2 <= 148.2, "cohorts not spread evenly");
+        TEST_ASSERT_LESS_OR_EQUAL(PANELS / 100, sameStart);
+    }
+}
+
+// Downloads at once for the whole fleet, each a minute long, panels polling a minute apart:
+// the peak falls with the rollout window
+static void test_peak_downloads_fall_with_window(void)
+{
+    for (int rolloutHours : {1, 6, 24})
+    {
+        std::vector<double> starts;
+        for (int i = 0; i < PANELS; i++)
+        {
+            char id[17];
+            rolloutId(rand() & 0xffffff, id, sizeof(id));
+            Rollout rollout;
+            rollout.begin(id, rolloutHours * 3600, 900);
+            double boot = (rand() % 60000) / 1000.0;
+            int64_t turn = rollout.startTime("v1.1.0", publishedAt) - publishedAt;
+            // the first check at or after the turn
+            starts.push_back(turn <= boot ? boot : boot + ceil((turn - boot) / 60.0) * 60);
+        }
+        std::sort(starts.begin(), starts.end());
+        uint32_t peak = 0;
+        for (size_t i = 0, first = 0; i < starts.size(); i++)
+        {
+            while (starts[first] + 60 <= starts[i])
+                first++;
+            peak = std::max(peak, (uint32_t)(i - first + 1));
+        }
+        TEST_ASSERT_LESS_OR_EQUAL((uint64_t)PANELS * 60 * 4, peak * (uint64_t)rolloutHours * 3600);
+    }
+}
+
+static void test_wait_until_turn(void)
+{
+    Rollout rollout;
+    rollout.begin("c4a00a2b1a24", 3600, 900);
+    int64_t turn = rollout.startTime("v1.1.0", publishedAt);
+    TEST_ASSERT_EQUAL_UINT32(turn - publishedAt, rollout.wait("v1.1.0", publishedAt, publishedAt));
+    TEST_ASSERT_EQUAL_UINT32(0, rollout.wait("v1.1.0", publishedAt, turn));
+    // no clock or no publish time to go by
+    TEST_ASSERT_EQUAL_UINT32(0, rollout.wait("v1.1.0", publishedAt, 0));
+    TEST_ASSERT_EQUAL_UINT32(0, rollout.wait("v1.1.0", -1, publishedAt));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_update_sources);
+    RUN_TEST(test_cohorts_even_and_fixed);
+    RUN_TEST(test_peak_downloads_fall_with_window);
+    RUN_TEST(test_wait_until_turn);
+    return UNITY_END();
+}
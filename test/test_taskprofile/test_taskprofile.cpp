@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "taskprofile.h"
+
+static TaskProfiler profiler;
+static TaskSample samples[PROFILE_TASKS_MAX + 4];
+static uint32_t total;
+
+// Three tasks with counters just below the wrap, sampled three times 1000000 ticks apart
+void setUp(void)
+{
+    profiler = TaskProfiler();
+    samples[0] = {"IDLE0", 1, 0, 600, 0};
+    samples[1] = {"Render", 2, 0, 3000, 5};
+    samples[2] = {"Animate", 3, 0, 1200, 4};
+    total = UINT32_MAX - 1500000;
+    samples[0].runtime = total - 300000;
+    profiler.sample(0, samples, 3, total);
+    const uint32_t shares[3] = {700, 250, 50};
+    for (int n = 1; n <= 3; n++)
+    {
+        total += 1000000;
+        for (int t = 0; t < 3; t++)
+            samples[t].runtime += shares[t] * 1000;
+        samples[1].stackFree -= 100;
+        profiler.sample(n * 5000000LL, samples, 3, total);
+    }
+}
+
+void tearDown(void) {}
+
+static void test_cpu_shares_across_counter_wrap(void)
+{
+    const uint16_t shares[3] = {700, 250, 50};
+    for (int age = 0; age < 3; age++)
+    {
+        for (int t = 0; t < 3; t++)
+            TEST_ASSERT_EQUAL_UINT16(shares[t], profiler.get(age).cpuPermille[t]);
+    }
+    // the first sample only sets the counters
+    TEST_ASSERT_EQUAL_UINT16(0, profiler.get(3).cpuPermille[0]);
+    TEST_ASSERT_EQUAL_UINT32(2700, profiler.getTask(1).stackFree);
+}
+
+// A task ends: a new task must not take its slot while snapshots still show it, once none
+// in the ring does the slot goes to the next new task
+static void test_ended_task_slot_kept_until_forgotten(void)
+{
+    samples[2] = {"Prefetch", 4, 0, 2000, 1};
+    for (int n = 0; n < PROFILE_HISTORY + 2; n++)
+    {
+        total += 1000000;
+        samples[0].runtime += 1000000;
+        profiler.sample(0, samples, 3, total);
+        TEST_ASSERT_EQUAL_STRING("Animate", profiler.getTask(2).name);
+    }
+    TEST_ASSERT_EQUAL_STRING("Prefetch", profiler.getTask(3).name);
+    samples[3] = {"Check For OTA", 5, 0, 4000, 1};
+    profiler.sample(0, samples, 4, total);
+    TEST_ASSERT_EQUAL_STRING("Check For OTA", profiler.getTask(2).name);
+}
+
+// More tasks than slots: the rest are counted
+static void test_tasks_beyond_slots_are_counted(void)
+{
+    static char names[PROFILE_TASKS_MAX + 4][PROFILE_NAME_LEN];
+    for (int t = 0; t < PROFILE_TASKS_MAX + 4; t++)
+    {
+        snprintf(names[t], sizeof(names[t]), "task%d", t);
+        samples[t] = {names[t], 100u + t, 0, 1000, 1};
+    }
+    TaskProfiler full;
+    full.sample(0, samples, PROFILE_TASKS_MAX + 4, 0);
+    TEST_ASSERT_EQUAL_UINT32(4, full.getUntracked());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_cpu_shares_across_counter_wrap);
+    RUN_TEST(test_ended_task_slot_kept_until_forgotten);
+    RUN_TEST(test_tasks_beyond_slots_are_counted);
+    return UNITY_END();
+}
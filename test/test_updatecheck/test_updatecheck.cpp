@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <stdint.h>
+#include <unity.h>
+
+#include "httpssession.h"
+#include "tcptransport.h"
+#include "updatecheck.h"
+
+#define INTERVAL_MS 60000
+#define MAX_BACKOFF_MS 3600000
+
+// the checker only asks the session for a Retry-After, none was sent
+static TcpTransport transport;
+static HttpsSession session(transport);
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// Each retry waits about twice as long, the first success resets the interval
+static void test_failures_back_off_exponentially(void)
+{
+    UpdateChecker checker(session, INTERVAL_MS, MAX_BACKOFF_MS);
+    checker.seed(1);
+    for (int i = 0; i < 5; i++)
+    {
+        uint32_t delayMs = checker.done(UPDATE_FAILED);
+        uint32_t backoff = INTERVAL_MS << (i + 1);
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(backoff / 2, delayMs);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(backoff, delayMs);
+    }
+    TEST_ASSERT_EQUAL_UINT32(5, checker.getStats().consecutiveFailures);
+    TEST_ASSERT_EQUAL_UINT32(INTERVAL_MS, checker.done(UPDATE_UNCHANGED));
+    TEST_ASSERT_EQUAL_UINT32(0, checker.getStats().consecutiveFailures);
+}
+
+static void test_backoff_is_capped(void)
+{
+    UpdateChecker checker(session, INTERVAL_MS, MAX_BACKOFF_MS);
+    uint32_t delayMs = 0;
+    for (int i = 0; i < 40; i++)
+    {
+        delayMs = checker.done(UPDATE_FAILED);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(MAX_BACKOFF_MS, delayMs);
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(MAX_BACKOFF_MS / 2, delayMs);
+}
+
+// A fleet failing at once spreads its retries over half the backoff
+static void test_fleet_retries_spread_out(void)
+{
+    uint32_t earliest = UINT32_MAX;
+    uint32_t latest = 0;
+    for (uint32_t panel = 1; panel <= 1000; panel++)
+    {
+        UpdateChecker fleet(session, INTERVAL_MS, MAX_BACKOFF_MS);
+        fleet.seed(panel * 2654435761u);
+        uint32_t delayMs = 0;
+        for (int i = 0; i < 3; i++)
+            delayMs = fleet.done(UPDATE_FAILED);
+        earliest = std::min(earliest, delayMs);
+        latest = std::max(latest, delayMs);
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(INTERVAL_MS * 8 / 2 * 9 / 10, latest - earliest);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_failures_back_off_exponentially);
+    RUN_TEST(test_backoff_is_capped);
+    RUN_TEST(test_fleet_retries_spread_out);
+    return UNITY_END();
+}